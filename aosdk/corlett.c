@@ -135,7 +135,7 @@ int corlett_decode(uint8 *input, uint32 input_len, uint8 **output, uint64 *size,
 		// Resize memory buffer to what we actually need
 		decomp_dat = realloc(decomp_dat, (size_t)decomp_length + 1);
 	}
-	if (payload_type == 2 && comp_length > 0)
+	else if (payload_type == 2 && comp_length > 0)
 	{
 		// Check CRC is correct
 		actual_crc = crc32(0, (unsigned char *)&buf[4+(res_area/4)], comp_length);
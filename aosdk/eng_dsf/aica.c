@@ -92,6 +92,12 @@ static const double DRTimes[64]={100000/*infinity*/,100000/*infinity*/,118200.0,
 static UINT32 FNS_Table[0x400];
 static INT32 EG_TABLE[0x400];
 
+// Like FNS_Table and EG_TABLE, the level/pan tables are the same for every AICA,
+// so AICA_InitTables() only makes them once
+static int LPANTABLE[0x20000];
+static int RPANTABLE[0x20000];
+static int TablesMade;
+
 typedef enum {ATTACK,DECAY1,DECAY2,RELEASE} _STATE;
 struct _EG
 {
@@ -133,6 +139,7 @@ struct _SLOT
 	int cur_lpquant, cur_lpsample, cur_lpstep;
 	UINT8 *adbase, *adlpbase;
 	UINT8 mslc;			// monitored?
+	UINT8 mute;			// muted by the player, see AICA_MuteSlot
 };
 
 
@@ -190,9 +197,6 @@ struct _AICA
 	UINT8 MidiStack[16];
 	UINT8 MidiW,MidiR;
 
-	int LPANTABLE[0x20000];
-	int RPANTABLE[0x20000];
-
 	int TimPris[3];
 	int TimCnt[3];
 
@@ -483,35 +487,9 @@ static void AICA_StopSlot(struct _SLOT *slot,int keyoff)
 
 #define log_base_2(n) (log((float) n)/log((float) 2))
 
-static void AICA_Init(struct _AICA *AICA, const struct AICAinterface *intf)
+static void AICA_InitTables(void)
 {
-	int i=0;
-
-	AICA->IrqTimA = AICA->IrqTimBC = AICA->IrqMidi = 0;
-	AICA->MidiR=AICA->MidiW=0;
-	AICA->MidiOutR=AICA->MidiOutW=0;
-
-	// get AICA RAM
-	{
-		memset(AICA,0,sizeof(*AICA));
-
-		if (!i)
-		{
-			AICA->Master=1;
-		}
-		else
-		{
-			AICA->Master=0;
-		}
-
-		if (intf->region)
-		{
-			AICA->AICARAM = &dc_ram[0];
-			AICA->AICARAM_LENGTH = 2*1024*1024;
-			AICA->DSP.AICARAM = (UINT16 *)AICA->AICARAM;
-			AICA->DSP.AICARAM_LENGTH =  (2*1024*1024)/2;
-		}
-	}
+	int i;
 
 	for(i=0;i<0x400;++i)
 	{
@@ -574,10 +552,46 @@ static void AICA_Init(struct _AICA *AICA, const struct AICAinterface *intf)
 		else
 			fSDL=0.0;
 
-		AICA->LPANTABLE[i]=FIX((4.0*LPAN*TL*fSDL));
-		AICA->RPANTABLE[i]=FIX((4.0*RPAN*TL*fSDL));
+		LPANTABLE[i]=FIX((4.0*LPAN*TL*fSDL));
+		RPANTABLE[i]=FIX((4.0*RPAN*TL*fSDL));
+	}
+
+	TablesMade=1;
+}
+
+static void AICA_Init(struct _AICA *AICA, const struct AICAinterface *intf)
+{
+	int i=0;
+
+	AICA->IrqTimA = AICA->IrqTimBC = AICA->IrqMidi = 0;
+	AICA->MidiR=AICA->MidiW=0;
+	AICA->MidiOutR=AICA->MidiOutW=0;
+
+	// get AICA RAM
+	{
+		memset(AICA,0,sizeof(*AICA));
+
+		if (!i)
+		{
+			AICA->Master=1;
+		}
+		else
+		{
+			AICA->Master=0;
+		}
+
+		if (intf->region)
+		{
+			AICA->AICARAM = &dc_ram[0];
+			AICA->AICARAM_LENGTH = 2*1024*1024;
+			AICA->DSP.AICARAM = (UINT16 *)AICA->AICARAM;
+			AICA->DSP.AICARAM_LENGTH =  (2*1024*1024)/2;
+		}
 	}
 
+	if(!TablesMade)
+		AICA_InitTables();
+
 	AICA->ARTABLE[0]=AICA->DRTABLE[0]=0;	//Infinite time
 	AICA->ARTABLE[1]=AICA->DRTABLE[1]=0;	//Infinite time
 	for(i=2;i<64;++i)
@@ -862,6 +876,7 @@ static void AICA_w16(struct _AICA *AICA,unsigned int addr,unsigned short val)
 	else
 	{
 		//DSP
+		AICA->DSP.Dirty=1;
 		if(addr<0x3200)	//COEF
 			*((unsigned short *) (AICA->DSP.COEF+(addr-0x3000)/2))=val;
 		else if(addr<0x3400)
@@ -957,6 +972,67 @@ void AICA_TimersAddTicks(struct _AICA *AICA, int ticks)
 	}
 }
 
+// moves a slot's play position one sample on and handles the loop modes,
+// returns the new (integer) play address
+INLINE UINT32 AICA_StepSlot(struct _AICA *AICA, struct _SLOT *slot, int step)
+{
+	UINT32 addr1,addr2;
+
+	slot->prv_addr=slot->cur_addr;
+	slot->cur_addr+=step;
+	slot->nxt_addr=slot->cur_addr+(1<<SHIFT);
+
+	addr1=slot->cur_addr>>SHIFT;
+	addr2=slot->nxt_addr>>SHIFT;
+
+	if(addr1>=LSA(slot))
+	{
+		if(LPSLNK(slot) && slot->EG.state==ATTACK)
+			slot->EG.state = DECAY1;
+	}
+
+	switch(LPCTL(slot))
+	{
+	case 0:	//no loop
+		if(addr2>=LSA(slot) && addr2>=LEA(slot)) // if next sample exceed then current must exceed too
+		{
+		//slot->active=0;
+		if(slot->mslc) AICA->udata.data[8] |= 0x8000;
+		AICA_StopSlot(slot,0);
+		}
+		break;
+	case 1: //normal loop
+		if(addr2>=LEA(slot))
+		{
+			INT32 rem_addr;
+			if(slot->mslc) AICA->udata.data[8] |= 0x8000;
+			rem_addr = slot->nxt_addr - (LEA(slot)<<SHIFT);
+			slot->nxt_addr = (LSA(slot)<<SHIFT) + rem_addr;
+			if(addr1>=LEA(slot))
+			{
+				rem_addr = slot->cur_addr - (LEA(slot)<<SHIFT);
+				slot->cur_addr = (LSA(slot)<<SHIFT) + rem_addr;
+			}
+				
+			if(PCMS(slot)>=2)
+			{
+				// restore the state @ LSA - the sampler will naturally walk to (LSA + remainder)
+				slot->adbase = &AICA->AICARAM[SA(slot)+(LSA(slot)/2)];
+				slot->curstep = LSA(slot);
+				if (PCMS(slot) == 2)
+				{
+					slot->cur_sample = slot->cur_lpsample;
+					slot->cur_quant = slot->cur_lpquant;
+				}
+//printf("Looping: slot_addr %x LSA %x LEA %x step %x base %x\n", slot->cur_addr>>SHIFT, LSA(slot), LEA(slot), slot->curstep, slot->adbase);
+			}
+		}
+		break;
+	}
+
+	return addr1;
+}
+
 INLINE INT32 AICA_UpdateSlot(struct _AICA *AICA, struct _SLOT *slot)
 {
 	INT32 sample, fpart;
@@ -1037,57 +1113,7 @@ INLINE INT32 AICA_UpdateSlot(struct _AICA *AICA, struct _SLOT *slot)
 	sample=cur_sample*((1<<SHIFT)-fpart)+nxt_sample*fpart;
 	sample>>=SHIFT;	
 
-	slot->prv_addr=slot->cur_addr;
-	slot->cur_addr+=step;
-	slot->nxt_addr=slot->cur_addr+(1<<SHIFT);
-
-	addr1=slot->cur_addr>>SHIFT;
-	addr2=slot->nxt_addr>>SHIFT;
-
-	if(addr1>=LSA(slot))
-	{
-		if(LPSLNK(slot) && slot->EG.state==ATTACK)
-			slot->EG.state = DECAY1;
-	}
-
-	switch(LPCTL(slot))
-	{
-	case 0:	//no loop
-		if(addr2>=LSA(slot) && addr2>=LEA(slot)) // if next sample exceed then current must exceed too
-		{
-		//slot->active=0;
-		if(slot->mslc) AICA->udata.data[8] |= 0x8000;
-		AICA_StopSlot(slot,0);
-		}
-		break;
-	case 1: //normal loop
-		if(addr2>=LEA(slot))
-		{
-			INT32 rem_addr;
-			if(slot->mslc) AICA->udata.data[8] |= 0x8000;
-			rem_addr = slot->nxt_addr - (LEA(slot)<<SHIFT);
-			slot->nxt_addr = (LSA(slot)<<SHIFT) + rem_addr;
-			if(addr1>=LEA(slot))
-			{
-				rem_addr = slot->cur_addr - (LEA(slot)<<SHIFT);
-				slot->cur_addr = (LSA(slot)<<SHIFT) + rem_addr;
-			}
-				
-			if(PCMS(slot)>=2)
-			{
-				// restore the state @ LSA - the sampler will naturally walk to (LSA + remainder)
-				slot->adbase = &AICA->AICARAM[SA(slot)+(LSA(slot)/2)];
-				slot->curstep = LSA(slot);
-				if (PCMS(slot) == 2)
-				{
-					slot->cur_sample = slot->cur_lpsample;
-					slot->cur_quant = slot->cur_lpquant;
-				}
-//printf("Looping: slot_addr %x LSA %x LEA %x step %x base %x\n", slot->cur_addr>>SHIFT, LSA(slot), LEA(slot), slot->curstep, slot->adbase);
-			}
-		}
-		break;
-	}
+	addr1=AICA_StepSlot(AICA, slot, step);
 
 	if(ALFOS(slot)!=0)
 	{
@@ -1125,6 +1151,30 @@ INLINE INT32 AICA_UpdateSlot(struct _AICA *AICA, struct _SLOT *slot)
 	return sample;
 }
 
+// a muted PCM slot that isn't being monitored: the same position, LFO and
+// EG stepping as AICA_UpdateSlot, without fetching the sample (ADPCM slots
+// always go through AICA_UpdateSlot, their decoder state has to keep up)
+INLINE void AICA_SkipSlot(struct _AICA *AICA, struct _SLOT *slot)
+{
+	int step=slot->step;
+
+	if(SSCTL(slot)!=0)	//no FM or noise yet
+		return;
+
+	if(PLFOS(slot)!=0)
+	{
+		step=step*AICAPLFO_Step(&(slot->PLFO));
+		step>>=SHIFT;
+	}
+
+	AICA_StepSlot(AICA, slot, step);
+
+	if(ALFOS(slot)!=0)
+		AICAALFO_Step(&(slot->ALFO));
+
+	EG_Update(slot);
+}
+
 static void AICA_DoMasterSamples(struct _AICA *AICA, int nsamples)
 {
 	INT16 *bufr,*bufl;
@@ -1150,14 +1200,20 @@ static void AICA_DoMasterSamples(struct _AICA *AICA, int nsamples)
 				unsigned int Enc;
 				signed int sample;
 
-				sample=AICA_UpdateSlot(AICA, slot);
-
-				Enc=((TL(slot))<<0x0)|((IMXL(slot))<<0xd);
-				AICADSP_SetSample(&AICA->DSP,(sample*AICA->LPANTABLE[Enc])>>(SHIFT-2),ISEL(slot),IMXL(slot));
-				Enc=((TL(slot))<<0x0)|((DIPAN(slot))<<0x8)|((DISDL(slot))<<0xd);
+				if(slot->mute && PCMS(slot)<2 && !slot->mslc)
+					AICA_SkipSlot(AICA, slot);
+				else
 				{
-					smpl+=(sample*AICA->LPANTABLE[Enc])>>SHIFT;
-					smpr+=(sample*AICA->RPANTABLE[Enc])>>SHIFT;
+					sample=AICA_UpdateSlot(AICA, slot);
+
+					if(!slot->mute)
+					{
+						Enc=((TL(slot))<<0x0)|((IMXL(slot))<<0xd);
+						AICADSP_SetSample(&AICA->DSP,(sample*LPANTABLE[Enc])>>(SHIFT-2),ISEL(slot),IMXL(slot));
+						Enc=((TL(slot))<<0x0)|((DIPAN(slot))<<0x8)|((DISDL(slot))<<0xd);
+						smpl+=(sample*LPANTABLE[Enc])>>SHIFT;
+						smpr+=(sample*RPANTABLE[Enc])>>SHIFT;
+					}
 				}
 			}
 			
@@ -1173,8 +1229,8 @@ static void AICA_DoMasterSamples(struct _AICA *AICA, int nsamples)
 			if(EFSDL(i))
 			{
 				unsigned int Enc=((EFPAN(i))<<0x8)|((EFSDL(i))<<0xd);
-				smpl+=(AICA->DSP.EFREG[i]*AICA->LPANTABLE[Enc])>>SHIFT;
-				smpr+=(AICA->DSP.EFREG[i]*AICA->RPANTABLE[Enc])>>SHIFT;
+				smpl+=(AICA->DSP.EFREG[i]*LPANTABLE[Enc])>>SHIFT;
+				smpr+=(AICA->DSP.EFREG[i]*RPANTABLE[Enc])>>SHIFT;
 			}
 		}
 
@@ -1201,6 +1257,112 @@ void AICA_Update(void *param, INT16 **inputs, INT16 **buf, int samples)
 	AICA_DoMasterSamples(AICA, samples);
 }
 
+/*
+    Scheduler support.  dc_hw.c lets the ARM7 run ahead of the sound
+    output and renders deferred samples in one AICA_Update() batch; these
+    tell it how far it may run ahead and which parts of sound RAM the chip
+    itself touches while rendering.
+*/
+
+int AICA_SamplesToNextEvent(void)
+{
+	struct _AICA *AICA = AllocedAICA;
+	UINT32 pend=AICA->udata.data[0xa0/2];
+	UINT32 en=AICA->udata.data[0x9c/2];
+	int i, n, samples = 0x7fffffff;
+
+	// CheckPendingIRQ() re-raises the FIQ after every sample, stay in lockstep
+	if(AICA->MidiW!=AICA->MidiR || (pend&en&0x1c0))
+		return 1;
+
+	// otherwise the next change comes from a timer expiring
+	for(i=0;i<3;++i)
+	{
+		if(AICA->TimCnt[i]<=0xff00)
+		{
+			int step=1<<(8-((AICA->udata.data[(0x90/2)+(i*2)]>>8)&0x7));
+			n=(0xff00-AICA->TimCnt[i]+step-1)/step;
+			if(n<1)
+				n=1;
+			if(n<samples)
+				samples=n;
+		}
+	}
+
+	return samples;
+}
+
+static void AICA_MarkRAM(UINT8 *map, int shift, UINT32 start, UINT32 len, UINT8 flags)
+{
+	UINT32 pages=0x800000>>shift;
+	UINT32 page, count;
+
+	start&=0x7fffff;
+	page=start>>shift;
+	count=((start+len-1)>>shift)-page+1;
+	if(count>pages)
+		count=pages;
+	while(count--)
+	{
+		map[page]|=flags;
+		page=(page+1)&(pages-1);
+	}
+}
+
+void AICA_MarkBusyRAM(UINT8 *map, int shift)
+{
+	struct _AICA *AICA = AllocedAICA;
+	int sl;
+
+	memset(map, 0, 0x800000>>shift);
+
+	for(sl=0;sl<64;++sl)
+	{
+		struct _SLOT *slot=AICA->Slots+sl;
+		UINT32 top;
+
+		if(!slot->active || SSCTL(slot)!=0)
+			continue;
+
+		// highest sample index the slot can fetch before it loops or stops
+		top=LEA(slot);
+		if(LSA(slot)>top)
+			top=LSA(slot);
+		if((slot->cur_addr>>SHIFT)>top)
+			top=slot->cur_addr>>SHIFT;
+		if((slot->nxt_addr>>SHIFT)>top)
+			top=slot->nxt_addr>>SHIFT;
+		top+=((slot->step*2)>>SHIFT)+2;
+		if(PCMS(slot)==0)
+			top*=2;
+		else if(PCMS(slot)>=2)
+			top=(top/2)+1;
+
+		AICA_MarkRAM(map, shift, SA(slot)-4, top+8, AICA_RAM_READ);
+	}
+
+	// the DSP only touches its ring buffer (or a table) through MRD/MWT
+	if(!AICA->DSP.Stopped)
+	{
+		UINT32 len=AICA->DSP.RBL;
+		int flags=0;
+
+		for(sl=0;sl<AICA->DSP.LastStep;++sl)
+		{
+			UINT16 *IPtr=AICA->DSP.MPRO+sl*8;
+
+			if(IPtr[4]&0x2000)
+				flags|=AICA_RAM_READ;
+			if(IPtr[4]&0x4000)
+				flags|=AICA_RAM_WRITE;
+			if((IPtr[4]&0x6000) && (IPtr[4]&0x8000))
+				len=0x10000;
+		}
+		if(flags)
+			AICA_MarkRAM(map, shift, AICA->DSP.RBP<<11, len*2, flags);
+	}
+}
+
 void *aica_start(const void *config)
 {
 	const struct AICAinterface *intf;
@@ -1242,6 +1404,13 @@ void AICA_set_ram_base(int which, void *base)
 	}
 }
 
+void AICA_MuteSlot(int slot, int mute)
+{
+	struct _AICA *AICA = AllocedAICA;
+	if (AICA && slot >= 0 && slot < 64)
+		AICA->Slots[slot].mute = mute ? 1 : 0;
+}
+
 READ16_HANDLER( AICA_0_r )
 {
 	struct _AICA *AICA = AllocedAICA;
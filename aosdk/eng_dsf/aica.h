@@ -28,6 +28,18 @@ int AICA_sh_start(struct AICAinterface *intf);
 void AICA_sh_stop(void);
 void scsp_stop(void);
 
+// scheduler support: how far the CPU may run ahead, and which RAM pages
+// the slots/DSP read or write while rendering
+#define AICA_RAM_READ	(1)
+#define AICA_RAM_WRITE	(2)
+void AICA_Update(void *param, INT16 **inputs, INT16 **buf, int samples);
+int AICA_SamplesToNextEvent(void);
+void AICA_MarkBusyRAM(UINT8 *map, int shift);
+
+// player-side muting: a muted slot keeps stepping its position/LFO/EG but
+// isn't mixed (or fetched, for PCM slots)
+void AICA_MuteSlot(int slot, int mute);
+
 #define READ16_HANDLER(name)	data16_t name(offs_t offset, data16_t mem_mask)
 #define WRITE16_HANDLER(name)	void     name(offs_t offset, data16_t data, data16_t mem_mask)
 
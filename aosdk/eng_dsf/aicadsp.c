@@ -52,11 +52,148 @@ static INT32 UNPACK(UINT16 val)
 	return uval;
 }
 
+//bits of _AICADSP_STEP.FLAGS
+#define DSP_TWT		0x0001
+#define DSP_XSEL	0x0002
+#define DSP_IWT		0x0004
+#define DSP_TABLE	0x0008
+#define DSP_MWT		0x0010	//only set on odd steps, see below
+#define DSP_MRD		0x0020	//only set on odd steps, see below
+#define DSP_EWT		0x0040
+#define DSP_ADRL	0x0080
+#define DSP_FRCL	0x0100
+#define DSP_YRL		0x0200
+#define DSP_NEGB	0x0400
+#define DSP_ZERO	0x0800
+#define DSP_BSEL	0x1000
+#define DSP_NOFL	0x2000
+#define DSP_ADREB	0x4000
+#define DSP_NXADR	0x8000
+#define DSP_MAC		0x10000	//the new ACC is used later on
+
+//liveness of the per-sample registers while translating
+#define L_ACC		0x01
+#define L_SHIFTED	0x02
+#define L_INPUTS	0x04
+#define L_FRC		0x08
+#define L_YREG		0x10
+#define L_ADRS		0x20
+#define L_MEMVAL	0x40
+
 void AICADSP_Init(struct _AICADSP *DSP)
 {
 	memset(DSP,0,sizeof(struct _AICADSP));
 	DSP->RBL=0x8000;
 	DSP->Stopped=1;
+	DSP->Dirty=1;
+}
+
+//Decodes MPRO[0..LastStep) into STEPS, baking in COEF/MADRS and dropping
+//steps whose results are never used. ACC, SHIFTED and the other registers
+//start from 0 on every sample, so nothing is live after the last step; a
+//step is kept only if it writes TEMP/MEMS/RAM/EFREG or a register that a
+//later kept step reads.
+static void AICADSP_Compile(struct _AICADSP *DSP)
+{
+	struct _AICADSP_STEP tmp[128];
+	char keep[128];
+	int live=0;
+	int step;
+
+	for(step=DSP->LastStep-1;step>=0;--step)
+	{
+		UINT16 *IPtr=DSP->MPRO+step*8;
+		struct _AICADSP_STEP *S=&tmp[step];
+		UINT32 F=0;
+		int use=0,def,out;
+		INT32 Y;
+
+		if(IPtr[0]&0x0100) F|=DSP_TWT;
+		if(IPtr[2]&0x8000) F|=DSP_XSEL;
+		if(IPtr[2]&0x0040) F|=DSP_IWT;
+		if(IPtr[4]&0x8000) F|=DSP_TABLE;
+		if(IPtr[4]&0x1000) F|=DSP_EWT;
+		if(IPtr[4]&0x0080) F|=DSP_ADRL;
+		if(IPtr[4]&0x0040) F|=DSP_FRCL;
+		if(IPtr[4]&0x0008) F|=DSP_YRL;
+		if(IPtr[4]&0x0004) F|=DSP_NEGB;
+		if(IPtr[4]&0x0002) F|=DSP_ZERO;
+		if(IPtr[4]&0x0001) F|=DSP_BSEL;
+		if(IPtr[6]&0x8000) F|=DSP_NOFL;
+		if(IPtr[6]&0x0100) F|=DSP_ADREB;
+		if(IPtr[6]&0x0080) F|=DSP_NXADR;
+		if(step&1)	//memory only allowed on odd? DoA inserts NOPs on even
+		{
+			if(IPtr[4]&0x4000) F|=DSP_MWT;
+			if((IPtr[4]&0x2000) && (live&L_MEMVAL)) F|=DSP_MRD;
+		}
+
+		S->TRA=(IPtr[0]>>9)&0x7F;
+		S->TWA=(IPtr[0]>>1)&0x7F;
+		S->YSEL=(IPtr[2]>>13)&0x03;
+		S->IRA=(IPtr[2]>>7)&0x3F;
+		S->IWA=(IPtr[2]>>1)&0x1F;
+		S->EWA=(IPtr[4]>>8)&0x0F;
+		S->SHIFT=(IPtr[4]>>4)&0x03;
+		S->MADRS=DSP->MADRS[((IPtr[6]>>9)&0x3f)<<1];
+		Y=DSP->COEF[step<<1]>>3;	//COEF is 16 bits
+		Y<<=19;
+		Y>>=19;
+		S->Y=Y;
+		assert(S->IRA<0x32);
+
+		//which results of this step are needed
+		out=0;
+		if(live&L_ACC)
+		{
+			F|=DSP_MAC;
+			out|=L_ACC;
+		}
+		if((live&L_SHIFTED) || (F&(DSP_TWT|DSP_MWT|DSP_EWT)) ||
+		   ((F&DSP_FRCL) && (live&L_FRC)) ||
+		   ((F&DSP_ADRL) && S->SHIFT==3 && (live&L_ADRS)))
+			out|=L_SHIFTED;
+		if((live&L_INPUTS) || ((F&DSP_XSEL) && (out&L_ACC)) ||
+		   ((F&DSP_YRL) && (live&L_YREG)) ||
+		   ((F&DSP_ADRL) && S->SHIFT!=3 && (live&L_ADRS)))
+			out|=L_INPUTS;
+		keep[step]=0;
+		if(!out && !(F&(DSP_IWT|DSP_MRD)) &&
+		   !((F&DSP_FRCL) && (live&L_FRC)) && !((F&DSP_YRL) && (live&L_YREG)) &&
+		   !((F&DSP_ADRL) && (live&L_ADRS)))
+			continue;
+
+		//what it overwrites and what it reads
+		def=L_ACC|L_SHIFTED;
+		if(S->IRA<0x32)
+			def|=L_INPUTS;
+		else if(out&L_INPUTS)
+			use|=L_INPUTS;
+		if(F&DSP_FRCL) def|=L_FRC;
+		if(F&DSP_YRL) def|=L_YREG;
+		if(F&DSP_ADRL) def|=L_ADRS;
+		if(F&DSP_MRD) def|=L_MEMVAL;
+		if(F&DSP_IWT) use|=L_MEMVAL;
+		if(out&L_SHIFTED) use|=L_ACC;
+		if(out&L_ACC)
+		{
+			if(!(F&DSP_ZERO) && (F&DSP_BSEL)) use|=L_ACC;
+			if(S->YSEL==0) use|=L_FRC;
+			if(S->YSEL>=2) use|=L_YREG;
+		}
+		if((F&(DSP_MRD|DSP_MWT)) && (F&DSP_ADREB)) use|=L_ADRS;
+		live=(live&~def)|use;
+
+		S->FLAGS=F;
+		keep[step]=1;
+	}
+
+	//the kept steps were marked from the back; pack them in program order
+	DSP->NumSteps=0;
+	for(step=0;step<DSP->LastStep;++step)
+		if(keep[step])
+			DSP->STEPS[DSP->NumSteps++]=tmp[step];
+	DSP->Dirty=0;
 }
 
 void AICADSP_Step(struct _AICADSP *DSP)
@@ -72,257 +209,158 @@ void AICADSP_Step(struct _AICADSP *DSP)
 	INT32 Y_REG=0;		//24 bit
 	UINT32 ADDR=0;
 	UINT32 ADRS_REG=0;	//13 bit
-	int step;
+	struct _AICADSP_STEP *S,*End;
 
 	if(DSP->Stopped)
 		return;
 
+	if(DSP->Dirty)
+		AICADSP_Compile(DSP);
+
 	memset(DSP->EFREG,0,2*16);
-#if 0
-	int dump=0;
-	FILE *f=NULL;
-	if(dump)
-		f=fopen("dsp.txt","wt");
-#endif
-	for(step=0;step</*128*/DSP->LastStep;++step)
+	End=DSP->STEPS+DSP->NumSteps;
+	for(S=DSP->STEPS;S<End;++S)
 	{
-		UINT16 *IPtr=DSP->MPRO+step*8;
-				
-//      if(IPtr[0]==0 && IPtr[1]==0 && IPtr[2]==0 && IPtr[3]==0)
-//          break;
-
-		UINT32 TRA=(IPtr[0]>>9)&0x7F;
-		UINT32 TWT=(IPtr[0]>>8)&0x01;
-		UINT32 TWA=(IPtr[0]>>1)&0x7F;
-
-		UINT32 XSEL=(IPtr[2]>>15)&0x01;
-		UINT32 YSEL=(IPtr[2]>>13)&0x03;
-		UINT32 IRA=(IPtr[2]>>7)&0x3F;
-		UINT32 IWT=(IPtr[2]>>6)&0x01;
-		UINT32 IWA=(IPtr[2]>>1)&0x1F;
-
-		UINT32 TABLE=(IPtr[4]>>15)&0x01;
-		UINT32 MWT=(IPtr[4]>>14)&0x01;
-		UINT32 MRD=(IPtr[4]>>13)&0x01;
-		UINT32 EWT=(IPtr[4]>>12)&0x01;
-		UINT32 EWA=(IPtr[4]>>8)&0x0F;
-		UINT32 ADRL=(IPtr[4]>>7)&0x01;
-		UINT32 FRCL=(IPtr[4]>>6)&0x01;
-		UINT32 SHIFT=(IPtr[4]>>4)&0x03;
-		UINT32 YRL=(IPtr[4]>>3)&0x01;
-		UINT32 NEGB=(IPtr[4]>>2)&0x01;
-		UINT32 ZERO=(IPtr[4]>>1)&0x01;
-		UINT32 BSEL=(IPtr[4]>>0)&0x01;
-
-		UINT32 NOFL=(IPtr[6]>>15)&1;		//????
-		UINT32 COEF=step;
-
-		UINT32 MASA=(IPtr[6]>>9)&0x3f;	//???
-		UINT32 ADREB=(IPtr[6]>>8)&0x1;
-		UINT32 NXADR=(IPtr[6]>>7)&0x1;
-		
-		INT64 v;
+		UINT32 F=S->FLAGS;
 
 		//operations are done at 24 bit precision
-#if 0
-		if(MASA)
-			int a=1;
-		if(NOFL)
-			int a=1;
-
-//      int dump=0;
 
-		if(f)
-		{
-#define DUMP(v)	fprintf(f," " #v ": %04X",v);
-
-			fprintf(f,"%d: ",step);
-			DUMP(ACC);
-			DUMP(SHIFTED);
-			DUMP(X);
-			DUMP(Y);
-			DUMP(B);
-			DUMP(INPUTS);
-			DUMP(MEMVAL);
-			DUMP(FRC_REG);
-			DUMP(Y_REG);
-			DUMP(ADDR);
-			DUMP(ADRS_REG);
-			fprintf(f,"\n");
-		}
-#endif
 		//INPUTS RW
-		assert(IRA<0x32);
-		if(IRA<=0x1f)
-			INPUTS=DSP->MEMS[IRA];
-		else if(IRA<=0x2F)
-			INPUTS=DSP->MIXS[IRA-0x20]<<4;	//MIXS is 20 bit
-		else if(IRA<=0x31)
+		if(S->IRA<=0x1f)
+			INPUTS=DSP->MEMS[S->IRA];
+		else if(S->IRA<=0x2F)
+			INPUTS=DSP->MIXS[S->IRA-0x20]<<4;	//MIXS is 20 bit
+		else if(S->IRA<=0x31)
 			INPUTS=0;
 
 		INPUTS<<=8;
 		INPUTS>>=8;
-		//if(INPUTS&0x00800000)
-		//  INPUTS|=0xFF000000;
 
-		if(IWT)
+		if(F&DSP_IWT)
 		{
-			DSP->MEMS[IWA]=MEMVAL;	//MEMVAL was selected in previous MRD
-			if(IRA==IWA)
+			DSP->MEMS[S->IWA]=MEMVAL;	//MEMVAL was selected in previous MRD
+			if(S->IRA==S->IWA)
 				INPUTS=MEMVAL;
 		}
 
-		//Operand sel
-		//B
-		if(!ZERO)
+		if(F&DSP_MAC)
 		{
-			if(BSEL)
-				B=ACC;
+			//B
+			if(F&DSP_ZERO)
+				B=0;
 			else
 			{
-				B=DSP->TEMP[(TRA+DSP->DEC)&0x7F];
-				B<<=8;
-				B>>=8;
-				//if(B&0x00800000)
-				//  B|=0xFF000000;  //Sign extend
+				if(F&DSP_BSEL)
+					B=ACC;
+				else
+				{
+					B=DSP->TEMP[(S->TRA+DSP->DEC)&0x7F];
+					B<<=8;
+					B>>=8;
+				}
+				if(F&DSP_NEGB)
+					B=0-B;
 			}
-			if(NEGB)
-				B=0-B;
-		}
-		else
-			B=0;
 
-		//X
-		if(XSEL)
-			X=INPUTS;
-		else
-		{
-			X=DSP->TEMP[(TRA+DSP->DEC)&0x7F];
-			X<<=8;
-			X>>=8;
-			//if(X&0x00800000)
-			//  X|=0xFF000000;
+			//X
+			if(F&DSP_XSEL)
+				X=INPUTS;
+			else
+			{
+				X=DSP->TEMP[(S->TRA+DSP->DEC)&0x7F];
+				X<<=8;
+				X>>=8;
+			}
+
+			//Y
+			if(S->YSEL==0)
+				Y=FRC_REG;
+			else if(S->YSEL==1)
+				Y=S->Y;
+			else if(S->YSEL==2)
+				Y=(Y_REG>>11)&0x1FFF;
+			else
+				Y=(Y_REG>>4)&0x0FFF;
+			Y<<=19;
+			Y>>=19;
 		}
 
-		//Y
-		if(YSEL==0)
-			Y=FRC_REG;
-		else if(YSEL==1)
-			Y=DSP->COEF[COEF<<1]>>3;	//COEF is 16 bits
-		else if(YSEL==2)
-			Y=(Y_REG>>11)&0x1FFF;
-		else if(YSEL==3)
-			Y=(Y_REG>>4)&0x0FFF;
-
-		if(YRL)
+		if(F&DSP_YRL)
 			Y_REG=INPUTS;
 
 		//Shifter
-		if(SHIFT==0)
-		{
-			SHIFTED=ACC;
-			if(SHIFTED>0x007FFFFF)
-				SHIFTED=0x007FFFFF;
-			if(SHIFTED<(-0x00800000))
-				SHIFTED=-0x00800000;
-		}
-		else if(SHIFT==1)
+		SHIFTED=(S->SHIFT==1 || S->SHIFT==2) ? ACC*2 : ACC;
+		if(S->SHIFT<2)
 		{
-			SHIFTED=ACC*2;
 			if(SHIFTED>0x007FFFFF)
 				SHIFTED=0x007FFFFF;
 			if(SHIFTED<(-0x00800000))
 				SHIFTED=-0x00800000;
 		}
-		else if(SHIFT==2)
-		{
-			SHIFTED=ACC*2;
-			SHIFTED<<=8;
-			SHIFTED>>=8;
-			//SHIFTED&=0x00FFFFFF;
-			//if(SHIFTED&0x00800000)
-			//  SHIFTED|=0xFF000000;
-		}
-		else if(SHIFT==3)
+		else
 		{
-			SHIFTED=ACC;
 			SHIFTED<<=8;
 			SHIFTED>>=8;
-			//SHIFTED&=0x00FFFFFF;
-			//if(SHIFTED&0x00800000)
-			//  SHIFTED|=0xFF000000;
 		}
 
 		//ACCUM
-		Y<<=19;
-		Y>>=19;
-		//if(Y&0x1000)
-		//  Y|=0xFFFFF000;
-
-		v=(((INT64) X*(INT64) Y)>>12);
-		ACC=(int) v+B;
+		if(F&DSP_MAC)
+			ACC=(int) (((INT64) X*(INT64) Y)>>12)+B;
 
-		if(TWT)
-			DSP->TEMP[(TWA+DSP->DEC)&0x7F]=SHIFTED;
+		if(F&DSP_TWT)
+			DSP->TEMP[(S->TWA+DSP->DEC)&0x7F]=SHIFTED;
 
-		if(FRCL)
+		if(F&DSP_FRCL)
 		{
-			if(SHIFT==3)
+			if(S->SHIFT==3)
 				FRC_REG=SHIFTED&0x0FFF;
 			else
 				FRC_REG=(SHIFTED>>11)&0x1FFF;
 		}
 
-		if(MRD || MWT)
-		//if(0)
+		if(F&(DSP_MRD|DSP_MWT))
 		{
-			ADDR=DSP->MADRS[MASA<<1];
-			if(!TABLE)
+			ADDR=S->MADRS;
+			if(!(F&DSP_TABLE))
 				ADDR+=DSP->DEC;
-			if(ADREB)
+			if(F&DSP_ADREB)
 				ADDR+=ADRS_REG&0x0FFF;
-			if(NXADR)
+			if(F&DSP_NXADR)
 				ADDR++;
-			if(!TABLE)
+			if(!(F&DSP_TABLE))
 				ADDR&=DSP->RBL-1;
 			else
 				ADDR&=0xFFFF;
-			//ADDR<<=1;
-			//ADDR+=DSP->RBP<<13;
-			//MEMVAL=DSP->AICARAM[ADDR>>1];
 			ADDR+=DSP->RBP<<10;
-			if(MRD && (step&1))	//memory only allowed on odd? DoA inserts NOPs on even
+			if(F&DSP_MRD)
 			{
-				if(NOFL)
+				if(F&DSP_NOFL)
 					MEMVAL=DSP->AICARAM[ADDR]<<8;
 				else
 					MEMVAL=UNPACK(DSP->AICARAM[ADDR]);
 			}
-			if(MWT && (step&1))
+			if(F&DSP_MWT)
 			{
-				if(NOFL)
+				if(F&DSP_NOFL)
 					DSP->AICARAM[ADDR]=SHIFTED>>8;
 				else
 					DSP->AICARAM[ADDR]=PACK(SHIFTED);
 			}
 		}
 
-		if(ADRL)
+		if(F&DSP_ADRL)
 		{
-			if(SHIFT==3)
+			if(S->SHIFT==3)
 				ADRS_REG=(SHIFTED>>12)&0xFFF;
 			else
 				ADRS_REG=(INPUTS>>16);
 		}
 
-		if(EWT)
-			DSP->EFREG[EWA]+=SHIFTED>>8;
-
+		if(F&DSP_EWT)
+			DSP->EFREG[S->EWA]+=SHIFTED>>8;
 	}
 	--DSP->DEC;
 	memset(DSP->MIXS,0,4*16);
-//  if(f)
-//      fclose(f);
 }
 
 void AICADSP_SetSample(struct _AICADSP *DSP,INT32 sample,int SEL,int MXL)
@@ -345,5 +383,6 @@ void AICADSP_Start(struct _AICADSP *DSP)
 			break;
 	}
 	DSP->LastStep=i+1;
+	DSP->Dirty=1;
 
 }
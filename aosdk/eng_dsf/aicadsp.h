@@ -1,6 +1,15 @@
 #ifndef AICADSP_H
 #define AICADSP_H
 
+//one step of the translated microprogram
+struct _AICADSP_STEP
+{
+	UINT32 FLAGS;	//DSP_* bits, see aicadsp.c
+	INT32 Y;	//13 bit COEF operand (YSEL=1), sign extended
+	UINT16 MADRS;
+	UINT8 TRA,TWA,IRA,IWA,EWA,SHIFT,YSEL;
+};
+
 //the DSP Context
 struct _AICADSP
 {
@@ -28,6 +37,11 @@ struct _AICADSP
 
 	int Stopped;
 	int LastStep;
+
+//translated program, rebuilt by AICADSP_Step when Dirty is set
+	struct _AICADSP_STEP STEPS[128];
+	int NumSteps;
+	int Dirty;	//set on any MPRO/COEF/MADRS write
 };
 
 void AICADSP_Init(struct _AICADSP *DSP);
@@ -55,6 +55,8 @@ void ARM7_Init ()
   ARM7.overflow = 0;
   ARM7.flagi = FALSE;
   ARM7.cykle = 0;
+  // new program, nothing decoded yet
+  ARM7i_FlushCache ();
 
   // reset will do the rest
   ARM7_HardReset ();
@@ -4,6 +4,8 @@
 // (c) Radoslaw Balcewicz
 //
 
+#include <string.h>
+
 #include "arm7.h"
 #include "arm7i.h"
 
@@ -14,6 +16,9 @@
  that on all stores and jumps. */
 #define PC_ADJUSTMENT (-4)
 
+  /** Number of entries in the decoded instruction cache (power of 2). */
+#define ARM7I_CACHE_SIZE (1 << 14)
+
   /** Memory access routines. */
 #include "arm7memil.c"
 
@@ -125,6 +130,9 @@ static void R_G110 (void);
   /** Group 111 opcodes. */
 static void R_G111 (void);
 
+  /** Picks the handler for an instruction code. */
+static void (*R_Handler (UINT32 kod)) (void);
+
 #ifdef ARM7_THUMB
   /** Halfword and Signed Data Transfer. */
 static void R_HSDT ();
@@ -146,6 +154,27 @@ static int s_tabAL [16] = {FALSE, FALSE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE,
 
   /** Cycles it took for current instruction to complete. */
 static int s_cykle;
+
+  /** Decoded instruction cache entry. */
+struct sKod
+  {
+  /** Address of the instruction, ~0 if the entry is empty. */
+  UINT32 adres;
+  /** Instruction code. */
+  UINT32 kod;
+  /** Handler picked by R_Handler. */
+  void (*rozkaz) (void);
+  };
+
+  /** Decoded instruction cache, direct mapped by address. */
+static struct sKod s_tabKod [ARM7I_CACHE_SIZE];
+  //--------------------------------------------------------------------------
+
+  //--------------------------------------------------------------------------
+  // public data
+
+  /** Pages that may have decoded instructions in the cache. */
+UINT8 ARM7i_CodePages [0x800000 >> ARM7I_CODE_PAGE_SHIFT];
   //--------------------------------------------------------------------------
 
 
@@ -156,23 +185,100 @@ static int s_cykle;
   /** Single step, returns number of burned cycles. */
 int ARM7i_Step ()
   {
-  ARM7.kod = arm7_read_32 (ARM7.Rx [ARM7_PC] & ~3);
+  UINT32 adres = ARM7.Rx [ARM7_PC] & ~3;
+  struct sKod *k = &s_tabKod [(adres >> 2) & (ARM7I_CACHE_SIZE - 1)];
+  void (*rozkaz) (void);
+
+  if (k->adres == adres)
+    {
+    // already decoded
+    ARM7.kod = k->kod;
+    rozkaz = k->rozkaz;
+    }
+  else
+    {
+    ARM7.kod = arm7_read_32 (adres);
+    rozkaz = R_Handler (ARM7.kod);
+    // keep it unless something other than us could change it unseen
+    if (arm7_code_cacheable (adres))
+      {
+      k->adres = adres;
+      k->kod = ARM7.kod;
+      k->rozkaz = rozkaz;
+      ARM7i_CodePages [adres >> ARM7I_CODE_PAGE_SHIFT] = TRUE;
+      }
+    }
 
   // we increment PC here, and if there's a load from memory it will simply
   // overwrite it (all PC modyfing code should be aware of this)
   ARM7.Rx [ARM7_PC] += 4;
   s_cykle = 2;
-  // condition test and group selection
-  if (s_tabWar [(ARM7.kod >> 28) & 15] ())
-    s_tabGrup [(ARM7.kod >> 25) & 7] ();
+  // condition test (skipped for the common "always") and execution
+  if ((ARM7.kod >> 28) == 14 || s_tabWar [(ARM7.kod >> 28) & 15] ())
+    rozkaz ();
   return s_cykle;
   }
   //--------------------------------------------------------------------------
 
+  //--------------------------------------------------------------------------
+  /** Empties the decoded instruction cache. */
+void ARM7i_FlushCache ()
+  {
+  int i;
+
+  for (i = 0; i < ARM7I_CACHE_SIZE; i++)
+    s_tabKod [i].adres = ~0;
+  memset (ARM7i_CodePages, 0, sizeof (ARM7i_CodePages));
+  }
+  //--------------------------------------------------------------------------
+
+  //--------------------------------------------------------------------------
+  /** Drops decoded instructions in [adres, adres + len) from the cache. */
+void ARM7i_InvalidateCode (UINT32 adres, UINT32 len)
+  {
+  UINT32 koniec = adres + len, a;
+  struct sKod *k;
+
+  for (a = adres & ~3; a < koniec; a += 4)
+    {
+    k = &s_tabKod [(a >> 2) & (ARM7I_CACHE_SIZE - 1)];
+    if (k->adres == a)
+      k->adres = ~0;
+    }
+
+  // pages covered entirely have nothing cached anymore
+  for (a = (adres + (1 << ARM7I_CODE_PAGE_SHIFT) - 1) >> ARM7I_CODE_PAGE_SHIFT;
+ (a + 1) << ARM7I_CODE_PAGE_SHIFT <= koniec && a < sizeof (ARM7i_CodePages); a++)
+    ARM7i_CodePages [a] = FALSE;
+  }
+  //--------------------------------------------------------------------------
+
 
   // private functions
 
 
+  //--------------------------------------------------------------------------
+  /** Picks the handler for an instruction code. */
+void (*R_Handler (UINT32 kod)) (void)
+  {
+#ifndef ARM7_THUMB
+  // resolve group 00x once instead of on every execution (same tests as
+  // R_G00x)
+  if (((kod >> 25) & 7) < 2)
+    {
+    if ((kod & 0x03b00090) == 0x01000090)
+      return R_SWP;
+    if ((kod & 0x03c00090) == 0x00000090)
+      return R_MUL_MLA;
+    if ((kod & 0x01900000) == 0x01000000)
+      return R_PSR;
+    return R_DP;
+    }
+#endif
+  return s_tabGrup [(kod >> 25) & 7];
+  }
+  //--------------------------------------------------------------------------
+
   //--------------------------------------------------------------------------
   /** Condition EQ. */
 int R_WEQ ()
@@ -14,6 +14,21 @@
 
   /** Single step, returns number of burned cycles. */
 int ARM7i_Step(void);
+
+  /** Empties the decoded instruction cache. */
+void ARM7i_FlushCache (void);
+  /** Drops decoded instructions in [adres, adres + len) from the cache. */
+void ARM7i_InvalidateCode (UINT32 adres, UINT32 len);
+  //--------------------------------------------------------------------------
+
+  //--------------------------------------------------------------------------
+  // public data
+
+  /** Size of the pages tracked in ARM7i_CodePages. */
+#define ARM7I_CODE_PAGE_SHIFT 12
+  /** Nonzero for RAM pages that may have decoded instructions in the
+ cache, so writes elsewhere can skip ARM7i_InvalidateCode. */
+extern UINT8 ARM7i_CodePages [0x800000 >> ARM7I_CODE_PAGE_SHIFT];
   //--------------------------------------------------------------------------
 
 #endif
@@ -1,5 +1,13 @@
 // memory inline functions shared by ARM and THUMB modes
 
+int dc_code_cacheable(int addr);
+
+// may the instruction word at addr be kept in the decoded instruction cache?
+static INLINE int arm7_code_cacheable(UINT32 addr)
+{
+	return dc_code_cacheable(addr);
+}
+
 static INLINE void arm7_write_32(UINT32 addr, UINT32 data )
 {
 	addr &= ~3;
@@ -8,12 +8,121 @@
 
 #if DK_CORE
 #include "arm7.h"
+#include "arm7i.h"
 #else
 #include "arm7core.h"
 #endif
 
 uint8 dc_ram[8*1024*1024];
 
+/*
+    Sample scheduler
+
+    dsf_gen() runs the ARM7 in fixed slices, one per output sample.  Rather
+    than rendering a sample after every slice, we let the CPU run ahead and
+    only catch the AICA up when the ARM7 could observe the difference: an
+    AICA register access, a RAM access that overlaps what the slots or DSP
+    are fetching, or a timer about to raise the FIQ.  The deferred samples
+    are then rendered in one AICA_Update() batch, so the output is identical
+    to the old lockstep loop; dc_hw_set_lockstep(1) brings that loop back
+    for aosdk/sched_check.c to compare against.
+
+    The ARM7 core caches decoded instructions, so RAM writes from either
+    side have to drop stale entries: the CPU's own writes do it directly,
+    and pages the DSP may write are dropped as they become busy (the core
+    won't cache code from a busy page, see dc_code_cacheable()).
+*/
+
+#define SCHED_PAGE_SHIFT	(12)
+
+static INT16 *sched_bufl, *sched_bufr;
+static int sched_pending;	// slices run but not yet rendered
+static int sched_horizon;	// slices we may run before the next AICA event
+static int sched_touched;	// the CPU accessed the AICA in this slice
+static int sched_lockstep;	// render after every slice, for checking the above
+static uint8 sched_busy[(8*1024*1024) >> SCHED_PAGE_SHIFT];
+
+static void sched_flush(void)
+{
+	INT16 *stereo[2];
+	int samples = sched_pending;
+
+	if (samples)
+	{
+		stereo[0] = sched_bufl;
+		stereo[1] = sched_bufr;
+		sched_bufl += samples;
+		sched_bufr += samples;
+		sched_pending = 0;
+		AICA_Update(NULL, NULL, stereo, samples);
+	}
+
+	sched_touched = 0;
+	sched_horizon = AICA_SamplesToNextEvent();
+	AICA_MarkBusyRAM(sched_busy, SCHED_PAGE_SHIFT);
+
+	#if DK_CORE
+	{
+		int page;
+
+		for (page = 0; page < sizeof(sched_busy); page++)
+		{
+			if ((sched_busy[page] & AICA_RAM_WRITE) && ARM7i_CodePages[(page << SCHED_PAGE_SHIFT) >> ARM7I_CODE_PAGE_SHIFT])
+				ARM7i_InvalidateCode(page << SCHED_PAGE_SHIFT, 1 << SCHED_PAGE_SHIFT);
+		}
+	}
+	#endif
+}
+
+// register access: render everything before this slice, and the sample
+// for this slice as soon as it completes
+#define SCHED_SYNC_REG() \
+	do { if (sched_pending) sched_flush(); sched_touched = 1; } while (0)
+
+// RAM access: only sync if the AICA reads/writes this page while rendering
+#define SCHED_SYNC_RAM(address, flag) \
+	do { if ((sched_busy[(address) >> SCHED_PAGE_SHIFT] & (flag)) && sched_pending) sched_flush(); } while (0)
+
+// CPU write to RAM: drop any decoded instructions it overwrites
+#if DK_CORE
+#define CODE_WRITE(address, len) \
+	do { if (ARM7i_CodePages[(address) >> ARM7I_CODE_PAGE_SHIFT]) ARM7i_InvalidateCode(address, len); } while (0)
+#else
+#define CODE_WRITE(address, len) do { } while (0)
+#endif
+
+void dc_hw_sched_begin(INT16 *left, INT16 *right)
+{
+	sched_bufl = left;
+	sched_bufr = right;
+	sched_pending = 0;
+	sched_flush();
+}
+
+void dc_hw_set_lockstep(int on)
+{
+	sched_lockstep = on;
+}
+
+void dc_hw_sched_slice(void)
+{
+	sched_pending++;
+	if (sched_lockstep || sched_touched || sched_pending >= sched_horizon)
+		sched_flush();
+}
+
+void dc_hw_sched_end(void)
+{
+	sched_flush();
+}
+
+// may the ARM7 keep a decoded copy of the instruction at addr?  Not if it
+// is outside RAM, or the AICA may write its page before we next sync
+int dc_code_cacheable(int addr)
+{
+	return (addr >= 0) && (addr < 0x800000) && !(sched_busy[addr >> SCHED_PAGE_SHIFT] & AICA_RAM_WRITE);
+}
+
 static void aica_irq(int irq)
 {
 	if (irq > 0)
@@ -51,11 +160,13 @@ uint8 dc_read8(int addr)
 {
 	if (addr < 0x800000)
 	{
+		SCHED_SYNC_RAM(addr, AICA_RAM_WRITE);
 		return dc_ram[addr];
 	}
 
 	if ((addr >= 0x800000) && (addr <= 0x807fff))
 	{
+		SCHED_SYNC_REG();
 		int foo = AICA_0_r((addr-0x800000)/2, 0);
 
 		if (addr & 1)
@@ -76,11 +187,13 @@ uint16 dc_read16(int addr)
 {
 	if (addr < 0x800000)
 	{
+		SCHED_SYNC_RAM(addr, AICA_RAM_WRITE);
 		return dc_ram[addr] | (dc_ram[addr+1]<<8);
 	}
 
 	if ((addr >= 0x800000) && (addr <= 0x807fff))
 	{
+		SCHED_SYNC_REG();
 		return AICA_0_r((addr-0x800000)/2, 0);
 	}
 
@@ -92,11 +205,13 @@ uint32 dc_read32(int addr)
 {
 	if (addr < 0x800000)
 	{
+		SCHED_SYNC_RAM(addr, AICA_RAM_WRITE);
 		return dc_ram[addr] | (dc_ram[addr+1]<<8) | (dc_ram[addr+2]<<16) | (dc_ram[addr+3]<<24);
 	}
 
 	if ((addr >= 0x800000) && (addr <= 0x807fff))
 	{
+		SCHED_SYNC_REG();
 		addr &= 0x7fff;
 		return AICA_0_r(addr/2, 0) & 0xffff;
 	}
@@ -109,12 +224,15 @@ void dc_write8(int addr, uint8 data)
 {
 	if (addr < 0x800000)
 	{
+		SCHED_SYNC_RAM(addr, AICA_RAM_READ|AICA_RAM_WRITE);
+		CODE_WRITE(addr, 1);
 		dc_ram[addr] = data;
 		return;
 	}
 
 	if ((addr >= 0x800000) && (addr <= 0x807fff))
 	{
+		SCHED_SYNC_REG();
 		addr -= 0x800000;
 		if ((addr & 1))
 			AICA_0_w(addr>>1, data<<8, 0x00ff);
@@ -130,6 +248,8 @@ void dc_write16(int addr, uint16 data)
 {
 	if (addr < 0x800000)
 	{
+		SCHED_SYNC_RAM(addr, AICA_RAM_READ|AICA_RAM_WRITE);
+		CODE_WRITE(addr, 2);
 		dc_ram[addr] = data&0xff;
 		dc_ram[addr+1] = (data>>8) & 0xff;
 		return;
@@ -137,6 +257,7 @@ void dc_write16(int addr, uint16 data)
 
 	if ((addr >= 0x800000) && (addr <= 0x807fff))
 	{
+		SCHED_SYNC_REG();
 		AICA_0_w((addr-0x800000)/2, data, 0);
 		return;
 	}
@@ -148,6 +269,8 @@ void dc_write32(int addr, uint32 data)
 {
 	if (addr < 0x800000)
 	{
+		SCHED_SYNC_RAM(addr, AICA_RAM_READ|AICA_RAM_WRITE);
+		CODE_WRITE(addr, 4);
 		dc_ram[addr] = data&0xff;
 		dc_ram[addr+1] = (data>>8) & 0xff;
 		dc_ram[addr+2] = (data>>16) & 0xff;
@@ -157,6 +280,7 @@ void dc_write32(int addr, uint32 data)
 
 	if ((addr >= 0x800000) && (addr <= 0x807fff))
 	{
+		SCHED_SYNC_REG();
 		addr -= 0x800000;
 		AICA_0_w((addr>>1), data&0xffff, 0x0000);
 		AICA_0_w((addr>>1)+1, data>>16, 0x0000);
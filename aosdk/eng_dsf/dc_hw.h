@@ -5,5 +5,10 @@ extern uint8 dc_ram[8*1024*1024];
 
 void dc_hw_init(void);
 
+void dc_hw_set_lockstep(int on);
+void dc_hw_sched_begin(INT16 *left, INT16 *right);
+void dc_hw_sched_slice(void);
+void dc_hw_sched_end(void);
+
 #endif
 
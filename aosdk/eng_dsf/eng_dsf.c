@@ -157,11 +157,10 @@ int32 dsf_gen(int16 *buffer, uint32 samples)
 	int i;
 //	int16 output[44100/30], output2[44100/30];
 	int16 output[44100], output2[44100];
-	int16 *stereo[2];
 	int16 *outp = buffer;
-	int opos;
 
-	opos = 0;
+	// the scheduler in dc_hw.c renders into output/output2 in batches
+	dc_hw_sched_begin(output, output2);
 	for (i = 0; i < samples; i++)
 	{
 		#if DK_CORE
@@ -169,11 +168,9 @@ int32 dsf_gen(int16 *buffer, uint32 samples)
 		#else
 		arm7_execute((33000000 / 60 / 4) / 735);
 		#endif
-		stereo[0] = &output[opos];
-		stereo[1] = &output2[opos];
-		AICA_Update(NULL, NULL, stereo, 1);
-		opos++;		
+		dc_hw_sched_slice();
 	}
+	dc_hw_sched_end();
 
 	for (i = 0; i < samples; i++)
 	{
@@ -224,6 +221,20 @@ int32 dsf_command(int32 command, int32 parameter)
 	return AO_FAIL;
 }
 
+int32 dsf_voice_count(void)
+{
+	return 64;
+}
+
+int32 dsf_mute_voice(int32 voice, int32 mute)
+{
+	if (voice < 0 || voice >= 64)
+		return AO_FAIL;
+
+	AICA_MuteSlot(voice, mute);
+	return AO_SUCCESS;
+}
+
 int32 dsf_fill_info(ao_display_info *info)
 {
 	if (c == NULL)
@@ -14,12 +14,16 @@ int32 psf_gen(int16 *, uint32);
 int32 psf_stop(void);
 int32 psf_command(int32, int32);
 int32 psf_fill_info(ao_display_info *);
+int32 psf_voice_count(void);
+int32 psf_mute_voice(int32 voice, int32 mute);
 
 int32 psf2_start(uint8 *, uint32 length);
 int32 psf2_gen(int16 *, uint32);
 int32 psf2_stop(void);
 int32 psf2_command(int32, int32);
 int32 psf2_fill_info(ao_display_info *);
+int32 psf2_voice_count(void);
+int32 psf2_mute_voice(int32 voice, int32 mute);
 
 int32 qsf_start(uint8 *, uint32 length);
 int32 qsf_gen(int16 *, uint32);
@@ -32,6 +36,8 @@ int32 ssf_gen(int16 *, uint32);
 int32 ssf_stop(void);
 int32 ssf_command(int32, int32);
 int32 ssf_fill_info(ao_display_info *);
+int32 ssf_voice_count(void);
+int32 ssf_mute_voice(int32 voice, int32 mute);
 
 int32 spu_start(uint8 *, uint32 length);
 int32 spu_gen(int16 *, uint32);
@@ -50,4 +56,6 @@ int32 dsf_gen(int16 *, uint32);
 int32 dsf_stop(void);
 int32 dsf_command(int32, int32);
 int32 dsf_fill_info(ao_display_info *);
+int32 dsf_voice_count(void);
+int32 dsf_mute_voice(int32 voice, int32 mute);
 
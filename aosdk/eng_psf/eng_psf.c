@@ -64,6 +64,8 @@ extern void mips_set_info(UINT32 state, union cpuinfo *info);
 extern void psx_hw_init(void);
 extern void psx_hw_slice(void);
 extern void psx_hw_frame(void);
+extern void psx_hw_spu_queue(void);
+extern void psx_hw_spu_flush(void);
 extern void setlength(int32 stop, int32 fade);
 
 int32 psf_start(uint8 *buffer, uint32 length)
@@ -363,11 +365,13 @@ int32 psf_gen(int16 *buffer, uint32 samples)
 {	
 	int i;
 
+	// the SPU mixes the queued samples whenever the IOP looks at it
 	for (i = 0; i < samples; i++)
 	{
 		psx_hw_slice();
-		SPUasync(384);
+		psx_hw_spu_queue();
 	}
+	psx_hw_spu_flush();
 
 	spu_pOutput = (char *)buffer;
 	SPU_flushboot();
@@ -429,6 +433,20 @@ int32 psf_command(int32 command, int32 parameter)
 	return AO_FAIL;
 }
 
+int32 psf_voice_count(void)
+{
+	return 24;
+}
+
+int32 psf_mute_voice(int32 voice, int32 mute)
+{
+	if (voice < 0 || voice >= 24)
+		return AO_FAIL;
+
+	SPUmuteChannel(voice, mute);
+	return AO_SUCCESS;
+}
+
 int32 psf_fill_info(ao_display_info *info)
 {
 	if (c == NULL)
@@ -89,6 +89,8 @@ extern void mips_set_info(UINT32 state, union cpuinfo *info);
 extern void psx_hw_init(void);
 extern void ps2_hw_slice(void);
 extern void ps2_hw_frame(void);
+extern void ps2_hw_spu_queue(void);
+extern void psx_hw_spu_flush(void);
 extern void setlength2(int32 stop, int32 fade);
 
 static uint32 secname(uint8 *start, uint32 strndx, uint32 shoff, uint32 shentsize, uint32 name)
@@ -597,11 +599,13 @@ int32 psf2_gen(int16 *buffer, uint32 samples)
 
 	spu_pOutput = (char *)buffer;
 
+	// the SPU2 mixes the queued samples whenever the IOP looks at it
 	for (i = 0; i < samples; i++)
 	{
-		SPU2async(1);
+		ps2_hw_spu_queue();
 		ps2_hw_slice();
 	}
+	psx_hw_spu_flush();
 
 	ps2_hw_frame();
 	
@@ -672,6 +676,20 @@ int32 psf2_command(int32 command, int32 parameter)
 	return AO_FAIL;
 }
 
+int32 psf2_voice_count(void)
+{
+	return 48;
+}
+
+int32 psf2_mute_voice(int32 voice, int32 mute)
+{
+	if (voice < 0 || voice >= 48)
+		return AO_FAIL;
+
+	SPU2muteChannel(voice, mute);
+	return AO_SUCCESS;
+}
+
 int32 psf2_fill_info(ao_display_info *info)
 {
 	if (c == NULL)
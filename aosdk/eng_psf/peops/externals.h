@@ -133,6 +133,7 @@ typedef struct
  int               iLeftVolume;                        // left volume
  int               iLeftVolRaw;                        // left psx volume value
  int               bIgnoreLoop;                        // ignore loop bit, if an external loop address is used
+ int               iMute;                              // mute mode
  int               iRightVolume;                       // right volume
  int               iRightVolRaw;                       // right psx volume value
  int               iRawPitch;                          // raw pitch (0...3fff)
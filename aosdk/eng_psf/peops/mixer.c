@@ -0,0 +1,338 @@
+/***************************************************************************
+                          mixer.c  -  description
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+//*************************************************************************//
+// History of changes:
+//
+// 2026/10/19
+// - channel-batched mixer: instead of walking all 24 channels for every
+//   output sample, each channel renders a whole block of samples at once.
+//   The adpcm/adsr/position stepping stays serial per channel, the decoded
+//   samples go into a flat cache so the gauss interpolation and the
+//   volume/reverb accumulation become plain loops over the block (with
+//   SSE2/AVX2 versions). The result is bit-identical to the per-sample
+//   mixer in SPUasync, which is still used whenever a block can't be
+//   batched safely (or when the block mixer is switched off)
+//
+//*************************************************************************//
+
+// will be included from spu.c
+#ifdef _IN_SPU
+
+#define MIXBLOCK 64                                    // samples per channel pass
+#define MIXCACHE (4+4*MIXBLOCK+4)                      // 4 old interpolation vals + max 4 new samples per output sample
+
+static int iUseBlockMixer=1;                           // 0: always use the per-sample mixer
+
+static s32 mixL[MIXBLOCK],mixR[MIXBLOCK];              // block accumulators
+static s32 mixRvbL[MIXBLOCK],mixRvbR[MIXBLOCK];
+
+static int iFModChan=-1;                               // fmod target channel of the current block...
+static int iFModSamples;                               // ... how many samples the freq channel drove it...
+static int iFModSinc[MIXBLOCK];                        // ... and the per-sample step it got
+
+void SPUsetBlockMixer(int iOn)
+{
+ iUseBlockMixer=iOn;
+}
+
+////////////////////////////////////////////////////////////////////////
+// simd helpers: the block accumulation (MulLo32 is in reverb.c)
+////////////////////////////////////////////////////////////////////////
+
+// pDst[t]=(pA[t]*pB[t])>>iShift
+static INLINE void MulShiftBlock(s32 *pDst,const s32 *pA,const s32 *pB,int iShift,int n)
+{
+ int t=0;
+#ifdef __AVX2__
+ for(;t+8<=n;t+=8)
+  _mm256_storeu_si256((__m256i *)(pDst+t),
+   _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(pA+t)),
+                                        _mm256_loadu_si256((const __m256i *)(pB+t))),iShift));
+#endif
+#ifdef __SSE2__
+ for(;t+4<=n;t+=4)
+  _mm_storeu_si128((__m128i *)(pDst+t),
+   _mm_srai_epi32(MulLo32(_mm_loadu_si128((const __m128i *)(pA+t)),
+                          _mm_loadu_si128((const __m128i *)(pB+t))),iShift));
+#endif
+ for(;t<n;t++)
+  pDst[t]=(pA[t]*pB[t])>>iShift;
+}
+
+// pDst[t]+=(pVal[t]*iVol)>>14, also into pRvb if the channel feeds the reverb
+static INLINE void AccumulateBlock(s32 *pDst,s32 *pRvb,const s32 *pVal,int iVol,int n)
+{
+ int t=0;
+#ifdef __AVX2__
+ {
+  const __m256i v=_mm256_set1_epi32(iVol);
+  for(;t+8<=n;t+=8)
+   {
+    const __m256i x=_mm256_srai_epi32(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(pVal+t)),v),14);
+    _mm256_storeu_si256((__m256i *)(pDst+t),_mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(pDst+t)),x));
+    if(pRvb)
+     _mm256_storeu_si256((__m256i *)(pRvb+t),_mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(pRvb+t)),x));
+   }
+ }
+#endif
+#ifdef __SSE2__
+ {
+  const __m128i v=_mm_set1_epi32(iVol);
+  for(;t+4<=n;t+=4)
+   {
+    const __m128i x=_mm_srai_epi32(MulLo32(_mm_loadu_si128((const __m128i *)(pVal+t)),v),14);
+    _mm_storeu_si128((__m128i *)(pDst+t),_mm_add_epi32(_mm_loadu_si128((const __m128i *)(pDst+t)),x));
+    if(pRvb)
+     _mm_storeu_si128((__m128i *)(pRvb+t),_mm_add_epi32(_mm_loadu_si128((const __m128i *)(pRvb+t)),x));
+   }
+ }
+#endif
+ for(;t<n;t++)
+  {
+   const s32 x=(pVal[t]*iVol)>>14;
+   pDst[t]+=x;
+   if(pRvb) pRvb[t]+=x;
+  }
+}
+
+// gauss interpolation of one output sample: pVal points to the 4 newest
+// decoded samples (oldest first), vl is the gauss table row
+static INLINE int GaussSample(const s32 *pVal,int vl)
+{
+#ifdef __SSE2__
+ __m128i x=_mm_srai_epi32(MulLo32(_mm_loadu_si128((const __m128i *)&gauss[vl]),
+                                  _mm_loadu_si128((const __m128i *)pVal)),9);
+ x=_mm_add_epi32(x,_mm_shuffle_epi32(x,_MM_SHUFFLE(1,0,3,2)));
+ x=_mm_add_epi32(x,_mm_shuffle_epi32(x,_MM_SHUFFLE(2,3,0,1)));
+ return _mm_cvtsi128_si32(x)>>2;
+#else
+ int vr;
+ vr =(gauss[vl]  *pVal[0])>>9;
+ vr+=(gauss[vl+1]*pVal[1])>>9;
+ vr+=(gauss[vl+2]*pVal[2])>>9;
+ vr+=(gauss[vl+3]*pVal[3])>>9;
+ return vr>>2;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////
+// MIX CHANNEL BLOCK: renders ns samples of one channel into the block
+// accumulators, same order of state changes as the per-sample loop
+////////////////////////////////////////////////////////////////////////
+
+static void MixChannelBlock(int ch,int ns)
+{
+ s32 cache[MIXCACHE];                                  // decoded samples, oldest first
+ s32 env[MIXBLOCK],val[MIXBLOCK];
+ int tap[MIXBLOCK],row[MIXBLOCK];
+ int t,n,p=0,gpos,bNoise;
+
+ if(s_chan[ch].bNew) StartSound(ch);                   // start new sound
+ if(!s_chan[ch].bOn) return;                           // channel not playing? next
+
+ if(s_chan[ch].iActFreq!=s_chan[ch].iUsedFreq)         // new psx frequency?
+  {
+   s_chan[ch].iUsedFreq=s_chan[ch].iActFreq;
+   s_chan[ch].sinc=s_chan[ch].iRawPitch<<4;
+   if(!s_chan[ch].sinc) s_chan[ch].sinc=1;
+  }
+
+ gpos=s_chan[ch].SB[28];                               // unroll the interpolation ring
+ for(t=0;t<4;t++) cache[t]=gval(t);
+ bNoise=s_chan[ch].bNoise;
+
+ //------------------------------------------------// serial part: decoding, noise, adsr
+
+ for(t=0;t<ns;t++)
+  {
+   while(s_chan[ch].spos>=0x10000L)
+    {
+     int fa;
+     if(s_chan[ch].iSBPos==28 && !DecodeBlock(ch))     // stop sign: done for this channel
+      goto STOPPED;
+
+     fa=s_chan[ch].SB[s_chan[ch].iSBPos++];
+     if((spuCtrl&0x4000)==0) fa=0;                     // muted?
+     else CLIP(fa);
+     cache[4+p++]=fa;
+     s_chan[ch].spos-=0x10000L;
+    }
+
+   tap[t]=p;
+   row[t]=(s_chan[ch].spos>>6)&~3;
+
+   if(bNoise)
+    {
+     int fa;
+     if((dwNoiseVal<<=1)&0x80000000L)
+      {
+       dwNoiseVal^=0x0040001L;
+       fa=((dwNoiseVal>>2)&0x7fff);
+       fa=-fa;
+      }
+     else fa=(dwNoiseVal>>2)&0x7fff;
+
+     fa=s_chan[ch].iOldNoise+((fa-s_chan[ch].iOldNoise)/((0x001f-((spuCtrl&0x3f00)>>9))+1));
+     if(fa>32767L)  fa=32767L;
+     if(fa<-32767L) fa=-32767L;
+     s_chan[ch].iOldNoise=fa;
+     val[t]=fa;
+    }
+
+   env[t]=MixADSR(ch);
+
+   if(ch==iFModChan && t<iFModSamples)                 // freq driven by the previous channel
+        s_chan[ch].spos+=iFModSinc[t];
+   else s_chan[ch].spos+=s_chan[ch].sinc;
+
+   if(!s_chan[ch].bOn) {t++;break;}                    // adsr has finished this channel
+  }
+STOPPED:
+ n=t;
+
+ gpos=(gpos+p)&3;                                      // store the ring back
+ s_chan[ch].SB[28]=gpos;
+ for(t=0;t<4;t++) gval(t)=cache[p+t];
+
+ if(!n)
+  {
+   if(s_chan[ch].bFMod==2) {iFModChan=ch+1;iFModSamples=0;}
+   return;
+  }
+
+ if(s_chan[ch].iMute && s_chan[ch].bFMod!=2)           // muted: the state is stepped, skip the rest
+  {
+   s_chan[ch].sval=0;
+   return;
+  }
+
+ //------------------------------------------------// block part: interpolation and volume
+
+ if(!bNoise)
+  for(t=0;t<n;t++)
+   val[t]=GaussSample(&cache[tap[t]],row[t]);
+
+ MulShiftBlock(val,env,val,10,n);                      // add adsr
+ s_chan[ch].sval=val[n-1];
+
+ if(s_chan[ch].bFMod==2)                               // fmod freq channel
+  {
+   int NP=0;
+   for(t=0;t<n;t++)
+    {
+     NP=s_chan[ch+1].iRawPitch;
+     NP=((32768L+val[t])*NP)>>15;
+     if(NP>0x3fff) NP=0x3fff;
+     if(NP<0x1)    NP=0x1;
+     NP=(44100L*NP)/(4096L);
+     iFModSinc[t]=(((NP/10)<<16)/4410);
+     if(!iFModSinc[t]) iFModSinc[t]=1;
+    }
+   s_chan[ch+1].iActFreq=NP;
+   s_chan[ch+1].iUsedFreq=NP;
+   s_chan[ch+1].sinc=iFModSinc[n-1];
+   iFModChan=ch+1;
+   iFModSamples=n;
+  }
+ else
+  {
+   const int bRvb=((rvb.Enabled>>ch)&1) && (spuCtrl&0x80);
+   AccumulateBlock(mixL,bRvb?mixRvbL:NULL,val,s_chan[ch].iLeftVolume,n);
+   AccumulateBlock(mixR,bRvb?mixRvbR:NULL,val,s_chan[ch].iRightVolume,n);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// check if the next ns samples can be mixed channel by channel: only one
+// noise channel (they share the generator), no fade end inside the block
+// and no voice reading from the reverb work area (written every sample)
+////////////////////////////////////////////////////////////////////////
+
+static int BlockMixOK(int ns)
+{
+ const int iSpan=((4*ns+4)/28+2)*16;                   // max adpcm bytes a voice can eat
+ u8 * pRvb=rvb.StartAddr?spuMemC+rvb.StartAddr*2:NULL;
+ int ch,iNoise=0;
+
+ if(decaybegin!=~0 && sampcount+ns>decayend) return 0;
+
+ for(ch=0;ch<MAXCHAN;ch++)
+  {
+   if(!s_chan[ch].bOn && !s_chan[ch].bNew) continue;
+   if(s_chan[ch].bNoise && ++iNoise>1) return 0;
+   if(pRvb)
+    {
+     if(s_chan[ch].pLoop+iSpan>pRvb) return 0;
+     if(s_chan[ch].pCurr!=(u8*)-1 && s_chan[ch].pCurr+iSpan>pRvb) return 0;
+     if(s_chan[ch].bNew && s_chan[ch].pStart+iSpan>pRvb) return 0;
+    }
+  }
+ return 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// MIX BLOCK: mixes up to MIXBLOCK samples into pS, returns the number of
+// samples done (0: block can't be batched, use the per-sample mixer)
+////////////////////////////////////////////////////////////////////////
+
+static int MixBlock(int ns)
+{
+ const int volmul=iVolume;
+ int ch,t;
+
+ if(ns>MIXBLOCK) ns=MIXBLOCK;
+ if(!BlockMixOK(ns)) return 0;
+
+ memset(mixL,0,ns*sizeof(s32));
+ memset(mixR,0,ns*sizeof(s32));
+ memset(mixRvbL,0,ns*sizeof(s32));
+ memset(mixRvbR,0,ns*sizeof(s32));
+ iFModChan=-1;
+
+ for(ch=0;ch<MAXCHAN;ch++)
+  MixChannelBlock(ch,ns);
+
+ MixREVERBBlock(mixL,mixR,mixRvbL,mixRvbR,ns);
+
+ for(t=0;t<ns;t++)
+  {
+   s32 sl=mixL[t],sr=mixR[t];
+
+   if(sampcount>=decaybegin && decaybegin!=~0)
+    {
+     const s32 dmul=256-(256*(sampcount-decaybegin)/(decayend-decaybegin));
+     sl=(sl*dmul)>>8;
+     sr=(sr*dmul)>>8;
+    }
+
+   sampcount++;
+   sl=(sl*volmul)>>8;
+   sr=(sr*volmul)>>8;
+
+   if(sl>32767)  sl=32767;
+   if(sl<-32767) sl=-32767;
+   if(sr>32767)  sr=32767;
+   if(sr<-32767) sr=-32767;
+
+   *pS++=sl;
+   *pS++=sr;
+  }
+
+ return ns;
+}
+
+#endif
@@ -19,6 +19,14 @@
 //*************************************************************************//
 // History of changes:
 //
+// 2026/10/19
+// - block reverb: MixREVERBBlock does the work of ns MixREVERBLeftRight
+//   calls at once. The 44.1 <-> 22 khz filters run over the whole block
+//   (SSE2), the work area addresses are wrapped once per run of 22 khz
+//   steps instead of for every tap access, and the steady-state itself
+//   stays a scalar loop since each step reads what the last one wrote.
+//   Bit-identical to the per-sample version, which remains the reference
+//
 // 2003/03/17 - xodnizel
 // - Implemented Neill's 44.1Khz-22050Hz downsampling data
 //   I also need to check if the ~4 sample delay doesn't screw any sounds
@@ -43,6 +51,27 @@
 // will be included from spu.c
 #ifdef _IN_SPU
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef __SSE2__
+static INLINE __m128i MulLo32(__m128i a,__m128i b)
+{
+#ifdef __SSE4_1__
+ return _mm_mullo_epi32(a,b);
+#else
+ const __m128i e=_mm_mul_epu32(a,b);                   // low 32 bits are the same for signed vals
+ const __m128i o=_mm_mul_epu32(_mm_srli_epi64(a,32),_mm_srli_epi64(b,32));
+ return _mm_unpacklo_epi32(_mm_shuffle_epi32(e,_MM_SHUFFLE(0,0,2,0)),
+                           _mm_shuffle_epi32(o,_MM_SHUFFLE(0,0,2,0)));
+#endif
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////
 // globals
 ////////////////////////////////////////////////////////////////////////
@@ -85,15 +114,17 @@ static INLINE void s_buffer1(int iOff,int iVal)                // set_buffer (+1
  *(p+iOff)=(s16)BFLIP16((s16)iVal);
 }
 
-static INLINE void MixREVERBLeftRight(s32 *oleft, s32 *oright, s32 inleft, s32 inright)
-{
-   static s32 downbuf[2][8];
-   static s32 upbuf[2][8];
-   static int dbpos=0,ubpos=0;
-   static s32 downcoeffs[8]={ /* Symmetry is sexy. */
+// 44.1 <-> 22 khz resampling state, shared by the per-sample and block reverb
+static s32 downbuf[2][8];
+static s32 upbuf[2][8];
+static int dbpos=0,ubpos=0;
+static const s32 downcoeffs[8]={ /* Symmetry is sexy. */
 				1283,5344,10895,15243,
 				15243,10895,5344,1283
 			       };
+
+static INLINE void MixREVERBLeftRight(s32 *oleft, s32 *oright, s32 inleft, s32 inright)
+{
    int x;
 
    if(!rvb.StartAddr)                                  // reverb is off
@@ -201,6 +232,254 @@ static INLINE void MixREVERBLeftRight(s32 *oleft, s32 *oright, s32 inleft, s32 i
    }
 }
 
+////////////////////////////////////////////////////////////////////////
+// BLOCK REVERB
+////////////////////////////////////////////////////////////////////////
+
+#define RVBBLOCK 64                                    // samples per block pass
+#define RVBTAPS  28                                    // work area accesses per 22 khz step
+
+// raw tap offsets (in samples, relative to CurrAddr) in the order
+// ReverbStep uses them: 0-3 IIR src, 4-7 IIR dest, 8-11 IIR dest+1,
+// 12-19 ACC src (A0-D0,A1-D1), 20-23 FB src, 24-27 MIX dest A0,A1,B0,B1
+
+static void ReverbTaps(int *pTap)
+{
+ pTap[0]=rvb.IIR_SRC_A0*4;  pTap[1]=rvb.IIR_SRC_A1*4;
+ pTap[2]=rvb.IIR_SRC_B0*4;  pTap[3]=rvb.IIR_SRC_B1*4;
+ pTap[4]=rvb.IIR_DEST_A0*4; pTap[5]=rvb.IIR_DEST_A1*4;
+ pTap[6]=rvb.IIR_DEST_B0*4; pTap[7]=rvb.IIR_DEST_B1*4;
+ pTap[8]=pTap[4]+1;         pTap[9]=pTap[5]+1;
+ pTap[10]=pTap[6]+1;        pTap[11]=pTap[7]+1;
+ pTap[12]=rvb.ACC_SRC_A0*4; pTap[13]=rvb.ACC_SRC_B0*4;
+ pTap[14]=rvb.ACC_SRC_C0*4; pTap[15]=rvb.ACC_SRC_D0*4;
+ pTap[16]=rvb.ACC_SRC_A1*4; pTap[17]=rvb.ACC_SRC_B1*4;
+ pTap[18]=rvb.ACC_SRC_C1*4; pTap[19]=rvb.ACC_SRC_D1*4;
+ pTap[20]=(rvb.MIX_DEST_A0-rvb.FB_SRC_A)*4;
+ pTap[21]=(rvb.MIX_DEST_A1-rvb.FB_SRC_A)*4;
+ pTap[22]=(rvb.MIX_DEST_B0-rvb.FB_SRC_B)*4;
+ pTap[23]=(rvb.MIX_DEST_B1-rvb.FB_SRC_B)*4;
+ pTap[24]=rvb.MIX_DEST_A0*4; pTap[25]=rvb.MIX_DEST_A1*4;
+ pTap[26]=rvb.MIX_DEST_B0*4; pTap[27]=rvb.MIX_DEST_B1*4;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+static INLINE int RVBWrap(int iOff)                   // same wrap as g_buffer/s_buffer
+{
+ while(iOff>0x3FFFF)       iOff=rvb.StartAddr+(iOff-0x40000);
+ while(iOff<rvb.StartAddr) iOff=0x3ffff-(rvb.StartAddr-iOff);
+ return iOff;
+}
+
+// resolve the tap addresses for CurrAddr and return for how many of the
+// next iSteps 22 khz steps they simply advance by one sample each. All
+// wraps jump backwards, so if the last step still is base+iSteps-1 there
+// was no wrap in between
+
+static int ReverbRun(const int *pTap,int *pAddr,int iSteps)
+{
+ int i;
+
+ if(iSteps>0x40000-rvb.CurrAddr) iSteps=0x40000-rvb.CurrAddr;
+
+ for(i=0;i<RVBTAPS;i++)
+  {
+   pAddr[i]=RVBWrap(pTap[i]+rvb.CurrAddr);
+   if(iSteps>1 && RVBWrap(pTap[i]+rvb.CurrAddr+iSteps-1)!=pAddr[i]+iSteps-1)
+    iSteps=1;
+  }
+ return iSteps;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+// one steady-state step, same math (and types) as MixREVERBLeftRight
+
+#define RVBGET(i)    ((s64)(s16)BFLIP16(*(p+pAddr[i]+k)))
+#define RVBSET(i,v)  {int iVal=(v);if(iVal<-32768L) iVal=-32768L;if(iVal>32767L) iVal=32767L;*(p+pAddr[i]+k)=(s16)BFLIP16((s16)iVal);}
+
+static INLINE void ReverbStep(const int *pAddr,int k,s32 INPUT_SAMPLE_L,s32 INPUT_SAMPLE_R)
+{
+ s16 * p=(s16 *)spuMem;
+ int ACC0,ACC1,FB_A0,FB_A1,FB_B0,FB_B1;
+
+ {
+  const s64 IIR_INPUT_A0 = ((RVBGET(0) * rvb.IIR_COEF)>>15) + ((INPUT_SAMPLE_L * rvb.IN_COEF_L)>>15);
+  const s64 IIR_INPUT_A1 = ((RVBGET(1) * rvb.IIR_COEF)>>15) + ((INPUT_SAMPLE_R * rvb.IN_COEF_R)>>15);
+  const s64 IIR_INPUT_B0 = ((RVBGET(2) * rvb.IIR_COEF)>>15) + ((INPUT_SAMPLE_L * rvb.IN_COEF_L)>>15);
+  const s64 IIR_INPUT_B1 = ((RVBGET(3) * rvb.IIR_COEF)>>15) + ((INPUT_SAMPLE_R * rvb.IN_COEF_R)>>15);
+  const s64 IIR_A0 = ((IIR_INPUT_A0 * rvb.IIR_ALPHA)>>15) + ((RVBGET(4) * (32768L - rvb.IIR_ALPHA))>>15);
+  const s64 IIR_A1 = ((IIR_INPUT_A1 * rvb.IIR_ALPHA)>>15) + ((RVBGET(5) * (32768L - rvb.IIR_ALPHA))>>15);
+  const s64 IIR_B0 = ((IIR_INPUT_B0 * rvb.IIR_ALPHA)>>15) + ((RVBGET(6) * (32768L - rvb.IIR_ALPHA))>>15);
+  const s64 IIR_B1 = ((IIR_INPUT_B1 * rvb.IIR_ALPHA)>>15) + ((RVBGET(7) * (32768L - rvb.IIR_ALPHA))>>15);
+
+  RVBSET(8, IIR_A0);
+  RVBSET(9, IIR_A1);
+  RVBSET(10,IIR_B0);
+  RVBSET(11,IIR_B1);
+ }
+
+#ifdef __SSE2__
+ {                                                     // 16x16 products fit in 32 bit: 8 taps in one go
+  const __m128i v=_mm_setr_epi16((s16)RVBGET(12),(s16)RVBGET(13),(s16)RVBGET(14),(s16)RVBGET(15),
+                                 (s16)RVBGET(16),(s16)RVBGET(17),(s16)RVBGET(18),(s16)RVBGET(19));
+  const __m128i c=_mm_setr_epi16(rvb.ACC_COEF_A,rvb.ACC_COEF_B,rvb.ACC_COEF_C,rvb.ACC_COEF_D,
+                                 rvb.ACC_COEF_A,rvb.ACC_COEF_B,rvb.ACC_COEF_C,rvb.ACC_COEF_D);
+  const __m128i lo=_mm_mullo_epi16(v,c),hi=_mm_mulhi_epi16(v,c);
+  __m128i a0=_mm_srai_epi32(_mm_unpacklo_epi16(lo,hi),15);
+  __m128i a1=_mm_srai_epi32(_mm_unpackhi_epi16(lo,hi),15);
+  __m128i s=_mm_add_epi32(_mm_unpacklo_epi64(a0,a1),_mm_unpackhi_epi64(a0,a1));
+  s=_mm_add_epi32(s,_mm_shuffle_epi32(s,_MM_SHUFFLE(2,3,0,1)));
+  ACC0=_mm_cvtsi128_si32(s);
+  ACC1=_mm_cvtsi128_si32(_mm_shuffle_epi32(s,_MM_SHUFFLE(2,2,2,2)));
+ }
+#else
+ ACC0 = ((RVBGET(12) * rvb.ACC_COEF_A)>>15) +
+        ((RVBGET(13) * rvb.ACC_COEF_B)>>15) +
+        ((RVBGET(14) * rvb.ACC_COEF_C)>>15) +
+        ((RVBGET(15) * rvb.ACC_COEF_D)>>15);
+ ACC1 = ((RVBGET(16) * rvb.ACC_COEF_A)>>15) +
+        ((RVBGET(17) * rvb.ACC_COEF_B)>>15) +
+        ((RVBGET(18) * rvb.ACC_COEF_C)>>15) +
+        ((RVBGET(19) * rvb.ACC_COEF_D)>>15);
+#endif
+
+ FB_A0 = RVBGET(20);
+ FB_A1 = RVBGET(21);
+ FB_B0 = RVBGET(22);
+ FB_B1 = RVBGET(23);
+
+ RVBSET(24, ACC0 - ((FB_A0 * rvb.FB_ALPHA)>>15));
+ RVBSET(25, ACC1 - ((FB_A1 * rvb.FB_ALPHA)>>15));
+
+ RVBSET(26, ((rvb.FB_ALPHA * ACC0)>>15) - ((FB_A0 * (int)(rvb.FB_ALPHA^0xFFFF8000))>>15) - ((FB_B0 * rvb.FB_X)>>15));
+ RVBSET(27, ((rvb.FB_ALPHA * ACC1)>>15) - ((FB_A1 * (int)(rvb.FB_ALPHA^0xFFFF8000))>>15) - ((FB_B1 * rvb.FB_X)>>15));
+
+ rvb.iRVBLeft  = (RVBGET(24)+RVBGET(26))/3;
+ rvb.iRVBRight = (RVBGET(25)+RVBGET(27))/3;
+
+ rvb.iRVBLeft  = ((s64)rvb.iRVBLeft * rvb.VolLeft)  >> 14;
+ rvb.iRVBRight = ((s64)rvb.iRVBRight * rvb.VolRight) >> 14;
+}
+
+#undef RVBGET
+#undef RVBSET
+
+////////////////////////////////////////////////////////////////////////
+
+// pOut[t]=sum((pHist[t+1+x]*downcoeffs[x])>>8): the resampling filter for
+// every sample of the block (pHist holds the 8 older values in front)
+
+static INLINE void RVBFilter(s32 *pOut,const s32 *pHist,int n)
+{
+ int t=0,x;
+#ifdef __SSE2__
+ for(;t+4<=n;t+=4)
+  {
+   __m128i s=_mm_setzero_si128();
+   for(x=0;x<8;x++)
+    s=_mm_add_epi32(s,_mm_srai_epi32(MulLo32(_mm_loadu_si128((const __m128i *)(pHist+t+1+x)),
+                                             _mm_set1_epi32(downcoeffs[x])),8));
+   _mm_storeu_si128((__m128i *)(pOut+t),s);
+  }
+#endif
+ for(;t<n;t++)
+  {
+   s32 s=0;
+   for(x=0;x<8;x++) s+=(pHist[t+1+x]*downcoeffs[x])>>8;
+   pOut[t]=s;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+
+static void MixREVERBBlockPart(s32 *pL,s32 *pR,const s32 *pInL,const s32 *pInR,int ns)
+{
+ s32 hL[8+RVBBLOCK],hR[8+RVBBLOCK];                    // linear resampler histories
+ s32 fL[RVBBLOCK],fR[RVBBLOCK];
+ int aTap[RVBTAPS],aAddr[RVBTAPS];
+ int t,x,k=0,iRun=0;
+
+ ReverbTaps(aTap);
+
+ // downsample: all inputs go through the 44.1 -> 22 khz filter up front
+
+ for(x=0;x<8;x++)
+  {
+   hL[x]=downbuf[0][(dbpos+x)&7];
+   hR[x]=downbuf[1][(dbpos+x)&7];
+  }
+ memcpy(hL+8,pInL,ns*sizeof(s32));
+ memcpy(hR+8,pInR,ns*sizeof(s32));
+ RVBFilter(fL,hL,ns);
+ RVBFilter(fR,hR,ns);
+ for(x=0;x<8;x++)
+  {
+   downbuf[0][(dbpos+ns+x)&7]=hL[ns+x];
+   downbuf[1][(dbpos+ns+x)&7]=hR[ns+x];
+  }
+
+ // 22 khz steps: every second sample, the others get 0 in the upsampler
+
+ for(x=0;x<8;x++)
+  {
+   hL[x]=upbuf[0][(ubpos+x)&7];
+   hR[x]=upbuf[1][(ubpos+x)&7];
+  }
+ for(t=0;t<ns;t++)
+  {
+   if((dbpos+t+1)&1)
+    {
+     if(!iRun) {iRun=ReverbRun(aTap,aAddr,(ns-t+1)/2);k=0;}
+     ReverbStep(aAddr,k,fL[t]>>(16-8),fR[t]>>(16-8));
+     k++;iRun--;
+     rvb.CurrAddr++;
+     if(rvb.CurrAddr>0x3ffff) rvb.CurrAddr=rvb.StartAddr;
+     hL[8+t]=rvb.iRVBLeft;
+     hR[8+t]=rvb.iRVBRight;
+    }
+   else hL[8+t]=hR[8+t]=0;
+  }
+ for(x=0;x<8;x++)
+  {
+   upbuf[0][(ubpos+ns+x)&7]=hL[ns+x];
+   upbuf[1][(ubpos+ns+x)&7]=hR[ns+x];
+  }
+ dbpos=(dbpos+ns)&7;
+ ubpos=(ubpos+ns)&7;
+
+ // upsample back to 44.1 khz and mix
+
+ RVBFilter(fL,hL,ns);
+ RVBFilter(fR,hR,ns);
+ for(t=0;t<ns;t++)
+  {
+   pL[t]+=fL[t]>>(16-8-1);
+   pR[t]+=fR[t]>>(16-8-1);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// MIX REVERB BLOCK: same as calling MixREVERBLeftRight(&pL[t],&pR[t],
+// pInL[t],pInR[t]) for t=0..ns-1
+////////////////////////////////////////////////////////////////////////
+
+static void MixREVERBBlock(s32 *pL,s32 *pR,const s32 *pInL,const s32 *pInR,int ns)
+{
+ int t;
+
+ if(!rvb.StartAddr || !(spuCtrl&0x80))                 // off or not working: the per-sample
+  {                                                    // version just does its early outs
+   for(t=0;t<ns;t++)
+    MixREVERBLeftRight(pL+t,pR+t,pInL[t],pInR[t]);
+   return;
+  }
+
+ for(t=0;t<ns;t+=RVBBLOCK)
+  MixREVERBBlockPart(pL+t,pR+t,pInL+t,pInR+t,(ns-t)>RVBBLOCK?RVBBLOCK:(ns-t));
+}
+
 ////////////////////////////////////////////////////////////////////////
 
 #endif
@@ -174,6 +174,111 @@ static INLINE void StartSound(int ch)
  s_chan[ch].spos=0x40000L;s_chan[ch].SB[28]=0;  // -> start with more decoding
 }
 
+////////////////////////////////////////////////////////////////////////
+// DECODE BLOCK... unpacks the next 28 adpcm samples of a channel into
+// SB[0..27] and handles the irq/loop flags. Returns 0 if the channel
+// has hit its stop sign (the channel gets switched off then)
+////////////////////////////////////////////////////////////////////////
+
+static INLINE int DecodeBlock(int ch)
+{
+ int predict_nr,shift_factor,flags,d,s;
+ u8* start;unsigned int nSample;
+ int s_1,s_2,fa;
+
+ start=s_chan[ch].pCurr;                   // set up the current pos
+
+ if (start == (u8*)-1)          // special "stop" sign
+  {
+   s_chan[ch].bOn=0;                       // -> turn everything off
+   s_chan[ch].ADSRX.lVolume=0;
+   s_chan[ch].ADSRX.EnvelopeVol=0;
+   return 0;                               // -> and done for this channel
+  }
+
+ s_chan[ch].iSBPos=0;	// Reset buffer play index.
+
+ //////////////////////////////////////////// spu irq handler here? mmm... do it later
+
+ s_1=s_chan[ch].s_1;
+ s_2=s_chan[ch].s_2;
+
+ predict_nr=(int)*start;start++;           
+ shift_factor=predict_nr&0xf;
+ predict_nr >>= 4;
+ flags=(int)*start;start++;
+
+ // -------------------------------------- // 
+ // Decode new samples into s_chan[ch].SB[0 through 27]
+ for (nSample=0;nSample<28;start++)      
+  {
+   d=(int)*start;
+   s=((d&0xf)<<12);
+   if(s&0x8000) s|=0xffff0000;
+
+   fa=(s >> shift_factor);
+   fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
+   s_2=s_1;s_1=fa;
+   s=((d & 0xf0) << 8);
+
+   s_chan[ch].SB[nSample++]=fa;
+
+   if(s&0x8000) s|=0xffff0000;
+   fa=(s>>shift_factor);              
+   fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
+   s_2=s_1;s_1=fa;
+
+   s_chan[ch].SB[nSample++]=fa;
+  }     
+
+ //////////////////////////////////////////// irq check
+
+ if(spuCtrl&0x40)         			// irq active?
+  {
+   if((pSpuIrq >  start-16 &&              // irq address reached?
+       pSpuIrq <= start) ||
+      ((flags&1) &&                        // special: irq on looping addr, when stop/loop flag is set 
+       (pSpuIrq >  s_chan[ch].pLoop-16 && 
+        pSpuIrq <= s_chan[ch].pLoop)))
+   {
+      //extern s32 spuirqvoodoo;
+     s_chan[ch].iIrqDone=1;                // -> debug flag
+      SPUirq();
+      //puts("IRQ");
+      //if(spuirqvoodoo!=-1)
+      //{
+      // spuirqvoodoo=temp*384;
+      // temp=0;
+      //}
+    }
+  }
+     
+ //////////////////////////////////////////// flag handler
+
+ if((flags&4) && (!s_chan[ch].bIgnoreLoop))
+  s_chan[ch].pLoop=start-16;               // loop adress
+
+ if(flags&1)                               // 1: stop/loop
+  {
+   // We play this block out first...
+   //if(!(flags&2))                          // 1+2: do loop... otherwise: stop
+   if(flags!=3 || s_chan[ch].pLoop==NULL)  // PETE: if we don't check exactly for 3, loop hang ups will happen (DQ4, for example)
+    {                                      // and checking if pLoop is set avoids crashes, yeah
+     start = (u8*)-1;
+    }
+   else
+    {
+     start = s_chan[ch].pLoop;
+    }
+  }
+
+ s_chan[ch].pCurr=start;                   // store values for next cycle
+ s_chan[ch].s_1=s_1;
+ s_chan[ch].s_2=s_2;      
+
+ return 1;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // MAIN SPU FUNCTION
 // here is the main job handler... thread, timer or direct func call
@@ -201,7 +306,19 @@ void setlength(s32 stop, s32 fade)
  }
 }
 
+// a muted channel still decodes and runs its adsr (the psx can read both
+// back, and it has to be in step once it is unmuted), it just skips the
+// interpolation and the volume/reverb sums
+void SPUmuteChannel(int ch,int iMute)
+{
+ if(ch>=0 && ch<MAXCHAN) s_chan[ch].iMute=iMute;
+}
+
 #define CLIP(_x) {if(_x>32767) _x=32767; if(_x<-32767) _x=-32767;}
+
+// channel-batched version of the mixing loop below
+#include "../peops/mixer.c"
+
 int SPUasync(u32 cycles)
 {
  int volmul=iVolume;
@@ -220,6 +337,12 @@ int SPUasync(u32 cycles)
    s32 sl=0, sr=0;
    int ch,fa;
 
+   if(iUseBlockMixer)                                  // try to mix a whole block channel by channel
+    {
+     const int ns=MixBlock(temp);
+     if(ns) {temp-=ns;continue;}
+    }
+
    temp--;
    //--------------------------------------------------//
    //- main channel loop                              -// 
@@ -242,101 +365,7 @@ int SPUasync(u32 cycles)
           {
            if(s_chan[ch].iSBPos==28)                   // 28 reached?
             {
-	     int predict_nr,shift_factor,flags,d,s;
-	     u8* start;unsigned int nSample;
-	     int s_1,s_2;
-
-             start=s_chan[ch].pCurr;                   // set up the current pos
-
-             if (start == (u8*)-1)          // special "stop" sign
-              {
-               s_chan[ch].bOn=0;                       // -> turn everything off
-               s_chan[ch].ADSRX.lVolume=0;
-               s_chan[ch].ADSRX.EnvelopeVol=0;
-               goto ENDX;                              // -> and done for this channel
-              }
-
-             s_chan[ch].iSBPos=0;	// Reset buffer play index.
-
-             //////////////////////////////////////////// spu irq handler here? mmm... do it later
-
-             s_1=s_chan[ch].s_1;
-             s_2=s_chan[ch].s_2;
-
-             predict_nr=(int)*start;start++;           
-             shift_factor=predict_nr&0xf;
-             predict_nr >>= 4;
-             flags=(int)*start;start++;
-
-             // -------------------------------------- // 
-	     // Decode new samples into s_chan[ch].SB[0 through 27]
-             for (nSample=0;nSample<28;start++)      
-              {
-               d=(int)*start;
-               s=((d&0xf)<<12);
-               if(s&0x8000) s|=0xffff0000;
-
-               fa=(s >> shift_factor);
-               fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
-               s_2=s_1;s_1=fa;
-               s=((d & 0xf0) << 8);
-
-               s_chan[ch].SB[nSample++]=fa;
-
-               if(s&0x8000) s|=0xffff0000;
-               fa=(s>>shift_factor);              
-               fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
-               s_2=s_1;s_1=fa;
-
-               s_chan[ch].SB[nSample++]=fa;
-              }     
-
-             //////////////////////////////////////////// irq check
-
-             if(spuCtrl&0x40)         			// irq active?
-              {
-               if((pSpuIrq >  start-16 &&              // irq address reached?
-                   pSpuIrq <= start) ||
-                  ((flags&1) &&                        // special: irq on looping addr, when stop/loop flag is set 
-                   (pSpuIrq >  s_chan[ch].pLoop-16 && 
-                    pSpuIrq <= s_chan[ch].pLoop)))
-               {
-		 //extern s32 spuirqvoodoo;
-                 s_chan[ch].iIrqDone=1;                // -> debug flag
-		 SPUirq();
-		//puts("IRQ");
-		 //if(spuirqvoodoo!=-1)
-		 //{
-		 // spuirqvoodoo=temp*384;
-		 // temp=0;
-		 //}
-                }
-              }
-      
-             //////////////////////////////////////////// flag handler
-
-             if((flags&4) && (!s_chan[ch].bIgnoreLoop))
-              s_chan[ch].pLoop=start-16;               // loop adress
-
-             if(flags&1)                               // 1: stop/loop
-              {
-               // We play this block out first...
-               //if(!(flags&2))                          // 1+2: do loop... otherwise: stop
-               if(flags!=3 || s_chan[ch].pLoop==NULL)  // PETE: if we don't check exactly for 3, loop hang ups will happen (DQ4, for example)
-                {                                      // and checking if pLoop is set avoids crashes, yeah
-                 start = (u8*)-1;
-                }
-               else
-                {
-                 start = s_chan[ch].pLoop;
-                }
-              }
-
-             s_chan[ch].pCurr=start;                   // store values for next cycle
-             s_chan[ch].s_1=s_1;
-             s_chan[ch].s_2=s_2;      
-
-             ////////////////////////////////////////////
+             if(!DecodeBlock(ch)) goto ENDX;           // -> stop sign: done for this channel
             }
 
            fa=s_chan[ch].SB[s_chan[ch].iSBPos++];      // get sample data
@@ -377,6 +406,8 @@ int SPUasync(u32 cycles)
            s_chan[ch].iOldNoise=fa;
 
           }                                            //----------------------------------------
+         else if(s_chan[ch].iMute && s_chan[ch].bFMod!=2) // muted, nothing to interpolate
+          fa=0;
          else                                         // NO NOISE (NORMAL SAMPLE DATA) HERE 
           {
              int vl, vr, gpos;
@@ -412,20 +443,16 @@ int SPUasync(u32 cycles)
 		//           s_chan[ch+1].iSBPos=28;
 		//           s_chan[ch+1].spos=0x10000L;
           }                    
+         else if(s_chan[ch].iMute)
+          s_chan[ch].sval=0;
          else
           {                                          
            //////////////////////////////////////////////
            // ok, left/right sound volume (psx volume goes from 0 ... 0x3fff)
 	   int tmpl,tmpr;
 
-		if (1) //ao_channel_enable[ch+PSF_1]) {
-		{
-			tmpl=(s_chan[ch].sval*s_chan[ch].iLeftVolume)>>14;
-			tmpr=(s_chan[ch].sval*s_chan[ch].iRightVolume)>>14;
-		} else {
-			tmpl = 0;
-			tmpr = 0;
-		}
+	   tmpl=(s_chan[ch].sval*s_chan[ch].iLeftVolume)>>14;
+	   tmpr=(s_chan[ch].sval*s_chan[ch].iRightVolume)>>14;
 	   sl+=tmpl;
 	   sr+=tmpr;
 
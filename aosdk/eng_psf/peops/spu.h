@@ -27,6 +27,8 @@
 void sexyd_update(unsigned char* pSound,long lBytes);
 
 int SPUasync(u32 cycles);
+void SPUsetBlockMixer(int iOn);
+void SPUmuteChannel(int ch,int iMute);
 void SPU_flushboot(void);
 int SPUinit(void);
 int SPUopen(void);
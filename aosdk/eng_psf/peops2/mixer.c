@@ -0,0 +1,396 @@
+/***************************************************************************
+                          mixer.c  -  description
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+//*************************************************************************//
+// History of changes:
+//
+// 2026/10/19
+// - channel-batched version of MAINThread: each of the 48 channels renders
+//   a whole block of samples at once (adpcm/adsr stepping stays serial,
+//   gauss interpolation and the volume/reverb sums run over the block,
+//   with SSE2/AVX2 versions). Bit-identical to MAINThread, which is still
+//   used for gauss-less interpolation modes, pending spu irqs and blocks
+//   that can't be batched safely
+//
+//*************************************************************************//
+
+// will be included from spu.c
+#ifdef _IN_SPU
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define MIXBLOCK 64                                    // samples per channel pass
+#define MIXCACHE (4+5*MIXBLOCK+4)                      // 4 old interpolation vals + max 5 new samples per output sample
+
+static int iUseBlockMixer=1;                           // 0: always use MAINThread
+
+static int mixL[MIXBLOCK],mixR[MIXBLOCK];              // block accumulators
+static int mixRvbL[2][MIXBLOCK],mixRvbR[2][MIXBLOCK];  // reverb input per core
+
+static int iFModChan=-1;                               // fmod target channel of the current block...
+static int iFModSamples;                               // ... how many samples the freq channel drove it...
+static int iFModSinc[MIXBLOCK];                        // ... and the per-sample step it got
+
+EXPORT_GCC void CALLBACK SPU2setBlockMixer(int iOn)
+{
+ iUseBlockMixer=iOn;
+}
+
+////////////////////////////////////////////////////////////////////////
+// simd helpers: 32 bit multiply (low part) and the block accumulation
+////////////////////////////////////////////////////////////////////////
+
+#ifdef __SSE2__
+static INLINE __m128i MulLo32(__m128i a,__m128i b)
+{
+#ifdef __SSE4_1__
+ return _mm_mullo_epi32(a,b);
+#else
+ const __m128i e=_mm_mul_epu32(a,b);                   // low 32 bits are the same for signed vals
+ const __m128i o=_mm_mul_epu32(_mm_srli_epi64(a,32),_mm_srli_epi64(b,32));
+ return _mm_unpacklo_epi32(_mm_shuffle_epi32(e,_MM_SHUFFLE(0,0,2,0)),
+                           _mm_shuffle_epi32(o,_MM_SHUFFLE(0,0,2,0)));
+#endif
+}
+
+static INLINE __m128i Div4000(__m128i x)               // x/0x4000, rounding towards zero like C does
+{
+ return _mm_srai_epi32(_mm_add_epi32(x,_mm_and_si128(_mm_srai_epi32(x,31),_mm_set1_epi32(0x3fff))),14);
+}
+#endif
+
+#ifdef __AVX2__
+static INLINE __m256i Div4000_256(__m256i x)
+{
+ return _mm256_srai_epi32(_mm256_add_epi32(x,_mm256_and_si256(_mm256_srai_epi32(x,31),_mm256_set1_epi32(0x3fff))),14);
+}
+#endif
+
+// pDst[t]+=(pVal[t]*iVol)/0x4000
+static INLINE void AccumulateBlock(int *pDst,const int *pVal,int iVol,int n)
+{
+ int t=0;
+#ifdef __AVX2__
+ {
+  const __m256i v=_mm256_set1_epi32(iVol);
+  for(;t+8<=n;t+=8)
+   _mm256_storeu_si256((__m256i *)(pDst+t),
+    _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(pDst+t)),
+     Div4000_256(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(pVal+t)),v))));
+ }
+#endif
+#ifdef __SSE2__
+ {
+  const __m128i v=_mm_set1_epi32(iVol);
+  for(;t+4<=n;t+=4)
+   _mm_storeu_si128((__m128i *)(pDst+t),
+    _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pDst+t)),
+     Div4000(MulLo32(_mm_loadu_si128((const __m128i *)(pVal+t)),v))));
+ }
+#endif
+ for(;t<n;t++)
+  pDst[t]+=(pVal[t]*iVol)/0x4000;
+}
+
+// gauss interpolation of one output sample: pVal points to the 4 newest
+// decoded samples (oldest first), vl is the gauss table row
+static INLINE int GaussSample(const int *pVal,int vl)
+{
+#ifdef __SSE2__
+ __m128i x=_mm_and_si128(MulLo32(_mm_loadu_si128((const __m128i *)&gauss[vl]),
+                                 _mm_loadu_si128((const __m128i *)pVal)),_mm_set1_epi32(~2047));
+ x=_mm_add_epi32(x,_mm_shuffle_epi32(x,_MM_SHUFFLE(1,0,3,2)));
+ x=_mm_add_epi32(x,_mm_shuffle_epi32(x,_MM_SHUFFLE(2,3,0,1)));
+ return _mm_cvtsi128_si32(x)>>11;
+#else
+ int vr;
+ vr =(gauss[vl]  *pVal[0])&~2047;
+ vr+=(gauss[vl+1]*pVal[1])&~2047;
+ vr+=(gauss[vl+2]*pVal[2])&~2047;
+ vr+=(gauss[vl+3]*pVal[3])&~2047;
+ return vr>>11;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////
+// MIX CHANNEL BLOCK: renders ns samples of one channel into the block
+// accumulators, same order of state changes as MAINThread
+////////////////////////////////////////////////////////////////////////
+
+static void MixChannelBlock(int ch,int ns)
+{
+ int cache[MIXCACHE];                                  // decoded samples, oldest first
+ int env[MIXBLOCK],val[MIXBLOCK];
+ int tap[MIXBLOCK],row[MIXBLOCK];
+ int t,n,p=0,gpos,bNoise;
+ const int core=ch/24;
+
+ if(s_chan[ch].bNew) StartSound(ch);                   // start new sound
+ if(!s_chan[ch].bOn) return;                           // channel not playing? next
+
+ if(s_chan[ch].iActFreq!=s_chan[ch].iUsedFreq)         // new psx frequency?
+  {
+   s_chan[ch].iUsedFreq=s_chan[ch].iActFreq;
+   s_chan[ch].sinc=s_chan[ch].iRawPitch<<4;
+   if(!s_chan[ch].sinc) s_chan[ch].sinc=1;
+  }
+
+ gpos=s_chan[ch].SB[28];                               // unroll the interpolation ring
+ for(t=0;t<4;t++) cache[t]=gval(t);
+ bNoise=s_chan[ch].bNoise;
+
+ //------------------------------------------------// serial part: decoding, noise, adsr
+
+ for(t=0;t<ns;t++)
+  {
+   while(s_chan[ch].spos>=0x10000L)
+    {
+     int fa;
+     if(s_chan[ch].iSBPos==28 && !DecodeBlock(ch))     // stop sign: done for this channel
+      goto STOPPED;
+
+     fa=s_chan[ch].SB[s_chan[ch].iSBPos++];
+     if(fa>32767L)  fa=32767L;
+     if(fa<-32767L) fa=-32767L;
+     cache[4+p++]=fa;
+     s_chan[ch].spos-=0x10000L;
+    }
+
+   tap[t]=p;
+   row[t]=(s_chan[ch].spos>>6)&~3;
+
+   if(bNoise)
+    {
+     int fa;
+     if((dwNoiseVal<<=1)&0x80000000L)
+      {
+       dwNoiseVal^=0x0040001L;
+       fa=((dwNoiseVal>>2)&0x7fff);
+       fa=-fa;
+      }
+     else fa=(dwNoiseVal>>2)&0x7fff;
+
+     fa=s_chan[ch].iOldNoise+((fa-s_chan[ch].iOldNoise)/((0x001f-((spuCtrl2[core]&0x3f00)>>9))+1));
+     if(fa>32767L)  fa=32767L;
+     if(fa<-32767L) fa=-32767L;
+     s_chan[ch].iOldNoise=fa;
+     val[t]=fa;
+    }
+
+   env[t]=MixADSR(ch);
+
+   if(ch==iFModChan && t<iFModSamples)                 // freq driven by the previous channel
+        s_chan[ch].spos+=iFModSinc[t];
+   else s_chan[ch].spos+=s_chan[ch].sinc;
+
+   if(!s_chan[ch].bOn) {t++;break;}                    // adsr has finished this channel
+  }
+STOPPED:
+ n=t;
+
+ gpos=(gpos+p)&3;                                      // store the ring back
+ s_chan[ch].SB[28]=gpos;
+ for(t=0;t<4;t++) gval(t)=cache[p+t];
+
+ if(!n)
+  {
+   if(s_chan[ch].bFMod==2) {iFModChan=ch+1;iFModSamples=0;}
+   return;
+  }
+
+ if(s_chan[ch].iMute && s_chan[ch].bFMod!=2)           // muted: the state is stepped, skip the rest
+  {
+   s_chan[ch].sval=0;
+   return;
+  }
+
+ //------------------------------------------------// block part: interpolation and volume
+
+ if(!bNoise)
+  for(t=0;t<n;t++)
+   val[t]=GaussSample(&cache[tap[t]],row[t]);
+
+ for(t=0;t<n;t++)                                      // add adsr
+  val[t]=(env[t]*val[t])/1023;
+ s_chan[ch].sval=val[n-1];
+
+ if(s_chan[ch].bFMod==2)                               // fmod freq channel
+  {
+   int NP=0;
+   for(t=0;t<n;t++)
+    {
+     double intr;
+     NP=s_chan[ch+1].iRawPitch;
+     NP=((32768L+val[t])*NP)/32768L;
+     if(NP>0x3fff) NP=0x3fff;
+     if(NP<0x1)    NP=0x1;
+     intr = (double)48000.0f / (double)44100.0f * (double)NP;
+     NP = (UINT32)intr;
+     NP=(44100L*NP)/(4096L);
+     iFModSinc[t]=(((NP/10)<<16)/4410);
+     if(!iFModSinc[t]) iFModSinc[t]=1;
+    }
+   s_chan[ch+1].iActFreq=NP;
+   s_chan[ch+1].iUsedFreq=NP;
+   s_chan[ch+1].sinc=iFModSinc[n-1];
+   iFModChan=ch+1;
+   iFModSamples=n;
+   return;
+  }
+
+ if(s_chan[ch].bVolumeL) AccumulateBlock(mixL,val,s_chan[ch].iLeftVolume,n);
+ if(s_chan[ch].bVolumeR) AccumulateBlock(mixR,val,s_chan[ch].iRightVolume,n);
+
+ if(s_chan[ch].bRVBActive && iUseReverb==1)            // reverb input, see StoreREVERB
+  {
+   if(s_chan[ch].bReverbL) AccumulateBlock(mixRvbL[core],val,s_chan[ch].iLeftVolume,n);
+   if(s_chan[ch].bReverbR) AccumulateBlock(mixRvbR[core],val,s_chan[ch].iRightVolume,n);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// check if the next ns samples can be mixed channel by channel: gauss
+// interpolation, no irqs, only one noise channel (they share the
+// generator), no fade end inside the block and no voice reading from a
+// reverb work area (written every sample)
+////////////////////////////////////////////////////////////////////////
+
+static int BlockMixOK(int ns)
+{
+ const int iSpan=((5*ns+4)/28+2)*16;                   // max adpcm bytes a voice can eat
+ unsigned char * pRvbS[2], * pRvbE[2];
+ int ch,core,iNoise=0;
+
+ if(iUseInterpolation!=2 || lastch>=0) return 0;
+ if((spuCtrl2[0]|spuCtrl2[1])&0x40) return 0;
+ if(decaybegin!=~0 && sampcount+ns>decayend) return 0;
+
+ for(core=0;core<2;core++)
+  {
+   if(iUseReverb==1 && rvb[core].StartAddr && rvb[core].EndAddr &&
+      rvb[core].StartAddr<rvb[core].EndAddr)
+    {
+     pRvbS[core]=spuMemC+rvb[core].StartAddr*2;
+     pRvbE[core]=spuMemC+rvb[core].EndAddr*2+2;
+    }
+   else pRvbS[core]=pRvbE[core]=NULL;
+  }
+
+ for(ch=0;ch<MAXCHAN;ch++)
+  {
+   if(!s_chan[ch].bOn && !s_chan[ch].bNew) continue;
+   if(s_chan[ch].bNoise && ++iNoise>1) return 0;
+   for(core=0;core<2;core++)
+    {
+     if(!pRvbS[core]) continue;
+     if(s_chan[ch].pLoop<pRvbE[core] && s_chan[ch].pLoop+iSpan>pRvbS[core]) return 0;
+     if(s_chan[ch].pCurr!=(unsigned char*)-1 &&
+        s_chan[ch].pCurr<pRvbE[core] && s_chan[ch].pCurr+iSpan>pRvbS[core]) return 0;
+     if(s_chan[ch].bNew &&
+        s_chan[ch].pStart<pRvbE[core] && s_chan[ch].pStart+iSpan>pRvbS[core]) return 0;
+    }
+  }
+ return 1;
+}
+
+// MAINThread's secure start counter (counts samples with new channels pending)
+static INLINE void SecureStart(void)
+{
+ if(dwNewChannel2[0] || dwNewChannel2[1])
+  {
+   iSecureStart++;
+   if(iSecureStart>5) iSecureStart=0;
+  }
+ else iSecureStart=0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// MIX BLOCK: mixes up to MIXBLOCK samples into pS, returns the number of
+// samples done (0: block can't be batched, use MAINThread)
+////////////////////////////////////////////////////////////////////////
+
+static int MixBlock(int ns)
+{
+ const int voldiv=iVolume;
+ int ch,t,d,d2;
+
+ if(ns>MIXBLOCK) ns=MIXBLOCK;
+ if(!BlockMixOK(ns)) return 0;
+
+ memset(mixL,0,ns*sizeof(int));
+ memset(mixR,0,ns*sizeof(int));
+ memset(mixRvbL,0,sizeof(mixRvbL));
+ memset(mixRvbR,0,sizeof(mixRvbR));
+ iFModChan=-1;
+
+ SecureStart();                                       // MAINThread does this before the channels...
+ for(ch=0;ch<MAXCHAN;ch++)
+  MixChannelBlock(ch,ns);
+ for(t=1;t<ns;t++) SecureStart();                      // ... and again for every further sample
+
+ for(t=0;t<ns;t++)
+  {
+   SSumL[0]+=mixL[t];
+   SSumR[0]+=mixR[t];
+
+   if(iUseReverb==1)
+    {
+     sRVBStart[0][0]+=mixRvbL[0][t];sRVBStart[0][1]+=mixRvbR[0][t];
+     sRVBStart[1][0]+=mixRvbL[1][t];sRVBStart[1][1]+=mixRvbR[1][t];
+    }
+
+   SSumL[0]+=MixREVERBLeft(0,0);
+   SSumL[0]+=MixREVERBLeft(0,1);
+   SSumR[0]+=MixREVERBRight(0);
+   SSumR[0]+=MixREVERBRight(1);
+
+   d=SSumL[0]/voldiv;SSumL[0]=0;
+   d2=SSumR[0]/voldiv;SSumR[0]=0;
+
+   if(d<-32767)  d=-32767;
+   if(d>32767)   d=32767;
+   if(d2<-32767) d2=-32767;
+   if(d2>32767)  d2=32767;
+
+   if(sampcount>=decaybegin && decaybegin!=~0)
+    {
+     const s32 dmul=256-(256*(sampcount-decaybegin)/(decayend-decaybegin));
+     d=(d*dmul)>>8;
+     d2=(d2*dmul)>>8;
+    }
+   sampcount++;
+
+   *pS++=d;
+   *pS++=d2;
+
+   InitREVERB();
+
+   if ((((unsigned char *)pS)-((unsigned char *)pSpuBuffer)) == (735*4))
+    {
+     ps2_update((u8*)pSpuBuffer,(u8*)pS-(u8*)pSpuBuffer);
+     pS=(short *)pSpuBuffer;
+    }
+  }
+
+ return ns;
+}
+
+#endif
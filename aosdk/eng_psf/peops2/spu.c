@@ -348,6 +348,15 @@ void setlength2(s32 stop, s32 fade)
   decayend=stop+fade;
  }
 }
+
+// a muted channel still decodes and runs its adsr (and keeps feeding its
+// fmod partner), it just skips the gauss/cubic interpolation and the
+// volume/reverb sums
+EXPORT_GCC void CALLBACK SPU2muteChannel(int ch,int iMute)
+{
+ if(ch>=0 && ch<MAXCHAN) s_chan[ch].iMute=iMute;
+}
+
 // 5 ms waiting phase, if buffer is full and no new sound has to get started
 // .. can be made smaller (smallest val: 1 ms), but bigger waits give
 // better performance
@@ -359,12 +368,125 @@ void setlength2(s32 stop, s32 fade)
 
 int iSpuAsyncWait=0;
 
-static void *MAINThread(int samp2run)
+////////////////////////////////////////////////////////////////////////
+// DECODE BLOCK... unpacks the next 28 adpcm samples of a channel into
+// SB[0..27] and handles the irq/loop flags. Returns 0 if the channel
+// has hit its stop sign (the channel gets switched off then), 2 if an
+// irq wants the main emu to catch up first, else 1
+////////////////////////////////////////////////////////////////////////
+
+static INLINE int DecodeBlock(int ch)
 {
- int s_1,s_2,fa,voldiv=iVolume;
+ int s_1,s_2,fa,iRet=1;
  unsigned char * start;unsigned int nSample;
- int ch,predict_nr,shift_factor,flags,d,d2,s;
- int gpos,bIRQReturn=0;
+ int predict_nr,shift_factor,flags,d,s;
+
+ start=s_chan[ch].pCurr;                   // set up the current pos
+
+ if (start == (unsigned char*)-1)          // special "stop" sign
+  {
+   s_chan[ch].bOn=0;                       // -> turn everything off
+   s_chan[ch].ADSRX.lVolume=0;
+   s_chan[ch].ADSRX.EnvelopeVol=0;
+   return 0;                               // -> and done for this channel
+  }
+
+ s_chan[ch].iSBPos=0;
+
+ //////////////////////////////////////////// spu irq handler here? mmm... do it later
+
+ s_1=s_chan[ch].s_1;
+ s_2=s_chan[ch].s_2;
+
+ predict_nr=(int)*start;start++;
+ shift_factor=predict_nr&0xf;
+ predict_nr >>= 4;
+ flags=(int)*start;start++;
+
+ // -------------------------------------- // 
+
+ for (nSample=0;nSample<28;start++)      
+  {
+   d=(int)*start;
+   s=((d&0xf)<<12);
+   if(s&0x8000) s|=0xffff0000;
+
+   fa=(s >> shift_factor);
+   fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
+   s_2=s_1;s_1=fa;
+   s=((d & 0xf0) << 8);
+
+   s_chan[ch].SB[nSample++]=fa;
+
+   if(s&0x8000) s|=0xffff0000;
+   fa=(s>>shift_factor);              
+   fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
+   s_2=s_1;s_1=fa;
+
+   s_chan[ch].SB[nSample++]=fa;
+  }     
+
+ //////////////////////////////////////////// irq check
+
+ if(spuCtrl2[ch/24]&0x40)                  // some irq active?
+  {
+   if((pSpuIrq[ch/24] >  start-16 &&       // irq address reached?
+       pSpuIrq[ch/24] <= start) ||
+      ((flags&1) &&                        // special: irq on looping addr, when stop/loop flag is set 
+       (pSpuIrq[ch/24] >  s_chan[ch].pLoop-16 &&
+        pSpuIrq[ch/24] <= s_chan[ch].pLoop)))
+    {
+     s_chan[ch].iIrqDone=1;                // -> debug flag
+
+     if(irqCallback) irqCallback();        // -> call main emu (not supported in SPU2 right now)
+     else
+      {
+       if(ch<24) InterruptDMA4();            // -> let's see what is happening if we call our irqs instead ;)
+       else      InterruptDMA7();
+      }
+
+     if(iSPUIRQWait)                       // -> option: wait after irq for main emu
+      {
+       iSpuAsyncWait=1;
+       iRet=2;
+      }
+    }
+  }
+
+ //////////////////////////////////////////// flag handler
+
+ if((flags&4) && (!s_chan[ch].bIgnoreLoop))
+  s_chan[ch].pLoop=start-16;               // loop adress
+
+ if(flags&1)                               // 1: stop/loop
+  {
+   dwEndChannel2[ch/24]|=(1<<(ch%24));
+
+   // We play this block out first...
+   //if(!(flags&2)|| s_chan[ch].pLoop==NULL)   
+                                           // 1+2: do loop... otherwise: stop
+   if(flags!=3 || s_chan[ch].pLoop==NULL)  // PETE: if we don't check exactly for 3, loop hang ups will happen (DQ4, for example)
+    {                                      // and checking if pLoop is set avoids crashes, yeah
+     start = (unsigned char*)-1;
+    }
+   else
+    {
+     start = s_chan[ch].pLoop;
+    }
+  }
+
+ s_chan[ch].pCurr=start;                   // store values for next cycle
+ s_chan[ch].s_1=s_1;
+ s_chan[ch].s_2=s_2;
+
+ return iRet;
+}
+
+static void *MAINThread(int samp2run)
+{
+ int fa,voldiv=iVolume;
+ int ch,d,d2;
+ int gpos;
 
 // while(!bEndThread)                                    // until we are shutting down
   {
@@ -433,115 +555,16 @@ static void *MAINThread(int samp2run)
           {
            if(s_chan[ch].iSBPos==28)                   // 28 reached?
             {
-             start=s_chan[ch].pCurr;                   // set up the current pos
-
-             if (start == (unsigned char*)-1)          // special "stop" sign
-              {
-               s_chan[ch].bOn=0;                       // -> turn everything off
-               s_chan[ch].ADSRX.lVolume=0;
-               s_chan[ch].ADSRX.EnvelopeVol=0;
-               goto ENDX;                              // -> and done for this channel
-              }
+             const int iRet=DecodeBlock(ch);
 
-             s_chan[ch].iSBPos=0;
+             if(!iRet) goto ENDX;                      // -> stop sign: done for this channel
 
-             //////////////////////////////////////////// spu irq handler here? mmm... do it later
-
-             s_1=s_chan[ch].s_1;
-             s_2=s_chan[ch].s_2;
-
-             predict_nr=(int)*start;start++;
-             shift_factor=predict_nr&0xf;
-             predict_nr >>= 4;
-             flags=(int)*start;start++;
-
-             // -------------------------------------- // 
-
-             for (nSample=0;nSample<28;start++)      
+             if(iRet==2)                               // special return for "spu irq - wait for cpu action"
               {
-               d=(int)*start;
-               s=((d&0xf)<<12);
-               if(s&0x8000) s|=0xffff0000;
-
-               fa=(s >> shift_factor);
-               fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
-               s_2=s_1;s_1=fa;
-               s=((d & 0xf0) << 8);
+               lastch=ch; 
+//               lastns=ns;	// changemeback
 
-               s_chan[ch].SB[nSample++]=fa;
-
-               if(s&0x8000) s|=0xffff0000;
-               fa=(s>>shift_factor);              
-               fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
-               s_2=s_1;s_1=fa;
-
-               s_chan[ch].SB[nSample++]=fa;
-              }     
-
-             //////////////////////////////////////////// irq check
-
-             if(spuCtrl2[ch/24]&0x40)                  // some irq active?
-              {
-               if((pSpuIrq[ch/24] >  start-16 &&       // irq address reached?
-                   pSpuIrq[ch/24] <= start) ||
-                  ((flags&1) &&                        // special: irq on looping addr, when stop/loop flag is set 
-                   (pSpuIrq[ch/24] >  s_chan[ch].pLoop-16 &&
-                    pSpuIrq[ch/24] <= s_chan[ch].pLoop)))
-                {
-                 s_chan[ch].iIrqDone=1;                // -> debug flag
-
-                 if(irqCallback) irqCallback();        // -> call main emu (not supported in SPU2 right now)
-                 else
-                  {
-                   if(ch<24) InterruptDMA4();            // -> let's see what is happening if we call our irqs instead ;)
-                   else      InterruptDMA7();
-                  }
-                  
-                 if(iSPUIRQWait)                       // -> option: wait after irq for main emu
-                  {
-                   iSpuAsyncWait=1;
-                   bIRQReturn=1;
-                  }
-                }
-              }
-      
-             //////////////////////////////////////////// flag handler
-
-             if((flags&4) && (!s_chan[ch].bIgnoreLoop))
-              s_chan[ch].pLoop=start-16;               // loop adress
-
-             if(flags&1)                               // 1: stop/loop
-              {
-               dwEndChannel2[ch/24]|=(1<<(ch%24));
-              
-               // We play this block out first...
-               //if(!(flags&2)|| s_chan[ch].pLoop==NULL)   
-                                                       // 1+2: do loop... otherwise: stop
-               if(flags!=3 || s_chan[ch].pLoop==NULL)  // PETE: if we don't check exactly for 3, loop hang ups will happen (DQ4, for example)
-                {                                      // and checking if pLoop is set avoids crashes, yeah
-                 start = (unsigned char*)-1;
-                }
-               else
-                {
-                 start = s_chan[ch].pLoop;
-                }
-              }
-
-             s_chan[ch].pCurr=start;                   // store values for next cycle
-             s_chan[ch].s_1=s_1;
-             s_chan[ch].s_2=s_2;      
-
-             ////////////////////////////////////////////
-
-             if(bIRQReturn)                            // special return for "spu irq - wait for cpu action"
-              {
-               bIRQReturn=0;
-                {
-                 lastch=ch; 
-//                 lastns=ns;	// changemeback
-
-                 return;
-                }
+               return;
               }
 
              ////////////////////////////////////////////
@@ -604,6 +627,8 @@ GOON: ;
            if(iUseInterpolation<2)                     // no gauss/cubic interpolation?
             s_chan[ch].SB[29] = fa;                    // -> store noise val in "current sample" slot
           }                                            //----------------------------------------
+         else if(s_chan[ch].iMute && s_chan[ch].bFMod!=2 && iUseInterpolation>=2)
+          fa=0;                                        // muted, nothing to interpolate
          else                                          // NO NOISE (NORMAL SAMPLE DATA) HERE 
           {//------------------------------------------//
            if(iUseInterpolation==3)                    // cubic interpolation
@@ -778,21 +803,34 @@ ENDX:   ;
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
+// channel-batched version of MAINThread
+#include "mixer.c"
+
 ////////////////////////////////////////////////////////////////////////
 // SPU ASYNC... even newer epsxe func
-//  1 time every 'cycle' cycles... harhar
+//  here 'cycle' is the number of samples to mix in one go
 ////////////////////////////////////////////////////////////////////////
 
 EXPORT_GCC void CALLBACK SPU2async(unsigned long cycle)
 {
- if(iSpuAsyncWait)
+ while(cycle)
   {
-   iSpuAsyncWait++;
-   if(iSpuAsyncWait<=64) return;
-   iSpuAsyncWait=0;
-  }
+   if(iUseBlockMixer && !iSpuAsyncWait)               // try to mix a whole block channel by channel
+    {
+     const int ns=MixBlock(cycle);
+     if(ns) {cycle-=ns;continue;}
+    }
+
+   cycle--;
+   if(iSpuAsyncWait)
+    {
+     iSpuAsyncWait++;
+     if(iSpuAsyncWait<=64) continue;
+     iSpuAsyncWait=0;
+    }
 
    MAINThread(0);                                      // -> linux high-compat mode
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////
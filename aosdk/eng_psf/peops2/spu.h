@@ -35,5 +35,7 @@ EXPORT_GCC void CALLBACK SPU2playADPCMchannel(xa_decode_t *xap);
 EXPORT_GCC long CALLBACK SPU2init(void);
 EXPORT_GCC long CALLBACK SPU2open(void *pDsp);
 EXPORT_GCC void CALLBACK SPU2async(unsigned long cycle);
+EXPORT_GCC void CALLBACK SPU2setBlockMixer(int iOn);
+EXPORT_GCC void CALLBACK SPU2muteChannel(int ch,int iMute);
 EXPORT_GCC void CALLBACK SPU2close(void);
 
@@ -84,6 +84,8 @@ extern void SPU2readDMA7Mem(uint32 usPSXMem,int iSize);
 extern void SPU2writeDMA7Mem(uint32 usPSXMem,int iSize);
 extern void SPU2interruptDMA4(void);
 extern void SPU2interruptDMA7(void);
+extern int SPUasync(uint32 cycles);
+extern void SPU2async(unsigned long cycle);
 
 #define MAX_FILE_SLOTS	(32)
 
@@ -471,6 +473,50 @@ void psx_irq_set(uint32 irq)
 	psx_irq_update();
 }
 
+// SPU catch-up
+//
+// psf_gen and psf2_gen step the IOP one sample at a time.  The SPU(2) only
+// sees the IOP through its registers, DMA and the DMA completion handlers,
+// so rather than mixing after every slice we count the samples owed and mix
+// them in one go right before the IOP touches any of those (or when the
+// frame is done).  The output is the same as mixing in lockstep.
+
+static int spu_pending = 0, spu2_pending = 0;
+
+static void spu_sync(void)
+{
+	if (spu_pending)
+	{
+		SPUasync(spu_pending * 384);
+		spu_pending = 0;
+	}
+}
+
+static void spu2_sync(void)
+{
+	if (spu2_pending)
+	{
+		SPU2async(spu2_pending);
+		spu2_pending = 0;
+	}
+}
+
+void psx_hw_spu_queue(void)
+{
+	spu_pending++;
+}
+
+void ps2_hw_spu_queue(void)
+{
+	spu2_pending++;
+}
+
+void psx_hw_spu_flush(void)
+{
+	spu_sync();
+	spu2_sync();
+}
+
 static uint32 gpu_stat = 0;
 
 uint32 psx_hw_read(offs_t offset, uint32 mem_mask)
@@ -510,6 +556,7 @@ uint32 psx_hw_read(offs_t offset, uint32 mem_mask)
 
 	if (offset >= 0x1f801c00 && offset <= 0x1f801dff)
 	{
+		spu_sync();
 		if ((mem_mask == 0xffff0000) || (mem_mask == 0xffffff00))
 		{
 			return SPUreadRegister(offset) & ~mem_mask;
@@ -523,6 +570,7 @@ uint32 psx_hw_read(offs_t offset, uint32 mem_mask)
 
 	if (offset >= 0xbf900000 && offset <= 0xbf9007ff)
 	{
+		spu2_sync();
 		if ((mem_mask == 0xffff0000) || (mem_mask == 0xffffff00))
 		{
 			return SPU2read(offset) & ~mem_mask;
@@ -598,6 +646,8 @@ uint32 psx_hw_read(offs_t offset, uint32 mem_mask)
 
 static void psx_dma4(uint32 madr, uint32 bcr, uint32 chcr)
 {
+	spu_sync();
+
 	if (chcr == 0x01000201)	// cpu to SPU
 	{
 //		printf("DMA4: RAM %08x to SPU\n", madr);
@@ -614,6 +664,8 @@ static void psx_dma4(uint32 madr, uint32 bcr, uint32 chcr)
 
 static void ps2_dma4(uint32 madr, uint32 bcr, uint32 chcr)
 {
+	spu2_sync();
+
 	if (chcr == 0x01000201)	// cpu to SPU2
 	{
 		#if DEBUG_HLE_IOP
@@ -636,6 +688,8 @@ static void ps2_dma4(uint32 madr, uint32 bcr, uint32 chcr)
 
 static void ps2_dma7(uint32 madr, uint32 bcr, uint32 chcr)
 {
+	spu2_sync();
+
 	if ((chcr == 0x01000201) || (chcr == 0x00100010) || (chcr == 0x000f0010) || (chcr == 0x00010010))	// cpu to SPU2
 	{
 		#if DEBUG_HLE_IOP
@@ -692,6 +746,7 @@ void psx_hw_write(offs_t offset, uint32 data, uint32 mem_mask)
 	if (offset >= 0x1f801c00 && offset <= 0x1f801dff)
 	{
 	  //		printf("SPU2 wrote %x to SPU1 address %x!\n", data, offset);
+		spu_sync();
 		if (mem_mask == 0xffff0000)
 		{
 			SPUwriteRegister(offset, data);
@@ -707,6 +762,7 @@ void psx_hw_write(offs_t offset, uint32 data, uint32 mem_mask)
 
 	if (offset >= 0xbf900000 && offset <= 0xbf9007ff)
 	{
+		spu2_sync();
 		if (mem_mask == 0xffff0000)
 		{
 			SPU2write(offset, data);
@@ -1305,6 +1361,7 @@ void psx_hw_init(void)
 
 	dma_icr = 0;
 	spu_delay = 0;
+	spu_pending = spu2_pending = 0;
 	irq_data = 0;
 	irq_mask = 0;
 	softcall_target = 0;
@@ -1859,6 +1916,7 @@ void psx_hw_runcounters(void)
 
 			if (dma4_delay == 0)
 			{
+				spu2_sync();
 				SPU2interruptDMA4();
 
 				if (dma4_cb)
@@ -1874,6 +1932,7 @@ void psx_hw_runcounters(void)
 
 			if (dma7_delay == 0)
 			{
+				spu2_sync();
 				SPU2interruptDMA7();
 
 				if (dma7_cb)
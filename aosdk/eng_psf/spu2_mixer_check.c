@@ -0,0 +1,223 @@
+/*
+    spu2_mixer_check.c - checks the PEOpS SPU2 block mixer against the
+    per-sample mixer
+
+    Random ADPCM with loop flags is uploaded to SPU2 RAM, then the voices of
+    both cores are driven with random register writes (volume, pitch, ADSR,
+    start address, key on/off, FM, noise, reverb) between SPU2async() calls.
+    Each seed is rendered with SPU2setBlockMixer(0) and with
+    SPU2setBlockMixer(1), and a hash of all the output has to match.  Some
+    seeds use the cubic interpolation and the reverb buffer overlapping the
+    samples.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ao.h"
+
+extern long SPU2init(void);
+extern long SPU2open(void *pDsp);
+extern void SPU2close(void);
+extern void SPU2async(unsigned long cycle);
+extern void SPU2setBlockMixer(int iOn);
+extern void SPU2write(unsigned long reg, unsigned short val);
+extern void SPU2writeDMA4Mem(uint32 usPSXMem, int iSize);
+extern void setlength2(int32 stop, int32 fade);
+extern int iUseInterpolation;
+
+// what the SPU2 expects from the rest of the PS2
+uint32 psx_ram[(2*1024*1024)/4];
+
+static uint64 out_hash;
+static long out_bytes;
+
+void ps2_update(unsigned char *pSound, long lBytes)
+{
+	long i;
+
+	for (i = 0; i < lBytes; i++)
+	{
+		out_hash = (out_hash ^ pSound[i]) * 1099511628211ULL;
+	}
+	out_bytes += lBytes;
+}
+
+static uint32 rnd_state;
+
+static int rnd(int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+#define W(reg, val)	SPU2write(0x1f900000 + (reg), (val))
+
+static void render(int block, int seed, int iters)
+{
+	unsigned char *ram = (unsigned char *)psx_ram;
+	int b, i, c, k, it, ev;
+
+	rnd_state = seed;
+	out_hash = 1469598103934665603ULL;
+	out_bytes = 0;
+
+	SPU2setBlockMixer(block);
+	if (seed % 5 == 4)
+	{
+		iUseInterpolation = 1;
+	}
+	SPU2init();
+	SPU2open(NULL);
+	setlength2((seed & 1) ? 20000 : ~0, 3000);
+
+	// ADPCM blocks: random shift/filter, loop start/end flags every 32 blocks
+	for (b = 0; b < 0x8000/16; b++)
+	{
+		unsigned char *q = ram + 0x1000 + b*16;
+
+		q[0] = (rnd(5) << 4) | (rnd(8) + 4);
+		q[1] = (b % 32 == 0) ? 4 : (b % 32 == 31) ? (rnd(4) ? 3 : 1) : (rnd(40) ? 0 : 1);
+		for (i = 2; i < 16; i++)
+		{
+			q[i] = rnd(256);
+		}
+	}
+	// to SPU2 word address 0x3000
+	W(0x1a8, 0);
+	W(0x1aa, 0x3000);
+	SPU2writeDMA4Mem(0x1000, 0x8000/2);
+
+	for (c = 0; c < 2; c++)
+	{
+		int o = c*0x400;
+		int rstart = (seed & 2) ? 0x3000 + 0x400 : 0x20000 + c*0x10000;
+
+		W(o+0x2e0, rstart >> 16);
+		W(o+0x2e2, rstart & 0xffff);
+		W(o+0x33c, (rstart + 0xffff) >> 16);
+		for (k = 0; k <= 86; k += 2)
+		{
+			W(o+0x2e4+k, (k & 2) ? rnd(0x2000) : 0);
+		}
+		for (k = 0; k < 20; k += 2)
+		{
+			W(c*0x28+0x774+k, rnd(0x10000));
+		}
+		W(c*0x28+0x764, rnd(0x8000));
+		W(c*0x28+0x766, rnd(0x8000));
+		W(o+0x19a, 0x0080 | (rnd(0x40) << 8) | ((seed % 7 == 6) ? 0x40 : 0));
+		W(o+0x188, 0xffff);
+		W(o+0x18a, 0xff);
+		W(o+0x190, 0xffff);
+		W(o+0x192, 0xff);
+		W(o+0x18c, rnd(0x10000));
+		W(o+0x18e, rnd(0x100));
+		W(o+0x194, rnd(0x10000));
+		W(o+0x196, rnd(0x100));
+	}
+
+	// a voice keyed on before its first pitch write divides by a zero step
+	// in the simple interpolation, so give every voice a pitch up front
+	for (k = 0; k < 48; k++)
+	{
+		W((k / 24)*0x400 + (k % 24)*16 + 4, 0x1000);
+	}
+
+	for (it = 0; it < iters; it++)
+	{
+		for (ev = rnd(12); ev > 0; ev--)
+		{
+			int v = rnd(48), c = v / 24, vv = v % 24;
+			int o = c*0x400 + vv*16, a = c*0x400 + 0x1c0 + vv*12;
+
+			switch (rnd(10))
+			{
+				case 0:	W(o+0, rnd(0x8000)); W(o+2, rnd(0x8000)); break;
+				case 1:	W(o+4, rnd(4) ? rnd(0x4000) : rnd(0x10000)); break;
+				case 2:	{ int s = 0x3000 + 8*rnd(0x8000/16); W(a+0, s >> 16); W(a+2, s & 0xffff); } break;
+				case 3:	W(o+6, rnd(0x10000)); W(o+8, rnd(0x10000)); break;
+				case 4:	W(c*0x400 + (vv < 16 ? 0x1a0 : 0x1a2), 1 << (vv & 15)); break;
+				case 5:	W(c*0x400 + (vv < 16 ? 0x1a4 : 0x1a6), 1 << (vv & 15)); break;
+				case 6:	W(c*0x400+0x180, rnd(0x10000)); W(c*0x400+0x182, rnd(0x100)); break;
+				case 7:	W(c*0x400+0x184, rnd(3) ? 0 : (1 << rnd(16))); W(c*0x400+0x186, rnd(4) ? 0 : (1 << rnd(8))); break;
+				case 8:	W(c*0x400+0x18c, rnd(0x10000)); W(c*0x400+0x194, rnd(0x10000)); break;
+				case 9:	W(c*0x400+0x188, rnd(0x10000)); W(c*0x400+0x190, rnd(0x10000)); break;
+			}
+		}
+		SPU2async(rnd(300) + 1);
+	}
+
+	SPU2close();
+}
+
+// the SPU2 doesn't reset all of its state in SPU2init(), so each run is done
+// in a child process, starting from the state a freshly loaded player has
+static int render_fresh(int block, int seed, int iters)
+{
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds))
+	{
+		return 0;
+	}
+
+	pid = fork();
+	if (pid == 0)
+	{
+		render(block, seed, iters);
+		if (write(fds[1], &out_hash, sizeof(out_hash)) != sizeof(out_hash) ||
+			write(fds[1], &out_bytes, sizeof(out_bytes)) != sizeof(out_bytes))
+		{
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(fds[1]);
+	status = (pid > 0) &&
+		read(fds[0], &out_hash, sizeof(out_hash)) == sizeof(out_hash) &&
+		read(fds[0], &out_bytes, sizeof(out_bytes)) == sizeof(out_bytes);
+	close(fds[0]);
+	if (pid > 0)
+	{
+		waitpid(pid, NULL, 0);
+	}
+	return status;
+}
+
+int main(int argc, char *argv[])
+{
+	int seed, failed = 0;
+
+	for (seed = 1; seed <= 8; seed++)
+	{
+		uint64 ref_hash;
+		long ref_bytes;
+
+		if (!render_fresh(0, seed, 2000))
+		{
+			printf("seed %d: render with the per-sample mixer failed\n", seed);
+			return 1;
+		}
+		ref_hash = out_hash;
+		ref_bytes = out_bytes;
+		if (!render_fresh(1, seed, 2000))
+		{
+			printf("seed %d: render with the block mixer failed\n", seed);
+			return 1;
+		}
+
+		printf("seed %d: %ld bytes, %016llx %s\n", seed, out_bytes, (unsigned long long)out_hash,
+			(out_hash == ref_hash && out_bytes == ref_bytes && out_bytes) ? "ok" : "MISMATCH");
+		if (out_hash != ref_hash || out_bytes != ref_bytes || !out_bytes)
+		{
+			failed = 1;
+		}
+	}
+
+	return failed;
+}
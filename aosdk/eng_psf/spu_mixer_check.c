@@ -0,0 +1,198 @@
+/*
+    spu_mixer_check.c - checks the PEOpS SPU block mixer against the
+    per-sample mixer
+
+    Random ADPCM with loop flags is uploaded to SPU RAM, then the voices
+    are driven with random register writes (volume, pitch, ADSR, key on/off,
+    FM, noise, reverb) between SPUasync() calls.  Each seed is rendered with
+    SPUsetBlockMixer(0) and with SPUsetBlockMixer(1), and a hash of all the
+    output has to match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ao.h"
+
+extern int SPUinit(void);
+extern int SPUopen(void);
+extern int SPUclose(void);
+extern int SPUasync(uint32 cycles);
+extern void SPU_flushboot(void);
+extern void SPUsetBlockMixer(int iOn);
+extern void SPUwriteRegister(uint32 reg, uint16 val);
+extern void SPUwriteDMAMem(uint32 usPSXMem, int iSize);
+extern void setlength(int32 stop, int32 fade);
+
+// what the SPU expects from the rest of the PSX
+uint32 psx_ram[(2*1024*1024)/4];
+
+static uint64 out_hash;
+static long out_bytes;
+
+void spu_update(unsigned char *pSound, long lBytes)
+{
+	long i;
+
+	for (i = 0; i < lBytes; i++)
+	{
+		out_hash = (out_hash ^ pSound[i]) * 1099511628211ULL;
+	}
+	out_bytes += lBytes;
+}
+
+void SPUirq(void)
+{
+}
+
+static uint32 rnd_state;
+
+static int rnd(int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+static void render(int block, int seed, int iters)
+{
+	unsigned char *ram = (unsigned char *)psx_ram;
+	int b, i, k, it, ev;
+
+	rnd_state = seed;
+	out_hash = 1469598103934665603ULL;
+	out_bytes = 0;
+
+	SPUsetBlockMixer(block);
+	SPUinit();
+	SPUopen();
+	setlength((seed & 1) ? 20000 : ~0, 3000);
+
+	// ADPCM blocks: random shift/filter, loop start/end flags every 32 blocks
+	for (b = 0; b < 0x6000/16; b++)
+	{
+		unsigned char *q = ram + 0x1000 + b*16;
+
+		q[0] = (rnd(5) << 4) | (rnd(8) + 4);
+		q[1] = (b % 32 == 0) ? 4 : (b % 32 == 31) ? (rnd(4) ? 3 : 1) : (rnd(40) ? 0 : 1);
+		for (i = 2; i < 16; i++)
+		{
+			q[i] = rnd(256);
+		}
+	}
+	SPUwriteRegister(0x1f801da6, 0x1000/8);
+	SPUwriteRegister(0x1f801dac, 4);
+	SPUwriteDMAMem(0x1000, 0x6000/2);
+
+	SPUwriteRegister(0x1f801d80, 0x3fff);
+	SPUwriteRegister(0x1f801d82, 0x3fff);
+	SPUwriteRegister(0x1f801d84, 0x3000);
+	SPUwriteRegister(0x1f801d86, 0x3000);
+	SPUwriteRegister(0x1f801daa, 0xc080 | (rnd(0x40) << 8));
+	SPUwriteRegister(0x1f801da2, (seed & 2) ? 0x200 + 0x1000/8 + 0x400/8 : 0xe000);
+	for (k = 0; k < 32; k++)
+	{
+		SPUwriteRegister(0x1f801dc0 + 2*k, ((k >= 1 && k <= 9) || k >= 30) ? rnd(0x7000) + 0x1000 :
+			(seed & 4) ? rnd(0x10000) : rnd(0x800) + 0x10);
+	}
+	SPUwriteRegister(0x1f801d98, rnd(0x10000));
+	SPUwriteRegister(0x1f801d9a, rnd(0x100));
+
+	for (it = 0; it < iters; it++)
+	{
+		for (ev = rnd(10); ev > 0; ev--)
+		{
+			int v = rnd(24), o = 0x1f801c00 + v*16;
+
+			switch (rnd(9))
+			{
+				case 0:	SPUwriteRegister(o+0, rnd(0x8000)); SPUwriteRegister(o+2, rnd(0x8000)); break;
+				case 1:	SPUwriteRegister(o+4, rnd(4) ? rnd(0x4000) : rnd(0x10000)); break;
+				case 2:	SPUwriteRegister(o+6, (0x1000 + 16*rnd(0x6000/16))/8); break;
+				case 3:	SPUwriteRegister(o+8, rnd(0x10000)); SPUwriteRegister(o+10, rnd(0x10000)); break;
+				case 4:	SPUwriteRegister(v < 16 ? 0x1f801d88 : 0x1f801d8a, 1 << (v & 15)); break;
+				case 5:	SPUwriteRegister(v < 16 ? 0x1f801d8c : 0x1f801d8e, 1 << (v & 15)); break;
+				case 6:	SPUwriteRegister(0x1f801d90, rnd(0x10000)); SPUwriteRegister(0x1f801d92, rnd(0x100)); break;
+				case 7:	SPUwriteRegister(0x1f801d94, rnd(3) ? 0 : (1 << rnd(16))); SPUwriteRegister(0x1f801d96, rnd(4) ? 0 : (1 << rnd(8))); break;
+				case 8:	SPUwriteRegister(0x1f801daa, (rnd(8) ? 0xc080 : 0x8080) | (rnd(0x40) << 8)); SPUwriteRegister(0x1f801d98, rnd(0x10000)); break;
+			}
+		}
+		if (!SPUasync((rnd(300) + 1) * 384))
+		{
+			break;
+		}
+		SPU_flushboot();
+	}
+
+	SPUclose();
+}
+
+// the SPU doesn't reset all of its state in SPUinit(), so each run is done
+// in a child process, starting from the state a freshly loaded player has
+static int render_fresh(int block, int seed, int iters)
+{
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds))
+	{
+		return 0;
+	}
+
+	pid = fork();
+	if (pid == 0)
+	{
+		render(block, seed, iters);
+		if (write(fds[1], &out_hash, sizeof(out_hash)) != sizeof(out_hash) ||
+			write(fds[1], &out_bytes, sizeof(out_bytes)) != sizeof(out_bytes))
+		{
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(fds[1]);
+	status = (pid > 0) &&
+		read(fds[0], &out_hash, sizeof(out_hash)) == sizeof(out_hash) &&
+		read(fds[0], &out_bytes, sizeof(out_bytes)) == sizeof(out_bytes);
+	close(fds[0]);
+	if (pid > 0)
+	{
+		waitpid(pid, NULL, 0);
+	}
+	return status;
+}
+
+int main(int argc, char *argv[])
+{
+	int seed, failed = 0;
+
+	for (seed = 1; seed <= 8; seed++)
+	{
+		uint64 ref_hash;
+		long ref_bytes;
+
+		if (!render_fresh(0, seed, 2000))
+		{
+			printf("seed %d: render with the per-sample mixer failed\n", seed);
+			return 1;
+		}
+		ref_hash = out_hash;
+		ref_bytes = out_bytes;
+		if (!render_fresh(1, seed, 2000))
+		{
+			printf("seed %d: render with the block mixer failed\n", seed);
+			return 1;
+		}
+
+		printf("seed %d: %ld bytes, %016llx %s\n", seed, out_bytes, (unsigned long long)out_hash,
+			(out_hash == ref_hash && out_bytes == ref_bytes && out_bytes) ? "ok" : "MISMATCH");
+		if (out_hash != ref_hash || out_bytes != ref_bytes || !out_bytes)
+		{
+			failed = 1;
+		}
+	}
+
+	return failed;
+}
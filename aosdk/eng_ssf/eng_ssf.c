@@ -211,19 +211,16 @@ int32 ssf_gen(int16 *buffer, uint32 samples)
 	int i;
 	//int16 output[44100/30], output2[44100/30];
 	int16 output[44100], output2[44100];
-	int16 *stereo[2];
 	int16 *outp = buffer;
-	int opos;
 
-	opos = 0;
+	// the scheduler in sat_hw.c renders into output/output2 in batches
+	sat_hw_sched_begin(output, output2);
 	for (i = 0; i < samples; i++)
 	{
 		m68k_execute((11300000/60)/735);
-		stereo[0] = &output[opos];
-		stereo[1] = &output2[opos];
-		SCSP_Update(NULL, NULL, stereo, 1);
-		opos++;		
+		sat_hw_sched_slice();
 	}
+	sat_hw_sched_end();
 
 	for (i = 0; i < samples; i++)
 	{
@@ -274,6 +271,20 @@ int32 ssf_command(int32 command, int32 parameter)
 	return AO_FAIL;
 }
 
+int32 ssf_voice_count(void)
+{
+	return 32;
+}
+
+int32 ssf_mute_voice(int32 voice, int32 mute)
+{
+	if (voice < 0 || voice >= 32)
+		return AO_FAIL;
+
+	SCSP_MuteSlot(voice, mute);
+	return AO_SUCCESS;
+}
+
 int32 ssf_fill_info(ao_display_info *info)
 {
 	if (c == NULL)
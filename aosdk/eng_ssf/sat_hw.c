@@ -37,6 +37,84 @@
 
 uint8 sat_ram[512*1024];
 
+/*
+    Sample scheduler
+
+    ssf_gen() runs the 68000 in fixed slices, one per output sample.  Rather
+    than rendering a sample after every slice, we let the CPU run ahead and
+    only catch the SCSP up when the 68000 could observe the difference: an
+    SCSP register access, a RAM access that overlaps what the slots or DSP
+    are fetching, or a timer about to raise an IRQ.  The deferred samples are
+    then rendered in one SCSP_Update() batch, so the output is identical to
+    the old lockstep loop; sat_hw_set_lockstep(1) brings that loop back
+    for aosdk/sched_check.c to compare against.
+*/
+
+#define SCHED_PAGE_SHIFT	(12)
+
+static INT16 *sched_bufl, *sched_bufr;
+static int sched_pending;	// slices run but not yet rendered
+static int sched_horizon;	// slices we may run before the next SCSP event
+static int sched_touched;	// the CPU accessed the SCSP in this slice
+static int sched_lockstep;	// render after every slice, for checking the above
+static uint8 sched_busy[(512*1024) >> SCHED_PAGE_SHIFT];
+
+static void sched_flush(void)
+{
+	INT16 *stereo[2];
+	int samples = sched_pending;
+
+	// rendering can raise an IRQ, and the 68000 takes it immediately,
+	// so clear our state before the exception frame is pushed
+	if (samples)
+	{
+		stereo[0] = sched_bufl;
+		stereo[1] = sched_bufr;
+		sched_bufl += samples;
+		sched_bufr += samples;
+		sched_pending = 0;
+		SCSP_Update(NULL, NULL, stereo, samples);
+	}
+
+	sched_touched = 0;
+	sched_horizon = SCSP_SamplesToNextEvent();
+	SCSP_MarkBusyRAM(sched_busy, SCHED_PAGE_SHIFT);
+}
+
+// register access: render everything before this slice, and the sample
+// for this slice as soon as it completes
+#define SCHED_SYNC_REG() \
+	do { if (sched_pending) sched_flush(); sched_touched = 1; } while (0)
+
+// RAM access: only sync if the SCSP reads/writes this page while rendering
+#define SCHED_SYNC_RAM(address, flag) \
+	do { if ((sched_busy[(address) >> SCHED_PAGE_SHIFT] & (flag)) && sched_pending) sched_flush(); } while (0)
+
+void sat_hw_sched_begin(INT16 *left, INT16 *right)
+{
+	sched_bufl = left;
+	sched_bufr = right;
+	sched_pending = 0;
+	sched_flush();
+}
+
+void sat_hw_set_lockstep(int on)
+{
+	sched_lockstep = on;
+}
+
+void sat_hw_sched_slice(void)
+{
+	sched_pending++;
+	if (sched_lockstep || sched_touched || sched_pending >= sched_horizon)
+		sched_flush();
+}
+
+void sat_hw_sched_end(void)
+{
+	sched_flush();
+}
+
 static void scsp_irq(int irq)
 {
 	if (irq > 0)
@@ -56,7 +134,7 @@ static struct SCSPinterface scsp_interface =
 	{ sat_ram, },
 	{ YM3012_VOL(100, MIXER_PAN_LEFT, 100, MIXER_PAN_RIGHT) },
 	{ scsp_irq, },
-};
+};
 
 void sat_hw_init(void)
 {
@@ -73,11 +151,17 @@ void sat_hw_init(void)
 unsigned int m68k_read_memory_8(unsigned int address)
 {
 	if (address < (512*1024))
+	{
+		SCHED_SYNC_RAM(address, SCSP_RAM_WRITE);
 		return sat_ram[address^1];
+	}
 
 	if (address >= 0x100000 && address < 0x100c00)
 	{
-		int foo = SCSP_0_r((address - 0x100000)/2, 0);
+		int foo;
+
+		SCHED_SYNC_REG();
+		foo = SCSP_0_r((address - 0x100000)/2, 0);
 
 		if (address & 1)
 			return foo & 0xff;
@@ -93,11 +177,15 @@ unsigned int m68k_read_memory_16(unsigned int address)
 {
 	if (address < (512*1024))
 	{
+		SCHED_SYNC_RAM(address, SCSP_RAM_WRITE);
 		return mem_readword_swap((unsigned short *)(sat_ram+address));
 	}
 
 	if (address >= 0x100000 && address < 0x100c00)
+	{
+		SCHED_SYNC_REG();
 		return SCSP_0_r((address-0x100000)/2, 0);
+	}
 
 	printf("R16 @ %x\n", address);
 	return 0;
@@ -107,6 +195,7 @@ unsigned int m68k_read_memory_32(unsigned int address)
 {
 	if (address < 0x80000)
 	{
+		SCHED_SYNC_RAM(address, SCSP_RAM_WRITE);
 		return sat_ram[address+2] | sat_ram[address+3]<<8 | sat_ram[address]<<16 | sat_ram[address+1]<<24;
 	}
 
@@ -118,12 +207,14 @@ void m68k_write_memory_8(unsigned int address, unsigned int data)
 {
 	if (address < 0x80000)
 	{
+		SCHED_SYNC_RAM(address, SCSP_RAM_READ|SCSP_RAM_WRITE);
 		sat_ram[address^1] = data;
 		return;
 	}
 
 	if (address >= 0x100000 && address < 0x100c00)
 	{
+		SCHED_SYNC_REG();
 		address -= 0x100000;
 		if (address & 1)
 			SCSP_0_w(address>>1, data, 0xff00);
@@ -137,6 +228,7 @@ void m68k_write_memory_16(unsigned int address, unsigned int data)
 {
 	if (address < 0x80000)
 	{
+		SCHED_SYNC_RAM(address, SCSP_RAM_READ|SCSP_RAM_WRITE);
 		sat_ram[address+1] = (data>>8)&0xff;
 		sat_ram[address] = data&0xff;
 		return;
@@ -144,6 +236,7 @@ void m68k_write_memory_16(unsigned int address, unsigned int data)
 
 	if (address >= 0x100000 && address < 0x100c00)
 	{
+		SCHED_SYNC_REG();
 		SCSP_0_w((address-0x100000)>>1, data, 0x0000);
 		return;
 	}
@@ -153,6 +246,7 @@ void m68k_write_memory_32(unsigned int address, unsigned int data)
 {
 	if (address < 0x80000)
 	{
+		SCHED_SYNC_RAM(address, SCSP_RAM_READ|SCSP_RAM_WRITE);
 		sat_ram[address+1] = (data>>24)&0xff;
 		sat_ram[address] = (data>>16)&0xff;
 		sat_ram[address+3] = (data>>8)&0xff;
@@ -162,6 +256,7 @@ void m68k_write_memory_32(unsigned int address, unsigned int data)
 
 	if (address >= 0x100000 && address < 0x100c00)
 	{
+		SCHED_SYNC_REG();
 		address -= 0x100000;
 		SCSP_0_w(address>>1, data>>16, 0x0000);
 		SCSP_0_w((address>>1)+1, data&0xffff, 0x0000);
@@ -5,6 +5,11 @@ extern uint8 sat_ram[512*1024];
 
 void sat_hw_init(void);
 
+void sat_hw_set_lockstep(int on);
+void sat_hw_sched_begin(INT16 *left, INT16 *right);
+void sat_hw_sched_slice(void);
+void sat_hw_sched_end(void);
+
 #if !LSB_FIRST
 static unsigned short INLINE mem_readword_swap(unsigned short *addr)
 {
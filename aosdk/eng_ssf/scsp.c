@@ -111,6 +111,12 @@ static const double DRTimes[64]={100000/*infinity*/,100000/*infinity*/,118200.0,
 static UINT32 FNS_Table[0x400];
 static INT32 EG_TABLE[0x400];
 
+// Like FNS_Table and EG_TABLE, the level/pan tables are the same for every SCSP,
+// so SCSP_InitTables() only makes them once
+static int LPANTABLE[0x10000];
+static int RPANTABLE[0x10000];
+static int TablesMade;
+
 typedef enum {ATTACK,DECAY1,DECAY2,RELEASE} _STATE;
 struct _EG
 {
@@ -146,6 +152,7 @@ struct _SLOT
 	struct _LFO ALFO;		//Amplitude LFO
 	int slot;
 	signed short Prev;	//Previous sample (for interpolation)
+	UINT8 mute;	//muted by the player, see SCSP_MuteSlot
 };
 
 
@@ -204,9 +211,6 @@ struct _SCSP
 	UINT8 MidiStack[16];
 	UINT8 MidiW,MidiR;
 
-	int LPANTABLE[0x10000];
-	int RPANTABLE[0x10000];
-
 	int TimPris[3];
 	int TimCnt[3];
 
@@ -444,36 +448,9 @@ static void SCSP_StopSlot(struct _SLOT *slot,int keyoff)
 
 #define log_base_2(n) (log((float) n)/log((float) 2))
 
-static void SCSP_Init(struct _SCSP *SCSP, const struct SCSPinterface *intf)
+static void SCSP_InitTables(void)
 {
-	int i=0;
-
-	SCSP->IrqTimA = SCSP->IrqTimBC = SCSP->IrqMidi = 0;
-	SCSP->MidiR=SCSP->MidiW=0;
-	SCSP->MidiOutR=SCSP->MidiOutW=0;
-
-	// get SCSP RAM
-	{
-		memset(SCSP,0,sizeof(*SCSP));
-
-		if (!i)
-		{
-			SCSP->Master=1;
-		}
-		else
-		{
-			SCSP->Master=0;
-		}
-
-		if (intf->region)
-		{
-			SCSP->SCSPRAM = &sat_ram[0]; //(unsigned char *)intf->region;
-			SCSP->SCSPRAM_LENGTH = 512*1024;
-			SCSP->DSP.SCSPRAM = (UINT16 *)SCSP->SCSPRAM;
-			SCSP->DSP.SCSPRAM_LENGTH =  (512*1024)/2;
-//			SCSP->SCSPRAM += intf->roffset;
-		}
-	}
+	int i;
 
 	for(i=0;i<0x400;++i)
 	{
@@ -536,10 +513,47 @@ static void SCSP_Init(struct _SCSP *SCSP, const struct SCSPinterface *intf)
 		else
 			fSDL=0.0;
 
-		SCSP->LPANTABLE[i]=FIX((4.0*LPAN*TL*fSDL));
-		SCSP->RPANTABLE[i]=FIX((4.0*RPAN*TL*fSDL));
+		LPANTABLE[i]=FIX((4.0*LPAN*TL*fSDL));
+		RPANTABLE[i]=FIX((4.0*RPAN*TL*fSDL));
 	}
 
+	TablesMade=1;
+}
+
+static void SCSP_Init(struct _SCSP *SCSP, const struct SCSPinterface *intf)
+{
+	int i=0;
+
+	SCSP->IrqTimA = SCSP->IrqTimBC = SCSP->IrqMidi = 0;
+	SCSP->MidiR=SCSP->MidiW=0;
+	SCSP->MidiOutR=SCSP->MidiOutW=0;
+
+	// get SCSP RAM
+	{
+		memset(SCSP,0,sizeof(*SCSP));
+
+		if (!i)
+		{
+			SCSP->Master=1;
+		}
+		else
+		{
+			SCSP->Master=0;
+		}
+
+		if (intf->region)
+		{
+			SCSP->SCSPRAM = &sat_ram[0]; //(unsigned char *)intf->region;
+			SCSP->SCSPRAM_LENGTH = 512*1024;
+			SCSP->DSP.SCSPRAM = (UINT16 *)SCSP->SCSPRAM;
+			SCSP->DSP.SCSPRAM_LENGTH =  (512*1024)/2;
+//			SCSP->SCSPRAM += intf->roffset;
+		}
+	}
+
+	if(!TablesMade)
+		SCSP_InitTables();
+
 	SCSP->ARTABLE[0]=SCSP->DRTABLE[0]=0;	//Infinite time
 	SCSP->ARTABLE[1]=SCSP->DRTABLE[1]=0;	//Infinite time
 	for(i=2;i<64;++i)
@@ -779,6 +793,7 @@ static void SCSP_w16(struct _SCSP *SCSP,unsigned int addr,unsigned short val)
 	else
 	{
 		//DSP
+		SCSP->DSP.Dirty=1;
 		if(addr<0x780)	//COEF
 			*((unsigned short *) (SCSP->DSP.COEF+(addr-0x700)/2))=val;
 		else if(addr<0x800)
@@ -860,71 +875,13 @@ void SCSP_TimersAddTicks(struct _SCSP *SCSP, int ticks)
 	}
 }
 
-INLINE INT32 SCSP_UpdateSlot(struct _SCSP *SCSP, struct _SLOT *slot)
+// moves a slot's play position one sample on and handles the loop modes
+INLINE void SCSP_StepSlot(struct _SCSP *SCSP, struct _SLOT *slot, int step)
 {
-	INT32 sample;
-	int step=slot->step;
 	UINT32 addr1,addr2,addr_select;                                   // current and next sample addresses
 	UINT32 *addr[2]      = {&addr1, &addr2};                          // used for linear interpolation
 	UINT32 *slot_addr[2] = {&(slot->cur_addr), &(slot->nxt_addr)};    //
 
-	if(SSCTL(slot)!=0)	//no FM or noise yet
-		return 0;
-
-	if(PLFOS(slot)!=0)
-	{
-		step=step*PLFO_Step(&(slot->PLFO));
-		step>>=SHIFT;
-	}
-
-	if(PCM8B(slot))
-	{
-		addr1=slot->cur_addr>>SHIFT;
-		addr2=slot->nxt_addr>>SHIFT;
-	}
-	else
-	{
-		addr1=(slot->cur_addr>>(SHIFT-1))&0x7fffe;
-		addr2=(slot->nxt_addr>>(SHIFT-1))&0x7fffe;
-	}
-
-	if(MDL(slot)!=0 || MDXSL(slot)!=0 || MDYSL(slot)!=0)
-	{
-		INT32 smp=(SCSP->RINGBUF[(SCSP->BUFPTR+MDXSL(slot))&63]+SCSP->RINGBUF[(SCSP->BUFPTR+MDYSL(slot))&63])/2;
-
-		smp<<=0xA; // associate cycle with 1024
-		smp>>=0x1A-MDL(slot); // ex. for MDL=0xF, sample range corresponds to +/- 64 pi (32=2^5 cycles) so shift by 11 (16-5 == 0x1A-0xF)
-		if(!PCM8B(slot)) smp<<=1;
-		
-		addr1+=smp; addr2+=smp;
-	}
-
-	if(PCM8B(slot))	//8 bit signed
-	{
-		INT8 *p1=(signed char *) (SCSP->SCSPRAM+(((SA(slot)+addr1)^1)&0x7FFFF));
-		INT8 *p2=(signed char *) (SCSP->SCSPRAM+(((SA(slot)+addr2)^1)&0x7FFFF));
-		//sample=(p[0])<<8;
-		INT32 s;
-		INT32 fpart=slot->cur_addr&((1<<SHIFT)-1);
-		s=(int) (p1[0]<<8)*((1<<SHIFT)-fpart)+(int) (p2[0]<<8)*fpart;
-		sample=(s>>SHIFT);
-	}
-	else	//16 bit signed (endianness?)
-	{
-		INT16 *p1=(signed short *) (SCSP->SCSPRAM+((SA(slot)+addr1)&0x7FFFE));
-		INT16 *p2=(signed short *) (SCSP->SCSPRAM+((SA(slot)+addr2)&0x7FFFE));
-		//sample=LE16(p[0]);
-		INT32 s;
-		INT32 fpart=slot->cur_addr&((1<<SHIFT)-1);
-		s=(int) LE16(p1[0])*((1<<SHIFT)-fpart)+(int) LE16(p2[0])*fpart;
-		sample=(s>>SHIFT);
-	}
-
-	if(SBCTL(slot)&0x1)
-		sample ^= 0x7FFF;
-	if(SBCTL(slot)&0x2)
-		sample = (INT16)(sample^0x8000);
-
 	if(slot->Backwards)
 		slot->cur_addr-=step;
 	else
@@ -988,6 +945,72 @@ INLINE INT32 SCSP_UpdateSlot(struct _SCSP *SCSP, struct _SLOT *slot)
 			break;
 		}
 	}
+}
+
+INLINE INT32 SCSP_UpdateSlot(struct _SCSP *SCSP, struct _SLOT *slot)
+{
+	INT32 sample;
+	int step=slot->step;
+	UINT32 addr1,addr2;                                   // current and next sample addresses
+
+	if(SSCTL(slot)!=0)	//no FM or noise yet
+		return 0;
+
+	if(PLFOS(slot)!=0)
+	{
+		step=step*PLFO_Step(&(slot->PLFO));
+		step>>=SHIFT;
+	}
+
+	if(PCM8B(slot))
+	{
+		addr1=slot->cur_addr>>SHIFT;
+		addr2=slot->nxt_addr>>SHIFT;
+	}
+	else
+	{
+		addr1=(slot->cur_addr>>(SHIFT-1))&0x7fffe;
+		addr2=(slot->nxt_addr>>(SHIFT-1))&0x7fffe;
+	}
+
+	if(MDL(slot)!=0 || MDXSL(slot)!=0 || MDYSL(slot)!=0)
+	{
+		INT32 smp=(SCSP->RINGBUF[(SCSP->BUFPTR+MDXSL(slot))&63]+SCSP->RINGBUF[(SCSP->BUFPTR+MDYSL(slot))&63])/2;
+
+		smp<<=0xA; // associate cycle with 1024
+		smp>>=0x1A-MDL(slot); // ex. for MDL=0xF, sample range corresponds to +/- 64 pi (32=2^5 cycles) so shift by 11 (16-5 == 0x1A-0xF)
+		if(!PCM8B(slot)) smp<<=1;
+		
+		addr1+=smp; addr2+=smp;
+	}
+
+	if(PCM8B(slot))	//8 bit signed
+	{
+		INT8 *p1=(signed char *) (SCSP->SCSPRAM+(((SA(slot)+addr1)^1)&0x7FFFF));
+		INT8 *p2=(signed char *) (SCSP->SCSPRAM+(((SA(slot)+addr2)^1)&0x7FFFF));
+		//sample=(p[0])<<8;
+		INT32 s;
+		INT32 fpart=slot->cur_addr&((1<<SHIFT)-1);
+		s=(int) (p1[0]<<8)*((1<<SHIFT)-fpart)+(int) (p2[0]<<8)*fpart;
+		sample=(s>>SHIFT);
+	}
+	else	//16 bit signed (endianness?)
+	{
+		INT16 *p1=(signed short *) (SCSP->SCSPRAM+((SA(slot)+addr1)&0x7FFFE));
+		INT16 *p2=(signed short *) (SCSP->SCSPRAM+((SA(slot)+addr2)&0x7FFFE));
+		//sample=LE16(p[0]);
+		INT32 s;
+		INT32 fpart=slot->cur_addr&((1<<SHIFT)-1);
+		s=(int) LE16(p1[0])*((1<<SHIFT)-fpart)+(int) LE16(p2[0])*fpart;
+		sample=(s>>SHIFT);
+	}
+
+	if(SBCTL(slot)&0x1)
+		sample ^= 0x7FFF;
+	if(SBCTL(slot)&0x2)
+		sample = (INT16)(sample^0x8000);
+
+	SCSP_StepSlot(SCSP, slot, step);
 
 	if(ALFOS(slot)!=0)
 	{
@@ -1003,12 +1026,35 @@ INLINE INT32 SCSP_UpdateSlot(struct _SCSP *SCSP, struct _SLOT *slot)
 	if(!STWINH(slot))
 	{
 		unsigned short Enc=((TL(slot))<<0x0)|(0x7<<0xd);
-		*RBUFDST=(sample*SCSP->LPANTABLE[Enc])>>(SHIFT+1);
+		*RBUFDST=(sample*LPANTABLE[Enc])>>(SHIFT+1);
 	}
 		
 	return sample;
 }
 
+// a muted slot whose output isn't fed back for FM: the same position, LFO
+// and EG stepping as SCSP_UpdateSlot, without fetching the sample
+INLINE void SCSP_SkipSlot(struct _SCSP *SCSP, struct _SLOT *slot)
+{
+	int step=slot->step;
+
+	if(SSCTL(slot)!=0)	//no FM or noise yet
+		return;
+
+	if(PLFOS(slot)!=0)
+	{
+		step=step*PLFO_Step(&(slot->PLFO));
+		step>>=SHIFT;
+	}
+
+	SCSP_StepSlot(SCSP, slot, step);
+
+	if(ALFOS(slot)!=0)
+		ALFO_Step(&(slot->ALFO));
+
+	EG_Update(slot);
+}
+
 static void SCSP_DoMasterSamples(struct _SCSP *SCSP, int nsamples)
 {
 	INT16 *bufr,*bufl;
@@ -1036,14 +1082,20 @@ static void SCSP_DoMasterSamples(struct _SCSP *SCSP, int nsamples)
 				unsigned short Enc;
 				signed int sample;
 
-				sample=SCSP_UpdateSlot(SCSP, slot);
-
-				Enc=((TL(slot))<<0x0)|((IMXL(slot))<<0xd);
-				SCSPDSP_SetSample(&SCSP->DSP,(sample*SCSP->LPANTABLE[Enc])>>(SHIFT-2),ISEL(slot),IMXL(slot));
-				Enc=((TL(slot))<<0x0)|((DIPAN(slot))<<0x8)|((DISDL(slot))<<0xd);
+				if(slot->mute && STWINH(slot))
+					SCSP_SkipSlot(SCSP, slot);
+				else
 				{
-					smpl+=(sample*SCSP->LPANTABLE[Enc])>>SHIFT;
-					smpr+=(sample*SCSP->RPANTABLE[Enc])>>SHIFT;
+					sample=SCSP_UpdateSlot(SCSP, slot);
+
+					if(!slot->mute)
+					{
+						Enc=((TL(slot))<<0x0)|((IMXL(slot))<<0xd);
+						SCSPDSP_SetSample(&SCSP->DSP,(sample*LPANTABLE[Enc])>>(SHIFT-2),ISEL(slot),IMXL(slot));
+						Enc=((TL(slot))<<0x0)|((DIPAN(slot))<<0x8)|((DISDL(slot))<<0xd);
+						smpl+=(sample*LPANTABLE[Enc])>>SHIFT;
+						smpr+=(sample*RPANTABLE[Enc])>>SHIFT;
+					}
 				}
 			}
 			
@@ -1066,8 +1118,8 @@ static void SCSP_DoMasterSamples(struct _SCSP *SCSP, int nsamples)
 			if(EFSDL(slot))
 			{
 				unsigned short Enc=((EFPAN(slot))<<0x8)|((EFSDL(slot))<<0xd);
-				smpl+=(SCSP->DSP.EFREG[i]*SCSP->LPANTABLE[Enc])>>SHIFT;
-				smpr+=(SCSP->DSP.EFREG[i]*SCSP->RPANTABLE[Enc])>>SHIFT;
+				smpl+=(SCSP->DSP.EFREG[i]*LPANTABLE[Enc])>>SHIFT;
+				smpr+=(SCSP->DSP.EFREG[i]*RPANTABLE[Enc])>>SHIFT;
 			}
 		}
 
@@ -1146,6 +1198,130 @@ void SCSP_Update(void *param, INT16 **inputs, INT16 **buf, int samples)
 	SCSP_DoMasterSamples(SCSP, samples);
 }
 
+/*
+    Scheduler support.  sat_hw.c lets the 68000 run ahead of the sound
+    output and renders deferred samples in one SCSP_Update() batch; these
+    tell it how far it may run ahead and which parts of sound RAM the chip
+    itself touches while rendering.
+*/
+
+// the IRQ level CheckPendingIRQ() would assert on the next sample
+static int SCSP_PendingIRQLevel(struct _SCSP *SCSP)
+{
+	UINT32 pend=SCSP->udata.data[0x20/2];
+	UINT32 en=SCSP->udata.data[0x1e/2];
+
+	if(SCSP->MidiW!=SCSP->MidiR)
+		return SCSP->IrqMidi;
+	if((pend&0x40) && (en&0x40))
+		return SCSP->IrqTimA;
+	if((pend&0x80) && (en&0x80))
+		return SCSP->IrqTimBC;
+	if((pend&0x100) && (en&0x100))
+		return SCSP->IrqTimBC;
+	return 0;
+}
+
+int SCSP_SamplesToNextEvent(void)
+{
+	struct _SCSP *SCSP = AllocedSCSP;
+	int i, n, samples = 0x7fffffff;
+
+	// an asserted IRQ is re-raised after every sample, so stay in lockstep
+	if(SCSP_PendingIRQLevel(SCSP))
+		return 1;
+
+	// otherwise the next change comes from a timer expiring
+	for(i=0;i<3;++i)
+	{
+		if(SCSP->TimCnt[i]<=0xff00)
+		{
+			int step=1<<(8-((SCSP->udata.data[(0x18/2)+i]>>8)&0x7));
+			n=((0xff00-SCSP->TimCnt[i])/step)+1;
+			if(n<samples)
+				samples=n;
+		}
+	}
+
+	return samples;
+}
+
+static void SCSP_MarkRAM(UINT8 *map, int shift, UINT32 start, UINT32 len, UINT8 flags)
+{
+	UINT32 pages=0x80000>>shift;
+	UINT32 page, count;
+
+	start&=0x7ffff;
+	page=start>>shift;
+	count=((start+len-1)>>shift)-page+1;
+	if(count>pages)
+		count=pages;
+	while(count--)
+	{
+		map[page]|=flags;
+		page=(page+1)&(pages-1);
+	}
+}
+
+void SCSP_MarkBusyRAM(UINT8 *map, int shift)
+{
+	struct _SCSP *SCSP = AllocedSCSP;
+	int sl;
+
+	memset(map, 0, 0x80000>>shift);
+
+	for(sl=0;sl<32;++sl)
+	{
+		struct _SLOT *slot=SCSP->Slots+sl;
+		UINT32 top, mod=0;
+
+		if(!slot->active || SSCTL(slot)!=0)
+			continue;
+
+		// modulation moves the fetch by at most +/- 2^(MDL-1) samples
+		if(MDL(slot)!=0 || MDXSL(slot)!=0 || MDYSL(slot)!=0)
+			mod=1<<MDL(slot);
+
+		// highest sample index the slot can fetch before it loops or stops
+		top=LEA(slot);
+		if(LSA(slot)>top)
+			top=LSA(slot);
+		if((slot->cur_addr>>SHIFT)>top)
+			top=slot->cur_addr>>SHIFT;
+		if((slot->nxt_addr>>SHIFT)>top)
+			top=slot->nxt_addr>>SHIFT;
+		top+=((slot->step*2)>>SHIFT)+2;
+		if(!PCM8B(slot))
+		{
+			top*=2;
+			mod*=2;
+		}
+
+		SCSP_MarkRAM(map, shift, SA(slot)-4-mod, top+8+mod*2, SCSP_RAM_READ);
+	}
+
+	// the DSP only touches its ring buffer (or a table) through MRD/MWT
+	if(!SCSP->DSP.Stopped)
+	{
+		UINT32 len=SCSP->DSP.RBL;
+		int flags=0;
+
+		for(sl=0;sl<SCSP->DSP.LastStep;++sl)
+		{
+			UINT16 *IPtr=SCSP->DSP.MPRO+sl*4;
+
+			if(IPtr[2]&0x2000)
+				flags|=SCSP_RAM_READ;
+			if(IPtr[2]&0x4000)
+				flags|=SCSP_RAM_WRITE;
+			if((IPtr[2]&0x6000) && (IPtr[2]&0x8000))
+				len=0x10000;
+		}
+		if(flags)
+			SCSP_MarkRAM(map, shift, SCSP->DSP.RBP<<13, len*2, flags);
+	}
+}
+
 void *scsp_start(const void *config)
 {
 	const struct SCSPinterface *intf;
@@ -1183,6 +1359,13 @@ void SCSP_set_ram_base(int which, void *base)
 	}
 }
 
+void SCSP_MuteSlot(int slot, int mute)
+{
+	struct _SCSP *SCSP = AllocedSCSP;
+	if (SCSP && slot >= 0 && slot < 32)
+		SCSP->Slots[slot].mute = mute ? 1 : 0;
+}
+
 
 READ16_HANDLER( SCSP_0_r )
 {
@@ -27,6 +27,17 @@ struct SCSPinterface
 void *scsp_start(const void *config);
 void SCSP_Update(void *param, INT16 **inputs, INT16 **buf, int samples);
 
+// scheduler support: how far the CPU may run ahead, and which RAM pages
+// the slots/DSP read or write while rendering
+#define SCSP_RAM_READ	(1)
+#define SCSP_RAM_WRITE	(2)
+int SCSP_SamplesToNextEvent(void);
+void SCSP_MarkBusyRAM(UINT8 *map, int shift);
+
+// player-side muting: a muted slot keeps stepping its position/LFO/EG but
+// isn't fetched or mixed (unless another slot uses it for FM)
+void SCSP_MuteSlot(int slot, int mute);
+
 #define READ16_HANDLER(name)	data16_t name(offs_t offset, data16_t mem_mask)
 #define WRITE16_HANDLER(name)	void     name(offs_t offset, data16_t data, data16_t mem_mask)
 
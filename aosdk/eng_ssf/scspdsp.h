@@ -1,6 +1,15 @@
 #ifndef SCSPDSP_H
 #define SCSPDSP_H
 
+//one step of the translated microprogram
+struct _SCSPDSP_STEP
+{
+	UINT32 FLAGS;	//DSP_* bits, see scspdsp.c
+	INT32 Y;	//13 bit COEF operand (YSEL=1), sign extended
+	UINT16 MADRS;
+	UINT8 TRA,TWA,IRA,IWA,EWA,SHIFT,YSEL;
+};
+
 //the DSP Context
 struct _SCSPDSP
 {
@@ -28,6 +37,11 @@ struct _SCSPDSP
 
 	int Stopped;
 	int LastStep;
+
+//translated program, rebuilt by SCSPDSP_Step when Dirty is set
+	struct _SCSPDSP_STEP STEPS[128];
+	int NumSteps;
+	int Dirty;	//set on any MPRO/COEF/MADRS write
 };
 
 void SCSPDSP_Init(struct _SCSPDSP *DSP);
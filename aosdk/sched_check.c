@@ -0,0 +1,525 @@
+/*
+    sched_check.c - checks the DSF/SSF sample schedulers against the
+    lockstep loop
+
+    A small program is built for each CPU that keys on a few looping slots
+    (16-bit, 8-bit or ADPCM, with and without FM) over random sample data,
+    optionally loads a random DSP program, and then spins on a RAM counter
+    while a timer interrupt writes RAM the slots are playing, retunes a slot
+    from the counter and reads the timer back.  Each case is rendered with
+    the scheduler and with dc_hw_set_lockstep(1)/sat_hw_set_lockstep(1),
+    and a hash of all the output has to match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+#include "ao.h"
+#include "eng_protos.h"
+
+extern void dc_hw_set_lockstep(int on);
+extern void sat_hw_set_lockstep(int on);
+
+#define IMAGE_SIZE	(0x40000)
+#define RENDER_SECONDS	(5)
+
+// no libraries to load, the images are complete
+int ao_get_lib(char *filename, uint8 **buffer, uint64 *length)
+{
+	return AO_FAIL;
+}
+
+static uint32 rnd_state;
+
+static int rnd(int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+static uint8 image[IMAGE_SIZE];
+static int pc;
+
+static void put16be(int addr, uint32 v)
+{
+	image[addr] = v >> 8;
+	image[addr+1] = v;
+}
+
+static void put32be(int addr, uint32 v)
+{
+	put16be(addr, v >> 16);
+	put16be(addr+2, v);
+}
+
+static void put32le(int addr, uint32 v)
+{
+	image[addr] = v;
+	image[addr+1] = v >> 8;
+	image[addr+2] = v >> 16;
+	image[addr+3] = v >> 24;
+}
+
+static void fill_random(void)
+{
+	int i;
+
+	for (i = 0x10000; i < 0x38000; i++)
+	{
+		image[i] = rnd(256);
+	}
+}
+
+// 68000: move.w #imm,(addr).l
+static void m68k_movew(uint32 imm, uint32 addr)
+{
+	put16be(pc, 0x33fc);
+	put16be(pc+2, imm);
+	put32be(pc+4, addr);
+	pc += 8;
+}
+
+// 68000: move.w (src).l,(dst).l
+static void m68k_movew_mem(uint32 src, uint32 dst)
+{
+	put16be(pc, 0x33f9);
+	put32be(pc+2, src);
+	put32be(pc+6, dst);
+	pc += 10;
+}
+
+static void m68k_slot(uint32 base, const uint32 *regs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i += 2)
+	{
+		m68k_movew(regs[i+1], base + regs[i]);
+	}
+}
+
+static void build_ssf(int modulate, int dsp)
+{
+	static const uint32 slot0[] = { 0x2,0, 0x4,0, 0x6,0x4000, 0x8,0x1f, 0xa,0x1f, 0xc,0, 0x10,0x0000, 0x16,0xe000 };
+	static const uint32 slot1[] = { 0x2,0, 0x4,0, 0x6,0x8000, 0x8,0x1f, 0xa,0x1f, 0xc,0, 0x10,0x0800, 0x16,0xe01f };
+	static const uint32 slot2[] = { 0x2,0x8000, 0x4,0, 0x6,0x2000, 0x8,0x1f, 0xa,0x1f, 0xc,0, 0xe,0x5041, 0x10,0x0200, 0x16,0xe00f };
+	uint32 S = 0x100000;
+	int i, lvl, loop;
+
+	memset(image, 0, sizeof(image));
+	rnd_state = 1234;
+	put32be(0, 0x7f000);
+	put32be(4, 0x1000);
+	for (lvl = 1; lvl < 8; lvl++)
+	{
+		put32be(0x60 + 4*lvl, 0x2000);
+	}
+	fill_random();
+
+	pc = 0x1000;
+	m68k_movew(0x000f, S+0x400);
+	m68k_movew(0x1000, S+0x0);
+	// slot 0: 16-bit loop at 0x10000
+	m68k_slot(S, slot0, sizeof(slot0)/sizeof(slot0[0]));
+	m68k_movew(0x0821, S+0x0);
+	// slot 1: 8-bit loop at 0x20000, an octave up
+	m68k_slot(S+0x20, slot1, sizeof(slot1)/sizeof(slot1[0]));
+	m68k_movew(0x0832, S+0x20);
+	if (modulate)
+	{
+		// slot 2: modulated by slot 1
+		m68k_slot(S+0x40, slot2, sizeof(slot2)/sizeof(slot2[0]));
+		m68k_movew(0x0822, S+0x40);
+	}
+	if (dsp)
+	{
+		// random MPRO/COEF/MADRS, ring buffer at RBP=3
+		m68k_movew(0x0003, S+0x402);
+		for (i = 0; i < 64; i++)
+		{
+			m68k_movew(rnd(0x10000) & 0xfff0, S+0x700+2*i);
+			m68k_movew(rnd(0x2000), S+0x780+2*i);
+		}
+		for (i = 0; i < 64; i++)
+		{
+			uint32 w = rnd(0x10000);
+
+			if (i % 4 == 1)
+			{
+				w = (w & ~0x0fc0) | (rnd(0x32) << 6);
+			}
+			m68k_movew(w, S+0x800+2*i);
+		}
+		m68k_movew(0x0000, S+0xbf0);
+	}
+	m68k_movew(0x1821, S+0x0);
+	// timer A, its IRQ level and enable
+	m68k_movew(0x0040, S+0x424);
+	m68k_movew(0x0040, S+0x426);
+	m68k_movew(0x0080, S+0x418);
+	m68k_movew(0x0040, S+0x41e);
+	put16be(pc, 0x46fc);	// move #$2000,sr
+	put16be(pc+2, 0x2000);
+	pc += 4;
+	loop = pc;
+	put16be(pc, 0x5279);	// addq.w #1,($3000).l
+	put32be(pc+2, 0x3000);
+	put16be(pc+6, 0x3039);	// move.w ($3000).l,d0
+	put32be(pc+8, 0x3000);
+	put16be(pc+12, 0x0240);	// andi.w #$ff,d0
+	put16be(pc+14, 0x00ff);
+	pc += 16;
+	put16be(pc, 0x6600 | ((loop - (pc + 2)) & 0xff));	// bne.s loop
+	pc += 2;
+	m68k_movew_mem(0x3000, 0x20100);	// every 256th pass, write RAM slot 1 plays
+	put16be(pc, 0x6000 | ((loop - (pc + 2)) & 0xff));	// bra.s loop
+	pc += 2;
+
+	// the timer IRQ handler
+	pc = 0x2000;
+	m68k_movew_mem(0x3000, 0x10100);	// write RAM slot 0 plays
+	m68k_movew_mem(0x3000, S+0x10);	// pitch from the counter
+	m68k_movew_mem(S+0x418, 0x3010);	// read the timer
+	m68k_movew(0x0040, S+0x422);	// SCIRE
+	m68k_movew(0x0080, S+0x418);	// reload timer A
+	put16be(pc, 0x4e73);	// rte
+}
+
+// ARM: b to
+static uint32 arm_b(int at, int to)
+{
+	return 0xea000000 | (((to - (at + 8)) >> 2) & 0xffffff);
+}
+
+#define ARM_POOL	(0x800)
+#define ARM_TABLE	(0x1000)
+
+static int pool_count, table_count;
+
+// ARM: ldr rd,=v
+static uint32 arm_ldr(int rd, uint32 v)
+{
+	int i, at;
+
+	for (i = 0; i < pool_count; i++)
+	{
+		if ((image[ARM_POOL+4*i] | (image[ARM_POOL+4*i+1] << 8) | (image[ARM_POOL+4*i+2] << 16) | ((uint32)image[ARM_POOL+4*i+3] << 24)) == v)
+		{
+			break;
+		}
+	}
+	if (i == pool_count)
+	{
+		put32le(ARM_POOL + 4*pool_count++, v);
+	}
+	at = ARM_POOL + 4*i;
+
+	return 0xe59f0000 | (rd << 12) | (at - (pc + 8));
+}
+
+static void arm_emit(uint32 op)
+{
+	put32le(pc, op);
+	pc += 4;
+}
+
+// the start-up code stores these (address, value) pairs
+static void table_add(uint32 addr, uint32 v)
+{
+	put32le(ARM_TABLE + 8*table_count, addr);
+	put32le(ARM_TABLE + 8*table_count + 4, v);
+	table_count++;
+}
+
+static void build_dsf(int adpcm, int dsp)
+{
+	static const uint32 slot0[] = { 0x04,0x0000, 0x08,0, 0x0c,0x4000, 0x10,0x1f, 0x14,0x1f, 0x18,0, 0x24,0x0f00, 0x28,0 };
+	static const uint32 slot1[] = { 0x04,0x0000, 0x08,0, 0x0c,0x8000, 0x10,0x1f, 0x14,0x1f, 0x18,0x0800, 0x24,0x0f1f, 0x28,0 };
+	uint32 A = 0x800000;
+	int i, loop, beq, done;
+
+	memset(image, 0, sizeof(image));
+	rnd_state = 99;
+	pool_count = table_count = 0;
+	fill_random();
+	put32le(0x0, arm_b(0x0, 0x40));
+	put32le(0x1c, arm_b(0x1c, 0x200));
+
+	table_add(A+0x2800, 0x000f);
+	table_add(A+0x00, 0x8000);
+	// slot 0: 16-bit loop at 0x10000
+	for (i = 0; i < sizeof(slot0)/sizeof(slot0[0]); i += 2)
+	{
+		table_add(A + slot0[i], slot0[i+1]);
+	}
+	table_add(A+0x00, 0x4201);
+	// slot 1: 8-bit or ADPCM loop at 0x20000
+	for (i = 0; i < sizeof(slot1)/sizeof(slot1[0]); i += 2)
+	{
+		table_add(A+0x80 + slot1[i], slot1[i+1]);
+	}
+	table_add(A+0x80, 0x4200 | (adpcm ? 0x100 : 0x080) | 2);
+	if (dsp)
+	{
+		// random MPRO/COEF/MADRS
+		table_add(A+0x2804, 0x0100);
+		for (i = 0; i < 32; i++)
+		{
+			table_add(A+0x3000+4*i, rnd(0x10000) & 0xfff0);
+			table_add(A+0x3200+4*i, rnd(0x2000));
+		}
+		for (i = 0; i < 64; i++)
+		{
+			uint32 w = rnd(0x10000);
+
+			if (i % 4 == 1)
+			{
+				w = (w & ~0x1f80) | (rnd(0x32) << 7);
+			}
+			table_add(A+0x3400+4*i, w);
+		}
+		table_add(A+0x3bfc, 0);
+	}
+	table_add(A+0x00, 0xc201);
+	// timer A and its FIQ
+	table_add(A+0x28a8, 0x40);
+	table_add(A+0x2890, 0x0080);
+	table_add(A+0x289c, 0x40);
+	table_add(0, 0);
+
+	pc = 0x40;
+	arm_emit(arm_ldr(0, ARM_TABLE));
+	loop = pc;
+	arm_emit(0xe4901004);	// ldr r1,[r0],#4
+	arm_emit(0xe3510000);	// cmp r1,#0
+	beq = pc;
+	arm_emit(0);
+	arm_emit(0xe4902004);	// ldr r2,[r0],#4
+	arm_emit(0xe5812000);	// str r2,[r1]
+	arm_emit(arm_b(pc, loop));
+	done = pc;
+	put32le(beq, 0x0a000000 | (((done - (beq + 8)) >> 2) & 0xffffff));
+	arm_emit(0xe321f013);	// msr cpsr_c,#0x13
+	arm_emit(0xe3a04a03);	// mov r4,#0x3000
+	arm_emit(arm_ldr(5, 0x20100));
+	loop = pc;
+	arm_emit(0xe5943000);	// ldr r3,[r4]
+	arm_emit(0xe2833001);	// add r3,r3,#1
+	arm_emit(0xe5843000);	// str r3,[r4]
+	arm_emit(0xe1b06a03);	// movs r6,r3,lsl #20
+	arm_emit(0x05853000);	// streq r3,[r5]: every 4096th pass, write RAM slot 1 plays
+	arm_emit(arm_b(pc, loop));
+
+	// the timer FIQ handler
+	pc = 0x200;
+	arm_emit(0xe3a08a03);	// mov r8,#0x3000
+	arm_emit(0xe5989000);	// ldr r9,[r8]
+	arm_emit(arm_ldr(10, 0x10100));	// write RAM slot 0 plays
+	arm_emit(0xe58a9000);
+	arm_emit(0xe20990ff);	// and r9,r9,#0xff
+	arm_emit(arm_ldr(10, A+0x18));	// pitch from the counter
+	arm_emit(0xe58a9000);
+	arm_emit(arm_ldr(10, A+0x2890));	// read the timer
+	arm_emit(0xe59ab000);
+	arm_emit(0xe588b010);
+	arm_emit(arm_ldr(10, A+0x28a4));	// SCIRE
+	arm_emit(0xe3a0b040);
+	arm_emit(0xe58ab000);
+	arm_emit(arm_ldr(10, A+0x2890));	// reload timer A
+	arm_emit(0xe3a0b080);
+	arm_emit(0xe58ab000);
+	arm_emit(arm_ldr(10, A+0x2d04));	// IRQR
+	arm_emit(0xe3a0b001);
+	arm_emit(0xe58ab000);
+	arm_emit(0xe25ef004);	// subs pc,lr,#4
+}
+
+// wrap the image, loaded at 0, in a PSF with a stored zlib stream
+static uint8 *make_psf(int version, uint32 *length)
+{
+	uint32 size = 4 + IMAGE_SIZE, blocks = (size + 0xfffe) / 0xffff;
+	uint32 comp_len = 2 + blocks*5 + size + 4;
+	uint8 *payload, *psf, *p;
+	uint32 i, adler, crc;
+
+	payload = malloc(size);
+	memset(payload, 0, 4);
+	memcpy(payload + 4, image, IMAGE_SIZE);
+
+	psf = malloc(16 + comp_len);
+	p = psf + 16;
+	*p++ = 0x78;
+	*p++ = 0x01;
+	for (i = 0; i < size; i += 0xffff)
+	{
+		uint32 len = (size - i > 0xffff) ? 0xffff : size - i;
+
+		*p++ = (i + len == size);
+		*p++ = len;
+		*p++ = len >> 8;
+		*p++ = ~len;
+		*p++ = ~len >> 8;
+		memcpy(p, payload + i, len);
+		p += len;
+	}
+	adler = adler32(adler32(0, NULL, 0), payload, size);
+	*p++ = adler >> 24;
+	*p++ = adler >> 16;
+	*p++ = adler >> 8;
+	*p++ = adler;
+	free(payload);
+
+	crc = crc32(crc32(0, NULL, 0), psf + 16, comp_len);
+	memcpy(psf, "PSF", 3);
+	psf[3] = version;
+	for (i = 0; i < 4; i++)
+	{
+		psf[4+i] = 0;
+		psf[8+i] = comp_len >> (8*i);
+		psf[12+i] = crc >> (8*i);
+	}
+
+	*length = 16 + comp_len;
+	return psf;
+}
+
+static uint64 out_hash;
+static long out_nonzero;
+
+static int render(int dsf, int lockstep, uint8 *psf, uint32 length)
+{
+	int16 buf[2048*2];
+	int i, j;
+
+	out_hash = 1469598103934665603ULL;
+	out_nonzero = 0;
+
+	if (dsf)
+	{
+		dc_hw_set_lockstep(lockstep);
+		if (dsf_start(psf, length) != AO_SUCCESS)
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		sat_hw_set_lockstep(lockstep);
+		if (ssf_start(psf, length) != AO_SUCCESS)
+		{
+			return 0;
+		}
+	}
+
+	for (i = 0; i < RENDER_SECONDS * 44100 / 2048; i++)
+	{
+		if (dsf)
+		{
+			dsf_gen(buf, 2048);
+		}
+		else
+		{
+			ssf_gen(buf, 2048);
+		}
+
+		for (j = 0; j < 2048*2; j++)
+		{
+			out_hash = (out_hash ^ (uint16)buf[j]) * 1099511628211ULL;
+			if (buf[j])
+			{
+				out_nonzero++;
+			}
+		}
+	}
+
+	return 1;
+}
+
+// the engines keep their state in globals, so each run is done in a child
+// process, starting from the state a freshly loaded player has
+static int render_fresh(int dsf, int lockstep, uint8 *psf, uint32 length)
+{
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds))
+	{
+		return 0;
+	}
+
+	pid = fork();
+	if (pid == 0)
+	{
+		if (!render(dsf, lockstep, psf, length) ||
+			write(fds[1], &out_hash, sizeof(out_hash)) != sizeof(out_hash) ||
+			write(fds[1], &out_nonzero, sizeof(out_nonzero)) != sizeof(out_nonzero))
+		{
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(fds[1]);
+	status = (pid > 0) &&
+		read(fds[0], &out_hash, sizeof(out_hash)) == sizeof(out_hash) &&
+		read(fds[0], &out_nonzero, sizeof(out_nonzero)) == sizeof(out_nonzero);
+	close(fds[0]);
+	if (pid > 0)
+	{
+		waitpid(pid, NULL, 0);
+	}
+	return status;
+}
+
+int main(int argc, char *argv[])
+{
+	int c, failed = 0;
+
+	for (c = 0; c < 8; c++)
+	{
+		int dsf = c >> 2, variant = (c >> 1) & 1, dsp = c & 1;
+		uint64 ref_hash;
+		long ref_nonzero;
+		uint32 length;
+		uint8 *psf;
+
+		if (dsf)
+		{
+			build_dsf(variant, dsp);
+			psf = make_psf(0x12, &length);
+		}
+		else
+		{
+			build_ssf(variant, dsp);
+			psf = make_psf(0x11, &length);
+		}
+
+		printf("%s %s%s: ", dsf ? "dsf" : "ssf", variant ? (dsf ? "adpcm" : "fm") : "plain", dsp ? " dsp" : "");
+		if (!render_fresh(dsf, 1, psf, length))
+		{
+			printf("lockstep render failed\n");
+			return 1;
+		}
+		ref_hash = out_hash;
+		ref_nonzero = out_nonzero;
+		if (!render_fresh(dsf, 0, psf, length))
+		{
+			printf("scheduled render failed\n");
+			return 1;
+		}
+		free(psf);
+
+		printf("%ld nonzero, %016llx %s\n", out_nonzero, (unsigned long long)out_hash,
+			(out_hash == ref_hash && out_nonzero == ref_nonzero && out_nonzero) ? "ok" : "MISMATCH");
+		if (out_hash != ref_hash || out_nonzero != ref_nonzero || !out_nonzero)
+		{
+			failed = 1;
+		}
+	}
+
+	return failed;
+}
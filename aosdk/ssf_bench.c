@@ -0,0 +1,343 @@
+/*
+    ssf_bench.c - times the SSF engine on synthetic input
+
+    A small program keys on some looping slots and then runs a busy 68000
+    loop over a table in RAM: loads, multiplies, rotates, a subroutine call
+    and stores, the kind of work a sound driver does between SCSP writes.
+    A timer interrupt copies the loop's checksum into slot 0's pitch, so the
+    output depends on what the CPU computed.  With one slot the 68000 takes
+    most of the time, with all 32 the SCSP does.
+
+    Each case prints its best realtime factor over several runs, which is the
+    least affected by other load on the machine, and a hash of the output, so
+    that a build can be compared against another one for speed and for
+    identical output.  Build the library and this with optimization, e.g.
+    make -f Makefile.linux-pulse AOSDK_CFLAGS="-Wall -O2 -Iaosdk -D__LITTLE_ENDIAN__" bench
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+#include "ao.h"
+#include "eng_protos.h"
+
+#define IMAGE_SIZE	(0x80000)
+#define RENDER_SECONDS	(30)
+#define RUNS		(5)
+
+// no libraries to load, the image is complete
+int ao_get_lib(char *filename, uint8 **buffer, uint64 *length)
+{
+	return AO_FAIL;
+}
+
+static uint32 rnd_state;
+
+static int rnd(int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+static uint8 image[IMAGE_SIZE];
+static int pc;
+
+static void put16be(int addr, uint32 v)
+{
+	image[addr] = v >> 8;
+	image[addr+1] = v;
+}
+
+static void put32be(int addr, uint32 v)
+{
+	put16be(addr, v >> 16);
+	put16be(addr+2, v);
+}
+
+static void emit(uint32 op)
+{
+	put16be(pc, op);
+	pc += 2;
+}
+
+// 68000: bxx.s to
+static void emit_branch(uint32 op, int to)
+{
+	emit(op | ((to - (pc + 2)) & 0xff));
+}
+
+// 68000: move.w #imm,(addr).l
+static void m68k_movew(uint32 imm, uint32 addr)
+{
+	emit(0x33fc);
+	emit(imm);
+	put32be(pc, addr);
+	pc += 4;
+}
+
+// 68000: move.w (src).l,(dst).l
+static void m68k_movew_mem(uint32 src, uint32 dst)
+{
+	emit(0x33f9);
+	put32be(pc, src);
+	put32be(pc+4, dst);
+	pc += 8;
+}
+
+static void build_ssf(int slots)
+{
+	uint32 S = 0x100000;
+	int i, lvl, outer, inner, dbra, bsr, sub;
+
+	memset(image, 0, sizeof(image));
+	rnd_state = 4321;
+	put32be(0, 0x7f000);
+	put32be(4, 0x1000);
+	for (lvl = 1; lvl < 8; lvl++)
+	{
+		put32be(0x60 + 4*lvl, 0x2000);
+	}
+	// 8-bit sample data at 0x10000, the CPU's table at 0x40000
+	for (i = 0x10000; i < 0x48000; i++)
+	{
+		image[i] = rnd(256);
+	}
+
+	pc = 0x1000;
+	m68k_movew(0x000f, S+0x400);
+	m68k_movew(0x1000, S+0x0);
+	// slot n: 8-bit loop of 4KB at 0x10000 + n*4KB
+	for (i = 0; i < slots; i++)
+	{
+		uint32 slot = S + 0x20*i, sa = 0x10000 + 0x1000*i;
+
+		m68k_movew(sa & 0xffff, slot+0x2);
+		m68k_movew(0, slot+0x4);
+		m68k_movew(0x1000, slot+0x6);
+		m68k_movew(0x001f, slot+0x8);
+		m68k_movew(0x001f, slot+0xa);
+		m68k_movew(0x0008, slot+0xc);
+		m68k_movew(0x0400 + 0x40*i, slot+0x10);
+		m68k_movew(0xe000 | ((i & 0x1f) << 8), slot+0x16);
+		m68k_movew(0x0830 | (sa >> 16), slot+0x0);
+	}
+	m68k_movew(0x1831, S+0x0);
+	// timer A, its IRQ level and enable
+	m68k_movew(0x0040, S+0x424);
+	m68k_movew(0x0040, S+0x426);
+	m68k_movew(0x0080, S+0x418);
+	m68k_movew(0x0040, S+0x41e);
+	emit(0x46fc);	// move #$2000,sr
+	emit(0x2000);
+
+	outer = pc;
+	emit(0x41f9);	// lea ($40000).l,a0
+	put32be(pc, 0x40000);
+	pc += 4;
+	emit(0x43f9);	// lea ($41000).l,a1
+	put32be(pc, 0x41000);
+	pc += 4;
+	emit(0x323c);	// move.w #$ff,d1
+	emit(0x00ff);
+	inner = pc;
+	emit(0x3418);	// move.w (a0)+,d2
+	emit(0xc4c1);	// mulu.w d1,d2
+	emit(0xd082);	// add.l d2,d0
+	emit(0xe798);	// rol.l #3,d0
+	emit(0xb340);	// eor.w d1,d0
+	bsr = pc;
+	emit(0);
+	emit(0x22c0);	// move.l d0,(a1)+
+	dbra = pc;
+	emit(0x51c9);	// dbra d1,inner
+	emit((inner - (dbra + 2)) & 0xffff);
+	emit(0x23c0);	// move.l d0,($3000).l
+	put32be(pc, 0x3000);
+	pc += 4;
+	emit_branch(0x6000, outer);	// bra.s outer
+
+	// the subroutine
+	sub = pc;
+	emit(0x3602);	// move.w d2,d3
+	emit(0x0243);	// andi.w #$f,d3
+	emit(0x000f);
+	emit(0x0c43);	// cmpi.w #8,d3
+	emit(0x0008);
+	emit(0x6502);	// bcs.s skip
+	emit(0x4443);	// neg.w d3
+	emit(0xd043);	// skip: add.w d3,d0
+	emit(0x4e75);	// rts
+	pc = bsr;
+	emit_branch(0x6100, sub);	// bsr.s sub
+
+	// the timer IRQ handler
+	pc = 0x2000;
+	m68k_movew_mem(0x3002, S+0x10);	// pitch from the checksum
+	m68k_movew(0x0040, S+0x422);	// SCIRE
+	m68k_movew(0x0080, S+0x418);	// reload timer A
+	emit(0x4e73);	// rte
+}
+
+// wrap the image, loaded at 0, in a PSF with a stored zlib stream
+static uint8 *make_psf(int version, uint32 *length)
+{
+	uint32 size = 4 + IMAGE_SIZE, blocks = (size + 0xfffe) / 0xffff;
+	uint32 comp_len = 2 + blocks*5 + size + 4;
+	uint8 *payload, *psf, *p;
+	uint32 i, adler, crc;
+
+	payload = malloc(size);
+	memset(payload, 0, 4);
+	memcpy(payload + 4, image, IMAGE_SIZE);
+
+	psf = malloc(16 + comp_len);
+	p = psf + 16;
+	*p++ = 0x78;
+	*p++ = 0x01;
+	for (i = 0; i < size; i += 0xffff)
+	{
+		uint32 len = (size - i > 0xffff) ? 0xffff : size - i;
+
+		*p++ = (i + len == size);
+		*p++ = len;
+		*p++ = len >> 8;
+		*p++ = ~len;
+		*p++ = ~len >> 8;
+		memcpy(p, payload + i, len);
+		p += len;
+	}
+	adler = adler32(adler32(0, NULL, 0), payload, size);
+	*p++ = adler >> 24;
+	*p++ = adler >> 16;
+	*p++ = adler >> 8;
+	*p++ = adler;
+	free(payload);
+
+	crc = crc32(crc32(0, NULL, 0), psf + 16, comp_len);
+	memcpy(psf, "PSF", 3);
+	psf[3] = version;
+	for (i = 0; i < 4; i++)
+	{
+		psf[4+i] = 0;
+		psf[8+i] = comp_len >> (8*i);
+		psf[12+i] = crc >> (8*i);
+	}
+
+	*length = 16 + comp_len;
+	return psf;
+}
+
+static double cpu_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64 out_hash;
+static double out_time;
+
+static int render(uint8 *psf, uint32 length)
+{
+	int16 buf[2048*2];
+	double start;
+	int i, j;
+
+	out_hash = 1469598103934665603ULL;
+
+	if (ssf_start(psf, length) != AO_SUCCESS)
+	{
+		return 0;
+	}
+
+	start = cpu_time();
+	for (i = 0; i < RENDER_SECONDS * 44100 / 2048; i++)
+	{
+		ssf_gen(buf, 2048);
+
+		for (j = 0; j < 2048*2; j++)
+		{
+			out_hash = (out_hash ^ (uint16)buf[j]) * 1099511628211ULL;
+		}
+	}
+	out_time = cpu_time() - start;
+
+	return 1;
+}
+
+// the engine keeps its state in globals, so each run is done in a child
+// process, starting from the state a freshly loaded player has
+static int render_fresh(uint8 *psf, uint32 length)
+{
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds))
+	{
+		return 0;
+	}
+
+	pid = fork();
+	if (pid == 0)
+	{
+		if (!render(psf, length) ||
+			write(fds[1], &out_hash, sizeof(out_hash)) != sizeof(out_hash) ||
+			write(fds[1], &out_time, sizeof(out_time)) != sizeof(out_time))
+		{
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(fds[1]);
+	status = (pid > 0) &&
+		read(fds[0], &out_hash, sizeof(out_hash)) == sizeof(out_hash) &&
+		read(fds[0], &out_time, sizeof(out_time)) == sizeof(out_time);
+	close(fds[0]);
+	if (pid > 0)
+	{
+		waitpid(pid, NULL, 0);
+	}
+	return status;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int slot_counts[] = { 1, 32 };
+	int c, r;
+
+	for (c = 0; c < sizeof(slot_counts)/sizeof(slot_counts[0]); c++)
+	{
+		double best = 0;
+		uint32 length;
+		uint8 *psf;
+
+		build_ssf(slot_counts[c]);
+		psf = make_psf(0x11, &length);
+
+		for (r = 0; r < RUNS; r++)
+		{
+			if (!render_fresh(psf, length))
+			{
+				printf("ssf %d slot%s: render failed\n", slot_counts[c], slot_counts[c] > 1 ? "s" : "");
+				return 1;
+			}
+			if (r == 0 || out_time < best)
+			{
+				best = out_time;
+			}
+		}
+		free(psf);
+
+		printf("ssf %d slot%s: %.1fx realtime, %016llx\n", slot_counts[c], slot_counts[c] > 1 ? "s" : "",
+			RENDER_SECONDS / best, (unsigned long long)out_hash);
+	}
+
+	return 0;
+}
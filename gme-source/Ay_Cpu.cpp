@@ -9,6 +9,7 @@ Last validated with zexall 2006.11.21 5:26 PM
 #include "Ay_Cpu.h"
 
 #include "blargg_endian.h"
+#include "blargg_dispatch.h"
 #include <string.h>
 
 //#include "z80_cpu_log.h"
@@ -115,6 +116,10 @@ void Ay_Cpu::reset( void* m )
 #define CASE7( a, b, c, d, e, f, g    ) CASE6( a, b, c, d, e, f    ): case 0x##g
 #define CASE8( a, b, c, d, e, f, g, h ) CASE7( a, b, c, d, e, f, g ): case 0x##h
 
+#define OPCODE5( a, b, c, d, e       ) OPCODE( 0x##a ) OPCODE( 0x##b ) OPCODE( 0x##c ) OPCODE( 0x##d ) OPCODE( 0x##e )
+#define OPCODE6( a, b, c, d, e, f    ) OPCODE5( a, b, c, d, e       ) OPCODE( 0x##f )
+#define OPCODE7( a, b, c, d, e, f, g ) OPCODE6( a, b, c, d, e, f    ) OPCODE( 0x##g )
+
 // high four bits are $ED time - 8, low four bits are $DD/$FD time - 8
 static byte const ed_dd_timing [0x100] = {
 //0    1    2    3    4    5    6    7    8    9    A    B    C    D    E    F
@@ -221,7 +226,7 @@ almost_out_of_time:
 				READ_PROG( pc + 1 ), READ_PROG( pc + 2 ) );
 	#endif
 	
-	switch ( opcode )
+	OPCODE_SWITCH( opcode )
 	{
 possibly_out_of_time:
 		if ( s_time < (int) data )
@@ -229,13 +234,29 @@ possibly_out_of_time:
 		s_time -= data;
 		goto out_of_time;
 
+// With computed goto, each opcode fetches and dispatches the next one the same way
+// loop does, rather than all of them sharing the indirect jump at loop
+#if BLARGG_COMPUTED_GOTO && !defined (Z80_CPU_LOG_H)
+	#define NEXT_INSTR() do {\
+		opcode = READ_PROG( pc );\
+		pc++;\
+		data = base_timing [opcode];\
+		if ( (s_time += data) >= 0 )\
+			goto possibly_out_of_time;\
+		data = READ_PROG( pc );\
+		OPCODE_DISPATCH( opcode );\
+	} while ( 0 )
+#else
+	#define NEXT_INSTR() goto loop
+#endif
+
 // Common
 
-	case 0x00: // NOP
-	CASE7( 40, 49, 52, 5B, 64, 6D, 7F ): // LD B,B etc.
-		goto loop;
+	OPCODE( 0x00 ) // NOP
+	OPCODE7( 40, 49, 52, 5B, 64, 6D, 7F ) // LD B,B etc.
+		NEXT_INSTR();
 	
-	case 0x08:{// EX AF,AF'
+	OPCODE( 0x08 ){// EX AF,AF'
 		int temp = r.alt.b.a;
 		r.alt.b.a = rg.a;
 		rg.a = temp;
@@ -243,29 +264,29 @@ possibly_out_of_time:
 		temp = r.alt.b.flags;
 		r.alt.b.flags = flags;
 		flags = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xD3: // OUT (imm),A
+	OPCODE( 0xD3 ) // OUT (imm),A
 		pc++;
 		OUT( data + rg.a * 0x100, rg.a );
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x2E: // LD L,imm
+	OPCODE( 0x2E ) // LD L,imm
 		pc++;
 		rg.l = data;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x3E: // LD A,imm
+	OPCODE( 0x3E ) // LD A,imm
 		pc++;
 		rg.a = data;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x3A:{// LD A,(addr)
+	OPCODE( 0x3A ){// LD A,(addr)
 		fuint16 addr = GET_ADDR();
 		pc += 2;
 		rg.a = READ( addr );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Conditional
@@ -282,141 +303,141 @@ possibly_out_of_time:
 	if ( !(cond) )\
 		goto jr_not_taken;\
 	pc += disp;\
-	goto loop;\
+	NEXT_INSTR();\
 }
 	
-	case 0x20: JR( !ZERO  ) // JR NZ,disp
-	case 0x28: JR(  ZERO  ) // JR Z,disp
-	case 0x30: JR( !CARRY ) // JR NC,disp
-	case 0x38: JR(  CARRY ) // JR C,disp
-	case 0x18: JR(  true  ) // JR disp
+	OPCODE( 0x20 ) JR( !ZERO  ) // JR NZ,disp
+	OPCODE( 0x28 ) JR(  ZERO  ) // JR Z,disp
+	OPCODE( 0x30 ) JR( !CARRY ) // JR NC,disp
+	OPCODE( 0x38 ) JR(  CARRY ) // JR C,disp
+	OPCODE( 0x18 ) JR(  true  ) // JR disp
 
-	case 0x10:{// DJNZ disp
+	OPCODE( 0x10 ){// DJNZ disp
 		int temp = rg.b - 1;
 		rg.b = temp;
 		JR( temp )
 	}
 	
 // JP
-#define JP( cond )  if ( !(cond) ) goto jp_not_taken; pc = GET_ADDR(); goto loop;
-	
-	case 0xC2: JP( !ZERO  ) // JP NZ,addr
-	case 0xCA: JP(  ZERO  ) // JP Z,addr
-	case 0xD2: JP( !CARRY ) // JP NC,addr
-	case 0xDA: JP(  CARRY ) // JP C,addr
-	case 0xE2: JP( !EVEN  ) // JP PO,addr
-	case 0xEA: JP(  EVEN  ) // JP PE,addr
-	case 0xF2: JP( !MINUS ) // JP P,addr
-	case 0xFA: JP(  MINUS ) // JP M,addr
-	
-	case 0xC3: // JP addr
+#define JP( cond )  if ( !(cond) ) goto jp_not_taken; pc = GET_ADDR(); NEXT_INSTR();
+	
+	OPCODE( 0xC2 ) JP( !ZERO  ) // JP NZ,addr
+	OPCODE( 0xCA ) JP(  ZERO  ) // JP Z,addr
+	OPCODE( 0xD2 ) JP( !CARRY ) // JP NC,addr
+	OPCODE( 0xDA ) JP(  CARRY ) // JP C,addr
+	OPCODE( 0xE2 ) JP( !EVEN  ) // JP PO,addr
+	OPCODE( 0xEA ) JP(  EVEN  ) // JP PE,addr
+	OPCODE( 0xF2 ) JP( !MINUS ) // JP P,addr
+	OPCODE( 0xFA ) JP(  MINUS ) // JP M,addr
+	
+	OPCODE( 0xC3 ) // JP addr
 		pc = GET_ADDR();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xE9: // JP HL
+	OPCODE( 0xE9 ) // JP HL
 		pc = rp.hl;
-		goto loop;
+		NEXT_INSTR();
 
 // RET
-#define RET( cond ) if ( cond ) goto ret_taken; s_time -= 6; goto loop;
-	
-	case 0xC0: RET( !ZERO  ) // RET NZ
-	case 0xC8: RET(  ZERO  ) // RET Z
-	case 0xD0: RET( !CARRY ) // RET NC
-	case 0xD8: RET(  CARRY ) // RET C
-	case 0xE0: RET( !EVEN  ) // RET PO
-	case 0xE8: RET(  EVEN  ) // RET PE
-	case 0xF0: RET( !MINUS ) // RET P
-	case 0xF8: RET(  MINUS ) // RET M
-	
-	case 0xC9: // RET
+#define RET( cond ) if ( cond ) goto ret_taken; s_time -= 6; NEXT_INSTR();
+	
+	OPCODE( 0xC0 ) RET( !ZERO  ) // RET NZ
+	OPCODE( 0xC8 ) RET(  ZERO  ) // RET Z
+	OPCODE( 0xD0 ) RET( !CARRY ) // RET NC
+	OPCODE( 0xD8 ) RET(  CARRY ) // RET C
+	OPCODE( 0xE0 ) RET( !EVEN  ) // RET PO
+	OPCODE( 0xE8 ) RET(  EVEN  ) // RET PE
+	OPCODE( 0xF0 ) RET( !MINUS ) // RET P
+	OPCODE( 0xF8 ) RET(  MINUS ) // RET M
+	
+	OPCODE( 0xC9 ) // RET
 	ret_taken:
 		pc = READ_WORD( sp );
 		sp = uint16_t (sp + 2);
-		goto loop;
+		NEXT_INSTR();
 	
 // CALL
 #define CALL( cond ) if ( cond ) goto call_taken; goto call_not_taken;
 
-	case 0xC4: CALL( !ZERO  ) // CALL NZ,addr
-	case 0xCC: CALL(  ZERO  ) // CALL Z,addr
-	case 0xD4: CALL( !CARRY ) // CALL NC,addr
-	case 0xDC: CALL(  CARRY ) // CALL C,addr
-	case 0xE4: CALL( !EVEN  ) // CALL PO,addr
-	case 0xEC: CALL(  EVEN  ) // CALL PE,addr
-	case 0xF4: CALL( !MINUS ) // CALL P,addr
-	case 0xFC: CALL(  MINUS ) // CALL M,addr
-	
-	case 0xCD:{// CALL addr
+	OPCODE( 0xC4 ) CALL( !ZERO  ) // CALL NZ,addr
+	OPCODE( 0xCC ) CALL(  ZERO  ) // CALL Z,addr
+	OPCODE( 0xD4 ) CALL( !CARRY ) // CALL NC,addr
+	OPCODE( 0xDC ) CALL(  CARRY ) // CALL C,addr
+	OPCODE( 0xE4 ) CALL( !EVEN  ) // CALL PO,addr
+	OPCODE( 0xEC ) CALL(  EVEN  ) // CALL PE,addr
+	OPCODE( 0xF4 ) CALL( !MINUS ) // CALL P,addr
+	OPCODE( 0xFC ) CALL(  MINUS ) // CALL M,addr
+	
+	OPCODE( 0xCD ){// CALL addr
 	call_taken:
 		fuint16 addr = pc + 2;
 		pc = GET_ADDR();
 		sp = uint16_t (sp - 2);
 		WRITE_WORD( sp, addr );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xFF: // RST
+	OPCODE( 0xFF ) // RST
 		if ( (pc - 1) > 0xFFFF )
 		{
 			pc = uint16_t (pc - 1);
 			s_time -= 11;
-			goto loop;
+			NEXT_INSTR();
 		}
-	CASE7( C7, CF, D7, DF, E7, EF, F7 ):
+	OPCODE7( C7, CF, D7, DF, E7, EF, F7 )
 		data = pc;
 		pc = opcode & 0x38;
 		goto push_data;
 
 // PUSH/POP
-	case 0xF5: // PUSH AF
+	OPCODE( 0xF5 ) // PUSH AF
 		data = rg.a * 0x100u + flags;
 		goto push_data;
 	
-	case 0xC5: // PUSH BC
-	case 0xD5: // PUSH DE
-	case 0xE5: // PUSH HL
+	OPCODE( 0xC5 ) // PUSH BC
+	OPCODE( 0xD5 ) // PUSH DE
+	OPCODE( 0xE5 ) // PUSH HL
 		data = R16( opcode, 4, 0xC5 );
 	push_data:
 		sp = uint16_t (sp - 2);
 		WRITE_WORD( sp, data );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xF1: // POP AF
+	OPCODE( 0xF1 ) // POP AF
 		flags = READ( sp );
 		rg.a = READ( sp + 1 );
 		sp = uint16_t (sp + 2);
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xC1: // POP BC
-	case 0xD1: // POP DE
-	case 0xE1: // POP HL
+	OPCODE( 0xC1 ) // POP BC
+	OPCODE( 0xD1 ) // POP DE
+	OPCODE( 0xE1 ) // POP HL
 		R16( opcode, 4, 0xC1 ) = READ_WORD( sp );
 		sp = uint16_t (sp + 2);
-		goto loop;
+		NEXT_INSTR();
 	
 // ADC/ADD/SBC/SUB
-	case 0x96: // SUB (HL)
-	case 0x86: // ADD (HL)
+	OPCODE( 0x96 ) // SUB (HL)
+	OPCODE( 0x86 ) // ADD (HL)
 		flags &= ~C01;
-	case 0x9E: // SBC (HL)
-	case 0x8E: // ADC (HL)
+	OPCODE( 0x9E ) // SBC (HL)
+	OPCODE( 0x8E ) // ADC (HL)
 		data = READ( rp.hl );
 		goto adc_data;
 	
-	case 0xD6: // SUB A,imm
-	case 0xC6: // ADD imm
+	OPCODE( 0xD6 ) // SUB A,imm
+	OPCODE( 0xC6 ) // ADD imm
 		flags &= ~C01;
-	case 0xDE: // SBC A,imm
-	case 0xCE: // ADC imm
+	OPCODE( 0xDE ) // SBC A,imm
+	OPCODE( 0xCE ) // ADC imm
 		pc++;
 		goto adc_data;
 	
-	CASE7( 90, 91, 92, 93, 94, 95, 97 ): // SUB r
-	CASE7( 80, 81, 82, 83, 84, 85, 87 ): // ADD r
+	OPCODE7( 90, 91, 92, 93, 94, 95, 97 ) // SUB r
+	OPCODE7( 80, 81, 82, 83, 84, 85, 87 ) // ADD r
 		flags &= ~C01;
-	CASE7( 98, 99, 9A, 9B, 9C, 9D, 9F ): // SBC r
-	CASE7( 88, 89, 8A, 8B, 8C, 8D, 8F ): // ADC r
+	OPCODE7( 98, 99, 9A, 9B, 9C, 9D, 9F ) // SBC r
+	OPCODE7( 88, 89, 8A, 8B, 8C, 8D, 8F ) // ADC r
 		data = R8( opcode & 7, 0 );
 	adc_data: {
 		int result = data + (flags & C01);
@@ -430,19 +451,19 @@ possibly_out_of_time:
 				((data - -0x80) >> 6 & V04) |
 				SZ28C( result & 0x1FF );
 		rg.a = result;
-		goto loop;
+		NEXT_INSTR();
 	}
 
 // CP
-	case 0xBE: // CP (HL)
+	OPCODE( 0xBE ) // CP (HL)
 		data = READ( rp.hl );
 		goto cp_data;
 	
-	case 0xFE: // CP imm
+	OPCODE( 0xFE ) // CP imm
 		pc++;
 		goto cp_data;
 	
-	CASE7( B8, B9, BA, BB, BC, BD, BF ): // CP r
+	OPCODE7( B8, B9, BA, BB, BC, BD, BF ) // CP r
 		data = R8( opcode, 0xB8 );
 	cp_data: {
 		int result = rg.a - data;
@@ -451,20 +472,20 @@ possibly_out_of_time:
 		flags |=(((result ^ rg.a) & data) >> 5 & V04) |
 				(((data & H10) ^ result) & (S80 | H10));
 		if ( (uint8_t) result )
-			goto loop;
+			NEXT_INSTR();
 		flags |= Z40;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // ADD HL,rp
 	
-	case 0x39: // ADD HL,SP
+	OPCODE( 0x39 ) // ADD HL,SP
 		data = sp;
 		goto add_hl_data;
 	
-	case 0x09: // ADD HL,BC
-	case 0x19: // ADD HL,DE
-	case 0x29: // ADD HL,HL
+	OPCODE( 0x09 ) // ADD HL,BC
+	OPCODE( 0x19 ) // ADD HL,DE
+	OPCODE( 0x29 ) // ADD HL,HL
 		data = R16( opcode, 4, 0x09 );
 	add_hl_data: {
 		blargg_ulong sum = rp.hl + data;
@@ -474,10 +495,10 @@ possibly_out_of_time:
 				(sum >> 16) |
 				(sum >> 8 & (F20 | F08)) |
 				((data ^ sum) >> 8 & H10);
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x27:{// DAA
+	OPCODE( 0x27 ){// DAA
 		int a = rg.a;
 		if ( a > 0x99 )
 			flags |= C01;
@@ -495,7 +516,7 @@ possibly_out_of_time:
 				((rg.a ^ a) & H10) |
 				SZ28P( (uint8_t) a );
 		rg.a = a;
-		goto loop;
+		NEXT_INSTR();
 	}
 	/*
 	case 0x27:{// DAA
@@ -517,263 +538,263 @@ possibly_out_of_time:
 	*/
 	
 // INC/DEC
-	case 0x34: // INC (HL)
+	OPCODE( 0x34 ) // INC (HL)
 		data = READ( rp.hl ) + 1;
 		WRITE( rp.hl, data );
 		goto inc_set_flags;
 	
-	CASE7( 04, 0C, 14, 1C, 24, 2C, 3C ): // INC r
+	OPCODE7( 04, 0C, 14, 1C, 24, 2C, 3C ) // INC r
 		data = ++R8( opcode >> 3, 0 );
 	inc_set_flags:
 		flags = (flags & C01) |
 				(((data & 0x0F) - 1) & H10) |
 				SZ28( (uint8_t) data );
 		if ( data != 0x80 )
-			goto loop;
+			NEXT_INSTR();
 		flags |= V04;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x35: // DEC (HL)
+	OPCODE( 0x35 ) // DEC (HL)
 		data = READ( rp.hl ) - 1;
 		WRITE( rp.hl, data );
 		goto dec_set_flags;
 	
-	CASE7( 05, 0D, 15, 1D, 25, 2D, 3D ): // DEC r
+	OPCODE7( 05, 0D, 15, 1D, 25, 2D, 3D ) // DEC r
 		data = --R8( opcode >> 3, 0 );
 	dec_set_flags:
 		flags = (flags & C01) | N02 |
 				(((data & 0x0F) + 1) & H10) |
 				SZ28( (uint8_t) data );
 		if ( data != 0x7F )
-			goto loop;
+			NEXT_INSTR();
 		flags |= V04;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x03: // INC BC
-	case 0x13: // INC DE
-	case 0x23: // INC HL
+	OPCODE( 0x03 ) // INC BC
+	OPCODE( 0x13 ) // INC DE
+	OPCODE( 0x23 ) // INC HL
 		R16( opcode, 4, 0x03 )++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x33: // INC SP
+	OPCODE( 0x33 ) // INC SP
 		sp = uint16_t (sp + 1);
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x0B: // DEC BC
-	case 0x1B: // DEC DE
-	case 0x2B: // DEC HL
+	OPCODE( 0x0B ) // DEC BC
+	OPCODE( 0x1B ) // DEC DE
+	OPCODE( 0x2B ) // DEC HL
 		R16( opcode, 4, 0x0B )--;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x3B: // DEC SP
+	OPCODE( 0x3B ) // DEC SP
 		sp = uint16_t (sp - 1);
-		goto loop;
+		NEXT_INSTR();
 	
 // AND
-	case 0xA6: // AND (HL)
+	OPCODE( 0xA6 ) // AND (HL)
 		data = READ( rp.hl );
 		goto and_data;
 	
-	case 0xE6: // AND imm
+	OPCODE( 0xE6 ) // AND imm
 		pc++;
 		goto and_data;
 	
-	CASE7( A0, A1, A2, A3, A4, A5, A7 ): // AND r
+	OPCODE7( A0, A1, A2, A3, A4, A5, A7 ) // AND r
 		data = R8( opcode, 0xA0 );
 	and_data:
 		rg.a &= data;
 		flags = SZ28P( rg.a ) | H10;
-		goto loop;
+		NEXT_INSTR();
 	
 // OR
-	case 0xB6: // OR (HL)
+	OPCODE( 0xB6 ) // OR (HL)
 		data = READ( rp.hl );
 		goto or_data;
 	
-	case 0xF6: // OR imm
+	OPCODE( 0xF6 ) // OR imm
 		pc++;
 		goto or_data;
 	
-	CASE7( B0, B1, B2, B3, B4, B5, B7 ): // OR r
+	OPCODE7( B0, B1, B2, B3, B4, B5, B7 ) // OR r
 		data = R8( opcode, 0xB0 );
 	or_data:
 		rg.a |= data;
 		flags = SZ28P( rg.a );
-		goto loop;
+		NEXT_INSTR();
 
 // XOR
-	case 0xAE: // XOR (HL)
+	OPCODE( 0xAE ) // XOR (HL)
 		data = READ( rp.hl );
 		goto xor_data;
 	
-	case 0xEE: // XOR imm
+	OPCODE( 0xEE ) // XOR imm
 		pc++;
 		goto xor_data;
 	
-	CASE7( A8, A9, AA, AB, AC, AD, AF ): // XOR r
+	OPCODE7( A8, A9, AA, AB, AC, AD, AF ) // XOR r
 		data = R8( opcode, 0xA8 );
 	xor_data:
 		rg.a ^= data;
 		flags = SZ28P( rg.a );
-		goto loop;
+		NEXT_INSTR();
 
 // LD
-	CASE7( 70, 71, 72, 73, 74, 75, 77 ): // LD (HL),r
+	OPCODE7( 70, 71, 72, 73, 74, 75, 77 ) // LD (HL),r
 		WRITE( rp.hl, R8( opcode, 0x70 ) );
-		goto loop;
-	
-	CASE6( 41, 42, 43, 44, 45, 47 ): // LD B,r
-	CASE6( 48, 4A, 4B, 4C, 4D, 4F ): // LD C,r
-	CASE6( 50, 51, 53, 54, 55, 57 ): // LD D,r
-	CASE6( 58, 59, 5A, 5C, 5D, 5F ): // LD E,r
-	CASE6( 60, 61, 62, 63, 65, 67 ): // LD H,r
-	CASE6( 68, 69, 6A, 6B, 6C, 6F ): // LD L,r
-	CASE6( 78, 79, 7A, 7B, 7C, 7D ): // LD A,r
+		NEXT_INSTR();
+	
+	OPCODE6( 41, 42, 43, 44, 45, 47 ) // LD B,r
+	OPCODE6( 48, 4A, 4B, 4C, 4D, 4F ) // LD C,r
+	OPCODE6( 50, 51, 53, 54, 55, 57 ) // LD D,r
+	OPCODE6( 58, 59, 5A, 5C, 5D, 5F ) // LD E,r
+	OPCODE6( 60, 61, 62, 63, 65, 67 ) // LD H,r
+	OPCODE6( 68, 69, 6A, 6B, 6C, 6F ) // LD L,r
+	OPCODE6( 78, 79, 7A, 7B, 7C, 7D ) // LD A,r
 		R8( opcode >> 3 & 7, 0 ) = R8( opcode & 7, 0 );
-		goto loop;
+		NEXT_INSTR();
 	
-	CASE5( 06, 0E, 16, 1E, 26 ): // LD r,imm
+	OPCODE5( 06, 0E, 16, 1E, 26 ) // LD r,imm
 		R8( opcode >> 3, 0 ) = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x36: // LD (HL),imm
+	OPCODE( 0x36 ) // LD (HL),imm
 		pc++;
 		WRITE( rp.hl, data );
-		goto loop;
+		NEXT_INSTR();
 	
-	CASE7( 46, 4E, 56, 5E, 66, 6E, 7E ): // LD r,(HL)
+	OPCODE7( 46, 4E, 56, 5E, 66, 6E, 7E ) // LD r,(HL)
 		R8( opcode >> 3, 8 ) = READ( rp.hl );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x01: // LD rp,imm
-	case 0x11:
-	case 0x21:
+	OPCODE( 0x01 ) // LD rp,imm
+	OPCODE( 0x11 )
+	OPCODE( 0x21 )
 		R16( opcode, 4, 0x01 ) = GET_ADDR();
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x31: // LD sp,imm
+	OPCODE( 0x31 ) // LD sp,imm
 		sp = GET_ADDR();
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x2A:{// LD HL,(addr)
+	OPCODE( 0x2A ){// LD HL,(addr)
 		fuint16 addr = GET_ADDR();
 		pc += 2;
 		rp.hl = READ_WORD( addr );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x32:{// LD (addr),A
+	OPCODE( 0x32 ){// LD (addr),A
 		fuint16 addr = GET_ADDR();
 		pc += 2;
 		WRITE( addr, rg.a );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x22:{// LD (addr),HL
+	OPCODE( 0x22 ){// LD (addr),HL
 		fuint16 addr = GET_ADDR();
 		pc += 2;
 		WRITE_WORD( addr, rp.hl );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x02: // LD (BC),A
-	case 0x12: // LD (DE),A
+	OPCODE( 0x02 ) // LD (BC),A
+	OPCODE( 0x12 ) // LD (DE),A
 		WRITE( R16( opcode, 4, 0x02 ), rg.a );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x0A: // LD A,(BC)
-	case 0x1A: // LD A,(DE)
+	OPCODE( 0x0A ) // LD A,(BC)
+	OPCODE( 0x1A ) // LD A,(DE)
 		rg.a = READ( R16( opcode, 4, 0x0A ) );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xF9: // LD SP,HL
+	OPCODE( 0xF9 ) // LD SP,HL
 		sp = rp.hl;
-		goto loop;
+		NEXT_INSTR();
 	
 // Rotate
 	
-	case 0x07:{// RLCA
+	OPCODE( 0x07 ){// RLCA
 		fuint16 temp = rg.a;
 		temp = (temp << 1) | (temp >> 7);
 		flags = (flags & (S80 | Z40 | P04)) |
 				(temp & (F20 | F08 | C01));
 		rg.a = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x0F:{// RRCA
+	OPCODE( 0x0F ){// RRCA
 		fuint16 temp = rg.a;
 		flags = (flags & (S80 | Z40 | P04)) |
 				(temp & C01);
 		temp = (temp << 7) | (temp >> 1);
 		flags |= temp & (F20 | F08);
 		rg.a = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x17:{// RLA
+	OPCODE( 0x17 ){// RLA
 		blargg_ulong temp = (rg.a << 1) | (flags & C01);
 		flags = (flags & (S80 | Z40 | P04)) |
 				(temp & (F20 | F08)) |
 				(temp >> 8);
 		rg.a = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x1F:{// RRA
+	OPCODE( 0x1F ){// RRA
 		fuint16 temp = (flags << 7) | (rg.a >> 1);
 		flags = (flags & (S80 | Z40 | P04)) |
 				(temp & (F20 | F08)) |
 				(rg.a & C01);
 		rg.a = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Misc
-	case 0x2F:{// CPL
+	OPCODE( 0x2F ){// CPL
 		fuint16 temp = ~rg.a;
 		flags = (flags & (S80 | Z40 | P04 | C01)) |
 				(temp & (F20 | F08)) |
 				(H10 | N02);
 		rg.a = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x3F:{// CCF
+	OPCODE( 0x3F ){// CCF
 		flags = ((flags & (S80 | Z40 | P04 | C01)) ^ C01) |
 				(flags << 4 & H10) |
 				(rg.a & (F20 | F08));
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x37: // SCF
+	OPCODE( 0x37 ) // SCF
 		flags = (flags & (S80 | Z40 | P04)) | C01 |
 				(rg.a & (F20 | F08));
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xDB: // IN A,(imm)
+	OPCODE( 0xDB ) // IN A,(imm)
 		pc++;
 		rg.a = IN( data + rg.a * 0x100 );
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xE3:{// EX (SP),HL
+	OPCODE( 0xE3 ){// EX (SP),HL
 		fuint16 temp = READ_WORD( sp );
 		WRITE_WORD( sp, rp.hl );
 		rp.hl = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xEB:{// EX DE,HL
+	OPCODE( 0xEB ){// EX DE,HL
 		fuint16 temp = rp.hl;
 		rp.hl = rp.de;
 		rp.de = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xD9:{// EXX DE,HL
+	OPCODE( 0xD9 ){// EXX DE,HL
 		fuint16 temp = r.alt.w.bc;
 		r.alt.w.bc = rp.bc;
 		rp.bc = temp;
@@ -785,26 +806,26 @@ possibly_out_of_time:
 		temp = r.alt.w.hl;
 		r.alt.w.hl = rp.hl;
 		rp.hl = temp;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xF3: // DI
+	OPCODE( 0xF3 ) // DI
 		r.iff1 = 0;
 		r.iff2 = 0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xFB: // EI
+	OPCODE( 0xFB ) // EI
 		r.iff1 = 1;
 		r.iff2 = 1;
 		// TODO: delayed effect
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x76: // HALT
+	OPCODE( 0x76 ) // HALT
 		goto halt;
 	
 //////////////////////////////////////// CB prefix
 	{
-	case 0xCB:
+	OPCODE( 0xCB )
 		unsigned data2;
 		data2 = INSTR( 1 );
 		pc++;
@@ -818,7 +839,7 @@ possibly_out_of_time:
 		result = uint8_t (result << 1) | (result >> 7);\
 		flags = SZ28P( result ) | (result & C01);\
 		write;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 		
 		case 0x06: // RLC (HL)
@@ -836,7 +857,7 @@ possibly_out_of_time:
 		fuint16 result = (read << 1) | (flags & C01);\
 		flags = SZ28PC( result );\
 		write;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 		
 		case 0x16: // RL (HL)
@@ -854,7 +875,7 @@ possibly_out_of_time:
 		fuint16 result = (read << 1) | add;\
 		flags = SZ28PC( result );\
 		write;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 		
 		case 0x26: // SLA (HL)
@@ -887,7 +908,7 @@ possibly_out_of_time:
 		result = uint8_t (result << 7) | (result >> 1);\
 		flags |= SZ28P( result );\
 		write;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 		
 		case 0x0E: // RRC (HL)
@@ -907,7 +928,7 @@ possibly_out_of_time:
 		result = uint8_t (flags << 7) | (result >> 1);\
 		flags = SZ28P( result ) | temp;\
 		write;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 		
 		case 0x1E: // RR (HL)
@@ -927,7 +948,7 @@ possibly_out_of_time:
 		result = (result & 0x80) | (result >> 1);\
 		flags |= SZ28P( result );\
 		write;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 		
 		case 0x2E: // SRA (HL)
@@ -947,7 +968,7 @@ possibly_out_of_time:
 		result >>= 1;\
 		flags |= SZ28P( result );\
 		write;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 		
 		case 0x3E: // SRL (HL)
@@ -983,7 +1004,7 @@ possibly_out_of_time:
 			int masked = temp & 1 << (data >> 3 & 7);
 			flags |=(masked & S80) | H10 |
 					((masked - 1) >> 8 & (Z40 | P04));
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 	// SET/RES
@@ -996,7 +1017,7 @@ possibly_out_of_time:
 			if ( !(data & 0x40) )
 				temp ^= bit; // RES
 			WRITE( rp.hl, temp );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		CASE7( C0, C1, C2, C3, C4, C5, C7 ): // SET 0,r
@@ -1008,7 +1029,7 @@ possibly_out_of_time:
 		CASE7( F0, F1, F2, F3, F4, F5, F7 ): // SET 6,r
 		CASE7( F8, F9, FA, FB, FC, FD, FF ): // SET 7,r
 			R8( data & 7, 0 ) |= 1 << (data >> 3 & 7);
-			goto loop;
+			NEXT_INSTR();
 		
 		CASE7( 80, 81, 82, 83, 84, 85, 87 ): // RES 0,r
 		CASE7( 88, 89, 8A, 8B, 8C, 8D, 8F ): // RES 1,r
@@ -1019,14 +1040,14 @@ possibly_out_of_time:
 		CASE7( B0, B1, B2, B3, B4, B5, B7 ): // RES 6,r
 		CASE7( B8, B9, BA, BB, BC, BD, BF ): // RES 7,r
 			R8( data & 7, 0 ) &= ~(1 << (data >> 3 & 7));
-			goto loop;
+			NEXT_INSTR();
 		}
 		assert( false );
 	}
 
 //////////////////////////////////////// ED prefix
 	{
-	case 0xED:
+	OPCODE( 0xED )
 		pc++;
 		s_time += ed_dd_timing [data] >> 4;
 		switch ( data )
@@ -1057,23 +1078,23 @@ possibly_out_of_time:
 					((temp - -0x8000) >> 14 & V04);
 			rp.hl = sum;
 			if ( (uint16_t) sum )
-				goto loop;
+				NEXT_INSTR();
 			flags |= Z40;
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		CASE8( 40, 48, 50, 58, 60, 68, 70, 78 ):{// IN r,(C)
 			int temp = IN( rp.bc );
 			R8( data >> 3, 8 ) = temp;
 			flags = (flags & C01) | SZ28P( temp );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		case 0x71: // OUT (C),0
 			rg.flags = 0;
 		CASE7( 41, 49, 51, 59, 61, 69, 79 ): // OUT (C),r
 			OUT( rp.bc, R8( data >> 3, 8 ) );
-			goto loop;
+			NEXT_INSTR();
 		
 		{
 			unsigned temp;
@@ -1086,7 +1107,7 @@ possibly_out_of_time:
 			fuint16 addr = GET_ADDR();
 			pc += 2;
 			WRITE_WORD( addr, temp );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		case 0x4B: // LD BC,(ADDR)
@@ -1094,14 +1115,14 @@ possibly_out_of_time:
 			fuint16 addr = GET_ADDR();
 			pc += 2;
 			R16( data, 4, 0x4B ) = READ_WORD( addr );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		case 0x7B:{// LD SP,(ADDR)
 			fuint16 addr = GET_ADDR();
 			pc += 2;
 			sp = READ_WORD( addr );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		case 0x67:{// RRD
@@ -1110,7 +1131,7 @@ possibly_out_of_time:
 			temp = (rg.a & 0xF0) | (temp & 0x0F);
 			flags = (flags & C01) | SZ28P( temp );
 			rg.a = temp;
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		case 0x6F:{// RLD
@@ -1119,7 +1140,7 @@ possibly_out_of_time:
 			temp = (rg.a & 0xF0) | (temp >> 4);
 			flags = (flags & C01) | SZ28P( temp );
 			rg.a = temp;
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		CASE8( 44, 4C, 54, 5C, 64, 6C, 74, 7C ): // NEG
@@ -1151,15 +1172,15 @@ possibly_out_of_time:
 			flags |= result & F08;
 			flags |= result << 4 & F20;
 			if ( !--rp.bc )
-				goto loop;
+				NEXT_INSTR();
 			
 			flags |= V04;
 			if ( flags & Z40 || data < 0xB0 )
-				goto loop;
+				NEXT_INSTR();
 			
 			pc -= 2;
 			s_time += 5;
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		{
@@ -1183,15 +1204,15 @@ possibly_out_of_time:
 			flags = (flags & (S80 | Z40 | C01)) |
 					(temp & F08) | (temp << 4 & F20);
 			if ( !--rp.bc )
-				goto loop;
+				NEXT_INSTR();
 			
 			flags |= V04;
 			if ( data < 0xB0 )
-				goto loop;
+				NEXT_INSTR();
 			
 			pc -= 2;
 			s_time += 5;
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		{
@@ -1216,7 +1237,7 @@ possibly_out_of_time:
 			}
 			
 			OUT( rp.bc, temp );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		{
@@ -1243,18 +1264,18 @@ possibly_out_of_time:
 			}
 			
 			WRITE( addr, temp );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		case 0x47: // LD I,A
 			r.i = rg.a;
-			goto loop;
+			NEXT_INSTR();
 		
 		case 0x4F: // LD R,A
 			SET_R( rg.a );
 			debug_printf( "LD R,A not supported\n" );
 			warning = true;
-			goto loop;
+			NEXT_INSTR();
 		
 		case 0x57: // LD A,I
 			rg.a = r.i;
@@ -1266,7 +1287,7 @@ possibly_out_of_time:
 			warning = true;
 		ld_ai_common:
 			flags = (flags & C01) | SZ28( rg.a ) | (r.iff2 << 2 & V04);
-			goto loop;
+			NEXT_INSTR();
 		
 		CASE8( 45, 4D, 55, 5D, 65, 6D, 75, 7D ): // RETI/RETN
 			r.iff1 = r.iff2;
@@ -1274,20 +1295,20 @@ possibly_out_of_time:
 		
 		case 0x46: case 0x4E: case 0x66: case 0x6E: // IM 0
 			r.im = 0;
-			goto loop;
+			NEXT_INSTR();
 		
 		case 0x56: case 0x76: // IM 1
 			r.im = 1;
-			goto loop;
+			NEXT_INSTR();
 		
 		case 0x5E: case 0x7E: // IM 2
 			r.im = 2;
-			goto loop;
+			NEXT_INSTR();
 		
 		default:
 			debug_printf( "Opcode $ED $%02X not supported\n", data );
 			warning = true;
-			goto loop;
+			NEXT_INSTR();
 		}
 		assert( false );
 	}
@@ -1295,10 +1316,10 @@ possibly_out_of_time:
 //////////////////////////////////////// DD/FD prefix
 	{
 	fuint16 ixy;
-	case 0xDD:
+	OPCODE( 0xDD )
 		ixy = ix;
 		goto ix_prefix;
-	case 0xFD:
+	OPCODE( 0xFD )
 		ixy = iy;
 	ix_prefix:
 		pc++;
@@ -1430,24 +1451,24 @@ possibly_out_of_time:
 				pc++, data = READ_PROG( pc );
 			pc++;
 			WRITE( IXY_DISP( ixy, (int8_t) data2 ), data );
-			goto loop;
+			NEXT_INSTR();
 
 		CASE5( 44, 4C, 54, 5C, 7C ): // LD r,HXY
 			R8( data >> 3, 8 ) = ixy >> 8;
-			goto loop;
+			NEXT_INSTR();
 		
 		case 0x64: // LD HXY,HXY
 		case 0x6D: // LD LXY,LXY
-			goto loop;
+			NEXT_INSTR();
 		
 		CASE5( 45, 4D, 55, 5D, 7D ): // LD r,LXY
 			R8( data >> 3, 8 ) = ixy;
-			goto loop;
+			NEXT_INSTR();
 		
 		CASE7( 46, 4E, 56, 5E, 66, 6E, 7E ): // LD r,(IXY+disp)
 			pc++;
 			R8( data >> 3, 8 ) = READ( IXY_DISP( ixy, (int8_t) data2 ) );
-			goto loop;
+			NEXT_INSTR();
 		
 		case 0x26: // LD HXY,imm
 			pc++;
@@ -1479,20 +1500,20 @@ possibly_out_of_time:
 			if ( opcode == 0xDD )
 			{
 				ix = ixy;
-				goto loop;
+				NEXT_INSTR();
 			}
 			iy = ixy;
-			goto loop;
+			NEXT_INSTR();
 
 		case 0xF9: // LD SP,IXY
 			sp = ixy;
-			goto loop;
+			NEXT_INSTR();
 	
 		case 0x22:{// LD (ADDR),IXY
 			fuint16 addr = GET_ADDR();
 			pc += 2;
 			WRITE_WORD( addr, ixy );
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		case 0x21: // LD IXY,imm
@@ -1530,7 +1551,7 @@ possibly_out_of_time:
 				flags = (flags & C01) | H10 |
 						(masked & S80) |
 						((masked - 1) >> 8 & (Z40 | P04));
-				goto loop;
+				NEXT_INSTR();
 			}
 			
 			CASE8( 86, 8E, 96, 9E, A6, AE, B6, BE ): // RES b,(IXY+disp)
@@ -1541,13 +1562,13 @@ possibly_out_of_time:
 				if ( !(data2 & 0x40) )
 					temp ^= bit; // RES
 				WRITE( data, temp );
-				goto loop;
+				NEXT_INSTR();
 			}
 			
 			default:
 				debug_printf( "Opcode $%02X $CB $%02X not supported\n", opcode, data2 );
 				warning = true;
-				goto loop;
+				NEXT_INSTR();
 			}
 			assert( false );
 		}
@@ -1624,7 +1645,7 @@ possibly_out_of_time:
 		
 		case 0xE9: // JP (IXY)
 			pc = ixy;
-			goto loop;
+			NEXT_INSTR();
 		
 		case 0xE3:{// EX (SP),IXY
 			fuint16 temp = READ_WORD( sp );
@@ -1637,7 +1658,7 @@ possibly_out_of_time:
 			debug_printf( "Unnecessary DD/FD prefix encountered\n" );
 			warning = true;
 			pc--;
-			goto loop;
+			NEXT_INSTR();
 		}
 		assert( false );
 	}
@@ -4,6 +4,7 @@
 
 #include "Multi_Buffer.h"
 #include <string.h>
+#include <math.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -22,7 +23,9 @@ Classic_Emu::Classic_Emu()
 {
 	buf           = 0;
 	stereo_buffer = 0;
+	stem_buffer   = 0;
 	voice_types   = 0;
+	track_clocks  = 0;
 	
 	// avoid inconsistency in our duplicated constants
 	assert( (int) wave_type  == (int) Multi_Buffer::wave_type );
@@ -33,6 +36,7 @@ Classic_Emu::Classic_Emu()
 Classic_Emu::~Classic_Emu()
 {
 	delete stereo_buffer;
+	delete stem_buffer;
 }
 
 void Classic_Emu::set_equalizer_( equalizer_t const& eq )
@@ -54,6 +58,14 @@ blargg_err_t Classic_Emu::set_sample_rate_( long rate )
 	return buf->set_sample_rate( rate, 1000 / 20 );
 }
 
+blargg_err_t Classic_Emu::enable_stems_()
+{
+	if ( !stem_buffer )
+		CHECK_ALLOC( stem_buffer = BLARGG_NEW Stem_Buffer );
+	buf = stem_buffer; // replaces any custom buffer
+	return 0;
+}
+
 void Classic_Emu::mute_voices_( int mask )
 {
 	Music_Emu::mute_voices_( mask );
@@ -79,6 +91,14 @@ void Classic_Emu::change_clock_rate( long rate )
 	buf->clock_rate( rate );
 }
 
+double Classic_Emu::track_time( blip_time_t t ) const
+{
+	// same rounding as Blip_Buffer::clock_rate_factor(), so times match output exactly
+	double const unit = 1L << BLIP_BUFFER_ACCURACY;
+	double factor = floor( (double) sample_rate() / clock_rate_ * unit + 0.5 );
+	return (track_clocks + t) * factor / unit / sample_rate();
+}
+
 blargg_err_t Classic_Emu::setup_buffer( long rate )
 {
 	change_clock_rate( rate );
@@ -92,11 +112,15 @@ blargg_err_t Classic_Emu::start_track_( int track )
 {
 	RETURN_ERR( Music_Emu::start_track_( track ) );
 	buf->clear();
+	track_clocks = 0;
 	return 0;
 }
 
 blargg_err_t Classic_Emu::play_( long count, sample_t* out )
 {
+	if ( stem_buffer )
+		stem_buffer->set_stem_output( stem_out(), stem_stride() );
+	
 	long remain = count;
 	while ( remain )
 	{
@@ -113,6 +137,7 @@ blargg_err_t Classic_Emu::play_( long count, sample_t* out )
 			RETURN_ERR( run_clocks( clocks_emulated, msec ) );
 			assert( clocks_emulated );
 			buf->end_frame( clocks_emulated );
+			track_clocks += clocks_emulated;
 		}
 	}
 	return 0;
@@ -128,7 +153,6 @@ blargg_err_t Rom_Data_::load_rom_data_( Data_Reader& in,
 	rom_addr = 0;
 	mask     = 0;
 	size_    = 0;
-	rom.clear();
 	
 	file_size_ = in.remain();
 	if ( file_size_ <= header_size ) // <= because there must be data after header
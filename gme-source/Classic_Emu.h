@@ -7,6 +7,7 @@
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
 #include "Music_Emu.h"
+class Stem_Buffer;
 
 class Classic_Emu : public Music_Emu {
 public:
@@ -21,6 +22,9 @@ protected:
 	long clock_rate() const { return clock_rate_; }
 	void change_clock_rate( long ); // experimental
 	
+	// Time since start of track, in seconds of output, at clock 't' of current frame
+	double track_time( blip_time_t t ) const;
+	
 	// Overridable
 	virtual void set_voice( int index, Blip_Buffer* center,
 			Blip_Buffer* left, Blip_Buffer* right ) = 0;
@@ -32,10 +36,13 @@ protected:
 	void mute_voices_( int );
 	void set_equalizer_( equalizer_t const& );
 	blargg_err_t play_( long, sample_t* );
+	blargg_err_t enable_stems_();
 private:
 	Multi_Buffer* buf;
 	Multi_Buffer* stereo_buffer; // NULL if using custom buffer
+	Stem_Buffer* stem_buffer;    // NULL unless stems are enabled
 	long clock_rate_;
+	double track_clocks; // clocks run in earlier frames
 	unsigned buf_changed_count;
 	int const* voice_types;
 };
@@ -20,9 +20,27 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 
 unsigned const resampler_extra = 256;
 
-Dual_Resampler::Dual_Resampler() { }
+Dual_Resampler::Dual_Resampler()
+{
+	stem_resamplers = 0;
+	stem_fm_count_  = 0;
+	stem_blip_bufs  = 0;
+	stem_blip_count = 0;
+}
 
-Dual_Resampler::~Dual_Resampler() { }
+Dual_Resampler::~Dual_Resampler() { delete [] stem_resamplers; }
+
+blargg_err_t Dual_Resampler::enable_stems( int fm_count, Blip_Buffer* blip_bufs, int blip_count )
+{
+	if ( !stem_resamplers )
+	{
+		CHECK_ALLOC( stem_resamplers = BLARGG_NEW Fir_Resampler<12> [fm_count] );
+		stem_fm_count_ = fm_count;
+	}
+	stem_blip_bufs  = blip_bufs;
+	stem_blip_count = blip_count;
+	return 0;
+}
 
 blargg_err_t Dual_Resampler::reset( int pairs )
 {
@@ -30,6 +48,9 @@ blargg_err_t Dual_Resampler::reset( int pairs )
 	RETURN_ERR( sample_buf.resize( (pairs + (pairs >> 2)) * 2 ) );
 	resize( pairs );
 	resampler_size = oversamples_per_frame + (oversamples_per_frame >> 2);
+	for ( int i = 0; i < stem_fm_count_; i++ )
+		RETURN_ERR( stem_resamplers [i].buffer_size( resampler_size ) );
+	RETURN_ERR( stem_buf.resize( sample_buf.size() * (stem_fm_count_ + stem_blip_count) ) );
 	return resampler.buffer_size( resampler_size );
 }
 
@@ -68,10 +89,88 @@ void Dual_Resampler::play_frame_( Blip_Buffer& blip_buf, dsample_t* out )
 	
 	mix_samples( blip_buf, out );
 	blip_buf.remove_samples( pair_count );
+	
+	if ( stem_fm_count_ + stem_blip_count )
+	{
+		for ( int i = 0; i < stem_fm_count_; i++ )
+			stem_resamplers [i].write( new_count );
+		play_stems( blip_time, out );
+	}
+}
+
+// Resample FM voices and read Blip_Buffer voices into stem_buf, and add the
+// latter to the mix (their synths don't write to the main Blip_Buffer)
+void Dual_Resampler::play_stems( blip_time_t blip_time, dsample_t* out )
+{
+	long const frame_size = sample_buf.size();
+	
+	for ( int i = 0; i < stem_fm_count_; i++ )
+	{
+		dsample_t* p = &stem_buf [i * frame_size];
+		long count = stem_resamplers [i].read( p, sample_buf_size );
+		assert( count == (long) sample_buf_size );
+		
+		// same scaling as mix_samples()
+		for ( long n = 0; n < count; n++ )
+		{
+			blargg_long s = (blargg_long) p [n] * 2;
+			if ( (BOOST::int16_t) s != s )
+				s = 0x7FFF - (s >> 24);
+			p [n] = (dsample_t) s;
+		}
+	}
+	
+	long pair_count = sample_buf_size >> 1;
+	for ( int i = 0; i < stem_blip_count; i++ )
+	{
+		Blip_Buffer& blip_buf = stem_blip_bufs [i];
+		blip_buf.end_frame( blip_time );
+		assert( blip_buf.samples_avail() == pair_count );
+		
+		dsample_t* p = &stem_buf [(stem_fm_count_ + i) * frame_size];
+		dsample_t* io = out;
+		Blip_Reader sn;
+		int bass = sn.begin( blip_buf );
+		for ( long n = pair_count; n--; )
+		{
+			blargg_long s = sn.read();
+			if ( (BOOST::int16_t) s != s )
+				s = 0x7FFF - (s >> 24);
+			sn.next( bass );
+			p [0] = (dsample_t) s;
+			p [1] = (dsample_t) s;
+			p += 2;
+			
+			blargg_long l = io [0] + s;
+			if ( (BOOST::int16_t) l != l )
+				l = 0x7FFF - (l >> 24);
+			blargg_long r = io [1] + s;
+			if ( (BOOST::int16_t) r != r )
+				r = 0x7FFF - (r >> 24);
+			io [0] = (dsample_t) l;
+			io [1] = (dsample_t) r;
+			io += 2;
+		}
+		sn.end( blip_buf );
+		blip_buf.remove_samples( pair_count );
+	}
 }
 
-void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_buf )
+void Dual_Resampler::copy_stems( dsample_t* stems, long stem_stride, long pos, int from, long count )
 {
+	if ( !stems )
+		return;
+	long const frame_size = sample_buf.size();
+	for ( int i = 0; i < stem_fm_count_ + stem_blip_count; i++ )
+		memcpy( &stems [i * stem_stride + pos], &stem_buf [i * frame_size + from],
+				count * sizeof *stems );
+}
+
+void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_buf,
+		dsample_t* stems, long stem_stride )
+{
+	long pos = 0;
+	
 	// empty extra buffer
 	long remain = sample_buf_size - buf_pos;
 	if ( remain )
@@ -80,7 +179,9 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 			remain = count;
 		count -= remain;
 		memcpy( out, &sample_buf [buf_pos], remain * sizeof *out );
+		copy_stems( stems, stem_stride, pos, buf_pos, remain );
 		out += remain;
+		pos += remain;
 		buf_pos += remain;
 	}
 	
@@ -88,7 +189,9 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 	while ( count >= (long) sample_buf_size )
 	{
 		play_frame_( blip_buf, out );
+		copy_stems( stems, stem_stride, pos, 0, sample_buf_size );
 		out += sample_buf_size;
+		pos += sample_buf_size;
 		count -= sample_buf_size;
 	}
 	
@@ -98,6 +201,7 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 		play_frame_( blip_buf, sample_buf.begin() );
 		buf_pos = count;
 		memcpy( out, sample_buf.begin(), count * sizeof *out );
+		copy_stems( stems, stem_stride, pos, 0, count );
 		out += count;
 	}
 }
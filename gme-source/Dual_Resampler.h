@@ -19,10 +19,22 @@ public:
 	void resize( int pairs_per_frame );
 	void clear();
 	
-	void dual_play( long count, dsample_t* out, Blip_Buffer& );
+	// Per-voice output: the first fm_count voices come from the FM chip and are
+	// resampled like the main output, the remaining blip_count voices are read from
+	// blip_bufs [0] to blip_bufs [blip_count - 1]. Call before setup().
+	blargg_err_t enable_stems( int fm_count, Blip_Buffer* blip_bufs, int blip_count );
+	
+	// If stems are enabled, voice i's samples also go to stems [i * stem_stride],
+	// or are discarded if stems is NULL
+	void dual_play( long count, dsample_t* out, Blip_Buffer&,
+			dsample_t* stems = NULL, long stem_stride = 0 );
 	
 protected:
 	virtual int play_frame( blip_time_t, int pcm_count, dsample_t* pcm_out ) = 0;
+	
+	// Where play_frame() writes FM voice i's samples, if stems are enabled
+	int stem_fm_count() const               { return stem_fm_count_; }
+	dsample_t* stem_pcm_out( int i )        { return stem_resamplers [i].buffer(); }
 private:
 	
 	blargg_vector<dsample_t> sample_buf;
@@ -34,10 +46,21 @@ private:
 	Fir_Resampler<12> resampler;
 	void mix_samples( Blip_Buffer&, dsample_t* );
 	void play_frame_( Blip_Buffer&, dsample_t* );
+	
+	// stems
+	Fir_Resampler<12>* stem_resamplers;
+	int stem_fm_count_;
+	Blip_Buffer* stem_blip_bufs;
+	int stem_blip_count;
+	blargg_vector<dsample_t> stem_buf; // one frame per voice
+	void play_stems( blip_time_t, dsample_t* out );
+	void copy_stems( dsample_t* stems, long stem_stride, long pos, int from, long count );
 };
 
 inline double Dual_Resampler::setup( double oversample, double rolloff, double gain )
 {
+	for ( int i = 0; i < stem_fm_count_; i++ )
+		stem_resamplers [i].time_ratio( oversample, rolloff, gain * 0.5 );
 	return resampler.time_ratio( oversample, rolloff, gain * 0.5 );
 }
 
@@ -45,6 +68,8 @@ inline void Dual_Resampler::clear()
 {
 	buf_pos = sample_buf_size;
 	resampler.clear();
+	for ( int i = 0; i < stem_fm_count_; i++ )
+		stem_resamplers [i].clear();
 }
 
 #endif
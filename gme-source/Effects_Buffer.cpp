@@ -4,6 +4,10 @@
 
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -385,70 +389,6 @@ void Effects_Buffer::mix_stereo( blip_sample_t* out_, blargg_long count )
 	BLIP_READER_END( c, bufs [0] );
 }
 
-void Effects_Buffer::mix_mono_enhanced( blip_sample_t* out_, blargg_long count )
-{
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [2] );
-	BLIP_READER_BEGIN( center, bufs [2] );
-	BLIP_READER_BEGIN( sq1, bufs [0] );
-	BLIP_READER_BEGIN( sq2, bufs [1] );
-	
-	blip_sample_t* const reverb_buf = this->reverb_buf.begin();
-	blip_sample_t* const echo_buf = this->echo_buf.begin();
-	int echo_pos = this->echo_pos;
-	int reverb_pos = this->reverb_pos;
-	
-	while ( count-- )
-	{
-		int sum1_s = BLIP_READER_READ( sq1 );
-		int sum2_s = BLIP_READER_READ( sq2 );
-		
-		BLIP_READER_NEXT( sq1, bass );
-		BLIP_READER_NEXT( sq2, bass );
-		
-		int new_reverb_l = FMUL( sum1_s, chans.pan_1_levels [0] ) +
-				FMUL( sum2_s, chans.pan_2_levels [0] ) +
-				reverb_buf [(reverb_pos + chans.reverb_delay_l) & reverb_mask];
-		
-		int new_reverb_r = FMUL( sum1_s, chans.pan_1_levels [1] ) +
-				FMUL( sum2_s, chans.pan_2_levels [1] ) +
-				reverb_buf [(reverb_pos + chans.reverb_delay_r) & reverb_mask];
-		
-		fixed_t reverb_level = chans.reverb_level;
-		reverb_buf [reverb_pos] = (blip_sample_t) FMUL( new_reverb_l, reverb_level );
-		reverb_buf [reverb_pos + 1] = (blip_sample_t) FMUL( new_reverb_r, reverb_level );
-		reverb_pos = (reverb_pos + 2) & reverb_mask;
-		
-		int sum3_s = BLIP_READER_READ( center );
-		BLIP_READER_NEXT( center, bass );
-		
-		int left = new_reverb_l + sum3_s + FMUL( chans.echo_level,
-				echo_buf [(echo_pos + chans.echo_delay_l) & echo_mask] );
-		int right = new_reverb_r + sum3_s + FMUL( chans.echo_level,
-				echo_buf [(echo_pos + chans.echo_delay_r) & echo_mask] );
-		
-		echo_buf [echo_pos] = sum3_s;
-		echo_pos = (echo_pos + 1) & echo_mask;
-		
-		if ( (BOOST::int16_t) left != left )
-			left = 0x7FFF - (left >> 24);
-		
-		out [0] = left;
-		out [1] = right;
-		
-		out += 2;
-		
-		if ( (BOOST::int16_t) right != right )
-			out [-1] = 0x7FFF - (right >> 24);
-	}
-	this->reverb_pos = reverb_pos;
-	this->echo_pos = echo_pos;
-	
-	BLIP_READER_END( sq1, bufs [0] );
-	BLIP_READER_END( sq2, bufs [1] );
-	BLIP_READER_END( center, bufs [2] );
-}
-
 void Effects_Buffer::mix_enhanced( blip_sample_t* out_, blargg_long count )
 {
 	blip_sample_t* BLIP_RESTRICT out = out_;
@@ -527,3 +467,239 @@ void Effects_Buffer::mix_enhanced( blip_sample_t* out_, blargg_long count )
 	BLIP_READER_END( center, bufs [2] );
 }
 
+// Mono effects are mixed in blocks. All delay line reads for a block are gathered
+// before any of its writes, so a block is never longer than the shortest delay.
+// With the four side buffers also being read, mix_enhanced() is limited by its
+// serial Blip_Buffer readers and blocks don't help, so it mixes per sample.
+int const max_block = 256;
+
+// Read count samples from the ring buffer, starting at pos and taking every
+// step'th sample, in contiguous spans between wraparounds
+static void ring_read( blip_sample_t const* ring, unsigned mask, unsigned pos,
+		int step, int* out, int count )
+{
+	while ( count > 0 )
+	{
+		pos &= mask;
+		int n = (mask + 1 - pos + step - 1) / step;
+		if ( n > count )
+			n = count;
+		count -= n;
+		
+		blip_sample_t const* in = ring + pos;
+		pos += n * step;
+		do
+		{
+			*out++ = *in;
+			in += step;
+		}
+		while ( --n );
+	}
+}
+
+// Write count samples to the ring buffer starting at pos
+static void ring_write( blip_sample_t* ring, unsigned mask, unsigned pos,
+		blip_sample_t const* in, int count )
+{
+	while ( count > 0 )
+	{
+		pos &= mask;
+		int n = mask + 1 - pos;
+		if ( n > count )
+			n = count;
+		memcpy( ring + pos, in, n * sizeof *in );
+		in += n;
+		pos += n;
+		count -= n;
+	}
+}
+
+#ifdef __SSE2__
+// Four FMUL( x, level ) at once, with the same result as the 64-bit multiply,
+// for 0 <= level < 0x10000. With x = xh * 0x10000 + xl and
+// level = lh * 0x8000 + ll, the result is x * lh + xh * ll * 2 + (xl * ll >> 15),
+// where each product fits in 32 bits.
+struct fmul4_t
+{
+	__m128i ll_lo; // ll in low half of each 32-bit lane
+	__m128i ll_hi; // ll in high half
+	__m128i lh_mask;
+	
+	void set( int l )
+	{
+		int ll = l & 0x7FFF;
+		ll_lo   = _mm_set1_epi32( ll );
+		ll_hi   = _mm_set1_epi32( ll << 16 );
+		lh_mask = _mm_set1_epi32( -(l >> 15) );
+	}
+	
+	__m128i operator () ( __m128i x ) const
+	{
+		__m128i high = _mm_madd_epi16( x, ll_hi );
+		__m128i low = _mm_or_si128( _mm_slli_epi32( _mm_mulhi_epu16( x, ll_lo ), 1 ),
+				_mm_srli_epi32( _mm_mullo_epi16( x, ll_lo ), 15 ) );
+		return _mm_add_epi32( _mm_add_epi32( high, high ),
+				_mm_add_epi32( low, _mm_and_si128( x, lh_mask ) ) );
+	}
+};
+
+// Low 16 bits of each sample, sign-extended
+static inline __m128i trunc16( __m128i x )
+{
+	return _mm_srai_epi32( _mm_slli_epi32( x, 16 ), 16 );
+}
+
+// Low 16 bits of l [0] r [0] l [1] r [1] ...
+static inline __m128i interleave16( __m128i l, __m128i r )
+{
+	__m128i lr = _mm_packs_epi32( trunc16( l ), trunc16( r ) );
+	return _mm_unpacklo_epi16( lr, _mm_srli_si128( lr, 8 ) );
+}
+
+// Same as clamping in scalar loop below
+static inline __m128i clamp16( __m128i x )
+{
+	__m128i in_range = _mm_cmpeq_epi32( trunc16( x ), x );
+	__m128i clamped = _mm_sub_epi32( _mm_set1_epi32( 0x7FFF ), _mm_srai_epi32( x, 24 ) );
+	return _mm_or_si128( _mm_and_si128( in_range, x ), _mm_andnot_si128( in_range, clamped ) );
+}
+#endif
+
+void Effects_Buffer::mix_mono_enhanced( blip_sample_t* out, blargg_long count )
+{
+	// limit block to shortest delay
+	int block = max_block;
+	int delays [4] = {
+		(int) (reverb_size     - chans.reverb_delay_l) >> 1,
+		(int) (reverb_size + 1 - chans.reverb_delay_r) >> 1,
+		(int) echo_size - chans.echo_delay_l,
+		(int) echo_size - chans.echo_delay_r
+	};
+	for ( int i = 0; i < 4; i++ )
+		if ( block > delays [i] )
+			block = delays [i];
+	
+	int const bass = BLIP_READER_BASS( bufs [2] );
+	fixed_t const pan_1_l = chans.pan_1_levels [0];
+	fixed_t const pan_1_r = chans.pan_1_levels [1];
+	fixed_t const pan_2_l = chans.pan_2_levels [0];
+	fixed_t const pan_2_r = chans.pan_2_levels [1];
+	fixed_t const reverb_level = chans.reverb_level;
+	fixed_t const echo_level = chans.echo_level;
+	
+	int reverb_l [max_block];
+	int reverb_r [max_block];
+	int echo_l [max_block];
+	int echo_r [max_block];
+	blip_sample_t reverb_out [max_block * 2];
+	blip_sample_t echo_out [max_block];
+	
+#ifdef __SSE2__
+	bool const fits = (unsigned long) (pan_1_l | pan_1_r | pan_2_l | pan_2_r |
+			reverb_level | echo_level) < 0x10000;
+	fmul4_t v_pan_1_l, v_pan_1_r, v_pan_2_l, v_pan_2_r, v_reverb, v_echo;
+	v_pan_1_l.set( (int) pan_1_l );
+	v_pan_1_r.set( (int) pan_1_r );
+	v_pan_2_l.set( (int) pan_2_l );
+	v_pan_2_r.set( (int) pan_2_r );
+	v_reverb .set( (int) reverb_level );
+	v_echo   .set( (int) echo_level );
+#endif
+	
+	BLIP_READER_BEGIN( sq1, bufs [0] );
+	BLIP_READER_BEGIN( sq2, bufs [1] );
+	BLIP_READER_BEGIN( center, bufs [2] );
+	
+	while ( count > 0 )
+	{
+		int n = block;
+		if ( n > count )
+			n = count;
+		count -= n;
+		
+		// gather delayed samples for whole block
+		ring_read( reverb_buf.begin(), reverb_mask, reverb_pos + chans.reverb_delay_l, 2, reverb_l, n );
+		ring_read( reverb_buf.begin(), reverb_mask, reverb_pos + chans.reverb_delay_r, 2, reverb_r, n );
+		ring_read( echo_buf.begin(), echo_mask, echo_pos + chans.echo_delay_l, 1, echo_l, n );
+		ring_read( echo_buf.begin(), echo_mask, echo_pos + chans.echo_delay_r, 1, echo_r, n );
+		
+		int i = 0;
+	#ifdef __SSE2__
+		if ( fits )
+		{
+			for ( ; i + 4 <= n; i += 4 )
+			{
+				// Blip_Buffer readers are serial, so they're read in the same loop
+				// to overlap with the vector work
+				#define READ4( name, out ) {\
+					int t0 = BLIP_READER_READ( name ); BLIP_READER_NEXT( name, bass );\
+					int t1 = BLIP_READER_READ( name ); BLIP_READER_NEXT( name, bass );\
+					int t2 = BLIP_READER_READ( name ); BLIP_READER_NEXT( name, bass );\
+					int t3 = BLIP_READER_READ( name ); BLIP_READER_NEXT( name, bass );\
+					out = _mm_setr_epi32( t0, t1, t2, t3 );\
+				}
+				__m128i s1, s2, c;
+				READ4( sq1, s1 );
+				READ4( sq2, s2 );
+				READ4( center, c );
+				#undef READ4
+				
+				__m128i new_reverb_l = _mm_add_epi32( _mm_add_epi32( v_pan_1_l( s1 ), v_pan_2_l( s2 ) ),
+						_mm_loadu_si128( (__m128i const*) (reverb_l + i) ) );
+				__m128i new_reverb_r = _mm_add_epi32( _mm_add_epi32( v_pan_1_r( s1 ), v_pan_2_r( s2 ) ),
+						_mm_loadu_si128( (__m128i const*) (reverb_r + i) ) );
+				_mm_storeu_si128( (__m128i*) (reverb_out + i * 2),
+						interleave16( v_reverb( new_reverb_l ), v_reverb( new_reverb_r ) ) );
+				
+				__m128i left  = _mm_add_epi32( _mm_add_epi32( new_reverb_l, c ),
+						v_echo( _mm_loadu_si128( (__m128i const*) (echo_l + i) ) ) );
+				__m128i right = _mm_add_epi32( _mm_add_epi32( new_reverb_r, c ),
+						v_echo( _mm_loadu_si128( (__m128i const*) (echo_r + i) ) ) );
+				c = trunc16( c );
+				_mm_storel_epi64( (__m128i*) (echo_out + i), _mm_packs_epi32( c, c ) );
+				_mm_storeu_si128( (__m128i*) (out + i * 2),
+						interleave16( clamp16( left ), clamp16( right ) ) );
+			}
+		}
+	#endif
+		for ( ; i < n; i++ )
+		{
+			int sum1_s = BLIP_READER_READ( sq1 );
+			int sum2_s = BLIP_READER_READ( sq2 );
+			int sum3_s = BLIP_READER_READ( center );
+			BLIP_READER_NEXT( sq1, bass );
+			BLIP_READER_NEXT( sq2, bass );
+			BLIP_READER_NEXT( center, bass );
+			
+			int new_reverb_l = FMUL( sum1_s, pan_1_l ) + FMUL( sum2_s, pan_2_l ) + reverb_l [i];
+			int new_reverb_r = FMUL( sum1_s, pan_1_r ) + FMUL( sum2_s, pan_2_r ) + reverb_r [i];
+			int left  = new_reverb_l + sum3_s + FMUL( echo_level, echo_l [i] );
+			int right = new_reverb_r + sum3_s + FMUL( echo_level, echo_r [i] );
+			
+			reverb_out [i * 2    ] = (blip_sample_t) FMUL( new_reverb_l, reverb_level );
+			reverb_out [i * 2 + 1] = (blip_sample_t) FMUL( new_reverb_r, reverb_level );
+			echo_out [i] = sum3_s;
+			
+			if ( (BOOST::int16_t) left != left )
+				left = 0x7FFF - (left >> 24);
+			
+			if ( (BOOST::int16_t) right != right )
+				right = 0x7FFF - (right >> 24);
+			
+			out [i * 2    ] = left;
+			out [i * 2 + 1] = right;
+		}
+		out += n * 2;
+		
+		// then write this block's samples back
+		ring_write( reverb_buf.begin(), reverb_mask, reverb_pos, reverb_out, n * 2 );
+		reverb_pos = (reverb_pos + n * 2) & reverb_mask;
+		
+		ring_write( echo_buf.begin(), echo_mask, echo_pos, echo_out, n );
+		echo_pos = (echo_pos + n) & echo_mask;
+	}
+	
+	BLIP_READER_END( sq1, bufs [0] );
+	BLIP_READER_END( sq2, bufs [1] );
+	BLIP_READER_END( center, bufs [2] );
+}
@@ -104,6 +104,7 @@ void Gb_Apu::reset()
 	next_frame_time = 0;
 	last_time       = 0;
 	frame_count     = 0;
+	idle_clocks_    = 0;
 	
 	square1.reset();
 	square2.reset();
@@ -139,16 +140,18 @@ void Gb_Apu::run_until( blip_time_t end_time )
 			time = end_time;
 		
 		// run oscillators
+		int any_playing = false;
 		for ( int i = 0; i < osc_count; ++i )
 		{
 			Gb_Osc& osc = *oscs [i];
+			int playing = false;
+			if ( osc.enabled && osc.volume &&
+					(!(osc.regs [4] & osc.len_enabled_mask) || osc.length) )
+				playing = -1;
+			any_playing |= playing;
 			if ( osc.output )
 			{
 				osc.output->set_modified(); // TODO: misses optimization opportunities?
-				int playing = false;
-				if ( osc.enabled && osc.volume &&
-						(!(osc.regs [4] & osc.len_enabled_mask) || osc.length) )
-					playing = -1;
 				switch ( i )
 				{
 				case 0: square1.run( last_time, time, playing ); break;
@@ -158,6 +161,8 @@ void Gb_Apu::run_until( blip_time_t end_time )
 				}
 			}
 		}
+		if ( !any_playing )
+			idle_clocks_ += time - last_time;
 		last_time = time;
 		
 		if ( time == end_time )
@@ -50,6 +50,10 @@ public:
 	
 	void set_tempo( double );
 	
+	// Number of clocks run since reset() during which no oscillator was playing.
+	// Silent oscillators already only advance their timers.
+	long idle_clocks() const { return idle_clocks_; }
+	
 public:
 	Gb_Apu();
 private:
@@ -63,6 +67,7 @@ private:
 	blip_time_t frame_period;
 	double      volume_unit;
 	int         frame_count;
+	long        idle_clocks_;
 	
 	Gb_Square   square1;
 	Gb_Square   square2;
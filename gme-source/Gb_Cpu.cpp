@@ -3,6 +3,7 @@
 #include "Gb_Cpu.h"
 
 #include <string.h>
+#include "blargg_dispatch.h"
 
 //#include "gb_cpu_log.h"
 
@@ -155,83 +156,99 @@ loop:
 		gb_cpu_log( "new", pc - 1, op, data, instr [1] );
 	#endif
 	
-	switch ( op )
+	OPCODE_SWITCH( op )
 	{
 
+// With computed goto, each opcode fetches and dispatches the next one the same way
+// loop does, rather than all of them sharing the indirect jump at loop
+#if BLARGG_COMPUTED_GOTO && !defined (GB_CPU_LOG_H)
+	#define NEXT_INSTR() do {\
+		instr = s.code_map [pc >> page_shift] + PAGE_OFFSET( pc );\
+		op = *instr++;\
+		pc++;\
+		if ( !--s.remain )\
+			goto stop;\
+		data = *instr;\
+		OPCODE_DISPATCH( op );\
+	} while ( 0 )
+#else
+	#define NEXT_INSTR() goto loop
+#endif
+
 // TODO: more efficient way to handle negative branch that wraps PC around
 #define BRANCH( cond )\
 {\
 	pc++;\
 	int offset = (BOOST::int8_t) data;\
-	if ( !(cond) ) goto loop;\
+	if ( !(cond) ) NEXT_INSTR();\
 	pc = uint16_t (pc + offset);\
-	goto loop;\
+	NEXT_INSTR();\
 }
 
 // Most Common
 
-	case 0x20: // JR NZ
+	OPCODE( 0x20 ) // JR NZ
 		BRANCH( !(flags & z_flag) )
 	
-	case 0x21: // LD HL,IMM (common)
+	OPCODE( 0x21 ) // LD HL,IMM (common)
 		rp.hl = GET_ADDR();
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x28: // JR Z
+	OPCODE( 0x28 ) // JR Z
 		BRANCH( flags & z_flag )
 	
 	{
 		unsigned temp;
-	case 0xF0: // LD A,(0xFF00+imm)
+	OPCODE( 0xF0 ) // LD A,(0xFF00+imm)
 		temp = data | 0xFF00;
 		pc++;
 		goto ld_a_ind_comm;
 	
-	case 0xF2: // LD A,(0xFF00+C)
+	OPCODE( 0xF2 ) // LD A,(0xFF00+C)
 		temp = rg.c | 0xFF00;
 		goto ld_a_ind_comm;
 	
-	case 0x0A: // LD A,(BC)
+	OPCODE( 0x0A ) // LD A,(BC)
 		temp = rp.bc;
 		goto ld_a_ind_comm;
 	
-	case 0x3A: // LD A,(HL-)
+	OPCODE( 0x3A ) // LD A,(HL-)
 		temp = rp.hl;
 		rp.hl = temp - 1;
 		goto ld_a_ind_comm;
 	
-	case 0x1A: // LD A,(DE)
+	OPCODE( 0x1A ) // LD A,(DE)
 		temp = rp.de;
 		goto ld_a_ind_comm;
 	
-	case 0x2A: // LD A,(HL+) (common)
+	OPCODE( 0x2A ) // LD A,(HL+) (common)
 		temp = rp.hl;
 		rp.hl = temp + 1;
 		goto ld_a_ind_comm;
 		
-	case 0xFA: // LD A,IND16 (common)
+	OPCODE( 0xFA ) // LD A,IND16 (common)
 		temp = GET_ADDR();
 		pc += 2;
 	ld_a_ind_comm:
 		READ_FAST( temp, rg.a );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xBE: // CMP (HL)
+	OPCODE( 0xBE ) // CMP (HL)
 		data = READ( rp.hl );
 		goto cmp_comm;
 	
-	case 0xB8: // CMP B
-	case 0xB9: // CMP C
-	case 0xBA: // CMP D
-	case 0xBB: // CMP E
-	case 0xBC: // CMP H
-	case 0xBD: // CMP L
+	OPCODE( 0xB8 ) // CMP B
+	OPCODE( 0xB9 ) // CMP C
+	OPCODE( 0xBA ) // CMP D
+	OPCODE( 0xBB ) // CMP E
+	OPCODE( 0xBC ) // CMP H
+	OPCODE( 0xBD ) // CMP L
 		data = R8( op & 7 );
 		goto cmp_comm;
 	
-	case 0xFE: // CMP IMM
+	OPCODE( 0xFE ) // CMP IMM
 		pc++;
 	cmp_comm:
 		op = rg.a;
@@ -241,29 +258,29 @@ loop:
 		flags |= (data >> 4) & c_flag;
 		flags |= n_flag;
 		if ( data & 0xFF )
-			goto loop;
+			NEXT_INSTR();
 		flags |= z_flag;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x46: // LD B,(HL)
-	case 0x4E: // LD C,(HL)
-	case 0x56: // LD D,(HL)
-	case 0x5E: // LD E,(HL)
-	case 0x66: // LD H,(HL)
-	case 0x6E: // LD L,(HL)
-	case 0x7E:{// LD A,(HL)
+	OPCODE( 0x46 ) // LD B,(HL)
+	OPCODE( 0x4E ) // LD C,(HL)
+	OPCODE( 0x56 ) // LD D,(HL)
+	OPCODE( 0x5E ) // LD E,(HL)
+	OPCODE( 0x66 ) // LD H,(HL)
+	OPCODE( 0x6E ) // LD L,(HL)
+	OPCODE( 0x7E ){// LD A,(HL)
 		unsigned addr = rp.hl;
 		READ_FAST( addr, R8( (op >> 3) & 7 ) );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xC4: // CNZ (next-most-common)
+	OPCODE( 0xC4 ) // CNZ (next-most-common)
 		pc += 2;
 		if ( flags & z_flag )
-			goto loop;
+			NEXT_INSTR();
 	call:
 		pc -= 2;
-	case 0xCD: // CALL (most-common)
+	OPCODE( 0xCD ) // CALL (most-common)
 		data = pc + 2;
 		pc = GET_ADDR();
 	push:
@@ -271,33 +288,34 @@ loop:
 		WRITE( sp, data >> 8 );
 		sp = (sp - 1) & 0xFFFF;
 		WRITE( sp, data & 0xFF );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xC8: // RNZ (next-most-common)
+	OPCODE( 0xC8 ) // RNZ (next-most-common)
 		if ( !(flags & z_flag) )
-			goto loop;
-	case 0xC9: // RET (most common)
+			NEXT_INSTR();
+	OPCODE( 0xC9 ) // RET (most common)
 	ret:
 		pc = READ( sp );
 		pc += 0x100 * READ( sp + 1 );
 		sp = (sp + 2) & 0xFFFF;
-		goto loop;
-	
-	case 0x00: // NOP
-	case 0x40: // LD B,B
-	case 0x49: // LD C,C
-	case 0x52: // LD D,D
-	case 0x5B: // LD E,E
-	case 0x64: // LD H,H
-	case 0x6D: // LD L,L
-	case 0x7F: // LD A,A
-		goto loop;
+		NEXT_INSTR();
+	
+	OPCODE( 0x00 ) // NOP
+	OPCODE( 0x40 ) // LD B,B
+	OPCODE( 0x49 ) // LD C,C
+	OPCODE( 0x52 ) // LD D,D
+	OPCODE( 0x5B ) // LD E,E
+	OPCODE( 0x64 ) // LD H,H
+	OPCODE( 0x6D ) // LD L,L
+	OPCODE( 0x7F ) // LD A,A
+		NEXT_INSTR();
 	
 // CB Instructions
 
-	case 0xCB:
+	OPCODE( 0xCB )
 		pc++;
-		// now data is the opcode
+		// now data is the opcode; these are less common, so they just go
+		// back through loop
 		switch ( data ) {
 			
 		{
@@ -451,8 +469,8 @@ loop:
 	} // CB op
 	assert( false ); // unhandled CB op
 
-	case 0x07: // RLCA
-	case 0x17: // RLA
+	OPCODE( 0x07 ) // RLCA
+	OPCODE( 0x17 ) // RLA
 		data = op;
 		op = rg.a;
 	rl_comm:
@@ -464,8 +482,8 @@ loop:
 		// SLA doesn't fill lower bit
 		goto shift_comm;
 	
-	case 0x0F: // RRCA
-	case 0x1F: // RRA
+	OPCODE( 0x0F ) // RRCA
+	OPCODE( 0x1F ) // RRA
 		data = op;
 		op = rg.a;
 	rr_comm:
@@ -483,197 +501,197 @@ loop:
 		if ( data == 6 )
 			goto write_hl_op_ff;
 		R8( data ) = op;
-		goto loop;
+		NEXT_INSTR();
 
 // Load
 
-	case 0x70: // LD (HL),B
-	case 0x71: // LD (HL),C
-	case 0x72: // LD (HL),D
-	case 0x73: // LD (HL),E
-	case 0x74: // LD (HL),H
-	case 0x75: // LD (HL),L
-	case 0x77: // LD (HL),A
+	OPCODE( 0x70 ) // LD (HL),B
+	OPCODE( 0x71 ) // LD (HL),C
+	OPCODE( 0x72 ) // LD (HL),D
+	OPCODE( 0x73 ) // LD (HL),E
+	OPCODE( 0x74 ) // LD (HL),H
+	OPCODE( 0x75 ) // LD (HL),L
+	OPCODE( 0x77 ) // LD (HL),A
 		op = R8( op & 7 );
 	write_hl_op_ff:
 		WRITE( rp.hl, op & 0xFF );
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x47: // LD r,r
-	case 0x48: case 0x4A: case 0x4B: case 0x4C: case 0x4D: case 0x4F:
-	case 0x50: case 0x51: case 0x53: case 0x54: case 0x55: case 0x57:
-	case 0x58: case 0x59: case 0x5A: case 0x5C: case 0x5D: case 0x5F:
-	case 0x60: case 0x61: case 0x62: case 0x63: case 0x65: case 0x67:
-	case 0x68: case 0x69: case 0x6A: case 0x6B: case 0x6C: case 0x6F:
-	case 0x78: case 0x79: case 0x7A: case 0x7B: case 0x7C: case 0x7D:
+	OPCODE( 0x41 ) OPCODE( 0x42 ) OPCODE( 0x43 ) OPCODE( 0x44 ) OPCODE( 0x45 ) OPCODE( 0x47 ) // LD r,r
+	OPCODE( 0x48 ) OPCODE( 0x4A ) OPCODE( 0x4B ) OPCODE( 0x4C ) OPCODE( 0x4D ) OPCODE( 0x4F )
+	OPCODE( 0x50 ) OPCODE( 0x51 ) OPCODE( 0x53 ) OPCODE( 0x54 ) OPCODE( 0x55 ) OPCODE( 0x57 )
+	OPCODE( 0x58 ) OPCODE( 0x59 ) OPCODE( 0x5A ) OPCODE( 0x5C ) OPCODE( 0x5D ) OPCODE( 0x5F )
+	OPCODE( 0x60 ) OPCODE( 0x61 ) OPCODE( 0x62 ) OPCODE( 0x63 ) OPCODE( 0x65 ) OPCODE( 0x67 )
+	OPCODE( 0x68 ) OPCODE( 0x69 ) OPCODE( 0x6A ) OPCODE( 0x6B ) OPCODE( 0x6C ) OPCODE( 0x6F )
+	OPCODE( 0x78 ) OPCODE( 0x79 ) OPCODE( 0x7A ) OPCODE( 0x7B ) OPCODE( 0x7C ) OPCODE( 0x7D )
 		R8( (op >> 3) & 7 ) = R8( op & 7 );
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x08: // LD IND16,SP
+	OPCODE( 0x08 ) // LD IND16,SP
 		data = GET_ADDR();
 		pc += 2;
 		WRITE( data, sp&0xFF );
 		data++;
 		WRITE( data, sp >> 8 );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xF9: // LD SP,HL
+	OPCODE( 0xF9 ) // LD SP,HL
 		sp = rp.hl;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x31: // LD SP,IMM
+	OPCODE( 0x31 ) // LD SP,IMM
 		sp = GET_ADDR();
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x01: // LD BC,IMM
-	case 0x11: // LD DE,IMM
+	OPCODE( 0x01 ) // LD BC,IMM
+	OPCODE( 0x11 ) // LD DE,IMM
 		r16 [op >> 4] = GET_ADDR();
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
 	{
 		unsigned temp;
-	case 0xE0: // LD (0xFF00+imm),A
+	OPCODE( 0xE0 ) // LD (0xFF00+imm),A
 		temp = data | 0xFF00;
 		pc++;
 		goto write_data_rg_a;
 	
-	case 0xE2: // LD (0xFF00+C),A
+	OPCODE( 0xE2 ) // LD (0xFF00+C),A
 		temp = rg.c | 0xFF00;
 		goto write_data_rg_a;
 
-	case 0x32: // LD (HL-),A
+	OPCODE( 0x32 ) // LD (HL-),A
 		temp = rp.hl;
 		rp.hl = temp - 1;
 		goto write_data_rg_a;
 	
-	case 0x02: // LD (BC),A
+	OPCODE( 0x02 ) // LD (BC),A
 		temp = rp.bc;
 		goto write_data_rg_a;
 	
-	case 0x12: // LD (DE),A
+	OPCODE( 0x12 ) // LD (DE),A
 		temp = rp.de;
 		goto write_data_rg_a;
 	
-	case 0x22: // LD (HL+),A
+	OPCODE( 0x22 ) // LD (HL+),A
 		temp = rp.hl;
 		rp.hl = temp + 1;
 		goto write_data_rg_a;
 		
-	case 0xEA: // LD IND16,A (common)
+	OPCODE( 0xEA ) // LD IND16,A (common)
 		temp = GET_ADDR();
 		pc += 2;
 	write_data_rg_a:
 		WRITE( temp, rg.a );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x06: // LD B,IMM
+	OPCODE( 0x06 ) // LD B,IMM
 		rg.b = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x0E: // LD C,IMM
+	OPCODE( 0x0E ) // LD C,IMM
 		rg.c = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x16: // LD D,IMM
+	OPCODE( 0x16 ) // LD D,IMM
 		rg.d = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x1E: // LD E,IMM
+	OPCODE( 0x1E ) // LD E,IMM
 		rg.e = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x26: // LD H,IMM
+	OPCODE( 0x26 ) // LD H,IMM
 		rg.h = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x2E: // LD L,IMM
+	OPCODE( 0x2E ) // LD L,IMM
 		rg.l = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x36: // LD (HL),IMM
+	OPCODE( 0x36 ) // LD (HL),IMM
 		WRITE( rp.hl, data );
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x3E: // LD A,IMM
+	OPCODE( 0x3E ) // LD A,IMM
 		rg.a = data;
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 
 // Increment/Decrement
 
-	case 0x03: // INC BC
-	case 0x13: // INC DE
-	case 0x23: // INC HL
+	OPCODE( 0x03 ) // INC BC
+	OPCODE( 0x13 ) // INC DE
+	OPCODE( 0x23 ) // INC HL
 		r16 [op >> 4]++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x33: // INC SP
+	OPCODE( 0x33 ) // INC SP
 		sp = (sp + 1) & 0xFFFF;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x0B: // DEC BC
-	case 0x1B: // DEC DE
-	case 0x2B: // DEC HL
+	OPCODE( 0x0B ) // DEC BC
+	OPCODE( 0x1B ) // DEC DE
+	OPCODE( 0x2B ) // DEC HL
 		r16 [op >> 4]--;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x3B: // DEC SP
+	OPCODE( 0x3B ) // DEC SP
 		sp = (sp - 1) & 0xFFFF;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x34: // INC (HL)
+	OPCODE( 0x34 ) // INC (HL)
 		op = rp.hl;
 		data = READ( op );
 		data++;
 		WRITE( op, data & 0xFF );
 		goto inc_comm;
 	
-	case 0x04: // INC B
-	case 0x0C: // INC C (common)
-	case 0x14: // INC D
-	case 0x1C: // INC E
-	case 0x24: // INC H
-	case 0x2C: // INC L
-	case 0x3C: // INC A
+	OPCODE( 0x04 ) // INC B
+	OPCODE( 0x0C ) // INC C (common)
+	OPCODE( 0x14 ) // INC D
+	OPCODE( 0x1C ) // INC E
+	OPCODE( 0x24 ) // INC H
+	OPCODE( 0x2C ) // INC L
+	OPCODE( 0x3C ) // INC A
 		op = (op >> 3) & 7;
 		R8( op ) = data = R8( op ) + 1;
 	inc_comm:
 		flags = (flags & c_flag) | (((data & 15) - 1) & h_flag) | ((data >> 1) & z_flag);
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x35: // DEC (HL)
+	OPCODE( 0x35 ) // DEC (HL)
 		op = rp.hl;
 		data = READ( op );
 		data--;
 		WRITE( op, data & 0xFF );
 		goto dec_comm;
 	
-	case 0x05: // DEC B
-	case 0x0D: // DEC C
-	case 0x15: // DEC D
-	case 0x1D: // DEC E
-	case 0x25: // DEC H
-	case 0x2D: // DEC L
-	case 0x3D: // DEC A
+	OPCODE( 0x05 ) // DEC B
+	OPCODE( 0x0D ) // DEC C
+	OPCODE( 0x15 ) // DEC D
+	OPCODE( 0x1D ) // DEC E
+	OPCODE( 0x25 ) // DEC H
+	OPCODE( 0x2D ) // DEC L
+	OPCODE( 0x3D ) // DEC A
 		op = (op >> 3) & 7;
 		data = R8( op ) - 1;
 		R8( op ) = data;
 	dec_comm:
 		flags = (flags & c_flag) | n_flag | (((data & 15) + 0x31) & h_flag);
 		if ( data & 0xFF )
-			goto loop;
+			NEXT_INSTR();
 		flags |= z_flag;
-		goto loop;
+		NEXT_INSTR();
 
 // Add 16-bit
 
@@ -681,7 +699,7 @@ loop:
 		blargg_ulong temp; // need more than 16 bits for carry
 		unsigned prev;
 		
-	case 0xF8: // LD HL,SP+imm
+	OPCODE( 0xF8 ) // LD HL,SP+imm
 		temp = BOOST::int8_t (data); // sign-extend to 16 bits
 		pc++;
 		flags = 0;
@@ -689,7 +707,7 @@ loop:
 		prev = sp;
 		goto add_16_hl;
 	
-	case 0xE8: // ADD SP,IMM
+	OPCODE( 0xE8 ) // ADD SP,IMM
 		temp = BOOST::int8_t (data); // sign-extend to 16 bits
 		pc++;
 		flags = 0;
@@ -698,13 +716,13 @@ loop:
 		sp = temp & 0xFFFF;
 		goto add_16_comm;
 
-	case 0x39: // ADD HL,SP
+	OPCODE( 0x39 ) // ADD HL,SP
 		temp = sp;
 		goto add_hl_comm;
 	
-	case 0x09: // ADD HL,BC
-	case 0x19: // ADD HL,DE
-	case 0x29: // ADD HL,HL
+	OPCODE( 0x09 ) // ADD HL,BC
+	OPCODE( 0x19 ) // ADD HL,DE
+	OPCODE( 0x29 ) // ADD HL,HL
 		temp = r16 [op >> 4];
 	add_hl_comm:
 		prev = rp.hl;
@@ -715,24 +733,24 @@ loop:
 	add_16_comm:
 		flags |= (temp >> 12) & c_flag;
 		flags |= (((temp & 0x0FFF) - (prev & 0x0FFF)) >> 7) & h_flag;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x86: // ADD (HL)
+	OPCODE( 0x86 ) // ADD (HL)
 		data = READ( rp.hl );
 		goto add_comm;
 	
-	case 0x80: // ADD B
-	case 0x81: // ADD C
-	case 0x82: // ADD D
-	case 0x83: // ADD E
-	case 0x84: // ADD H
-	case 0x85: // ADD L
-	case 0x87: // ADD A
+	OPCODE( 0x80 ) // ADD B
+	OPCODE( 0x81 ) // ADD C
+	OPCODE( 0x82 ) // ADD D
+	OPCODE( 0x83 ) // ADD E
+	OPCODE( 0x84 ) // ADD H
+	OPCODE( 0x85 ) // ADD L
+	OPCODE( 0x87 ) // ADD A
 		data = R8( op & 7 );
 		goto add_comm;
 	
-	case 0xC6: // ADD IMM
+	OPCODE( 0xC6 ) // ADD IMM
 		pc++;
 	add_comm:
 		flags = rg.a;
@@ -741,48 +759,48 @@ loop:
 		flags |= (data >> 4) & c_flag;
 		rg.a = data;
 		if ( data & 0xFF )
-			goto loop;
+			NEXT_INSTR();
 		flags |= z_flag;
-		goto loop;
+		NEXT_INSTR();
 
 // Add/Subtract
 
-	case 0x8E: // ADC (HL)
+	OPCODE( 0x8E ) // ADC (HL)
 		data = READ( rp.hl );
 		goto adc_comm;
 	
-	case 0x88: // ADC B
-	case 0x89: // ADC C
-	case 0x8A: // ADC D
-	case 0x8B: // ADC E
-	case 0x8C: // ADC H
-	case 0x8D: // ADC L
-	case 0x8F: // ADC A
+	OPCODE( 0x88 ) // ADC B
+	OPCODE( 0x89 ) // ADC C
+	OPCODE( 0x8A ) // ADC D
+	OPCODE( 0x8B ) // ADC E
+	OPCODE( 0x8C ) // ADC H
+	OPCODE( 0x8D ) // ADC L
+	OPCODE( 0x8F ) // ADC A
 		data = R8( op & 7 );
 		goto adc_comm;
 	
-	case 0xCE: // ADC IMM
+	OPCODE( 0xCE ) // ADC IMM
 		pc++;
 	adc_comm:
 		data += (flags >> 4) & 1;
 		data &= 0xFF; // to do: does carry get set when sum + carry = 0x100?
 		goto add_comm;
 
-	case 0x96: // SUB (HL)
+	OPCODE( 0x96 ) // SUB (HL)
 		data = READ( rp.hl );
 		goto sub_comm;
 	
-	case 0x90: // SUB B
-	case 0x91: // SUB C
-	case 0x92: // SUB D
-	case 0x93: // SUB E
-	case 0x94: // SUB H
-	case 0x95: // SUB L
-	case 0x97: // SUB A
+	OPCODE( 0x90 ) // SUB B
+	OPCODE( 0x91 ) // SUB C
+	OPCODE( 0x92 ) // SUB D
+	OPCODE( 0x93 ) // SUB E
+	OPCODE( 0x94 ) // SUB H
+	OPCODE( 0x95 ) // SUB L
+	OPCODE( 0x97 ) // SUB A
 		data = R8( op & 7 );
 		goto sub_comm;
 	
-	case 0xD6: // SUB IMM
+	OPCODE( 0xD6 ) // SUB IMM
 		pc++;
 	sub_comm:
 		op = rg.a;
@@ -790,21 +808,21 @@ loop:
 		rg.a = data;
 		goto sub_set_flags;
 
-	case 0x9E: // SBC (HL)
+	OPCODE( 0x9E ) // SBC (HL)
 		data = READ( rp.hl );
 		goto sbc_comm;
 	
-	case 0x98: // SBC B
-	case 0x99: // SBC C
-	case 0x9A: // SBC D
-	case 0x9B: // SBC E
-	case 0x9C: // SBC H
-	case 0x9D: // SBC L
-	case 0x9F: // SBC A
+	OPCODE( 0x98 ) // SBC B
+	OPCODE( 0x99 ) // SBC C
+	OPCODE( 0x9A ) // SBC D
+	OPCODE( 0x9B ) // SBC E
+	OPCODE( 0x9C ) // SBC H
+	OPCODE( 0x9D ) // SBC L
+	OPCODE( 0x9F ) // SBC A
 		data = R8( op & 7 );
 		goto sbc_comm;
 	
-	case 0xDE: // SBC IMM
+	OPCODE( 0xDE ) // SBC IMM
 		pc++;
 	sbc_comm:
 		data += (flags >> 4) & 1;
@@ -813,226 +831,226 @@ loop:
 
 // Logical
 
-	case 0xA0: // AND B
-	case 0xA1: // AND C
-	case 0xA2: // AND D
-	case 0xA3: // AND E
-	case 0xA4: // AND H
-	case 0xA5: // AND L
+	OPCODE( 0xA0 ) // AND B
+	OPCODE( 0xA1 ) // AND C
+	OPCODE( 0xA2 ) // AND D
+	OPCODE( 0xA3 ) // AND E
+	OPCODE( 0xA4 ) // AND H
+	OPCODE( 0xA5 ) // AND L
 		data = R8( op & 7 );
 		goto and_comm;
 	
-	case 0xA6: // AND (HL)
+	OPCODE( 0xA6 ) // AND (HL)
 		data = READ( rp.hl );
 		pc--;
-	case 0xE6: // AND IMM
+	OPCODE( 0xE6 ) // AND IMM
 		pc++;
 	and_comm:
 		rg.a &= data;
-	case 0xA7: // AND A
+	OPCODE( 0xA7 ) // AND A
 		flags = h_flag | (((rg.a - 1) >> 1) & z_flag);
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xB0: // OR B
-	case 0xB1: // OR C
-	case 0xB2: // OR D
-	case 0xB3: // OR E
-	case 0xB4: // OR H
-	case 0xB5: // OR L
+	OPCODE( 0xB0 ) // OR B
+	OPCODE( 0xB1 ) // OR C
+	OPCODE( 0xB2 ) // OR D
+	OPCODE( 0xB3 ) // OR E
+	OPCODE( 0xB4 ) // OR H
+	OPCODE( 0xB5 ) // OR L
 		data = R8( op & 7 );
 		goto or_comm;
 	
-	case 0xB6: // OR (HL)
+	OPCODE( 0xB6 ) // OR (HL)
 		data = READ( rp.hl );
 		pc--;
-	case 0xF6: // OR IMM
+	OPCODE( 0xF6 ) // OR IMM
 		pc++;
 	or_comm:
 		rg.a |= data;
-	case 0xB7: // OR A
+	OPCODE( 0xB7 ) // OR A
 		flags = ((rg.a - 1) >> 1) & z_flag;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xA8: // XOR B
-	case 0xA9: // XOR C
-	case 0xAA: // XOR D
-	case 0xAB: // XOR E
-	case 0xAC: // XOR H
-	case 0xAD: // XOR L
+	OPCODE( 0xA8 ) // XOR B
+	OPCODE( 0xA9 ) // XOR C
+	OPCODE( 0xAA ) // XOR D
+	OPCODE( 0xAB ) // XOR E
+	OPCODE( 0xAC ) // XOR H
+	OPCODE( 0xAD ) // XOR L
 		data = R8( op & 7 );
 		goto xor_comm;
 	
-	case 0xAE: // XOR (HL)
+	OPCODE( 0xAE ) // XOR (HL)
 		data = READ( rp.hl );
 		pc--;
-	case 0xEE: // XOR IMM
+	OPCODE( 0xEE ) // XOR IMM
 		pc++;
 	xor_comm:
 		data ^= rg.a;
 		rg.a = data;
 		data--;
 		flags = (data >> 1) & z_flag;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xAF: // XOR A
+	OPCODE( 0xAF ) // XOR A
 		rg.a = 0;
 		flags = z_flag;
-		goto loop;
+		NEXT_INSTR();
 
 // Stack
 
-	case 0xF1: // POP FA
-	case 0xC1: // POP BC
-	case 0xD1: // POP DE
-	case 0xE1: // POP HL (common)
+	OPCODE( 0xF1 ) // POP FA
+	OPCODE( 0xC1 ) // POP BC
+	OPCODE( 0xD1 ) // POP DE
+	OPCODE( 0xE1 ) // POP HL (common)
 		data = READ( sp );
 		r16 [(op >> 4) & 3] = data + 0x100 * READ( sp + 1 );
 		sp = (sp + 2) & 0xFFFF;
 		if ( op != 0xF1 )
-			goto loop;
+			NEXT_INSTR();
 		flags = rg.flags & 0xF0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xC5: // PUSH BC
+	OPCODE( 0xC5 ) // PUSH BC
 		data = rp.bc;
 		goto push;
 	
-	case 0xD5: // PUSH DE
+	OPCODE( 0xD5 ) // PUSH DE
 		data = rp.de;
 		goto push;
 	
-	case 0xE5: // PUSH HL
+	OPCODE( 0xE5 ) // PUSH HL
 		data = rp.hl;
 		goto push;
 	
-	case 0xF5: // PUSH FA
+	OPCODE( 0xF5 ) // PUSH FA
 		data = (flags << 8) | rg.a;
 		goto push;
 
 // Flow control
 	
-	case 0xFF:
+	OPCODE( 0xFF )
 		if ( pc == idle_addr + 1 )
 			goto stop;
-	case 0xC7: case 0xCF: case 0xD7: case 0xDF:  // RST
-	case 0xE7: case 0xEF: case 0xF7:
+	OPCODE( 0xC7 ) OPCODE( 0xCF ) OPCODE( 0xD7 ) OPCODE( 0xDF )  // RST
+	OPCODE( 0xE7 ) OPCODE( 0xEF ) OPCODE( 0xF7 )
 		data = pc;
 		pc = (op & 0x38) + rst_base;
 		goto push;
 	
-	case 0xCC: // CZ
+	OPCODE( 0xCC ) // CZ
 		pc += 2;
 		if ( flags & z_flag )
 			goto call;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD4: // CNC
+	OPCODE( 0xD4 ) // CNC
 		pc += 2;
 		if ( !(flags & c_flag) )
 			goto call;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xDC: // CC
+	OPCODE( 0xDC ) // CC
 		pc += 2;
 		if ( flags & c_flag )
 			goto call;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xD9: // RETI
+	OPCODE( 0xD9 ) // RETI
 		//interrupts_enabled = 1;
 		goto ret;
 	
-	case 0xC0: // RZ
+	OPCODE( 0xC0 ) // RZ
 		if ( !(flags & z_flag) )
 			goto ret;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD0: // RNC
+	OPCODE( 0xD0 ) // RNC
 		if ( !(flags & c_flag) )
 			goto ret;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD8: // RC
+	OPCODE( 0xD8 ) // RC
 		if ( flags & c_flag )
 			goto ret;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x18: // JR
+	OPCODE( 0x18 ) // JR
 		BRANCH( true )
 	
-	case 0x30: // JR NC
+	OPCODE( 0x30 ) // JR NC
 		BRANCH( !(flags & c_flag) )
 	
-	case 0x38: // JR C
+	OPCODE( 0x38 ) // JR C
 		BRANCH( flags & c_flag )
 	
-	case 0xE9: // JP_HL
+	OPCODE( 0xE9 ) // JP_HL
 		pc = rp.hl;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xC3: // JP (next-most-common)
+	OPCODE( 0xC3 ) // JP (next-most-common)
 		pc = GET_ADDR();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xC2: // JP NZ
+	OPCODE( 0xC2 ) // JP NZ
 		pc += 2;
 		if ( !(flags & z_flag) )
 			goto jp_taken;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xCA: // JP Z (most common)
+	OPCODE( 0xCA ) // JP Z (most common)
 		pc += 2;
 		if ( !(flags & z_flag) )
-			goto loop;
+			NEXT_INSTR();
 	jp_taken:
 		pc -= 2;
 		pc = GET_ADDR();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD2: // JP NC
+	OPCODE( 0xD2 ) // JP NC
 		pc += 2;
 		if ( !(flags & c_flag) )
 			goto jp_taken;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xDA: // JP C
+	OPCODE( 0xDA ) // JP C
 		pc += 2;
 		if ( flags & c_flag )
 			goto jp_taken;
-		goto loop;
+		NEXT_INSTR();
 
 // Flags
 
-	case 0x2F: // CPL
+	OPCODE( 0x2F ) // CPL
 		rg.a = ~rg.a;
 		flags |= n_flag | h_flag;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x3F: // CCF
+	OPCODE( 0x3F ) // CCF
 		flags = (flags ^ c_flag) & ~(n_flag | h_flag);
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x37: // SCF
+	OPCODE( 0x37 ) // SCF
 		flags = (flags | c_flag) & ~(n_flag | h_flag);
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xF3: // DI
+	OPCODE( 0xF3 ) // DI
 		//interrupts_enabled = 0;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xFB: // EI
+	OPCODE( 0xFB ) // EI
 		//interrupts_enabled = 1;
-		goto loop;
+		NEXT_INSTR();
 
 // Special
 
-	case 0xDD: case 0xD3: case 0xDB: case 0xE3: case 0xE4: // ?
-	case 0xEB: case 0xEC: case 0xF4: case 0xFD: case 0xFC:
-	case 0x10: // STOP
-	case 0x27: // DAA (I'll have to implement this eventually...)
-	case 0xBF:
-	case 0xED: // Z80 prefix
-	case 0x76: // HALT
+	OPCODE( 0xDD ) OPCODE( 0xD3 ) OPCODE( 0xDB ) OPCODE( 0xE3 ) OPCODE( 0xE4 ) // ?
+	OPCODE( 0xEB ) OPCODE( 0xEC ) OPCODE( 0xF4 ) OPCODE( 0xFD ) OPCODE( 0xFC )
+	OPCODE( 0x10 ) // STOP
+	OPCODE( 0x27 ) // DAA (I'll have to implement this eventually...)
+	OPCODE( 0xBF )
+	OPCODE( 0xED ) // Z80 prefix
+	OPCODE( 0x76 ) // HALT
 		s.remain++;
 		goto stop;
 	}
@@ -47,7 +47,7 @@ Gbs_Emu::~Gbs_Emu() { }
 
 void Gbs_Emu::unload()
 {
-	rom.clear();
+	// rom is kept so that loading another file can reuse it
 	Music_Emu::unload();
 }
 
@@ -178,6 +178,14 @@ blargg_err_t Gym_Emu::set_sample_rate_( long sample_rate )
 	
 	RETURN_ERR( blip_buf.set_sample_rate( sample_rate, int (1000 / 60.0 / min_tempo) ) );
 	blip_buf.clock_rate( clock_rate );
+	if ( stems_enabled() )
+	{
+		for ( int i = 0; i < 2; i++ )
+		{
+			RETURN_ERR( stem_blip_bufs [i].set_sample_rate( sample_rate, int (1000 / 60.0 / min_tempo) ) );
+			stem_blip_bufs [i].clock_rate( clock_rate );
+		}
+	}
 	
 	RETURN_ERR( fm.set_rate( fm_sample_rate, base_clock / 7.0 ) );
 	RETURN_ERR( Dual_Resampler::reset( long (1.0 / 60 / min_tempo * sample_rate) ) );
@@ -185,6 +193,11 @@ blargg_err_t Gym_Emu::set_sample_rate_( long sample_rate )
 	return 0;
 }
 
+blargg_err_t Gym_Emu::enable_stems_()
+{
+	return Dual_Resampler::enable_stems( Ym2612_Emu::channel_count, stem_blip_bufs, 2 );
+}
+
 void Gym_Emu::set_tempo_( double t )
 {
 	if ( t < min_tempo )
@@ -205,7 +218,7 @@ void Gym_Emu::mute_voices_( int mask )
 	Music_Emu::mute_voices_( mask );
 	fm.mute_voices( mask );
 	dac_muted = (mask & 0x40) != 0;
-	apu.output( (mask & 0x80) ? 0 : &blip_buf );
+	apu.output( (mask & 0x80) ? 0 : psg_buf() );
 }
 
 blargg_err_t Gym_Emu::load_mem_( byte const* in, long size )
@@ -243,6 +256,8 @@ blargg_err_t Gym_Emu::start_track_( int track )
 	fm.reset();
 	apu.reset();
 	blip_buf.clear();
+	stem_blip_bufs [0].clear();
+	stem_blip_bufs [1].clear();
 	Dual_Resampler::clear();
 	return 0;
 }
@@ -291,7 +306,7 @@ void Gym_Emu::run_dac( int dac_count )
 	{
 		int delta = dac_buf [i] - dac_amp;
 		dac_amp += delta;
-		dac_synth.offset_resampled( time, delta, &blip_buf );
+		dac_synth.offset_resampled( time, delta, pcm_buf() );
 		time += period;
 	}
 	this->dac_amp = dac_amp;
@@ -368,13 +383,25 @@ int Gym_Emu::play_frame( blip_time_t blip_time, int sample_count, sample_t* buf
 	apu.end_frame( blip_time );
 	
 	memset( buf, 0, sample_count * sizeof *buf );
-	fm.run( sample_count >> 1, buf );
+	if ( stems_enabled() )
+	{
+		sample_t* fm_out [Ym2612_Emu::channel_count];
+		for ( int i = 0; i < Ym2612_Emu::channel_count; i++ )
+			fm_out [i] = stem_pcm_out( i );
+		fm.set_voice_outputs( fm_out );
+		fm.run( sample_count >> 1, buf );
+		fm.set_voice_outputs( NULL );
+	}
+	else
+	{
+		fm.run( sample_count >> 1, buf );
+	}
 	
 	return sample_count;
 }
 
 blargg_err_t Gym_Emu::play_( long count, sample_t* out )
 {
-	Dual_Resampler::dual_play( count, out, blip_buf );
+	Dual_Resampler::dual_play( count, out, blip_buf, stem_out(), stem_stride() );
 	return 0;
 }
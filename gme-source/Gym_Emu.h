@@ -52,6 +52,7 @@ protected:
 	void mute_voices_( int );
 	void set_tempo_( double );
 	int play_frame( blip_time_t blip_time, int sample_count, sample_t* buf );
+	blargg_err_t enable_stems_();
 private:
 	// sequence data begin, loop begin, current position, end
 	const byte* data;
@@ -76,6 +77,11 @@ private:
 	Ym2612_Emu fm;
 	Blip_Synth<blip_med_quality,1> dac_synth;
 	Sms_Apu apu;
+	
+	// PCM and PSG voices get their own buffers when stems are enabled
+	Blip_Buffer stem_blip_bufs [2];
+	Blip_Buffer* pcm_buf() { return stems_enabled() ? &stem_blip_bufs [0] : &blip_buf; }
+	Blip_Buffer* psg_buf() { return stems_enabled() ? &stem_blip_bufs [1] : &blip_buf; }
 	byte dac_buf [1024];
 };
 
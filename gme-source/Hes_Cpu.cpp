@@ -3,6 +3,7 @@
 #include "Hes_Cpu.h"
 
 #include "blargg_endian.h"
+#include "blargg_dispatch.h"
 
 //#include "hes_cpu_log.h"
 
@@ -134,9 +135,6 @@ bool Hes_Cpu::run( hes_time_t end_time )
 		SET_STATUS( temp );
 	}
 	
-	goto loop;
-branch_not_taken:
-	s_time -= 2;
 loop:
 	
 	#ifndef NDEBUG
@@ -207,7 +205,7 @@ almost_out_of_time:
 		//log_opcode( opcode );
 	#endif
 	
-	switch ( opcode )
+	OPCODE_SWITCH( opcode )
 	{
 possibly_out_of_time:
 		if ( s_time < (int) data )
@@ -217,6 +215,23 @@ possibly_out_of_time:
 
 // Macros
 
+// With computed goto, each opcode fetches and dispatches the next one the same way
+// loop does, rather than all of them sharing the indirect jump at loop
+#if BLARGG_COMPUTED_GOTO && !defined (HES_CPU_LOG_H)
+	#define NEXT_INSTR() do {\
+		instr = s.code_map [pc >> page_shift] + PAGE_OFFSET( pc );\
+		opcode = *instr++;\
+		pc++;\
+		data = clock_table [opcode];\
+		if ( (s_time += data) >= 0 )\
+			goto possibly_out_of_time;\
+		data = *instr;\
+		OPCODE_DISPATCH( opcode );\
+	} while ( 0 )
+#else
+	#define NEXT_INSTR() goto loop
+#endif
+
 #define GET_MSB()           (instr [1])
 #define ADD_PAGE( out )     (pc++, out = data + 0x100 * GET_MSB());
 #define GET_ADDR()          GET_LE16( instr )
@@ -232,57 +247,57 @@ possibly_out_of_time:
 {\
 	fint16 offset = (BOOST::int8_t) data;\
 	pc++;\
-	if ( !(cond) ) goto branch_not_taken;\
+	if ( !(cond) ) { s_time -= 2; NEXT_INSTR(); }\
 	pc = BOOST::uint16_t (pc + offset);\
-	goto loop;\
+	NEXT_INSTR();\
 }
 
-	case 0xF0: // BEQ
+	OPCODE( 0xF0 ) // BEQ
 		BRANCH( !((uint8_t) nz) );
 	
-	case 0xD0: // BNE
+	OPCODE( 0xD0 ) // BNE
 		BRANCH( (uint8_t) nz );
 	
-	case 0x10: // BPL
+	OPCODE( 0x10 ) // BPL
 		BRANCH( !IS_NEG );
 	
-	case 0x90: // BCC
+	OPCODE( 0x90 ) // BCC
 		BRANCH( !(c & 0x100) )
 	
-	case 0x30: // BMI
+	OPCODE( 0x30 ) // BMI
 		BRANCH( IS_NEG )
 	
-	case 0x50: // BVC
+	OPCODE( 0x50 ) // BVC
 		BRANCH( !(status & st_v) )
 	
-	case 0x70: // BVS
+	OPCODE( 0x70 ) // BVS
 		BRANCH( status & st_v )
 	
-	case 0xB0: // BCS
+	OPCODE( 0xB0 ) // BCS
 		BRANCH( c & 0x100 )
 	
-	case 0x80: // BRA
+	OPCODE( 0x80 ) // BRA
 	branch_taken:
 		BRANCH( true );
 	
-	case 0xFF:
+	OPCODE( 0xFF )
 		if ( pc == idle_addr + 1 )
 			goto idle_done;
-	case 0x0F: // BBRn
-	case 0x1F:
-	case 0x2F:
-	case 0x3F:
-	case 0x4F:
-	case 0x5F:
-	case 0x6F:
-	case 0x7F:
-	case 0x8F: // BBSn
-	case 0x9F:
-	case 0xAF:
-	case 0xBF:
-	case 0xCF:
-	case 0xDF:
-	case 0xEF: {
+	OPCODE( 0x0F ) // BBRn
+	OPCODE( 0x1F )
+	OPCODE( 0x2F )
+	OPCODE( 0x3F )
+	OPCODE( 0x4F )
+	OPCODE( 0x5F )
+	OPCODE( 0x6F )
+	OPCODE( 0x7F )
+	OPCODE( 0x8F ) // BBSn
+	OPCODE( 0x9F )
+	OPCODE( 0xAF )
+	OPCODE( 0xBF )
+	OPCODE( 0xCF )
+	OPCODE( 0xDF )
+	OPCODE( 0xEF ) {
 		fuint16 t = 0x101 * READ_LOW( data );
 		t ^= 0xFF;
 		pc++;
@@ -290,165 +305,165 @@ possibly_out_of_time:
 		BRANCH( t & (1 << (opcode >> 4)) )
 	}
 	
-	case 0x4C: // JMP abs
+	OPCODE( 0x4C ) // JMP abs
 		pc = GET_ADDR();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x7C: // JMP (ind+X)
+	OPCODE( 0x7C ) // JMP (ind+X)
 		data += x;
-	case 0x6C:{// JMP (ind)
+	OPCODE( 0x6C ){// JMP (ind)
 		data += 0x100 * GET_MSB();
 		pc = GET_LE16( &READ_PROG( data ) );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Subroutine
 
-	case 0x44: // BSR
+	OPCODE( 0x44 ) // BSR
 		WRITE_LOW( 0x100 | (sp - 1), pc >> 8 );
 		sp = (sp - 2) | 0x100;
 		WRITE_LOW( sp, pc );
 		goto branch_taken;
 	
-	case 0x20: { // JSR
+	OPCODE( 0x20 ) { // JSR
 		fuint16 temp = pc + 1;
 		pc = GET_ADDR();
 		WRITE_LOW( 0x100 | (sp - 1), temp >> 8 );
 		sp = (sp - 2) | 0x100;
 		WRITE_LOW( sp, temp );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x60: // RTS
+	OPCODE( 0x60 ) // RTS
 		pc = 0x100 * READ_LOW( 0x100 | (sp - 0xFF) );
 		pc += 1 + READ_LOW( sp );
 		sp = (sp - 0xFE) | 0x100;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x00: // BRK
+	OPCODE( 0x00 ) // BRK
 		goto handle_brk;
 	
 // Common
 
-	case 0xBD:{// LDA abs,X
+	OPCODE( 0xBD ){// LDA abs,X
 		PAGE_CROSS_PENALTY( data + x );
 		fuint16 addr = GET_ADDR() + x;
 		pc += 2;
 		CPU_READ_FAST( this, addr, TIME, nz );
 		a = nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x9D:{// STA abs,X
+	OPCODE( 0x9D ){// STA abs,X
 		fuint16 addr = GET_ADDR() + x;
 		pc += 2;
 		CPU_WRITE_FAST( this, addr, a, TIME );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x95: // STA zp,x
+	OPCODE( 0x95 ) // STA zp,x
 		data = uint8_t (data + x);
-	case 0x85: // STA zp
+	OPCODE( 0x85 ) // STA zp
 		pc++;
 		WRITE_LOW( data, a );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xAE:{// LDX abs
+	OPCODE( 0xAE ){// LDX abs
 		fuint16 addr = GET_ADDR();
 		pc += 2;
 		CPU_READ_FAST( this, addr, TIME, nz );
 		x = nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xA5: // LDA zp
+	OPCODE( 0xA5 ) // LDA zp
 		a = nz = READ_LOW( data );
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
 // Load/store
 	
 	{
 		fuint16 addr;
-	case 0x91: // STA (ind),Y
+	OPCODE( 0x91 ) // STA (ind),Y
 		addr = 0x100 * READ_LOW( uint8_t (data + 1) );
 		addr += READ_LOW( data ) + y;
 		pc++;
 		goto sta_ptr;
 	
-	case 0x81: // STA (ind,X)
+	OPCODE( 0x81 ) // STA (ind,X)
 		data = uint8_t (data + x);
-	case 0x92: // STA (ind)
+	OPCODE( 0x92 ) // STA (ind)
 		addr = 0x100 * READ_LOW( uint8_t (data + 1) );
 		addr += READ_LOW( data );
 		pc++;
 		goto sta_ptr;
 	
-	case 0x99: // STA abs,Y
+	OPCODE( 0x99 ) // STA abs,Y
 		data += y;
-	case 0x8D: // STA abs
+	OPCODE( 0x8D ) // STA abs
 		addr = data + 0x100 * GET_MSB();
 		pc += 2;
 	sta_ptr:
 		CPU_WRITE_FAST( this, addr, a, TIME );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 	{
 		fuint16 addr;
-	case 0xA1: // LDA (ind,X)
+	OPCODE( 0xA1 ) // LDA (ind,X)
 		data = uint8_t (data + x);
-	case 0xB2: // LDA (ind)
+	OPCODE( 0xB2 ) // LDA (ind)
 		addr = 0x100 * READ_LOW( uint8_t (data + 1) );
 		addr += READ_LOW( data );
 		pc++;
 		goto a_nz_read_addr;
 	
-	case 0xB1:// LDA (ind),Y
+	OPCODE( 0xB1 )// LDA (ind),Y
 		addr = READ_LOW( data ) + y;
 		PAGE_CROSS_PENALTY( addr );
 		addr += 0x100 * READ_LOW( (uint8_t) (data + 1) );
 		pc++;
 		goto a_nz_read_addr;
 	
-	case 0xB9: // LDA abs,Y
+	OPCODE( 0xB9 ) // LDA abs,Y
 		data += y;
 		PAGE_CROSS_PENALTY( data );
-	case 0xAD: // LDA abs
+	OPCODE( 0xAD ) // LDA abs
 		addr = data + 0x100 * GET_MSB();
 		pc += 2;
 	a_nz_read_addr:
 		CPU_READ_FAST( this, addr, TIME, nz );
 		a = nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 
-	case 0xBE:{// LDX abs,y
+	OPCODE( 0xBE ){// LDX abs,y
 		PAGE_CROSS_PENALTY( data + y );
 		fuint16 addr = GET_ADDR() + y;
 		pc += 2;
 		FLUSH_TIME();
 		x = nz = READ( addr );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xB5: // LDA zp,x
+	OPCODE( 0xB5 ) // LDA zp,x
 		a = nz = READ_LOW( uint8_t (data + x) );
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xA9: // LDA #imm
+	OPCODE( 0xA9 ) // LDA #imm
 		pc++;
 		a  = data;
 		nz = data;
-		goto loop;
+		NEXT_INSTR();
 
 // Bit operations
 
-	case 0x3C: // BIT abs,x
+	OPCODE( 0x3C ) // BIT abs,x
 		data += x;
-	case 0x2C:{// BIT abs
+	OPCODE( 0x2C ){// BIT abs
 		fuint16 addr;
 		ADD_PAGE( addr );
 		FLUSH_TIME();
@@ -456,29 +471,29 @@ possibly_out_of_time:
 		CACHE_TIME();
 		goto bit_common;
 	}
-	case 0x34: // BIT zp,x
+	OPCODE( 0x34 ) // BIT zp,x
 		data = uint8_t (data + x);
-	case 0x24: // BIT zp
+	OPCODE( 0x24 ) // BIT zp
 		data = READ_LOW( data );
-	case 0x89: // BIT imm
+	OPCODE( 0x89 ) // BIT imm
 		nz = data;
 	bit_common:
 		pc++;
 		status &= ~st_v;
 		status |= nz & st_v;
 		if ( nz & a )
-			goto loop; // Z should be clear, and nz must be non-zero if nz & a is
+			NEXT_INSTR(); // Z should be clear, and nz must be non-zero if nz & a is
 		nz <<= 8; // set Z flag without affecting N flag
-		goto loop;
+		NEXT_INSTR();
 		
 	{
 		fuint16 addr;
 		
-	case 0xB3: // TST abs,x
+	OPCODE( 0xB3 ) // TST abs,x
 		addr = GET_MSB() + x;
 		goto tst_abs;
 	
-	case 0x93: // TST abs
+	OPCODE( 0x93 ) // TST abs
 		addr = GET_MSB();
 	tst_abs:
 		addr += 0x100 * instr [2];
@@ -489,32 +504,32 @@ possibly_out_of_time:
 		goto tst_common;
 	}
 	
-	case 0xA3: // TST zp,x
+	OPCODE( 0xA3 ) // TST zp,x
 		nz = READ_LOW( uint8_t (GET_MSB() + x) );
 		goto tst_common;
 	
-	case 0x83: // TST zp
+	OPCODE( 0x83 ) // TST zp
 		nz = READ_LOW( GET_MSB() );
 	tst_common:
 		pc += 2;
 		status &= ~st_v;
 		status |= nz & st_v;
 		if ( nz & data )
-			goto loop; // Z should be clear, and nz must be non-zero if nz & data is
+			NEXT_INSTR(); // Z should be clear, and nz must be non-zero if nz & data is
 		nz <<= 8; // set Z flag without affecting N flag
-		goto loop;
+		NEXT_INSTR();
 	
 	{
 		fuint16 addr;
-	case 0x0C: // TSB abs
-	case 0x1C: // TRB abs
+	OPCODE( 0x0C ) // TSB abs
+	OPCODE( 0x1C ) // TRB abs
 		addr = GET_ADDR();
 		pc++;
 		goto txb_addr;
 	
 	// TODO: everyone lists different behaviors for the status flags, ugh
-	case 0x04: // TSB zp
-	case 0x14: // TRB zp
+	OPCODE( 0x04 ) // TSB zp
+	OPCODE( 0x14 ) // TRB zp
 		addr = data + ram_addr;
 	txb_addr:
 		FLUSH_TIME();
@@ -526,105 +541,105 @@ possibly_out_of_time:
 		pc++;
 		WRITE( addr, nz );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x07: // RMBn
-	case 0x17:
-	case 0x27:
-	case 0x37:
-	case 0x47:
-	case 0x57:
-	case 0x67:
-	case 0x77:
+	OPCODE( 0x07 ) // RMBn
+	OPCODE( 0x17 )
+	OPCODE( 0x27 )
+	OPCODE( 0x37 )
+	OPCODE( 0x47 )
+	OPCODE( 0x57 )
+	OPCODE( 0x67 )
+	OPCODE( 0x77 )
 		pc++;
 		READ_LOW( data ) &= ~(1 << (opcode >> 4));
-		goto loop;
-	
-	case 0x87: // SMBn
-	case 0x97:
-	case 0xA7:
-	case 0xB7:
-	case 0xC7:
-	case 0xD7:
-	case 0xE7:
-	case 0xF7:
+		NEXT_INSTR();
+	
+	OPCODE( 0x87 ) // SMBn
+	OPCODE( 0x97 )
+	OPCODE( 0xA7 )
+	OPCODE( 0xB7 )
+	OPCODE( 0xC7 )
+	OPCODE( 0xD7 )
+	OPCODE( 0xE7 )
+	OPCODE( 0xF7 )
 		pc++;
 		READ_LOW( data ) |= 1 << ((opcode >> 4) - 8);
-		goto loop;
+		NEXT_INSTR();
 	
 // Load/store
 	
-	case 0x9E: // STZ abs,x
+	OPCODE( 0x9E ) // STZ abs,x
 		data += x;
-	case 0x9C: // STZ abs
+	OPCODE( 0x9C ) // STZ abs
 		ADD_PAGE( data );
 		pc++;
 		FLUSH_TIME();
 		WRITE( data, 0 );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x74: // STZ zp,x
+	OPCODE( 0x74 ) // STZ zp,x
 		data = uint8_t (data + x);
-	case 0x64: // STZ zp
+	OPCODE( 0x64 ) // STZ zp
 		pc++;
 		WRITE_LOW( data, 0 );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x94: // STY zp,x
+	OPCODE( 0x94 ) // STY zp,x
 		data = uint8_t (data + x);
-	case 0x84: // STY zp
+	OPCODE( 0x84 ) // STY zp
 		pc++;
 		WRITE_LOW( data, y );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x96: // STX zp,y
+	OPCODE( 0x96 ) // STX zp,y
 		data = uint8_t (data + y);
-	case 0x86: // STX zp
+	OPCODE( 0x86 ) // STX zp
 		pc++;
 		WRITE_LOW( data, x );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xB6: // LDX zp,y
+	OPCODE( 0xB6 ) // LDX zp,y
 		data = uint8_t (data + y);
-	case 0xA6: // LDX zp
+	OPCODE( 0xA6 ) // LDX zp
 		data = READ_LOW( data );
-	case 0xA2: // LDX #imm
+	OPCODE( 0xA2 ) // LDX #imm
 		pc++;
 		x = data;
 		nz = data;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xB4: // LDY zp,x
+	OPCODE( 0xB4 ) // LDY zp,x
 		data = uint8_t (data + x);
-	case 0xA4: // LDY zp
+	OPCODE( 0xA4 ) // LDY zp
 		data = READ_LOW( data );
-	case 0xA0: // LDY #imm
+	OPCODE( 0xA0 ) // LDY #imm
 		pc++;
 		y = data;
 		nz = data;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xBC: // LDY abs,X
+	OPCODE( 0xBC ) // LDY abs,X
 		data += x;
 		PAGE_CROSS_PENALTY( data );
-	case 0xAC:{// LDY abs
+	OPCODE( 0xAC ){// LDY abs
 		fuint16 addr = data + 0x100 * GET_MSB();
 		pc += 2;
 		FLUSH_TIME();
 		y = nz = READ( addr );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 	{
 		fuint8 temp;
-	case 0x8C: // STY abs
+	OPCODE( 0x8C ) // STY abs
 		temp = y;
 		goto store_abs;
 	
-	case 0x8E: // STX abs
+	OPCODE( 0x8E ) // STX abs
 		temp = x;
 	store_abs:
 		fuint16 addr = GET_ADDR();
@@ -632,12 +647,12 @@ possibly_out_of_time:
 		FLUSH_TIME();
 		WRITE( addr, temp );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 
 // Compare
 
-	case 0xEC:{// CPX abs
+	OPCODE( 0xEC ){// CPX abs
 		fuint16 addr = GET_ADDR();
 		pc++;
 		FLUSH_TIME();
@@ -646,17 +661,17 @@ possibly_out_of_time:
 		goto cpx_data;
 	}
 	
-	case 0xE4: // CPX zp
+	OPCODE( 0xE4 ) // CPX zp
 		data = READ_LOW( data );
-	case 0xE0: // CPX #imm
+	OPCODE( 0xE0 ) // CPX #imm
 	cpx_data:
 		nz = x - data;
 		pc++;
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xCC:{// CPY abs
+	OPCODE( 0xCC ){// CPY abs
 		fuint16 addr = GET_ADDR();
 		pc++;
 		FLUSH_TIME();
@@ -665,80 +680,81 @@ possibly_out_of_time:
 		goto cpy_data;
 	}
 	
-	case 0xC4: // CPY zp
+	OPCODE( 0xC4 ) // CPY zp
 		data = READ_LOW( data );
-	case 0xC0: // CPY #imm
+	OPCODE( 0xC0 ) // CPY #imm
 	cpy_data:
 		nz = y - data;
 		pc++;
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_INSTR();
 	
 // Logical
 
-#define ARITH_ADDR_MODES( op )\
-	case op - 0x04: /* (ind,x) */\
+// Opcodes are listed in the order op (zp), (ind,x), (ind), (ind),y, zp,X, abs,Y, abs,X, abs, imm
+#define ARITH_ADDR_MODES( op, ind_x, zp_ind, ind_y, zp_x, abs_y, abs_x, abs, immed )\
+	OPCODE( ind_x ) /* (ind,x) */\
 		data = uint8_t (data + x);\
-	case op + 0x0D: /* (ind) */\
+	OPCODE( zp_ind ) /* (ind) */\
 		data = 0x100 * READ_LOW( uint8_t (data + 1) ) + READ_LOW( data );\
 		goto ptr##op;\
-	case op + 0x0C:{/* (ind),y */\
+	OPCODE( ind_y ){/* (ind),y */\
 		fuint16 temp = READ_LOW( data ) + y;\
 		PAGE_CROSS_PENALTY( temp );\
 		data = temp + 0x100 * READ_LOW( uint8_t (data + 1) );\
 		goto ptr##op;\
 	}\
-	case op + 0x10: /* zp,X */\
+	OPCODE( zp_x ) /* zp,X */\
 		data = uint8_t (data + x);\
-	case op + 0x00: /* zp */\
+	OPCODE( op ) /* zp */\
 		data = READ_LOW( data );\
 		goto imm##op;\
-	case op + 0x14: /* abs,Y */\
+	OPCODE( abs_y ) /* abs,Y */\
 		data += y;\
 		goto ind##op;\
-	case op + 0x18: /* abs,X */\
+	OPCODE( abs_x ) /* abs,X */\
 		data += x;\
 	ind##op:\
 		PAGE_CROSS_PENALTY( data );\
-	case op + 0x08: /* abs */\
+	OPCODE( abs ) /* abs */\
 		ADD_PAGE( data );\
 	ptr##op:\
 		FLUSH_TIME();\
 		data = READ( data );\
 		CACHE_TIME();\
-	case op + 0x04: /* imm */\
+	OPCODE( immed ) /* imm */\
 	imm##op:
 
-	ARITH_ADDR_MODES( 0xC5 ) // CMP
+	ARITH_ADDR_MODES( 0xC5, 0xC1, 0xD2, 0xD1, 0xD5, 0xD9, 0xDD, 0xCD, 0xC9 ) // CMP
 		nz = a - data;
 		pc++;
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_INSTR();
 	
-	ARITH_ADDR_MODES( 0x25 ) // AND
+	ARITH_ADDR_MODES( 0x25, 0x21, 0x32, 0x31, 0x35, 0x39, 0x3D, 0x2D, 0x29 ) // AND
 		nz = (a &= data);
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	ARITH_ADDR_MODES( 0x45 ) // EOR
+	ARITH_ADDR_MODES( 0x45, 0x41, 0x52, 0x51, 0x55, 0x59, 0x5D, 0x4D, 0x49 ) // EOR
 		nz = (a ^= data);
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	ARITH_ADDR_MODES( 0x05 ) // ORA
+	ARITH_ADDR_MODES( 0x05, 0x01, 0x12, 0x11, 0x15, 0x19, 0x1D, 0x0D, 0x09 ) // ORA
 		nz = (a |= data);
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
 // Add/subtract
 
-	ARITH_ADDR_MODES( 0xE5 ) // SBC
+	ARITH_ADDR_MODES( 0xE5, 0xE1, 0xF2, 0xF1, 0xF5, 0xF9, 0xFD, 0xED, 0xE9 ) // SBC
 		data ^= 0xFF;
 		goto adc_imm;
 	
-	ARITH_ADDR_MODES( 0x65 ) // ADC
+	ARITH_ADDR_MODES( 0x65, 0x61, 0x72, 0x71, 0x75, 0x79, 0x7D, 0x6D, 0x69 ) // ADC
 	adc_imm: {
 		if ( status & st_d )
 			debug_printf( "Decimal mode not supported\n" );
@@ -749,40 +765,40 @@ possibly_out_of_time:
 		c = nz = a + data + carry;
 		pc++;
 		a = (uint8_t) nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Shift/rotate
 
-	case 0x4A: // LSR A
+	OPCODE( 0x4A ) // LSR A
 		c = 0;
-	case 0x6A: // ROR A
+	OPCODE( 0x6A ) // ROR A
 		nz = c >> 1 & 0x80;
 		c = a << 8;
 		nz |= a >> 1;
 		a = nz;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x0A: // ASL A
+	OPCODE( 0x0A ) // ASL A
 		nz = a << 1;
 		c = nz;
 		a = (uint8_t) nz;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x2A: { // ROL A
+	OPCODE( 0x2A ) { // ROL A
 		nz = a << 1;
 		fint16 temp = c >> 8 & 1;
 		c = nz;
 		nz |= temp;
 		a = (uint8_t) nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x5E: // LSR abs,X
+	OPCODE( 0x5E ) // LSR abs,X
 		data += x;
-	case 0x4E: // LSR abs
+	OPCODE( 0x4E ) // LSR abs
 		c = 0;
-	case 0x6E: // ROR abs
+	OPCODE( 0x6E ) // ROR abs
 	ror_abs: {
 		ADD_PAGE( data );
 		FLUSH_TIME();
@@ -792,15 +808,15 @@ possibly_out_of_time:
 		goto rotate_common;
 	}
 	
-	case 0x3E: // ROL abs,X
+	OPCODE( 0x3E ) // ROL abs,X
 		data += x;
 		goto rol_abs;
 	
-	case 0x1E: // ASL abs,X
+	OPCODE( 0x1E ) // ASL abs,X
 		data += x;
-	case 0x0E: // ASL abs
+	OPCODE( 0x0E ) // ASL abs
 		c = 0;
-	case 0x2E: // ROL abs
+	OPCODE( 0x2E ) // ROL abs
 	rol_abs:
 		ADD_PAGE( data );
 		nz = c >> 8 & 1;
@@ -810,21 +826,21 @@ possibly_out_of_time:
 		pc++;
 		WRITE( data, (uint8_t) nz );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x7E: // ROR abs,X
+	OPCODE( 0x7E ) // ROR abs,X
 		data += x;
 		goto ror_abs;
 	
-	case 0x76: // ROR zp,x
+	OPCODE( 0x76 ) // ROR zp,x
 		data = uint8_t (data + x);
 		goto ror_zp;
 	
-	case 0x56: // LSR zp,x
+	OPCODE( 0x56 ) // LSR zp,x
 		data = uint8_t (data + x);
-	case 0x46: // LSR zp
+	OPCODE( 0x46 ) // LSR zp
 		c = 0;
-	case 0x66: // ROR zp
+	OPCODE( 0x66 ) // ROR zp
 	ror_zp: {
 		int temp = READ_LOW( data );
 		nz = (c >> 1 & 0x80) | (temp >> 1);
@@ -832,15 +848,15 @@ possibly_out_of_time:
 		goto write_nz_zp;
 	}
 	
-	case 0x36: // ROL zp,x
+	OPCODE( 0x36 ) // ROL zp,x
 		data = uint8_t (data + x);
 		goto rol_zp;
 	
-	case 0x16: // ASL zp,x
+	OPCODE( 0x16 ) // ASL zp,x
 		data = uint8_t (data + x);
-	case 0x06: // ASL zp
+	OPCODE( 0x06 ) // ASL zp
 		c = 0;
-	case 0x26: // ROL zp
+	OPCODE( 0x26 ) // ROL zp
 	rol_zp:
 		nz = c >> 8 & 1;
 		nz |= (c = READ_LOW( data ) << 1);
@@ -848,58 +864,58 @@ possibly_out_of_time:
 	
 // Increment/decrement
 
-#define INC_DEC_AXY( reg, n ) reg = uint8_t (nz = reg + n); goto loop;
+#define INC_DEC_AXY( reg, n ) reg = uint8_t (nz = reg + n); NEXT_INSTR();
 
-	case 0x1A: // INA
+	OPCODE( 0x1A ) // INA
 		INC_DEC_AXY( a, +1 )
 	
-	case 0xE8: // INX
+	OPCODE( 0xE8 ) // INX
 		INC_DEC_AXY( x, +1 )
 	
-	case 0xC8: // INY
+	OPCODE( 0xC8 ) // INY
 		INC_DEC_AXY( y, +1 )
 
-	case 0x3A: // DEA
+	OPCODE( 0x3A ) // DEA
 		INC_DEC_AXY( a, -1 )
 	
-	case 0xCA: // DEX
+	OPCODE( 0xCA ) // DEX
 		INC_DEC_AXY( x, -1 )
 	
-	case 0x88: // DEY
+	OPCODE( 0x88 ) // DEY
 		INC_DEC_AXY( y, -1 )
 	
-	case 0xF6: // INC zp,x
+	OPCODE( 0xF6 ) // INC zp,x
 		data = uint8_t (data + x);
-	case 0xE6: // INC zp
+	OPCODE( 0xE6 ) // INC zp
 		nz = 1;
 		goto add_nz_zp;
 	
-	case 0xD6: // DEC zp,x
+	OPCODE( 0xD6 ) // DEC zp,x
 		data = uint8_t (data + x);
-	case 0xC6: // DEC zp
+	OPCODE( 0xC6 ) // DEC zp
 		nz = (unsigned) -1;
 	add_nz_zp:
 		nz += READ_LOW( data );
 	write_nz_zp:
 		pc++;
 		WRITE_LOW( data, nz );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xFE: // INC abs,x
+	OPCODE( 0xFE ) // INC abs,x
 		data = x + GET_ADDR();
 		goto inc_ptr;
 	
-	case 0xEE: // INC abs
+	OPCODE( 0xEE ) // INC abs
 		data = GET_ADDR();
 	inc_ptr:
 		nz = 1;
 		goto inc_common;
 	
-	case 0xDE: // DEC abs,x
+	OPCODE( 0xDE ) // DEC abs,x
 		data = x + GET_ADDR();
 		goto dec_ptr;
 	
-	case 0xCE: // DEC abs
+	OPCODE( 0xCE ) // DEC abs
 		data = GET_ADDR();
 	dec_ptr:
 		nz = (unsigned) -1;
@@ -909,81 +925,81 @@ possibly_out_of_time:
 		pc += 2;
 		WRITE( data, (uint8_t) nz );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 		
 // Transfer
 
-	case 0xA8: // TAY
+	OPCODE( 0xA8 ) // TAY
 		y  = a;
 		nz = a;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x98: // TYA
+	OPCODE( 0x98 ) // TYA
 		a  = y;
 		nz = y;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xAA: // TAX
+	OPCODE( 0xAA ) // TAX
 		x  = a;
 		nz = a;
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x8A: // TXA
+	OPCODE( 0x8A ) // TXA
 		a  = x;
 		nz = x;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x9A: // TXS
+	OPCODE( 0x9A ) // TXS
 		SET_SP( x ); // verified (no flag change)
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xBA: // TSX
+	OPCODE( 0xBA ) // TSX
 		x = nz = GET_SP();
-		goto loop;
+		NEXT_INSTR();
 	
 	#define SWAP_REGS( r1, r2 ) {\
 		fuint8 t = r1;\
 		r1 = r2;\
 		r2 = t;\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 	
-	case 0x02: // SXY
+	OPCODE( 0x02 ) // SXY
 		SWAP_REGS( x, y );
 	
-	case 0x22: // SAX
+	OPCODE( 0x22 ) // SAX
 		SWAP_REGS( a, x );
 	
-	case 0x42: // SAY
+	OPCODE( 0x42 ) // SAY
 		SWAP_REGS( a, y );
 	
-	case 0x62: // CLA
+	OPCODE( 0x62 ) // CLA
 		a = 0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x82: // CLX
+	OPCODE( 0x82 ) // CLX
 		x = 0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xC2: // CLY
+	OPCODE( 0xC2 ) // CLY
 		y = 0;
-		goto loop;
+		NEXT_INSTR();
 	
 // Stack
 	
-	case 0x48: // PHA
+	OPCODE( 0x48 ) // PHA
 		PUSH( a );
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0xDA: // PHX
+	OPCODE( 0xDA ) // PHX
 		PUSH( x );
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x5A: // PHY
+	OPCODE( 0x5A ) // PHY
 		PUSH( y );
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x40:{// RTI
+	OPCODE( 0x40 ){// RTI
 		fuint8 temp = READ_LOW( sp );
 		pc  = READ_LOW( 0x100 | (sp - 0xFF) );
 		pc |= READ_LOW( 0x100 | (sp - 0xFE) ) * 0x100;
@@ -1000,67 +1016,67 @@ possibly_out_of_time:
 			s.base = new_time;
 			s_time += delta;
 		}
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 	#define POP()  READ_LOW( sp ); sp = (sp - 0xFF) | 0x100
 	
-	case 0x68: // PLA
+	OPCODE( 0x68 ) // PLA
 		a = nz = POP();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xFA: // PLX
+	OPCODE( 0xFA ) // PLX
 		x = nz = POP();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x7A: // PLY
+	OPCODE( 0x7A ) // PLY
 		y = nz = POP();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x28:{// PLP
+	OPCODE( 0x28 ){// PLP
 		fuint8 temp = POP();
 		fuint8 changed = status ^ temp;
 		SET_STATUS( temp );
 		if ( !(changed & st_i) )
-			goto loop; // I flag didn't change
+			NEXT_INSTR(); // I flag didn't change
 		if ( status & st_i )
 			goto handle_sei;
 		goto handle_cli;
 	}
 	#undef POP
 	
-	case 0x08: { // PHP
+	OPCODE( 0x08 ) { // PHP
 		fuint8 temp;
 		CALC_STATUS( temp );
 		PUSH( temp | st_b );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Flags
 
-	case 0x38: // SEC
+	OPCODE( 0x38 ) // SEC
 		c = (unsigned) ~0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x18: // CLC
+	OPCODE( 0x18 ) // CLC
 		c = 0;
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0xB8: // CLV
+	OPCODE( 0xB8 ) // CLV
 		status &= ~st_v;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD8: // CLD
+	OPCODE( 0xD8 ) // CLD
 		status &= ~st_d;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xF8: // SED
+	OPCODE( 0xF8 ) // SED
 		status |= st_d;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x58: // CLI
+	OPCODE( 0x58 ) // CLI
 		if ( !(status & st_i) )
-			goto loop;
+			NEXT_INSTR();
 		status &= ~st_i;
 	handle_cli: {
 		this->r.status = status; // update externally-visible I flag
@@ -1068,13 +1084,13 @@ possibly_out_of_time:
 		if ( delta <= 0 )
 		{
 			if ( TIME < irq_time_ )
-				goto loop;
+				NEXT_INSTR();
 			goto delayed_cli;
 		}
 		s.base = irq_time_;
 		s_time += delta;
 		if ( s_time < 0 )
-			goto loop;
+			NEXT_INSTR();
 		
 		if ( delta >= s_time + 1 )
 		{
@@ -1082,16 +1098,16 @@ possibly_out_of_time:
 			s.base += s_time + 1;
 			s_time = -1;
 			irq_time_ = s.base; // TODO: remove, as only to satisfy debug check in loop
-			goto loop;
+			NEXT_INSTR();
 		}
 	delayed_cli:
 		debug_printf( "Delayed CLI not supported\n" ); // TODO: implement
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x78: // SEI
+	OPCODE( 0x78 ) // SEI
 		if ( status & st_i )
-			goto loop;
+			NEXT_INSTR();
 		status |= st_i;
 	handle_sei: {
 		this->r.status = status; // update externally-visible I flag
@@ -1099,23 +1115,23 @@ possibly_out_of_time:
 		s.base = end_time_;
 		s_time += delta;
 		if ( s_time < 0 )
-			goto loop;
+			NEXT_INSTR();
 		debug_printf( "Delayed SEI not supported\n" ); // TODO: implement
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Special
 	
-	case 0x53:{// TAM
+	OPCODE( 0x53 ){// TAM
 		fuint8 const bits = data; // avoid using data across function call
 		pc++;
 		for ( int i = 0; i < 8; i++ )
 			if ( bits & (1 << i) )
 				set_mmr( i, a );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x43:{// TMA
+	OPCODE( 0x43 ){// TMA
 		pc++;
 		byte const* in = mmr;
 		do
@@ -1125,12 +1141,12 @@ possibly_out_of_time:
 			in++;
 		}
 		while ( (data >>= 1) != 0 );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x03: // ST0
-	case 0x13: // ST1
-	case 0x23:{// ST2
+	OPCODE( 0x03 ) // ST0
+	OPCODE( 0x13 ) // ST1
+	OPCODE( 0x23 ){// ST2
 		fuint16 addr = opcode >> 4;
 		if ( addr )
 			addr++;
@@ -1138,28 +1154,28 @@ possibly_out_of_time:
 		FLUSH_TIME();
 		CPU_WRITE_VDP( this, addr, data, TIME );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xEA: // NOP
-		goto loop;
+	OPCODE( 0xEA ) // NOP
+		NEXT_INSTR();
 
-	case 0x54: // CSL
+	OPCODE( 0x54 ) // CSL
 		debug_printf( "CSL not supported\n" );
 		illegal_encountered = true;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD4: // CSH
-		goto loop;
+	OPCODE( 0xD4 ) // CSH
+		NEXT_INSTR();
 	
-	case 0xF4: { // SET
+	OPCODE( 0xF4 ) { // SET
 		//fuint16 operand = GET_MSB();
 		debug_printf( "SET not handled\n" );
 		//switch ( data )
 		//{
 		//}
 		illegal_encountered = true;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Block transfer
@@ -1170,11 +1186,11 @@ possibly_out_of_time:
 		fuint16 out_alt;
 		fint16 out_inc;
 		
-	case 0xE3: // TIA
+	OPCODE( 0xE3 ) // TIA
 		in_alt  = 0;
 		goto bxfer_alt;
 	
-	case 0xF3: // TAI
+	OPCODE( 0xF3 ) // TAI
 		in_alt  = 1;
 	bxfer_alt:
 		in_inc  = in_alt ^ 1;
@@ -1182,17 +1198,17 @@ possibly_out_of_time:
 		out_inc = in_alt;
 		goto bxfer;
 	
-	case 0xD3: // TIN
+	OPCODE( 0xD3 ) // TIN
 		in_inc  = 1;
 		out_inc = 0;
 		goto bxfer_no_alt;
 	
-	case 0xC3: // TDD
+	OPCODE( 0xC3 ) // TDD
 		in_inc  = -1;
 		out_inc = -1;
 		goto bxfer_no_alt;
 	
-	case 0x73: // TII
+	OPCODE( 0x73 ) // TII
 		in_inc  = 1;
 		out_inc = 1;
 	bxfer_no_alt:
@@ -1226,16 +1242,19 @@ possibly_out_of_time:
 		}
 		while ( --count );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 
 // Illegal
 
-	default:
+	OPCODE( 0x0B ) OPCODE( 0x1B ) OPCODE( 0x2B ) OPCODE( 0x33 ) OPCODE( 0x3B ) OPCODE( 0x4B )
+	OPCODE( 0x5B ) OPCODE( 0x5C ) OPCODE( 0x63 ) OPCODE( 0x6B ) OPCODE( 0x7B ) OPCODE( 0x8B )
+	OPCODE( 0x9B ) OPCODE( 0xAB ) OPCODE( 0xBB ) OPCODE( 0xCB ) OPCODE( 0xDB ) OPCODE( 0xDC )
+	OPCODE( 0xE2 ) OPCODE( 0xEB ) OPCODE( 0xFB ) OPCODE( 0xFC )
 		assert( (unsigned) opcode <= 0xFF );
 		debug_printf( "Illegal opcode $%02X at $%04X\n", (int) opcode, (int) pc - 1 );
 		illegal_encountered = true;
-		goto loop;
+		NEXT_INSTR();
 	}
 	assert( false );
 	
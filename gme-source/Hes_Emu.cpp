@@ -48,7 +48,7 @@ Hes_Emu::~Hes_Emu() { }
 
 void Hes_Emu::unload()
 {
-	rom.clear();
+	// rom is kept so that loading another file can reuse it
 	Music_Emu::unload();
 }
 
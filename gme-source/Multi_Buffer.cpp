@@ -2,6 +2,8 @@
 
 #include "Multi_Buffer.h"
 
+#include <string.h>
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -230,3 +232,131 @@ void Stereo_Buffer::mix_mono( blip_sample_t* out_, blargg_long count )
 	
 	BLIP_READER_END( center, bufs [0] );
 }
+
+// Stem_Buffer
+
+Stem_Buffer::Stem_Buffer() : Multi_Buffer( 2 )
+{
+	chans       = 0;
+	chans_count = 0;
+	clock_rate_ = 0;
+	bass_freq_  = 16;
+	stem_out    = 0;
+	stem_stride = 0;
+}
+
+Stem_Buffer::~Stem_Buffer() { delete [] chans; }
+
+blargg_err_t Stem_Buffer::set_channel_count( int n )
+{
+	if ( n != chans_count )
+	{
+		delete [] chans;
+		chans_count = 0;
+		CHECK_ALLOC( chans = BLARGG_NEW Stereo_Buffer [n] );
+		chans_count = n;
+		
+		// bring new buffers up to the current configuration
+		if ( sample_rate() )
+		{
+			for ( int i = 0; i < n; i++ )
+			{
+				RETURN_ERR( chans [i].set_sample_rate( sample_rate(), length() ) );
+				if ( clock_rate_ )
+					chans [i].clock_rate( clock_rate_ );
+				chans [i].bass_freq( bass_freq_ );
+				chans [i].clear();
+			}
+		}
+		channels_changed();
+	}
+	RETURN_ERR( scratch.resize( mix_size ) );
+	return mix.resize( mix_size );
+}
+
+blargg_err_t Stem_Buffer::set_sample_rate( long rate, int msec )
+{
+	for ( int i = 0; i < chans_count; i++ )
+	{
+		RETURN_ERR( chans [i].set_sample_rate( rate, msec ) );
+		chans [i].clear();
+	}
+	
+	// all channels end up with the same rounded rate and length
+	Blip_Buffer probe;
+	RETURN_ERR( probe.set_sample_rate( rate, msec ) );
+	return Multi_Buffer::set_sample_rate( probe.sample_rate(), probe.length() );
+}
+
+void Stem_Buffer::clock_rate( long rate )
+{
+	clock_rate_ = rate;
+	for ( int i = 0; i < chans_count; i++ )
+		chans [i].clock_rate( rate );
+}
+
+void Stem_Buffer::bass_freq( int bass )
+{
+	bass_freq_ = bass;
+	for ( int i = 0; i < chans_count; i++ )
+		chans [i].bass_freq( bass );
+}
+
+void Stem_Buffer::clear()
+{
+	for ( int i = 0; i < chans_count; i++ )
+		chans [i].clear();
+}
+
+Multi_Buffer::channel_t Stem_Buffer::channel( int index, int type )
+{
+	assert( (unsigned) index < (unsigned) chans_count );
+	return chans [index].channel( index, type );
+}
+
+void Stem_Buffer::end_frame( blip_time_t clock_count )
+{
+	for ( int i = 0; i < chans_count; i++ )
+		chans [i].end_frame( clock_count );
+}
+
+long Stem_Buffer::read_samples( blip_sample_t* out, long count )
+{
+	require( !(count & 1) ); // count must be even
+	
+	long avail = samples_avail();
+	if ( count > avail )
+		count = avail;
+	
+	for ( long pos = 0; pos < count; )
+	{
+		long n = count - pos;
+		if ( n > mix_size )
+			n = mix_size;
+		
+		memset( mix.begin(), 0, n * sizeof mix [0] );
+		for ( int i = 0; i < chans_count; i++ )
+		{
+			blip_sample_t* in = scratch.begin();
+			if ( stem_out )
+				in = stem_out + i * stem_stride + pos;
+			chans [i].read_samples( in, n );
+			for ( long j = 0; j < n; j++ )
+				mix [j] += in [j];
+		}
+		
+		for ( long j = 0; j < n; j++ )
+		{
+			blargg_long s = mix [j];
+			if ( (BOOST::int16_t) s != s )
+				s = 0x7FFF - (s >> 24);
+			out [pos + j] = (blip_sample_t) s;
+		}
+		pos += n;
+	}
+	
+	if ( stem_out )
+		stem_out += count;
+	
+	return count;
+}
@@ -121,6 +121,42 @@ private:
 	void mix_mono( blip_sample_t*, blargg_long );
 };
 
+// Gives each channel its own Stereo_Buffer, so that every voice's output can be
+// read separately ("stems") while still producing the usual stereo mix.
+class Stem_Buffer : public Multi_Buffer {
+public:
+	// Make the following read_samples() calls also write channel i's stereo
+	// samples to out + i * stride, continuing where the previous call left off.
+	// If out is NULL, channel samples are only mixed.
+	void set_stem_output( blip_sample_t* out, long stride );
+	
+public:
+	Stem_Buffer();
+	~Stem_Buffer();
+	blargg_err_t set_channel_count( int );
+	blargg_err_t set_sample_rate( long, int msec = blip_default_length );
+	void clock_rate( long );
+	void bass_freq( int );
+	void clear();
+	channel_t channel( int, int );
+	void end_frame( blip_time_t );
+	
+	long samples_avail() const { return chans_count ? chans [0].samples_avail() : 0; }
+	long read_samples( blip_sample_t*, long );
+	
+private:
+	Stereo_Buffer* chans;
+	int chans_count;
+	long clock_rate_;
+	int bass_freq_;
+	blip_sample_t* stem_out;
+	long stem_stride;
+	
+	enum { mix_size = 1024 };
+	blargg_vector<blip_sample_t> scratch; // channel samples that aren't kept
+	blargg_vector<blargg_long> mix;
+};
+
 // Silent_Buffer generates no samples, useful where no sound is wanted
 class Silent_Buffer : public Multi_Buffer {
 	channel_t chan;
@@ -144,6 +180,12 @@ inline blargg_err_t Multi_Buffer::set_sample_rate( long rate, int msec )
 	return 0;
 }
 
+inline void Stem_Buffer::set_stem_output( blip_sample_t* out, long stride )
+{
+	stem_out    = out;
+	stem_stride = stride;
+}
+
 inline blargg_err_t Silent_Buffer::set_sample_rate( long rate, int msec )
 {
 	return Multi_Buffer::set_sample_rate( rate, msec );
@@ -3,7 +3,9 @@
 #include "Music_Emu.h"
 
 #include "Multi_Buffer.h"
+#include "blargg_endian.h"
 #include <string.h>
+#include <math.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -23,6 +25,12 @@ int const silence_max = 6; // seconds
 int const silence_threshold = 0x10;
 long const fade_block_size = 512;
 int const fade_shift = 8; // fade ends with gain at 1.0 / (1 << fade_shift)
+double const loop_min = 2.0; // seconds
+double const loop_max = 120.0;
+int const loop_table_bits = 16;
+int const loop_max_rejects = 3;
+long const loop_window = 2048; // frames compared where recorded loop repeats
+int const loop_catchup_speed = 8; // most samples emulated per sample played while catching up
 
 Music_Emu::equalizer_t const Music_Emu::tv_eq = { -8.0, 180 };
 
@@ -38,6 +46,7 @@ void Music_Emu::clear_track_vars()
 	silence_time     = 0;
 	silence_count    = 0;
 	buf_remain       = 0;
+	loop_clear();
 	warning(); // clear warning
 }
 
@@ -52,6 +61,13 @@ Music_Emu::Music_Emu()
 {
 	effects_buffer = 0;
 	
+	stems_enabled_ = false;
+	stem_out_      = 0;
+	stem_stride_   = 0;
+	
+	loop_enabled   = false;
+	loop_pending   = 0;
+	
 	sample_rate_ = 0;
 	mute_mask_   = 0;
 	tempo_       = 1.0;
@@ -60,6 +76,7 @@ Music_Emu::Music_Emu()
 	// defaults
 	max_initial_silence = 2;
 	silence_lookahead   = 3;
+	lookahead_limit     = 0;
 	ignore_silence_     = false;
 	equalizer_.treble   = -1.0;
 	equalizer_.bass     = 60;
@@ -83,6 +100,21 @@ blargg_err_t Music_Emu::set_sample_rate( long rate )
 	return 0;
 }
 
+blargg_err_t Music_Emu::enable_stems()
+{
+	require( !sample_rate() ); // stems must be enabled before setting sample rate
+	if ( !stems_enabled_ )
+	{
+		RETURN_ERR( enable_stems_() );
+		stems_enabled_ = true;
+		ignore_silence_ = true;
+		loop_enabled = false;
+	}
+	return 0;
+}
+
+blargg_err_t Music_Emu::enable_stems_() { return "Per-voice output not supported"; }
+
 void Music_Emu::pre_load()
 {
 	require( sample_rate() ); // set_sample_rate() must be called before loading a file
@@ -91,8 +123,12 @@ void Music_Emu::pre_load()
 
 void Music_Emu::set_equalizer( equalizer_t const& eq )
 {
+	loop_resync();
 	equalizer_ = eq;
-	set_equalizer_( eq );
+	if ( loop_state == loop_catchup )
+		loop_pending |= loop_pending_eq;
+	else
+		set_equalizer_( eq );
 }
 
 void Music_Emu::mute_voice( int index, bool mute )
@@ -108,8 +144,12 @@ void Music_Emu::mute_voice( int index, bool mute )
 void Music_Emu::mute_voices( int mask )
 {
 	require( sample_rate() ); // sample rate must be set first
+	loop_resync();
 	mute_mask_ = mask;
-	mute_voices_( mask );
+	if ( loop_state == loop_catchup )
+		loop_pending |= loop_pending_mute;
+	else
+		mute_voices_( mask );
 }
 
 void Music_Emu::set_tempo( double t )
@@ -119,8 +159,12 @@ void Music_Emu::set_tempo( double t )
 	double const max = 4.00;
 	if ( t < min ) t = min;
 	if ( t > max ) t = max;
+	loop_resync();
 	tempo_ = t;
-	set_tempo_( t );
+	if ( loop_state == loop_catchup )
+		loop_pending |= loop_pending_tempo;
+	else
+		set_tempo_( t );
 }
 
 void Music_Emu::post_load_()
@@ -132,6 +176,7 @@ void Music_Emu::post_load_()
 blargg_err_t Music_Emu::start_track( int track )
 {
 	clear_track_vars();
+	loop_sync_settings();
 	
 	int remapped = track;
 	RETURN_ERR( remap_track_( &remapped ) );
@@ -211,7 +256,16 @@ blargg_err_t Music_Emu::skip( long count )
 	if ( count && !emu_track_ended_ )
 	{
 		emu_time += count;
-		end_track_if_error( skip_( count ) );
+		if ( loop_state == loop_replay || loop_state == loop_catchup )
+		{
+			loop_pos = (loop_pos + count) % loop_size;
+		}
+		else
+		{
+			end_track_if_error( skip_( count ) );
+			if ( loop_state != loop_off )
+				loop_clear(); // recording has a gap and checkpoint times may be off
+		}
 	}
 	
 	if ( !(silence_count | buf_remain) ) // caught up to emulator, so update track ended
@@ -292,7 +346,24 @@ void Music_Emu::emu_play( long count, sample_t* out )
 	check( current_track_ >= 0 );
 	emu_time += count;
 	if ( current_track_ >= 0 && !emu_track_ended_ )
-		end_track_if_error( play_( count, out ) );
+	{
+		if ( loop_state == loop_replay )
+		{
+			loop_replay_( count, out );
+		}
+		else if ( loop_state == loop_catchup )
+		{
+			loop_catch_up( count, out );
+		}
+		else
+		{
+			end_track_if_error( play_( count, out ) );
+			if ( loop_state == loop_record )
+				loop_record_( count, out );
+			else if ( loop_state == loop_verify )
+				loop_verify_( count, out );
+		}
+	}
 	else
 		memset( out, 0, count * sizeof *out );
 }
@@ -347,6 +418,8 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 		{
 			// during a run of silence, run emulator at >=2x speed so it gets ahead
 			long ahead_time = silence_lookahead * (out_time + out_count - silence_time) + silence_time;
+			if ( lookahead_limit && ahead_time > emu_time + lookahead_limit * out_count )
+				ahead_time = emu_time + lookahead_limit * out_count;
 			while ( emu_time < ahead_time && !(buf_remain | emu_track_ended_) )
 				fill_buf();
 			
@@ -398,6 +471,299 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 	return 0;
 }
 
+blargg_err_t Music_Emu::play_stems( long out_count, sample_t* out, sample_t* stems )
+{
+	require( stems_enabled_ );
+	require( !(silence_count | buf_remain) ); // play() has buffered samples without stems
+	
+	long stems_count = out_count * voice_count();
+	if ( track_ended_ )
+	{
+		memset( out, 0, out_count * sizeof *out );
+		memset( stems, 0, stems_count * sizeof *stems );
+	}
+	else
+	{
+		require( current_track() >= 0 );
+		require( out_count % stereo == 0 );
+		
+		if ( emu_track_ended_ )
+			memset( stems, 0, stems_count * sizeof *stems );
+		
+		stem_out_    = stems;
+		stem_stride_ = out_count;
+		emu_play( out_count, out );
+		stem_out_    = 0;
+		track_ended_ |= emu_track_ended_;
+		
+		if ( out_time > fade_start )
+		{
+			for ( int i = 0; i < voice_count(); i++ )
+				handle_fade( out_count, stems + i * out_count );
+			handle_fade( out_count, out );
+		}
+	}
+	out_time += out_count;
+	return 0;
+}
+
+// Loop replay
+
+void Music_Emu::enable_loop_replay( bool enable )
+{
+	loop_resync();
+	loop_enabled = enable && !stems_enabled_;
+	if ( loop_state != loop_catchup )
+		loop_clear();
+}
+
+void Music_Emu::loop_clear()
+{
+	loop_state   = loop_enabled ? loop_search : loop_off;
+	loop_rejects = 0;
+	loop_used    = 0;
+	loop_period  = 0;
+	loop_size    = 0;
+	loop_pos     = 0;
+	loop_emu_pos = 0;
+	loop_verified = 0;
+	loop_buf.clear();
+}
+
+// Stop replaying. The emulator has to get to the same point in the loop as
+// output first, which can be most of a loop, so play() does that a bit at a
+// time while the recording keeps playing. Setting changes meanwhile are held
+// back from the emulator until it's there.
+void Music_Emu::loop_resync()
+{
+	if ( loop_state == loop_replay )
+		loop_state = loop_catchup;
+	else if ( loop_state != loop_catchup )
+		loop_clear();
+}
+
+// pass settings changed while catching up on to emulator
+void Music_Emu::loop_sync_settings()
+{
+	int pending = loop_pending;
+	loop_pending = 0;
+	if ( pending & loop_pending_tempo )
+		set_tempo_( tempo_ );
+	if ( pending & loop_pending_eq )
+		set_equalizer_( equalizer_ );
+	if ( pending & loop_pending_mute )
+		mute_voices_( mute_mask_ );
+}
+
+// Replay count samples to out while running the emulator up to
+// loop_catchup_speed times as far towards output's point in the loop. The
+// emulator is played rather than skipped since skip_() may be inexact, using
+// out as scratch.
+void Music_Emu::loop_catch_up( long count, sample_t* out )
+{
+	long behind = loop_pos - loop_emu_pos;
+	if ( behind < 0 )
+		behind += loop_size;
+	behind = (behind + count) % loop_size;
+	
+	long n = min( behind, count * loop_catchup_speed );
+	loop_emu_pos = (loop_emu_pos + n) % loop_size;
+	while ( n && !emu_track_ended_ )
+	{
+		long chunk = min( n, count );
+		n -= chunk;
+		end_track_if_error( play_( chunk, out ) );
+	}
+	
+	loop_replay_( count, out );
+	
+	if ( loop_emu_pos == loop_pos || emu_track_ended_ )
+	{
+		loop_clear();
+		loop_sync_settings();
+	}
+}
+
+blargg_ulong Music_Emu::hash_state( void const* p, long size, blargg_ulong hash )
+{
+	// FNV-1a, a word at a time
+	unsigned char const* in = (unsigned char const*) p;
+	for ( ; size >= 4; size -= 4, in += 4 )
+		hash = ((hash ^ get_le32( in )) * 0x01000193) & 0xFFFFFFFF;
+	for ( ; size > 0; size-- )
+		hash = ((hash ^ *in++) * 0x01000193) & 0xFFFFFFFF;
+	return hash;
+}
+
+// range around expected loop length searched for where recording repeats
+static long loop_slack( long period ) { return period / 4096 + 16; }
+
+void Music_Emu::loop_checkpoint( blargg_ulong hash, double time )
+{
+	if ( loop_state != loop_search )
+		return;
+	
+	int const table_size = 1 << loop_table_bits;
+	if ( !loop_used )
+	{
+		if ( !loop_table.size() && loop_table.resize( table_size ) )
+		{
+			loop_state = loop_off;
+			return;
+		}
+		for ( int i = 0; i < table_size; i++ )
+			loop_table [i].time = -1;
+	}
+	
+	loop_entry_t* e = &loop_table [hash & (table_size - 1)];
+	while ( e->time >= 0 && e->hash != hash )
+	{
+		if ( ++e == loop_table.end() )
+			e = loop_table.begin();
+	}
+	
+	if ( e->time < 0 )
+	{
+		// new state, so not in a loop yet
+		loop_period = 0;
+		if ( ++loop_used > table_size / 4 * 3 )
+		{
+			loop_used = 0; // full; start over
+			return;
+		}
+		e->hash = hash;
+		e->time = time;
+		return;
+	}
+	
+	double period = time - e->time;
+	e->time = time;
+	if ( period < loop_min || period > loop_max )
+	{
+		loop_period = 0;
+	}
+	else if ( !loop_period || fabs( period - loop_period ) > loop_period / 256 )
+	{
+		loop_period = period;
+	}
+	else
+	{
+		// states keep repeating after the same time, so record a little over
+		// that much sound and see whether it repeats too
+		long frames = (long) (loop_period * sample_rate() + 0.5);
+		if ( loop_buf.resize( (frames + loop_slack( frames ) + loop_window) * stereo ) )
+		{
+			loop_state = loop_off;
+			return;
+		}
+		loop_size  = 0;
+		loop_state = loop_record;
+	}
+}
+
+void Music_Emu::loop_record_( long count, sample_t const* in )
+{
+	long n = min( count, (long) loop_buf.size() - loop_size );
+	memcpy( loop_buf.begin() + loop_size, in, n * sizeof *in );
+	loop_size += n;
+	if ( loop_size < (long) loop_buf.size() )
+		return;
+	
+	// find where beginning of recording repeats best
+	sample_t const* const begin = loop_buf.begin();
+	long const window = loop_window * stereo;
+	long const period = (long) (loop_period * sample_rate() + 0.5);
+	long const slack  = loop_slack( period );
+	double best = -1;
+	long best_period = 0;
+	for ( long p = period - slack; p <= period + slack && best != 0; p++ )
+	{
+		sample_t const* in = begin + p * stereo;
+		double error = 0;
+		for ( long i = 0; i < window && (best < 0 || error < best); i++ )
+		{
+			double diff = begin [i] - in [i];
+			error += diff * diff;
+		}
+		if ( best < 0 || error < best )
+		{
+			best        = error;
+			best_period = p;
+		}
+	}
+	
+	double signal = 0;
+	for ( long i = 0; i < window; i++ )
+		signal += (double) begin [i] * begin [i];
+	
+	// must be audible and match exactly, since replaying a near match would
+	// change the output from what emulation gives
+	if ( signal >= window * (double) (silence_threshold * silence_threshold) &&
+			best == 0 )
+	{
+		// the window matching doesn't mean the rest of the loop does, so emulate
+		// one more pass and compare it all before replaying. Emulator continues
+		// past the end of recording by what's left of this block.
+		loop_size     = best_period * stereo;
+		loop_pos      = ((long) loop_buf.size() + (count - n) - loop_size) % loop_size;
+		loop_verified = 0;
+		loop_state    = loop_verify;
+		if ( loop_buf.resize( loop_size ) ) { } // OK if shrink fails
+		return;
+	}
+	
+	loop_reject();
+}
+
+void Music_Emu::loop_verify_( long count, sample_t const* in )
+{
+	while ( count )
+	{
+		long n = min( count, loop_size - loop_pos );
+		if ( memcmp( in, loop_buf.begin() + loop_pos, n * sizeof *in ) )
+		{
+			loop_reject();
+			return;
+		}
+		in       += n;
+		count    -= n;
+		loop_pos += n;
+		if ( loop_pos >= loop_size )
+			loop_pos = 0;
+		loop_verified += n;
+	}
+	
+	if ( loop_verified >= loop_size )
+	{
+		loop_emu_pos = loop_pos;
+		loop_state   = loop_replay;
+	}
+}
+
+void Music_Emu::loop_reject()
+{
+	// times in table weren't updated while recording
+	loop_buf.clear();
+	loop_used   = 0;
+	loop_size   = 0;
+	loop_period = 0;
+	loop_state  = (++loop_rejects < loop_max_rejects) ? loop_search : loop_off;
+}
+
+void Music_Emu::loop_replay_( long count, sample_t* out )
+{
+	while ( count )
+	{
+		long n = min( count, loop_size - loop_pos );
+		memcpy( out, loop_buf.begin() + loop_pos, n * sizeof *out );
+		out      += n;
+		count    -= n;
+		loop_pos += n;
+		if ( loop_pos >= loop_size )
+			loop_pos = 0;
+	}
+}
+
 // Gme_Info_
 
 blargg_err_t Gme_Info_::set_sample_rate_( long )            { return 0; }
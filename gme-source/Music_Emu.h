@@ -57,6 +57,21 @@ public:
 	// Disable automatic end-of-track detection and skipping of silence at beginning
 	void ignore_silence( bool disable = true );
 	
+	// Limit emulation done by play() while looking ahead during silence to n times
+	// the number of samples requested, so each call takes time proportional to its
+	// count. End of track is still detected, just after more of the silence has
+	// played. 0 (default) doesn't limit lookahead.
+	void set_lookahead_limit( int n );
+	
+	// Once the track is found to loop, play back the recorded loop instead of
+	// emulating it again. A loop is only used once a whole pass of it has been
+	// emulated again and matched the recording exactly. Changing voice muting, tempo or equalization goes back to
+	// emulation: the recording keeps playing while play() runs the emulator up
+	// to the same point, a few times faster than output, and the change is
+	// heard from there. Has no effect with stems or with emulators that don't
+	// report their state.
+	void enable_loop_replay( bool enable = true );
+	
 	// Info for current track
 	Gme_File::track_info;
 	blargg_err_t track_info( track_info_t* out ) const;
@@ -78,6 +93,18 @@ public:
 	// Must be called before set_sample_rate().
 	void set_gain( double );
 	
+	// Request per-voice ("stem") output for play_stems(). Must be called before
+	// set_sample_rate(), and also disables silence detection (see ignore_silence()).
+	// Returns an error if the emulator can't keep its voices separate.
+	blargg_err_t enable_stems();
+	
+	// Generate 'count' samples into 'out' as play() does and, from the same
+	// emulation pass, each voice's own output into 'stems', as voice_count()
+	// blocks of 'count' stereo samples one after another. Voices are taken
+	// before they are mixed, so echo and stereo effects on the mix aren't
+	// included. Fading applies to both.
+	blargg_err_t play_stems( long count, sample_t* out, sample_t* stems );
+	
 	// Request use of custom multichannel buffer. Only supported by "classic" emulators;
 	// on others this has no effect. Should be called only once *before* set_sample_rate().
 	virtual void set_buffer( Multi_Buffer* ) { }
@@ -117,6 +144,21 @@ protected:
 	virtual blargg_err_t start_track_( int ) = 0; // tempo is set before this
 	virtual blargg_err_t play_( long count, sample_t* out ) = 0;
 	virtual blargg_err_t skip_( long count );
+	
+	// Per-voice output. When play_() is called from play_stems(), stem_out() is
+	// where voice i's samples go (at i * stem_stride()); otherwise it's NULL and
+	// they should be discarded, keeping any per-voice state in step.
+	virtual blargg_err_t enable_stems_();
+	bool stems_enabled() const                  { return stems_enabled_; }
+	sample_t* stem_out() const                  { return stem_out_; }
+	long stem_stride() const                    { return stem_stride_; }
+	
+	// Loop detection. While loop_searching(), call loop_checkpoint() each time
+	// the music driver steps its song, with a hash of the state it steps from
+	// and the time since the start of the track, in seconds.
+	bool loop_searching() const                 { return loop_state == loop_search; }
+	void loop_checkpoint( blargg_ulong hash, double time );
+	static blargg_ulong hash_state( void const*, long size, blargg_ulong hash = 0 );
 protected:
 	virtual void unload();
 	virtual void pre_load();
@@ -150,6 +192,7 @@ private:
 	
 	// silence detection
 	int silence_lookahead; // speed to run emulator when looking ahead for silence
+	int lookahead_limit;   // most samples to look ahead per sample played, or 0
 	bool ignore_silence_;
 	long silence_time;     // number of samples where most recent silence began
 	long silence_count;    // number of samples of silence to play before using buf
@@ -159,6 +202,36 @@ private:
 	void fill_buf();
 	void emu_play( long count, sample_t* out );
 	
+	// stems
+	bool stems_enabled_;
+	sample_t* stem_out_;
+	long stem_stride_;
+	
+	// loop replay
+	enum { loop_off, loop_search, loop_record, loop_verify, loop_replay, loop_catchup };
+	enum { loop_pending_mute = 1, loop_pending_tempo = 2, loop_pending_eq = 4 };
+	struct loop_entry_t { blargg_ulong hash; double time; };
+	bool loop_enabled;
+	int loop_state;
+	int loop_rejects;
+	int loop_used;         // entries in loop_table
+	double loop_period;    // time between latest repeat of a state, or 0
+	long loop_size;        // samples recorded, then length of loop
+	long loop_pos;         // next sample to replay
+	long loop_emu_pos;     // loop position emulator is at
+	long loop_verified;    // samples emulation has matched recorded loop for
+	int loop_pending;      // settings held back from emulator while catching up
+	blargg_vector<loop_entry_t> loop_table;
+	blargg_vector<sample_t> loop_buf;
+	void loop_clear();
+	void loop_resync();
+	void loop_sync_settings();
+	void loop_catch_up( long count, sample_t* out );
+	void loop_record_( long count, sample_t const* in );
+	void loop_verify_( long count, sample_t const* in );
+	void loop_reject();
+	void loop_replay_( long count, sample_t* out );
+	
 	Multi_Buffer* effects_buffer;
 	friend Music_Emu* gme_new_emu( gme_type_t, int );
 	friend void gme_set_stereo_depth( Music_Emu*, double );
@@ -192,6 +265,7 @@ inline const Music_Emu::equalizer_t& Music_Emu::equalizer() const { return equal
 inline void Music_Emu::set_tempo_( double t )       { tempo_ = t; }
 inline void Music_Emu::remute_voices()              { mute_voices( mute_mask_ ); }
 inline void Music_Emu::ignore_silence( bool b )     { ignore_silence_ = b; }
+inline void Music_Emu::set_lookahead_limit( int n ) { lookahead_limit = n; }
 inline blargg_err_t Music_Emu::start_track_( int )  { return 0; }
 
 inline void Music_Emu::set_voice_names( const char* const* names )
@@ -99,6 +99,7 @@ void Nes_Apu::reset( bool pal_mode, int initial_dmc_dac )
 	last_time = 0;
 	last_dmc_time = 0;
 	osc_enables = 0;
+	idle_clocks_ = 0;
 	irq_flag = false;
 	earliest_irq_ = no_irq;
 	frame_delay = 1;
@@ -145,6 +146,13 @@ void Nes_Apu::run_until( nes_time_t end_time )
 	}
 }
 
+inline bool Nes_Apu::oscs_idle() const
+{
+	return !square1.volume() && !square2.volume() && !noise.volume() &&
+			!(triangle.length_counter && triangle.linear_counter) &&
+			dmc.silence && !dmc.buf_full;
+}
+
 void Nes_Apu::run_until_( nes_time_t end_time )
 {
 	require( end_time >= last_time );
@@ -167,6 +175,9 @@ void Nes_Apu::run_until_( nes_time_t end_time )
 			time = end_time;
 		frame_delay -= time - last_time;
 		
+		if ( oscs_idle() )
+			idle_clocks_ += time - last_time;
+		
 		// run oscs to present
 		square1.run( last_time, time );
 		square2.run( last_time, time );
@@ -94,6 +94,10 @@ public:
 	// accounted for (i.e. inserting CPU wait states).
 	void run_until( nes_time_t );
 	
+	// Number of clocks run since reset() during which no oscillator was playing.
+	// Silent oscillators already only advance their timers.
+	long idle_clocks() const { return idle_clocks_; }
+	
 public:
 	Nes_Apu();
 	BLARGG_DISABLE_NOTHROW
@@ -125,6 +129,7 @@ private:
 	int frame; // current frame (0-3)
 	int osc_enables;
 	int frame_mode;
+	long idle_clocks_;
 	bool irq_flag;
 	void (*irq_notifier_)( void* user_data );
 	void* irq_data;
@@ -132,6 +137,7 @@ private:
 	
 	void irq_changed();
 	void state_restored();
+	bool oscs_idle() const;
 	void run_until_( nes_time_t );
 	
 	// TODO: remove
@@ -3,6 +3,7 @@
 #include "Nes_Cpu.h"
 
 #include "blargg_endian.h"
+#include "blargg_dispatch.h"
 #include <limits.h>
 
 #define BLARGG_CPU_X86 1
@@ -160,9 +161,6 @@ bool Nes_Cpu::run( nes_time_t end_time )
 		SET_STATUS( temp );
 	}
 	
-	goto loop;
-dec_clock_loop:
-	s_time--;
 loop:
 	
 	check( (unsigned) GET_SP() < 0x100 );
@@ -215,7 +213,7 @@ loop:
 	
 	data = *instr;
 	
-	switch ( opcode )
+	OPCODE_SWITCH( opcode )
 	{
 #else
 
@@ -226,7 +224,7 @@ almost_out_of_time:
 	
 	data = *instr;
 	
-	switch ( opcode )
+	OPCODE_SWITCH( opcode )
 	{
 possibly_out_of_time:
 		if ( s_time < (int) data )
@@ -237,6 +235,23 @@ possibly_out_of_time:
 
 // Macros
 
+// With computed goto, each opcode fetches and dispatches the next one the same way
+// loop does, rather than all of them sharing the indirect jump at loop
+#if BLARGG_COMPUTED_GOTO && BLARGG_CPU_X86
+	#define NEXT_INSTR() do {\
+		instr = s.code_map [pc >> page_bits] + PAGE_OFFSET( pc );\
+		opcode = *instr++;\
+		pc++;\
+		data = clock_table [opcode];\
+		if ( (s_time += data) >= 0 )\
+			goto possibly_out_of_time;\
+		data = *instr;\
+		OPCODE_DISPATCH( opcode );\
+	} while ( 0 )
+#else
+	#define NEXT_INSTR() goto loop
+#endif
+
 #define GET_MSB()   (instr [1])
 #define ADD_PAGE()  (pc++, data += 0x100 * GET_MSB())
 #define GET_ADDR()  GET_LE16( instr )
@@ -244,7 +259,7 @@ possibly_out_of_time:
 #define NO_PAGE_CROSSING( lsb )
 #define HANDLE_PAGE_CROSSING( lsb ) s_time += (lsb) >> 8;
 
-#define INC_DEC_XY( reg, n ) reg = uint8_t (nz = reg + n); goto loop;
+#define INC_DEC_XY( reg, n ) reg = uint8_t (nz = reg + n); NEXT_INSTR();
 
 #define IND_Y( cross, out ) {\
 		fuint16 temp = READ_LOW( data ) + y;\
@@ -257,32 +272,33 @@ possibly_out_of_time:
 		out = 0x100 * READ_LOW( uint8_t (temp + 1) ) + READ_LOW( uint8_t (temp) );\
 	}
 	
-#define ARITH_ADDR_MODES( op )\
-case op - 0x04: /* (ind,x) */\
+// Opcodes are listed in the order op (zp), (ind,x), (ind),y, zp,X, abs,Y, abs,X, abs, imm
+#define ARITH_ADDR_MODES( op, ind_x, ind_y, zp_x, abs_y, abs_x, abs, immed )\
+OPCODE( ind_x ) /* (ind,x) */\
 	IND_X( data )\
 	goto ptr##op;\
-case op + 0x0C: /* (ind),y */\
+OPCODE( ind_y ) /* (ind),y */\
 	IND_Y( HANDLE_PAGE_CROSSING, data )\
 	goto ptr##op;\
-case op + 0x10: /* zp,X */\
+OPCODE( zp_x ) /* zp,X */\
 	data = uint8_t (data + x);\
-case op + 0x00: /* zp */\
+OPCODE( op ) /* zp */\
 	data = READ_LOW( data );\
 	goto imm##op;\
-case op + 0x14: /* abs,Y */\
+OPCODE( abs_y ) /* abs,Y */\
 	data += y;\
 	goto ind##op;\
-case op + 0x18: /* abs,X */\
+OPCODE( abs_x ) /* abs,X */\
 	data += x;\
 ind##op:\
 	HANDLE_PAGE_CROSSING( data );\
-case op + 0x08: /* abs */\
+OPCODE( abs ) /* abs */\
 	ADD_PAGE();\
 ptr##op:\
 	FLUSH_TIME();\
 	data = READ( data );\
 	CACHE_TIME();\
-case op + 0x04: /* imm */\
+OPCODE( immed ) /* imm */\
 imm##op:
 
 // TODO: more efficient way to handle negative branch that wraps PC around
@@ -290,272 +306,272 @@ imm##op:
 {\
 	fint16 offset = (BOOST::int8_t) data;\
 	fuint16 extra_clock = (++pc & 0xFF) + offset;\
-	if ( !(cond) ) goto dec_clock_loop;\
+	if ( !(cond) ) { s_time--; NEXT_INSTR(); }\
 	pc = BOOST::uint16_t (pc + offset);\
 	s_time += extra_clock >> 8 & 1;\
-	goto loop;\
+	NEXT_INSTR();\
 }
 
 // Often-Used
 
-	case 0xB5: // LDA zp,x
+	OPCODE( 0xB5 ) // LDA zp,x
 		a = nz = READ_LOW( uint8_t (data + x) );
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xA5: // LDA zp
+	OPCODE( 0xA5 ) // LDA zp
 		a = nz = READ_LOW( data );
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD0: // BNE
+	OPCODE( 0xD0 ) // BNE
 		BRANCH( (uint8_t) nz );
 	
-	case 0x20: { // JSR
+	OPCODE( 0x20 ) { // JSR
 		fuint16 temp = pc + 1;
 		pc = GET_ADDR();
 		WRITE_LOW( 0x100 | (sp - 1), temp >> 8 );
 		sp = (sp - 2) | 0x100;
 		WRITE_LOW( sp, temp );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x4C: // JMP abs
+	OPCODE( 0x4C ) // JMP abs
 		pc = GET_ADDR();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xE8: // INX
+	OPCODE( 0xE8 ) // INX
 		INC_DEC_XY( x, 1 )
 	
-	case 0x10: // BPL
+	OPCODE( 0x10 ) // BPL
 		BRANCH( !IS_NEG )
 	
-	ARITH_ADDR_MODES( 0xC5 ) // CMP
+	ARITH_ADDR_MODES( 0xC5, 0xC1, 0xD1, 0xD5, 0xD9, 0xDD, 0xCD, 0xC9 ) // CMP
 		nz = a - data;
 		pc++;
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x30: // BMI
+	OPCODE( 0x30 ) // BMI
 		BRANCH( IS_NEG )
 	
-	case 0xF0: // BEQ
+	OPCODE( 0xF0 ) // BEQ
 		BRANCH( !(uint8_t) nz );
 	
-	case 0x95: // STA zp,x
+	OPCODE( 0x95 ) // STA zp,x
 		data = uint8_t (data + x);
-	case 0x85: // STA zp
+	OPCODE( 0x85 ) // STA zp
 		pc++;
 		WRITE_LOW( data, a );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xC8: // INY
+	OPCODE( 0xC8 ) // INY
 		INC_DEC_XY( y, 1 )
 
-	case 0xA8: // TAY
+	OPCODE( 0xA8 ) // TAY
 		y  = a;
 		nz = a;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x98: // TYA
+	OPCODE( 0x98 ) // TYA
 		a  = y;
 		nz = y;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xAD:{// LDA abs
+	OPCODE( 0xAD ){// LDA abs
 		unsigned addr = GET_ADDR();
 		pc += 2;
 		READ_LIKELY_PPU( addr, nz );
 		a = nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x60: // RTS
+	OPCODE( 0x60 ) // RTS
 		pc = 1 + READ_LOW( sp );
 		pc += 0x100 * READ_LOW( 0x100 | (sp - 0xFF) );
 		sp = (sp - 0xFE) | 0x100;
-		goto loop;
+		NEXT_INSTR();
 	
 	{
 		fuint16 addr;
 		
-	case 0x99: // STA abs,Y
+	OPCODE( 0x99 ) // STA abs,Y
 		addr = y + GET_ADDR();
 		pc += 2;
 		if ( addr <= 0x7FF )
 		{
 			WRITE_LOW( addr, a );
-			goto loop;
+			NEXT_INSTR();
 		}
 		goto sta_ptr;
 	
-	case 0x8D: // STA abs
+	OPCODE( 0x8D ) // STA abs
 		addr = GET_ADDR();
 		pc += 2;
 		if ( addr <= 0x7FF )
 		{
 			WRITE_LOW( addr, a );
-			goto loop;
+			NEXT_INSTR();
 		}
 		goto sta_ptr;
 	
-	case 0x9D: // STA abs,X (slightly more common than STA abs)
+	OPCODE( 0x9D ) // STA abs,X (slightly more common than STA abs)
 		addr = x + GET_ADDR();
 		pc += 2;
 		if ( addr <= 0x7FF )
 		{
 			WRITE_LOW( addr, a );
-			goto loop;
+			NEXT_INSTR();
 		}
 	sta_ptr:
 		FLUSH_TIME();
 		WRITE( addr, a );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x91: // STA (ind),Y
+	OPCODE( 0x91 ) // STA (ind),Y
 		IND_Y( NO_PAGE_CROSSING, addr )
 		pc++;
 		goto sta_ptr;
 	
-	case 0x81: // STA (ind,X)
+	OPCODE( 0x81 ) // STA (ind,X)
 		IND_X( addr )
 		pc++;
 		goto sta_ptr;
 	
 	}
 	
-	case 0xA9: // LDA #imm
+	OPCODE( 0xA9 ) // LDA #imm
 		pc++;
 		a  = data;
 		nz = data;
-		goto loop;
+		NEXT_INSTR();
 
 	// common read instructions
 	{
 		fuint16 addr;
 		
-	case 0xA1: // LDA (ind,X)
+	OPCODE( 0xA1 ) // LDA (ind,X)
 		IND_X( addr )
 		pc++;
 		goto a_nz_read_addr;
 	
-	case 0xB1:// LDA (ind),Y
+	OPCODE( 0xB1 )// LDA (ind),Y
 		addr = READ_LOW( data ) + y;
 		HANDLE_PAGE_CROSSING( addr );
 		addr += 0x100 * READ_LOW( (uint8_t) (data + 1) );
 		pc++;
 		a = nz = READ_PROG( addr );
 		if ( (addr ^ 0x8000) <= 0x9FFF )
-			goto loop;
+			NEXT_INSTR();
 		goto a_nz_read_addr;
 	
-	case 0xB9: // LDA abs,Y
+	OPCODE( 0xB9 ) // LDA abs,Y
 		HANDLE_PAGE_CROSSING( data + y );
 		addr = GET_ADDR() + y;
 		pc += 2;
 		a = nz = READ_PROG( addr );
 		if ( (addr ^ 0x8000) <= 0x9FFF )
-			goto loop;
+			NEXT_INSTR();
 		goto a_nz_read_addr;
 	
-	case 0xBD: // LDA abs,X
+	OPCODE( 0xBD ) // LDA abs,X
 		HANDLE_PAGE_CROSSING( data + x );
 		addr = GET_ADDR() + x;
 		pc += 2;
 		a = nz = READ_PROG( addr );
 		if ( (addr ^ 0x8000) <= 0x9FFF )
-			goto loop;
+			NEXT_INSTR();
 	a_nz_read_addr:
 		FLUSH_TIME();
 		a = nz = READ( addr );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	
 	}
 
 // Branch
 
-	case 0x50: // BVC
+	OPCODE( 0x50 ) // BVC
 		BRANCH( !(status & st_v) )
 	
-	case 0x70: // BVS
+	OPCODE( 0x70 ) // BVS
 		BRANCH( status & st_v )
 	
-	case 0xB0: // BCS
+	OPCODE( 0xB0 ) // BCS
 		BRANCH( c & 0x100 )
 	
-	case 0x90: // BCC
+	OPCODE( 0x90 ) // BCC
 		BRANCH( !(c & 0x100) )
 	
 // Load/store
 	
-	case 0x94: // STY zp,x
+	OPCODE( 0x94 ) // STY zp,x
 		data = uint8_t (data + x);
-	case 0x84: // STY zp
+	OPCODE( 0x84 ) // STY zp
 		pc++;
 		WRITE_LOW( data, y );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x96: // STX zp,y
+	OPCODE( 0x96 ) // STX zp,y
 		data = uint8_t (data + y);
-	case 0x86: // STX zp
+	OPCODE( 0x86 ) // STX zp
 		pc++;
 		WRITE_LOW( data, x );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xB6: // LDX zp,y
+	OPCODE( 0xB6 ) // LDX zp,y
 		data = uint8_t (data + y);
-	case 0xA6: // LDX zp
+	OPCODE( 0xA6 ) // LDX zp
 		data = READ_LOW( data );
-	case 0xA2: // LDX #imm
+	OPCODE( 0xA2 ) // LDX #imm
 		pc++;
 		x = data;
 		nz = data;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xB4: // LDY zp,x
+	OPCODE( 0xB4 ) // LDY zp,x
 		data = uint8_t (data + x);
-	case 0xA4: // LDY zp
+	OPCODE( 0xA4 ) // LDY zp
 		data = READ_LOW( data );
-	case 0xA0: // LDY #imm
+	OPCODE( 0xA0 ) // LDY #imm
 		pc++;
 		y = data;
 		nz = data;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xBC: // LDY abs,X
+	OPCODE( 0xBC ) // LDY abs,X
 		data += x;
 		HANDLE_PAGE_CROSSING( data );
-	case 0xAC:{// LDY abs
+	OPCODE( 0xAC ){// LDY abs
 		unsigned addr = data + 0x100 * GET_MSB();
 		pc += 2;
 		FLUSH_TIME();
 		y = nz = READ( addr );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xBE: // LDX abs,y
+	OPCODE( 0xBE ) // LDX abs,y
 		data += y;
 		HANDLE_PAGE_CROSSING( data );
-	case 0xAE:{// LDX abs
+	OPCODE( 0xAE ){// LDX abs
 		unsigned addr = data + 0x100 * GET_MSB();
 		pc += 2;
 		FLUSH_TIME();
 		x = nz = READ( addr );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 	{
 		fuint8 temp;
-	case 0x8C: // STY abs
+	OPCODE( 0x8C ) // STY abs
 		temp = y;
 		goto store_abs;
 	
-	case 0x8E: // STX abs
+	OPCODE( 0x8E ) // STX abs
 		temp = x;
 	store_abs:
 		unsigned addr = GET_ADDR();
@@ -563,17 +579,17 @@ imm##op:
 		if ( addr <= 0x7FF )
 		{
 			WRITE_LOW( addr, temp );
-			goto loop;
+			NEXT_INSTR();
 		}
 		FLUSH_TIME();
 		WRITE( addr, temp );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	}
 
 // Compare
 
-	case 0xEC:{// CPX abs
+	OPCODE( 0xEC ){// CPX abs
 		unsigned addr = GET_ADDR();
 		pc++;
 		FLUSH_TIME();
@@ -582,17 +598,17 @@ imm##op:
 		goto cpx_data;
 	}
 	
-	case 0xE4: // CPX zp
+	OPCODE( 0xE4 ) // CPX zp
 		data = READ_LOW( data );
-	case 0xE0: // CPX #imm
+	OPCODE( 0xE0 ) // CPX #imm
 	cpx_data:
 		nz = x - data;
 		pc++;
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xCC:{// CPY abs
+	OPCODE( 0xCC ){// CPY abs
 		unsigned addr = GET_ADDR();
 		pc++;
 		FLUSH_TIME();
@@ -601,63 +617,63 @@ imm##op:
 		goto cpy_data;
 	}
 	
-	case 0xC4: // CPY zp
+	OPCODE( 0xC4 ) // CPY zp
 		data = READ_LOW( data );
-	case 0xC0: // CPY #imm
+	OPCODE( 0xC0 ) // CPY #imm
 	cpy_data:
 		nz = y - data;
 		pc++;
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_INSTR();
 	
 // Logical
 
-	ARITH_ADDR_MODES( 0x25 ) // AND
+	ARITH_ADDR_MODES( 0x25, 0x21, 0x31, 0x35, 0x39, 0x3D, 0x2D, 0x29 ) // AND
 		nz = (a &= data);
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	ARITH_ADDR_MODES( 0x45 ) // EOR
+	ARITH_ADDR_MODES( 0x45, 0x41, 0x51, 0x55, 0x59, 0x5D, 0x4D, 0x49 ) // EOR
 		nz = (a ^= data);
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	ARITH_ADDR_MODES( 0x05 ) // ORA
+	ARITH_ADDR_MODES( 0x05, 0x01, 0x11, 0x15, 0x19, 0x1D, 0x0D, 0x09 ) // ORA
 		nz = (a |= data);
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x2C:{// BIT abs
+	OPCODE( 0x2C ){// BIT abs
 		unsigned addr = GET_ADDR();
 		pc += 2;
 		status &= ~st_v;
 		READ_LIKELY_PPU( addr, nz );
 		status |= nz & st_v;
 		if ( a & nz )
-			goto loop;
+			NEXT_INSTR();
 		nz <<= 8; // result must be zero, even if N bit is set
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x24: // BIT zp
+	OPCODE( 0x24 ) // BIT zp
 		nz = READ_LOW( data );
 		pc++;
 		status &= ~st_v;
 		status |= nz & st_v;
 		if ( a & nz )
-			goto loop;
+			NEXT_INSTR();
 		nz <<= 8; // result must be zero, even if N bit is set
-		goto loop;
+		NEXT_INSTR();
 		
 // Add/subtract
 
-	ARITH_ADDR_MODES( 0xE5 ) // SBC
-	case 0xEB: // unofficial equivalent
+	ARITH_ADDR_MODES( 0xE5, 0xE1, 0xF1, 0xF5, 0xF9, 0xFD, 0xED, 0xE9 ) // SBC
+	OPCODE( 0xEB ) // unofficial equivalent
 		data ^= 0xFF;
 		goto adc_imm;
 	
-	ARITH_ADDR_MODES( 0x65 ) // ADC
+	ARITH_ADDR_MODES( 0x65, 0x61, 0x71, 0x75, 0x79, 0x7D, 0x6D, 0x69 ) // ADC
 	adc_imm: {
 		fint16 carry = c >> 8 & 1;
 		fint16 ov = (a ^ 0x80) + carry + (BOOST::int8_t) data; // sign-extend
@@ -666,40 +682,40 @@ imm##op:
 		c = nz = a + data + carry;
 		pc++;
 		a = (uint8_t) nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Shift/rotate
 
-	case 0x4A: // LSR A
+	OPCODE( 0x4A ) // LSR A
 		c = 0;
-	case 0x6A: // ROR A
+	OPCODE( 0x6A ) // ROR A
 		nz = c >> 1 & 0x80;
 		c = a << 8;
 		nz |= a >> 1;
 		a = nz;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x0A: // ASL A
+	OPCODE( 0x0A ) // ASL A
 		nz = a << 1;
 		c = nz;
 		a = (uint8_t) nz;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x2A: { // ROL A
+	OPCODE( 0x2A ) { // ROL A
 		nz = a << 1;
 		fint16 temp = c >> 8 & 1;
 		c = nz;
 		nz |= temp;
 		a = (uint8_t) nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x5E: // LSR abs,X
+	OPCODE( 0x5E ) // LSR abs,X
 		data += x;
-	case 0x4E: // LSR abs
+	OPCODE( 0x4E ) // LSR abs
 		c = 0;
-	case 0x6E: // ROR abs
+	OPCODE( 0x6E ) // ROR abs
 	ror_abs: {
 		ADD_PAGE();
 		FLUSH_TIME();
@@ -709,15 +725,15 @@ imm##op:
 		goto rotate_common;
 	}
 	
-	case 0x3E: // ROL abs,X
+	OPCODE( 0x3E ) // ROL abs,X
 		data += x;
 		goto rol_abs;
 	
-	case 0x1E: // ASL abs,X
+	OPCODE( 0x1E ) // ASL abs,X
 		data += x;
-	case 0x0E: // ASL abs
+	OPCODE( 0x0E ) // ASL abs
 		c = 0;
-	case 0x2E: // ROL abs
+	OPCODE( 0x2E ) // ROL abs
 	rol_abs:
 		ADD_PAGE();
 		nz = c >> 8 & 1;
@@ -727,21 +743,21 @@ imm##op:
 		pc++;
 		WRITE( data, (uint8_t) nz );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x7E: // ROR abs,X
+	OPCODE( 0x7E ) // ROR abs,X
 		data += x;
 		goto ror_abs;
 	
-	case 0x76: // ROR zp,x
+	OPCODE( 0x76 ) // ROR zp,x
 		data = uint8_t (data + x);
 		goto ror_zp;
 	
-	case 0x56: // LSR zp,x
+	OPCODE( 0x56 ) // LSR zp,x
 		data = uint8_t (data + x);
-	case 0x46: // LSR zp
+	OPCODE( 0x46 ) // LSR zp
 		c = 0;
-	case 0x66: // ROR zp
+	OPCODE( 0x66 ) // ROR zp
 	ror_zp: {
 		int temp = READ_LOW( data );
 		nz = (c >> 1 & 0x80) | (temp >> 1);
@@ -749,15 +765,15 @@ imm##op:
 		goto write_nz_zp;
 	}
 	
-	case 0x36: // ROL zp,x
+	OPCODE( 0x36 ) // ROL zp,x
 		data = uint8_t (data + x);
 		goto rol_zp;
 	
-	case 0x16: // ASL zp,x
+	OPCODE( 0x16 ) // ASL zp,x
 		data = uint8_t (data + x);
-	case 0x06: // ASL zp
+	OPCODE( 0x06 ) // ASL zp
 		c = 0;
-	case 0x26: // ROL zp
+	OPCODE( 0x26 ) // ROL zp
 	rol_zp:
 		nz = c >> 8 & 1;
 		nz |= (c = READ_LOW( data ) << 1);
@@ -765,44 +781,44 @@ imm##op:
 	
 // Increment/decrement
 
-	case 0xCA: // DEX
+	OPCODE( 0xCA ) // DEX
 		INC_DEC_XY( x, -1 )
 	
-	case 0x88: // DEY
+	OPCODE( 0x88 ) // DEY
 		INC_DEC_XY( y, -1 )
 	
-	case 0xF6: // INC zp,x
+	OPCODE( 0xF6 ) // INC zp,x
 		data = uint8_t (data + x);
-	case 0xE6: // INC zp
+	OPCODE( 0xE6 ) // INC zp
 		nz = 1;
 		goto add_nz_zp;
 	
-	case 0xD6: // DEC zp,x
+	OPCODE( 0xD6 ) // DEC zp,x
 		data = uint8_t (data + x);
-	case 0xC6: // DEC zp
+	OPCODE( 0xC6 ) // DEC zp
 		nz = (unsigned) -1;
 	add_nz_zp:
 		nz += READ_LOW( data );
 	write_nz_zp:
 		pc++;
 		WRITE_LOW( data, nz );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xFE: // INC abs,x
+	OPCODE( 0xFE ) // INC abs,x
 		data = x + GET_ADDR();
 		goto inc_ptr;
 	
-	case 0xEE: // INC abs
+	OPCODE( 0xEE ) // INC abs
 		data = GET_ADDR();
 	inc_ptr:
 		nz = 1;
 		goto inc_common;
 	
-	case 0xDE: // DEC abs,x
+	OPCODE( 0xDE ) // DEC abs,x
 		data = x + GET_ADDR();
 		goto dec_ptr;
 	
-	case 0xCE: // DEC abs
+	OPCODE( 0xCE ) // DEC abs
 		data = GET_ADDR();
 	dec_ptr:
 		nz = (unsigned) -1;
@@ -812,113 +828,113 @@ imm##op:
 		pc += 2;
 		WRITE( data, (uint8_t) nz );
 		CACHE_TIME();
-		goto loop;
+		NEXT_INSTR();
 		
 // Transfer
 
-	case 0xAA: // TAX
+	OPCODE( 0xAA ) // TAX
 		x  = a;
 		nz = a;
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x8A: // TXA
+	OPCODE( 0x8A ) // TXA
 		a  = x;
 		nz = x;
-		goto loop;
+		NEXT_INSTR();
 
-	case 0x9A: // TXS
+	OPCODE( 0x9A ) // TXS
 		SET_SP( x ); // verified (no flag change)
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xBA: // TSX
+	OPCODE( 0xBA ) // TSX
 		x = nz = GET_SP();
-		goto loop;
+		NEXT_INSTR();
 	
 // Stack
 	
-	case 0x48: // PHA
+	OPCODE( 0x48 ) // PHA
 		PUSH( a ); // verified
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x68: // PLA
+	OPCODE( 0x68 ) // PLA
 		a = nz = READ_LOW( sp );
 		sp = (sp - 0xFF) | 0x100;
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x40:{// RTI
+	OPCODE( 0x40 ){// RTI
 		fuint8 temp = READ_LOW( sp );
 		pc  = READ_LOW( 0x100 | (sp - 0xFF) );
 		pc |= READ_LOW( 0x100 | (sp - 0xFE) ) * 0x100;
 		sp = (sp - 0xFD) | 0x100;
 		data = status;
 		SET_STATUS( temp );
-		if ( !((data ^ status) & st_i) ) goto loop; // I flag didn't change
+		if ( !((data ^ status) & st_i) ) NEXT_INSTR(); // I flag didn't change
 		this->r.status = status; // update externally-visible I flag
 		blargg_long delta = s.base - irq_time_;
-		if ( delta <= 0 ) goto loop;
-		if ( status & st_i ) goto loop;
+		if ( delta <= 0 ) NEXT_INSTR();
+		if ( status & st_i ) NEXT_INSTR();
 		s_time += delta;
 		s.base = irq_time_;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x28:{// PLP
+	OPCODE( 0x28 ){// PLP
 		fuint8 temp = READ_LOW( sp );
 		sp = (sp - 0xFF) | 0x100;
 		fuint8 changed = status ^ temp;
 		SET_STATUS( temp );
 		if ( !(changed & st_i) )
-			goto loop; // I flag didn't change
+			NEXT_INSTR(); // I flag didn't change
 		if ( status & st_i )
 			goto handle_sei;
 		goto handle_cli;
 	}
 	
-	case 0x08: { // PHP
+	OPCODE( 0x08 ) { // PHP
 		fuint8 temp;
 		CALC_STATUS( temp );
 		PUSH( temp | (st_b | st_r) );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x6C:{// JMP (ind)
+	OPCODE( 0x6C ){// JMP (ind)
 		data = GET_ADDR();
 		check( unsigned (data - 0x2000) >= 0x4000 ); // ensure it's outside I/O space
 		uint8_t const* page = s.code_map [data >> page_bits];
 		pc = page [PAGE_OFFSET( data )];
 		data = (data & 0xFF00) | ((data + 1) & 0xFF);
 		pc |= page [PAGE_OFFSET( data )] << 8;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x00: // BRK
+	OPCODE( 0x00 ) // BRK
 		goto handle_brk;
 	
 // Flags
 
-	case 0x38: // SEC
+	OPCODE( 0x38 ) // SEC
 		c = (unsigned) ~0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x18: // CLC
+	OPCODE( 0x18 ) // CLC
 		c = 0;
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0xB8: // CLV
+	OPCODE( 0xB8 ) // CLV
 		status &= ~st_v;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xD8: // CLD
+	OPCODE( 0xD8 ) // CLD
 		status &= ~st_d;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xF8: // SED
+	OPCODE( 0xF8 ) // SED
 		status |= st_d;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x58: // CLI
+	OPCODE( 0x58 ) // CLI
 		if ( !(status & st_i) )
-			goto loop;
+			NEXT_INSTR();
 		status &= ~st_i;
 	handle_cli: {
 		//debug_printf( "CLI at %d\n", TIME );
@@ -927,30 +943,30 @@ imm##op:
 		if ( delta <= 0 )
 		{
 			if ( TIME < irq_time_ )
-				goto loop;
+				NEXT_INSTR();
 			goto delayed_cli;
 		}
 		s.base = irq_time_;
 		s_time += delta;
 		if ( s_time < 0 )
-			goto loop;
+			NEXT_INSTR();
 		
 		if ( delta >= s_time + 1 )
 		{
 			s.base += s_time + 1;
 			s_time = -1;
-			goto loop;
+			NEXT_INSTR();
 		}
 		
 		// TODO: implement
 	delayed_cli:
 		debug_printf( "Delayed CLI not emulated\n" );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x78: // SEI
+	OPCODE( 0x78 ) // SEI
 		if ( status & st_i )
-			goto loop;
+			NEXT_INSTR();
 		status |= st_i;
 	handle_sei: {
 		this->r.status = status; // update externally-visible I flag
@@ -958,66 +974,76 @@ imm##op:
 		s.base = end_time_;
 		s_time += delta;
 		if ( s_time < 0 )
-			goto loop;
+			NEXT_INSTR();
 		
 		debug_printf( "Delayed SEI not emulated\n" );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // Unofficial
 	
 	// SKW - Skip word
-	case 0x1C: case 0x3C: case 0x5C: case 0x7C: case 0xDC: case 0xFC:
+	OPCODE( 0x1C ) OPCODE( 0x3C ) OPCODE( 0x5C ) OPCODE( 0x7C ) OPCODE( 0xDC ) OPCODE( 0xFC )
 		HANDLE_PAGE_CROSSING( data + x );
-	case 0x0C:
+	OPCODE( 0x0C )
 		pc++;
 	// SKB - Skip byte
-	case 0x74: case 0x04: case 0x14: case 0x34: case 0x44: case 0x54: case 0x64:
-	case 0x80: case 0x82: case 0x89: case 0xC2: case 0xD4: case 0xE2: case 0xF4:
+	OPCODE( 0x74 ) OPCODE( 0x04 ) OPCODE( 0x14 ) OPCODE( 0x34 ) OPCODE( 0x44 ) OPCODE( 0x54 ) OPCODE( 0x64 )
+	OPCODE( 0x80 ) OPCODE( 0x82 ) OPCODE( 0x89 ) OPCODE( 0xC2 ) OPCODE( 0xD4 ) OPCODE( 0xE2 ) OPCODE( 0xF4 )
 		pc++;
-		goto loop;
+		NEXT_INSTR();
 	
 	// NOP
-	case 0xEA: case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xFA:
-		goto loop;
+	OPCODE( 0xEA ) OPCODE( 0x1A ) OPCODE( 0x3A ) OPCODE( 0x5A ) OPCODE( 0x7A ) OPCODE( 0xDA ) OPCODE( 0xFA )
+		NEXT_INSTR();
 
-	case bad_opcode: // HLT
+	OPCODE( 0xF2 ) // HLT (bad_opcode)
 		pc--;
 		if ( pc > 0xFFFF )
 		{
 			// handle wrap-around (assumes caller has put page of HLT at 0x10000)
 			pc &= 0xFFFF;
-			goto loop;
+			NEXT_INSTR();
 		}
-	case 0x02: case 0x12: case 0x22: case 0x32: case 0x42: case 0x52:
-	case 0x62: case 0x72: case 0x92: case 0xB2: case 0xD2:
+	OPCODE( 0x02 ) OPCODE( 0x12 ) OPCODE( 0x22 ) OPCODE( 0x32 ) OPCODE( 0x42 ) OPCODE( 0x52 )
+	OPCODE( 0x62 ) OPCODE( 0x72 ) OPCODE( 0x92 ) OPCODE( 0xB2 ) OPCODE( 0xD2 )
 		goto stop;
 	
 // Unimplemented
 	
-	case 0xFF: // force 256-entry jump table for optimization purposes
+	OPCODE( 0xFF ) // force 256-entry jump table for optimization purposes
 		c |= 1;
-	default:
+	OPCODE( 0x03 ) OPCODE( 0x07 ) OPCODE( 0x0B ) OPCODE( 0x0F ) OPCODE( 0x13 ) OPCODE( 0x17 )
+	OPCODE( 0x1B ) OPCODE( 0x1F ) OPCODE( 0x23 ) OPCODE( 0x27 ) OPCODE( 0x2B ) OPCODE( 0x2F )
+	OPCODE( 0x33 ) OPCODE( 0x37 ) OPCODE( 0x3B ) OPCODE( 0x3F ) OPCODE( 0x43 ) OPCODE( 0x47 )
+	OPCODE( 0x4B ) OPCODE( 0x4F ) OPCODE( 0x53 ) OPCODE( 0x57 ) OPCODE( 0x5B ) OPCODE( 0x5F )
+	OPCODE( 0x63 ) OPCODE( 0x67 ) OPCODE( 0x6B ) OPCODE( 0x6F ) OPCODE( 0x73 ) OPCODE( 0x77 )
+	OPCODE( 0x7B ) OPCODE( 0x7F ) OPCODE( 0x83 ) OPCODE( 0x87 ) OPCODE( 0x8B ) OPCODE( 0x8F )
+	OPCODE( 0x93 ) OPCODE( 0x97 ) OPCODE( 0x9B ) OPCODE( 0x9C ) OPCODE( 0x9E ) OPCODE( 0x9F )
+	OPCODE( 0xA3 ) OPCODE( 0xA7 ) OPCODE( 0xAB ) OPCODE( 0xAF ) OPCODE( 0xB3 ) OPCODE( 0xB7 )
+	OPCODE( 0xBB ) OPCODE( 0xBF ) OPCODE( 0xC3 ) OPCODE( 0xC7 ) OPCODE( 0xCB ) OPCODE( 0xCF )
+	OPCODE( 0xD3 ) OPCODE( 0xD7 ) OPCODE( 0xDB ) OPCODE( 0xDF ) OPCODE( 0xE3 ) OPCODE( 0xE7 )
+	OPCODE( 0xEF ) OPCODE( 0xF3 ) OPCODE( 0xF7 ) OPCODE( 0xFB )
 		check( (unsigned) opcode <= 0xFF );
 		// skip over proper number of bytes
 		static unsigned char const illop_lens [8] = {
 			0x40, 0x40, 0x40, 0x80, 0x40, 0x40, 0x80, 0xA0
 		};
-		fuint8 opcode = instr [-1];
-		fint16 len = illop_lens [opcode >> 2 & 7] >> (opcode << 1 & 6) & 3;
-		if ( opcode == 0x9C )
+		fuint8 op = instr [-1]; // (not opcode, which NEXT_INSTR() sets)
+		fint16 len = illop_lens [op >> 2 & 7] >> (op << 1 & 6) & 3;
+		if ( op == 0x9C )
 			len = 2;
 		pc += len;
 		error_count_++;
 		
-		if ( (opcode >> 4) == 0x0B )
+		if ( (op >> 4) == 0x0B )
 		{
-			if ( opcode == 0xB3 )
+			if ( op == 0xB3 )
 				data = READ_LOW( data );
-			if ( opcode != 0xB7 )
+			if ( op != 0xB7 )
 				HANDLE_PAGE_CROSSING( data + y );
 		}
-		goto loop;
+		NEXT_INSTR();
 	}
 	assert( false );
 	
@@ -70,7 +70,7 @@ void Nsf_Emu::unload()
 	}
 	#endif
 	
-	rom.clear();
+	// rom is kept so that loading another file can reuse it
 	Music_Emu::unload();
 }
 
@@ -524,6 +524,9 @@ blargg_err_t Nsf_Emu::run_clocks( blip_time_t& duration, int )
 				check( saved_state.pc == badop_addr );
 				if ( r.pc != badop_addr )
 					saved_state = cpu::r;
+				else if ( loop_searching() )
+					loop_checkpoint( hash_state( sram, sizeof sram,
+							hash_state( low_mem, sizeof low_mem ) ), track_time( time() ) );
 				
 				r.pc = play_addr;
 				low_mem [0x100 + r.sp--] = (badop_addr - 1) >> 8;
@@ -23,10 +23,12 @@ int const timer_disabled_time = 127;
 Snes_Spc::Snes_Spc() : dsp( mem.ram ), cpu( this, mem.ram )
 {
 	set_tempo( 1.0 );
+	set_tick_hook( NULL );
 	
 	// Put STOP instruction around memory to catch PC underflow/overflow.
 	memset( mem.padding1, 0xFF, sizeof mem.padding1 );
 	memset( mem.padding2, 0xFF, sizeof mem.padding2 );
+	memset( ram_written_, 1, sizeof ram_written_ );
 	
 	// A few tracks read from the last four bytes of IPL ROM
 	boot_rom [sizeof boot_rom - 2] = 0xC0;
@@ -101,6 +103,7 @@ void Snes_Spc::clear_echo()
 		unsigned addr = 0x100 * dsp.read( 0x6D );
 		size_t   size = 0x800 * dsp.read( 0x7D );
 		memset( mem.ram + addr, 0xFF, min( size, sizeof mem.ram - addr ) );
+		memset( ram_written_, 1, sizeof ram_written_ );
 	}
 }
 
@@ -122,6 +125,7 @@ blargg_err_t Snes_Spc::load_state( const registers_t& cpu_state, const void* new
 	// ram
 	memcpy( mem.ram, new_ram, sizeof mem.ram );
 	memcpy( extra_ram, mem.ram + rom_addr, sizeof extra_ram );
+	memset( ram_written_, 1, sizeof ram_written_ );
 	
 	// boot rom (have to force enable_rom() to update it)
 	rom_enabled = !(mem.ram [0xF1] & 0x80);
@@ -256,6 +260,8 @@ int Snes_Spc::read( spc_addr_t addr )
 			t.run_until( time() );
 			int old = t.counter;
 			t.counter = 0;
+			if ( old && tick_func )
+				tick_func( tick_data, time() );
 			return old;
 		}
 		
@@ -290,6 +296,7 @@ void Snes_Spc::enable_rom( bool enable )
 	{
 		rom_enabled = enable;
 		memcpy( mem.ram + rom_addr, (enable ? boot_rom : extra_ram), rom_size );
+		ram_written_ [rom_addr >> 8] = 1;
 		// TODO: ROM can still get overwritten when DSP writes to echo buffer
 	}
 }
@@ -305,6 +312,7 @@ void Snes_Spc::write( spc_addr_t addr, int data )
 		// RAM
 		default:
 			check(( check_for_echo_access( addr ), true ));
+			ram_written_ [addr >> 8] = 1;
 			if ( addr < rom_addr ) {
 				mem.ram [addr] = (uint8_t) data;
 			}
@@ -44,15 +44,33 @@ public:
 	// If true, prevent channels and global volumes from being phase-negated
 	void disable_surround( bool disable = true );
 	
+	// Write each voice's own output to out [n] during play() (see Spc_Dsp.h)
+	void set_voice_outputs( sample_t* const* out );
+	
 	// Set 128 bytes to use for IPL boot ROM. Makes copy. Default is zero filled,
 	// to avoid including copyrighted code from the SPC-700.
 	void set_ipl_rom( const void* );
 	
 	void set_tempo( double );
 	
+	// Set function to call when a timer's counter is read back non-zero, which is
+	// how music drivers pace their song. 'time' is in CPU clocks (1.024 MHz)
+	// relative to the end of the current play(), so it's zero or negative.
+	typedef void (*tick_func_t)( void* user_data, long time );
+	void set_tick_hook( tick_func_t, void* user_data = NULL );
+	
+	// Current RAM and DSP register contents
+	typedef BOOST::uint8_t uint8_t;
+	uint8_t const* ram() const { return mem.ram; }
+	int dsp_reg( int i ) { return dsp.read( i ); }
+	
+	// One flag for each 256-byte page of RAM, set when the CPU writes to the page or
+	// RAM is reloaded, and left for the caller to clear. Writes to the first two
+	// pages aren't tracked.
+	uint8_t* ram_written() { return ram_written_; }
+	
 public:
 	Snes_Spc();
-	typedef BOOST::uint8_t uint8_t;
 private:
 	// timers
 	struct Timer
@@ -73,6 +91,8 @@ private:
 	};
 	enum { timer_count = 3 };
 	Timer timer [timer_count];
+	tick_func_t tick_func;
+	void* tick_data;
 
 	// hardware
 	int extra_cycles;
@@ -110,12 +130,21 @@ private:
 		uint8_t padding2 [0x100];
 	} mem;
 	uint8_t boot_rom [rom_size];
+	uint8_t ram_written_ [0x100];
 };
 
 inline void Snes_Spc::disable_surround( bool disable ) { dsp.disable_surround( disable ); }
 
 inline void Snes_Spc::mute_voices( int mask ) { dsp.mute_voices( mask ); }
 
+inline void Snes_Spc::set_voice_outputs( sample_t* const* out ) { dsp.set_voice_outputs( out ); }
+
 inline void Snes_Spc::set_gain( double v ) { dsp.set_gain( v ); }
 
+inline void Snes_Spc::set_tick_hook( tick_func_t f, void* data )
+{
+	tick_func = f;
+	tick_data = data;
+}
+
 #endif
@@ -3,6 +3,7 @@
 #include "Spc_Cpu.h"
 
 #include "blargg_endian.h"
+#include "blargg_dispatch.h"
 #include "Snes_Spc.h"
 
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
@@ -162,7 +163,6 @@ spc_time_t Spc_Cpu::run( spc_time_t cycle_count )
 cbranch_taken_loop: // compare and branch
 	pc += (BOOST::int8_t) READ_PROG( pc );
 	remain_ -= 2;
-inc_pc_loop: // end of instruction with an operand
 	pc++;
 loop:
 	
@@ -185,9 +185,28 @@ loop:
 	
 	// Use 'data' for temporaries whose lifetime crosses read/write calls, otherwise
 	// use a local temporary.
-	switch ( opcode )
+	OPCODE_SWITCH( opcode )
 	{
 	
+	// With computed goto, each opcode fetches and dispatches the next one the same
+	// way loop does, rather than all of them sharing the indirect jump at loop
+	#if BLARGG_COMPUTED_GOTO
+		#define NEXT_INSTR() do {\
+			opcode = READ_PROG( pc );\
+			pc++;\
+			data = READ_PROG( pc );\
+			if ( remain_ <= 0 )\
+				goto stop;\
+			remain_ -= cycle_table [opcode];\
+			OPCODE_DISPATCH( opcode );\
+		} while ( 0 )
+	#else
+		#define NEXT_INSTR() goto loop
+	#endif
+	
+	// end of instruction with an operand
+	#define INC_PC_NEXT_INSTR() do { pc++; NEXT_INSTR(); } while ( 0 )
+	
 	#define BRANCH( cond ) {\
 		pc++;\
 		int offset = (BOOST::int8_t) data;\
@@ -195,279 +214,281 @@ loop:
 			pc += offset;\
 			remain_ -= 2;\
 		}\
-		goto loop;\
+		NEXT_INSTR();\
 	}
 	
 // Most-Common
 
-	case 0xF0: // BEQ (most common)
+	OPCODE( 0xF0 ) // BEQ (most common)
 		BRANCH( !(uint8_t) nz )
 	
-	case 0xD0: // BNE
+	OPCODE( 0xD0 ) // BNE
 		BRANCH( (uint8_t) nz )
 	
-	case 0x3F: // CALL
+	OPCODE( 0x3F ) // CALL
 		PUSH16( pc + 2 );
 		pc = READ_PROG16( pc );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x6F: // RET
+	OPCODE( 0x6F ) // RET
 		pc = POP();
 		pc += POP() * 0x100;
-		goto loop;
+		NEXT_INSTR();
 
-#define CASE( n )   case n:
+#define CASE( n )   OPCODE( n )
 
 // Define common address modes based on opcode for immediate mode. Execution
-// ends with data set to the address of the operand.
-#define ADDR_MODES( op )\
-	CASE( op - 0x02 ) /* (X) */\
+// ends with data set to the address of the operand. Opcodes are listed in the
+// order op (imm), (X), (dp)+Y, (dp+X), abs+Y, abs+X, abs, dp+X, dp
+#define ADDR_MODES( op, x_ind, ind_y, ind_x, abs_y, abs_x, abs, dp_x, direct )\
+	CASE( x_ind ) /* (X) */\
 		data = x + dp;\
 		pc--;\
 		goto end_##op;\
-	CASE( op + 0x0F ) /* (dp)+Y */\
+	CASE( ind_y ) /* (dp)+Y */\
 		data = READ_PROG16( data + dp ) + y;\
 		goto end_##op;\
-	CASE( op - 0x01 ) /* (dp+X) */\
+	CASE( ind_x ) /* (dp+X) */\
 		data = READ_PROG16( uint8_t (data + x) + dp );\
 		goto end_##op;\
-	CASE( op + 0x0E ) /* abs+Y */\
+	CASE( abs_y ) /* abs+Y */\
 		data += y;\
 		goto abs_##op;\
-	CASE( op + 0x0D ) /* abs+X */\
+	CASE( abs_x ) /* abs+X */\
 		data += x;\
-	CASE( op - 0x03 ) /* abs */\
+	CASE( abs ) /* abs */\
 	abs_##op:\
 		pc++;\
 		data += 0x100 * READ_PROG( pc );\
 		goto end_##op;\
-	CASE( op + 0x0C ) /* dp+X */\
+	CASE( dp_x ) /* dp+X */\
 		data = uint8_t (data + x);\
-	CASE( op - 0x04 ) /* dp */\
+	CASE( direct ) /* dp */\
 		data += dp;\
 	end_##op:
 
 // 1. 8-bit Data Transmission Commands. Group I
 
-	ADDR_MODES( 0xE8 ) // MOV A,addr
+	ADDR_MODES( 0xE8, 0xE6, 0xF7, 0xE7, 0xF6, 0xF5, 0xE5, 0xF4, 0xE4 ) // MOV A,addr
 	// case 0xE4: // MOV a,dp (most common)
 	mov_a_addr:
 		a = nz = READ( data );
-		goto inc_pc_loop;
-	case 0xBF: // MOV A,(X)+
+		INC_PC_NEXT_INSTR();
+	OPCODE( 0xBF ) // MOV A,(X)+
 		data = x + dp;
 		x = uint8_t (x + 1);
 		pc--;
 		goto mov_a_addr;
 	
-	case 0xE8: // MOV A,imm
+	OPCODE( 0xE8 ) // MOV A,imm
 		a = data;
 		nz = data;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0xF9: // MOV X,dp+Y
+	OPCODE( 0xF9 ) // MOV X,dp+Y
 		data = uint8_t (data + y);
-	case 0xF8: // MOV X,dp
+	OPCODE( 0xF8 ) // MOV X,dp
 		data += dp;
 		goto mov_x_addr;
-	case 0xE9: // MOV X,abs
+	OPCODE( 0xE9 ) // MOV X,abs
 		data = READ_PROG16( pc );
 		pc++;
 	mov_x_addr:
 		data = READ( data );
-	case 0xCD: // MOV X,imm
+	OPCODE( 0xCD ) // MOV X,imm
 		x = data;
 		nz = data;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0xFB: // MOV Y,dp+X
+	OPCODE( 0xFB ) // MOV Y,dp+X
 		data = uint8_t (data + x);
-	case 0xEB: // MOV Y,dp
+	OPCODE( 0xEB ) // MOV Y,dp
 		data += dp;
 		goto mov_y_addr;
-	case 0xEC: // MOV Y,abs
+	OPCODE( 0xEC ) // MOV Y,abs
 		data = READ_PROG16( pc );
 		pc++;
 	mov_y_addr:
 		data = READ( data );
-	case 0x8D: // MOV Y,imm
+	OPCODE( 0x8D ) // MOV Y,imm
 		y = data;
 		nz = data;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 
 // 2. 8-BIT DATA TRANSMISSION COMMANDS, GROUP 2
 
-	ADDR_MODES( 0xC8 ) // MOV addr,A
+	ADDR_MODES( 0xC8, 0xC6, 0xD7, 0xC7, 0xD6, 0xD5, 0xC5, 0xD4, 0xC4 ) // MOV addr,A
 		WRITE( data, a );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
 	{
 		int temp;
-	case 0xCC: // MOV abs,Y
+	OPCODE( 0xCC ) // MOV abs,Y
 		temp = y;
 		goto mov_abs_temp;
-	case 0xC9: // MOV abs,X
+	OPCODE( 0xC9 ) // MOV abs,X
 		temp = x;
 	mov_abs_temp:
 		WRITE( READ_PROG16( pc ), temp );
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xD9: // MOV dp+Y,X
+	OPCODE( 0xD9 ) // MOV dp+Y,X
 		data = uint8_t (data + y);
-	case 0xD8: // MOV dp,X
+	OPCODE( 0xD8 ) // MOV dp,X
 		WRITE( data + dp, x );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0xDB: // MOV dp+X,Y
+	OPCODE( 0xDB ) // MOV dp+X,Y
 		data = uint8_t (data + x);
-	case 0xCB: // MOV dp,Y
+	OPCODE( 0xCB ) // MOV dp,Y
 		WRITE( data + dp, y );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 
-	case 0xFA: // MOV dp,dp
+	OPCODE( 0xFA ) // MOV dp,dp
 		data = READ( data + dp );
-	case 0x8F: // MOV dp,#imm
+	OPCODE( 0x8F ) // MOV dp,#imm
 		pc++;
 		WRITE_DP( READ_PROG( pc ), data );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
 // 3. 8-BIT DATA TRANSMISSIN COMMANDS, GROUP 3.
 	
-	case 0x7D: // MOV A,X
+	OPCODE( 0x7D ) // MOV A,X
 		a = x;
 		nz = x;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xDD: // MOV A,Y
+	OPCODE( 0xDD ) // MOV A,Y
 		a = y;
 		nz = y;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x5D: // MOV X,A
+	OPCODE( 0x5D ) // MOV X,A
 		x = a;
 		nz = a;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xFD: // MOV Y,A
+	OPCODE( 0xFD ) // MOV Y,A
 		y = a;
 		nz = a;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x9D: // MOV X,SP
+	OPCODE( 0x9D ) // MOV X,SP
 		x = nz = GET_SP();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xBD: // MOV SP,X
+	OPCODE( 0xBD ) // MOV SP,X
 		SET_SP( x );
-		goto loop;
+		NEXT_INSTR();
 	
 	//case 0xC6: // MOV (X),A (handled by MOV addr,A in group 2)
 	
-	case 0xAF: // MOV (X)+,A
+	OPCODE( 0xAF ) // MOV (X)+,A
 		WRITE_DP( x, a );
 		x++;
-		goto loop;
+		NEXT_INSTR();
 	
 // 5. 8-BIT LOGIC OPERATION COMMANDS
 	
-#define LOGICAL_OP( op, func )\
-	ADDR_MODES( op ) /* addr */\
+// Opcodes are listed in the order op (imm), the eight ADDR_MODES ones, X,Y, dp,dp, dp,imm
+#define LOGICAL_OP( op, func, x_ind, ind_y, ind_x, abs_y, abs_x, abs, dp_x, direct, x_y, dp_dp, dp_imm )\
+	ADDR_MODES( op, x_ind, ind_y, ind_x, abs_y, abs_x, abs, dp_x, direct ) /* addr */\
 		data = READ( data );\
-	case op: /* imm */\
+	OPCODE( op ) /* imm */\
 		nz = a func##= data;\
-		goto inc_pc_loop;\
+		INC_PC_NEXT_INSTR();\
 	{   unsigned addr;\
-	case op + 0x11: /* X,Y */\
+	OPCODE( x_y ) /* X,Y */\
 		data = READ_DP( y );\
 		addr = x + dp;\
 		pc--;\
 		goto addr_##op;\
-	case op + 0x01: /* dp,dp */\
+	OPCODE( dp_dp ) /* dp,dp */\
 		data = READ_DP( data );\
-	case op + 0x10: /*dp,imm*/\
+	OPCODE( dp_imm ) /*dp,imm*/\
 		pc++;\
 		addr = READ_PROG( pc ) + dp;\
 	addr_##op:\
 		nz = data func READ( addr );\
 		WRITE( addr, nz );\
-		goto inc_pc_loop;\
+		INC_PC_NEXT_INSTR();\
 	}
 	
-	LOGICAL_OP( 0x28, & ); // AND
+	LOGICAL_OP( 0x28, &, 0x26, 0x37, 0x27, 0x36, 0x35, 0x25, 0x34, 0x24, 0x39, 0x29, 0x38 ); // AND
 	
-	LOGICAL_OP( 0x08, | ); // OR
+	LOGICAL_OP( 0x08, |, 0x06, 0x17, 0x07, 0x16, 0x15, 0x05, 0x14, 0x04, 0x19, 0x09, 0x18 ); // OR
 	
-	LOGICAL_OP( 0x48, ^ ); // EOR
+	LOGICAL_OP( 0x48, ^, 0x46, 0x57, 0x47, 0x56, 0x55, 0x45, 0x54, 0x44, 0x59, 0x49, 0x58 ); // EOR
 	
 // 4. 8-BIT ARITHMETIC OPERATION COMMANDS
 
-	ADDR_MODES( 0x68 ) // CMP addr
+	ADDR_MODES( 0x68, 0x66, 0x77, 0x67, 0x76, 0x75, 0x65, 0x74, 0x64 ) // CMP addr
 		data = READ( data );
-	case 0x68: // CMP imm
+	OPCODE( 0x68 ) // CMP imm
 		nz = a - data;
 		c = ~nz;
 		nz &= 0xFF;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0x79: // CMP (X),(Y)
+	OPCODE( 0x79 ) // CMP (X),(Y)
 		data = READ_DP( x );
 		nz = data - READ_DP( y );
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x69: // CMP (dp),(dp)
+	OPCODE( 0x69 ) // CMP (dp),(dp)
 		data = READ_DP( data );
-	case 0x78: // CMP dp,imm
+	OPCODE( 0x78 ) // CMP dp,imm
 		pc++;
 		nz = READ_DP( READ_PROG( pc ) ) - data;
 		c = ~nz;
 		nz &= 0xFF;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0x3E: // CMP X,dp
+	OPCODE( 0x3E ) // CMP X,dp
 		data += dp;
 		goto cmp_x_addr;
-	case 0x1E: // CMP X,abs
+	OPCODE( 0x1E ) // CMP X,abs
 		data = READ_PROG16( pc );
 		pc++;
 	cmp_x_addr:
 		data = READ( data );
-	case 0xC8: // CMP X,imm
+	OPCODE( 0xC8 ) // CMP X,imm
 		nz = x - data;
 		c = ~nz;
 		nz &= 0xFF;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0x7E: // CMP Y,dp
+	OPCODE( 0x7E ) // CMP Y,dp
 		data += dp;
 		goto cmp_y_addr;
-	case 0x5E: // CMP Y,abs
+	OPCODE( 0x5E ) // CMP Y,abs
 		data = READ_PROG16( pc );
 		pc++;
 	cmp_y_addr:
 		data = READ( data );
-	case 0xAD: // CMP Y,imm
+	OPCODE( 0xAD ) // CMP Y,imm
 		nz = y - data;
 		c = ~nz;
 		nz &= 0xFF;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
 	{
 		int addr;
-	case 0xB9: // SBC (x),(y)
-	case 0x99: // ADC (x),(y)
+	OPCODE( 0xB9 ) // SBC (x),(y)
+	OPCODE( 0x99 ) // ADC (x),(y)
 		pc--; // compensate for inc later
 		data = READ_DP( x );
 		addr = y + dp;
 		goto adc_addr;
-	case 0xA9: // SBC dp,dp
-	case 0x89: // ADC dp,dp
+	OPCODE( 0xA9 ) // SBC dp,dp
+	OPCODE( 0x89 ) // ADC dp,dp
 		data = READ_DP( data );
-	case 0xB8: // SBC dp,imm
-	case 0x98: // ADC dp,imm
+	OPCODE( 0xB8 ) // SBC dp,imm
+	OPCODE( 0x98 ) // ADC dp,imm
 		pc++;
 		addr = READ_PROG( pc ) + dp;
 	adc_addr:
@@ -476,11 +497,12 @@ loop:
 		
 // catch ADC and SBC together, then decode later based on operand
 #undef CASE
-#define CASE( n ) case n: case (n) + 0x20:
-	ADDR_MODES( 0x88 ) // ADC/SBC addr
+#define CASE( n ) CASE_ADC_SBC_ n
+#define CASE_ADC_SBC_( adc, sbc ) OPCODE( adc ) OPCODE( sbc )
+	ADDR_MODES( 0x88, (0x86, 0xA6), (0x97, 0xB7), (0x87, 0xA7), (0x96, 0xB6), (0x95, 0xB5), (0x85, 0xA5), (0x94, 0xB4), (0x84, 0xA4) ) // ADC/SBC addr
 		data = READ( data );
-	case 0xA8: // SBC imm
-	case 0x88: // ADC imm
+	OPCODE( 0xA8 ) // SBC imm
+	OPCODE( 0x88 ) // ADC imm
 		addr = -1; // A
 		nz = a;
 	adc_data: {
@@ -494,10 +516,10 @@ loop:
 		status = (status & ~(st_v | st_h)) | ((ov >> 2) & st_v) | ((hc >> 1) & st_h);
 		if ( addr < 0 ) {
 			a = (uint8_t) nz;
-			goto inc_pc_loop;
+			INC_PC_NEXT_INSTR();
 		}
 		WRITE( addr, (uint8_t) nz );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	}
 	
 	}
@@ -507,90 +529,90 @@ loop:
 #define INC_DEC_REG( reg, n )\
 		nz = reg + n;\
 		reg = (uint8_t) nz;\
-		goto loop;
+		NEXT_INSTR();
 
-	case 0xBC: INC_DEC_REG( a, 1 )  // INC A
-	case 0x3D: INC_DEC_REG( x, 1 )  // INC X
-	case 0xFC: INC_DEC_REG( y, 1 )  // INC Y
+	OPCODE( 0xBC ) INC_DEC_REG( a, 1 )  // INC A
+	OPCODE( 0x3D ) INC_DEC_REG( x, 1 )  // INC X
+	OPCODE( 0xFC ) INC_DEC_REG( y, 1 )  // INC Y
 	
-	case 0x9C: INC_DEC_REG( a, -1 ) // DEC A
-	case 0x1D: INC_DEC_REG( x, -1 ) // DEC X
-	case 0xDC: INC_DEC_REG( y, -1 ) // DEC Y
+	OPCODE( 0x9C ) INC_DEC_REG( a, -1 ) // DEC A
+	OPCODE( 0x1D ) INC_DEC_REG( x, -1 ) // DEC X
+	OPCODE( 0xDC ) INC_DEC_REG( y, -1 ) // DEC Y
 
-	case 0x9B: // DEC dp+X
-	case 0xBB: // INC dp+X
+	OPCODE( 0x9B ) // DEC dp+X
+	OPCODE( 0xBB ) // INC dp+X
 		data = uint8_t (data + x);
-	case 0x8B: // DEC dp
-	case 0xAB: // INC dp
+	OPCODE( 0x8B ) // DEC dp
+	OPCODE( 0xAB ) // INC dp
 		data += dp;
 		goto inc_abs;
-	case 0x8C: // DEC abs
-	case 0xAC: // INC abs
+	OPCODE( 0x8C ) // DEC abs
+	OPCODE( 0xAC ) // INC abs
 		data = READ_PROG16( pc );
 		pc++;
 	inc_abs:
 		nz = ((opcode >> 4) & 2) - 1;
 		nz += READ( data );
 		WRITE( data, (uint8_t) nz );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
 // 7. SHIFT, ROTATION COMMANDS
 
-	case 0x5C: // LSR A
+	OPCODE( 0x5C ) // LSR A
 		c = 0;
-	case 0x7C:{// ROR A
+	OPCODE( 0x7C ){// ROR A
 		nz = ((c >> 1) & 0x80) | (a >> 1);
 		c = a << 8;
 		a = nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x1C: // ASL A
+	OPCODE( 0x1C ) // ASL A
 		c = 0;
-	case 0x3C:{// ROL A
+	OPCODE( 0x3C ){// ROL A
 		int temp = (c >> 8) & 1;
 		c = a << 1;
 		nz = c | temp;
 		a = (uint8_t) nz;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x0B: // ASL dp
+	OPCODE( 0x0B ) // ASL dp
 		c = 0;
 		data += dp;
 		goto rol_mem;
-	case 0x1B: // ASL dp+X
+	OPCODE( 0x1B ) // ASL dp+X
 		c = 0;
-	case 0x3B: // ROL dp+X
+	OPCODE( 0x3B ) // ROL dp+X
 		data = uint8_t (data + x);
-	case 0x2B: // ROL dp
+	OPCODE( 0x2B ) // ROL dp
 		data += dp;
 		goto rol_mem;
-	case 0x0C: // ASL abs
+	OPCODE( 0x0C ) // ASL abs
 		c = 0;
-	case 0x2C: // ROL abs
+	OPCODE( 0x2C ) // ROL abs
 		data = READ_PROG16( pc );
 		pc++;
 	rol_mem:
 		nz = (c >> 8) & 1;
 		nz |= (c = READ( data ) << 1);
 		WRITE( data, (uint8_t) nz );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0x4B: // LSR dp
+	OPCODE( 0x4B ) // LSR dp
 		c = 0;
 		data += dp;
 		goto ror_mem;
-	case 0x5B: // LSR dp+X
+	OPCODE( 0x5B ) // LSR dp+X
 		c = 0;
-	case 0x7B: // ROR dp+X
+	OPCODE( 0x7B ) // ROR dp+X
 		data = uint8_t (data + x);
-	case 0x6B: // ROR dp
+	OPCODE( 0x6B ) // ROR dp
 		data += dp;
 		goto ror_mem;
-	case 0x4C: // LSR abs
+	OPCODE( 0x4C ) // LSR abs
 		c = 0;
-	case 0x6C: // ROR abs
+	OPCODE( 0x6C ) // ROR abs
 		data = READ_PROG16( pc );
 		pc++;
 	ror_mem: {
@@ -598,31 +620,31 @@ loop:
 		nz = ((c >> 1) & 0x80) | (temp >> 1);
 		c = temp << 8;
 		WRITE( data, nz );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	}
 
-	case 0x9F: // XCN
+	OPCODE( 0x9F ) // XCN
 		nz = a = (a >> 4) | uint8_t (a << 4);
-		goto loop;
+		NEXT_INSTR();
 
 // 8. 16-BIT TRANSMISION COMMANDS
 
-	case 0xBA: // MOVW YA,dp
+	OPCODE( 0xBA ) // MOVW YA,dp
 		a = READ_DP( data );
 		nz = (a & 0x7F) | (a >> 1);
 		y = READ_DP( uint8_t (data + 1) );
 		nz |= y;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0xDA: // MOVW dp,YA
+	OPCODE( 0xDA ) // MOVW dp,YA
 		WRITE_DP( data, a );
 		WRITE_DP( uint8_t (data + 1), y );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
 // 9. 16-BIT OPERATION COMMANDS
 
-	case 0x3A: // INCW dp
-	case 0x1A:{// DECW dp
+	OPCODE( 0x3A ) // INCW dp
+	OPCODE( 0x1A ){// DECW dp
 		data += dp;
 		
 		// low byte
@@ -638,11 +660,11 @@ loop:
 		nz |= temp;
 		WRITE( data, temp );
 		
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	}
 		
-	case 0x9A: // SUBW YA,dp
-	case 0x7A: // ADDW YA,dp
+	OPCODE( 0x9A ) // SUBW YA,dp
+	OPCODE( 0x7A ) // ADDW YA,dp
 	{
 		// read 16-bit addend
 		int temp = READ_DP( data );
@@ -677,10 +699,10 @@ loop:
 		
 		y = (uint8_t) c;
 		
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	}
 	
-	case 0x5A: { // CMPW YA,dp
+	OPCODE( 0x5A ) { // CMPW YA,dp
 		int temp = a - READ_DP( data );
 		nz = ((temp >> 1) | temp) & 0x7F;
 		temp = y + (temp >> 8);
@@ -688,21 +710,21 @@ loop:
 		nz |= temp;
 		c = ~temp;
 		nz &= 0xFF;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	}
 	
 // 10. MULTIPLICATION & DIVISON COMMANDS
 
-	case 0xCF: { // MUL YA
+	OPCODE( 0xCF ) { // MUL YA
 		unsigned temp = y * a;
 		a = (uint8_t) temp;
 		nz = ((temp >> 1) | temp) & 0x7F;
 		y = temp >> 8;
 		nz |= y;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x9E: // DIV YA,X
+	OPCODE( 0x9E ) // DIV YA,X
 	{
 		// behavior based on SPC CPU tests
 		
@@ -729,7 +751,7 @@ loop:
 		nz = (uint8_t) a;
 		a = (uint8_t) a;
 		
-		goto loop;
+		NEXT_INSTR();
 	}
 	
 // 11. DECIMAL COMPENSATION COMMANDS
@@ -740,86 +762,86 @@ loop:
 	
 // 12. BRANCHING COMMANDS
 
-	case 0x2F: // BRA rel
+	OPCODE( 0x2F ) // BRA rel
 		pc += (BOOST::int8_t) data;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0x30: // BMI
+	OPCODE( 0x30 ) // BMI
 		BRANCH( IS_NEG )
 	
-	case 0x10: // BPL
+	OPCODE( 0x10 ) // BPL
 		BRANCH( !IS_NEG )
 	
-	case 0xB0: // BCS
+	OPCODE( 0xB0 ) // BCS
 		BRANCH( c & 0x100 )
 	
-	case 0x90: // BCC
+	OPCODE( 0x90 ) // BCC
 		BRANCH( !(c & 0x100) )
 	
-	case 0x70: // BVS
+	OPCODE( 0x70 ) // BVS
 		BRANCH( status & st_v )
 	
-	case 0x50: // BVC
+	OPCODE( 0x50 ) // BVC
 		BRANCH( !(status & st_v) )
 	
-	case 0x03: // BBS dp.bit,rel
-	case 0x23:
-	case 0x43:
-	case 0x63:
-	case 0x83:
-	case 0xA3:
-	case 0xC3:
-	case 0xE3:
+	OPCODE( 0x03 ) // BBS dp.bit,rel
+	OPCODE( 0x23 )
+	OPCODE( 0x43 )
+	OPCODE( 0x63 )
+	OPCODE( 0x83 )
+	OPCODE( 0xA3 )
+	OPCODE( 0xC3 )
+	OPCODE( 0xE3 )
 		pc++;
 		if ( (READ_DP( data ) >> (opcode >> 5)) & 1 )
 			goto cbranch_taken_loop;
-		goto inc_pc_loop;
-	
-	case 0x13: // BBC dp.bit,rel
-	case 0x33:
-	case 0x53:
-	case 0x73:
-	case 0x93:
-	case 0xB3:
-	case 0xD3:
-	case 0xF3:
+		INC_PC_NEXT_INSTR();
+	
+	OPCODE( 0x13 ) // BBC dp.bit,rel
+	OPCODE( 0x33 )
+	OPCODE( 0x53 )
+	OPCODE( 0x73 )
+	OPCODE( 0x93 )
+	OPCODE( 0xB3 )
+	OPCODE( 0xD3 )
+	OPCODE( 0xF3 )
 		pc++;
 		if ( !((READ_DP( data ) >> (opcode >> 5)) & 1) )
 			goto cbranch_taken_loop;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0xDE: // CBNE dp+X,rel
+	OPCODE( 0xDE ) // CBNE dp+X,rel
 		data = uint8_t (data + x);
 		// fall through
-	case 0x2E: // CBNE dp,rel
+	OPCODE( 0x2E ) // CBNE dp,rel
 		pc++;
 		if ( READ_DP( data ) != a )
 			goto cbranch_taken_loop;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	
-	case 0xFE: // DBNZ Y,rel
+	OPCODE( 0xFE ) // DBNZ Y,rel
 		y = uint8_t (y - 1);
 		BRANCH( y )
 	
-	case 0x6E: { // DBNZ dp,rel
+	OPCODE( 0x6E ) { // DBNZ dp,rel
 		pc++;
 		unsigned temp = READ_DP( data ) - 1;
 		WRITE_DP( (uint8_t) data, (uint8_t) temp );
 		if ( temp )
 			goto cbranch_taken_loop;
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	}
 	
-	case 0x1F: // JMP (abs+X)
+	OPCODE( 0x1F ) // JMP (abs+X)
 		pc = READ_PROG16( pc ) + x;
 		// fall through
-	case 0x5F: // JMP abs
+	OPCODE( 0x5F ) // JMP abs
 		pc = READ_PROG16( pc );
-		goto loop;
+		NEXT_INSTR();
 	
 // 13. SUB-ROUTINE CALL RETURN COMMANDS
 	
-	case 0x0F:{// BRK
+	OPCODE( 0x0F ){// BRK
 		check( false ); // untested
 		PUSH16( pc + 1 );
 		pc = READ_PROG16( 0xFFDE ); // vector address verified
@@ -827,111 +849,111 @@ loop:
 		CALC_STATUS( temp );
 		PUSH( temp );
 		status = (status | st_b) & ~st_i;
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x4F: // PCALL offset
+	OPCODE( 0x4F ) // PCALL offset
 		pc++;
 		PUSH16( pc );
 		pc = 0xFF00 + data;
-		goto loop;
-	
-	case 0x01: // TCALL n
-	case 0x11:
-	case 0x21:
-	case 0x31:
-	case 0x41:
-	case 0x51:
-	case 0x61:
-	case 0x71:
-	case 0x81:
-	case 0x91:
-	case 0xA1:
-	case 0xB1:
-	case 0xC1:
-	case 0xD1:
-	case 0xE1:
-	case 0xF1:
+		NEXT_INSTR();
+	
+	OPCODE( 0x01 ) // TCALL n
+	OPCODE( 0x11 )
+	OPCODE( 0x21 )
+	OPCODE( 0x31 )
+	OPCODE( 0x41 )
+	OPCODE( 0x51 )
+	OPCODE( 0x61 )
+	OPCODE( 0x71 )
+	OPCODE( 0x81 )
+	OPCODE( 0x91 )
+	OPCODE( 0xA1 )
+	OPCODE( 0xB1 )
+	OPCODE( 0xC1 )
+	OPCODE( 0xD1 )
+	OPCODE( 0xE1 )
+	OPCODE( 0xF1 )
 		PUSH16( pc );
 		pc = READ_PROG16( 0xFFDE - (opcode >> 3) );
-		goto loop;
+		NEXT_INSTR();
 	
 // 14. STACK OPERATION COMMANDS
 
 	{
 		int temp;
-	case 0x7F: // RET1
+	OPCODE( 0x7F ) // RET1
 		temp = POP();
 		pc = POP();
 		pc |= POP() << 8;
 		goto set_status;
-	case 0x8E: // POP PSW
+	OPCODE( 0x8E ) // POP PSW
 		temp = POP();
 	set_status:
 		SET_STATUS( temp );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x0D: { // PUSH PSW
+	OPCODE( 0x0D ) { // PUSH PSW
 		int temp;
 		CALC_STATUS( temp );
 		PUSH( temp );
-		goto loop;
+		NEXT_INSTR();
 	}
 
-	case 0x2D: // PUSH A
+	OPCODE( 0x2D ) // PUSH A
 		PUSH( a );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x4D: // PUSH X
+	OPCODE( 0x4D ) // PUSH X
 		PUSH( x );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x6D: // PUSH Y
+	OPCODE( 0x6D ) // PUSH Y
 		PUSH( y );
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xAE: // POP A
+	OPCODE( 0xAE ) // POP A
 		a = POP();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xCE: // POP X
+	OPCODE( 0xCE ) // POP X
 		x = POP();
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xEE: // POP Y
+	OPCODE( 0xEE ) // POP Y
 		y = POP();
-		goto loop;
+		NEXT_INSTR();
 	
 // 15. BIT OPERATION COMMANDS
 
-	case 0x02: // SET1
-	case 0x22:
-	case 0x42:
-	case 0x62:
-	case 0x82:
-	case 0xA2:
-	case 0xC2:
-	case 0xE2:
-	case 0x12: // CLR1
-	case 0x32:
-	case 0x52:
-	case 0x72:
-	case 0x92:
-	case 0xB2:
-	case 0xD2:
-	case 0xF2: {
+	OPCODE( 0x02 ) // SET1
+	OPCODE( 0x22 )
+	OPCODE( 0x42 )
+	OPCODE( 0x62 )
+	OPCODE( 0x82 )
+	OPCODE( 0xA2 )
+	OPCODE( 0xC2 )
+	OPCODE( 0xE2 )
+	OPCODE( 0x12 ) // CLR1
+	OPCODE( 0x32 )
+	OPCODE( 0x52 )
+	OPCODE( 0x72 )
+	OPCODE( 0x92 )
+	OPCODE( 0xB2 )
+	OPCODE( 0xD2 )
+	OPCODE( 0xF2 ) {
 		data += dp;
 		int bit = 1 << (opcode >> 5);
 		int mask = ~bit;
 		if ( opcode & 0x10 )
 			bit = 0;
 		WRITE( data, (READ( data ) & mask) | bit );
-		goto inc_pc_loop;
+		INC_PC_NEXT_INSTR();
 	}
 		
-	case 0x0E: // TSET1 abs
-	case 0x4E:{// TCLR1 abs
+	OPCODE( 0x0E ) // TSET1 abs
+	OPCODE( 0x4E ){// TCLR1 abs
 		data = READ_PROG16( pc );
 		pc += 2;
 		unsigned temp = READ( data );
@@ -940,105 +962,108 @@ loop:
 		if ( !(opcode & 0x40) )
 			temp |= a;
 		WRITE( data, temp );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0x4A: // AND1 C,mem.bit
+	OPCODE( 0x4A ) // AND1 C,mem.bit
 		c &= mem_bit( pc );
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x6A: // AND1 C,/mem.bit
+	OPCODE( 0x6A ) // AND1 C,/mem.bit
 		check( false ); // untested
 		c &= ~mem_bit( pc );
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x0A: // OR1 C,mem.bit
+	OPCODE( 0x0A ) // OR1 C,mem.bit
 		check( false ); // untested
 		c |= mem_bit( pc );
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x2A: // OR1 C,/mem.bit
+	OPCODE( 0x2A ) // OR1 C,/mem.bit
 		check( false ); // untested
 		c |= ~mem_bit( pc );
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x8A: // EOR1 C,mem.bit
+	OPCODE( 0x8A ) // EOR1 C,mem.bit
 		c ^= mem_bit( pc );
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xEA: { // NOT1 mem.bit
+	OPCODE( 0xEA ) { // NOT1 mem.bit
 		data = READ_PROG16( pc );
 		pc += 2;
 		unsigned temp = READ( data & 0x1FFF );
 		temp ^= 1 << (data >> 13);
 		WRITE( data & 0x1FFF, temp );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xCA: { // MOV1 mem.bit,C
+	OPCODE( 0xCA ) { // MOV1 mem.bit,C
 		data = READ_PROG16( pc );
 		pc += 2;
 		unsigned temp = READ( data & 0x1FFF );
 		unsigned bit = data >> 13;
 		temp = (temp & ~(1 << bit)) | (((c >> 8) & 1) << bit);
 		WRITE( data & 0x1FFF, temp );
-		goto loop;
+		NEXT_INSTR();
 	}
 	
-	case 0xAA: // MOV1 C,mem.bit
+	OPCODE( 0xAA ) // MOV1 C,mem.bit
 		c = mem_bit( pc );
 		pc += 2;
-		goto loop;
+		NEXT_INSTR();
 	
 // 16. PROGRAM STATUS FLAG OPERATION COMMANDS
 
-	case 0x60: // CLRC
+	OPCODE( 0x60 ) // CLRC
 		c = 0;
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0x80: // SETC
+	OPCODE( 0x80 ) // SETC
 		c = ~0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xED: // NOTC
+	OPCODE( 0xED ) // NOTC
 		c ^= 0x100;
-		goto loop;
+		NEXT_INSTR();
 		
-	case 0xE0: // CLRV
+	OPCODE( 0xE0 ) // CLRV
 		status &= ~(st_v | st_h);
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x20: // CLRP
+	OPCODE( 0x20 ) // CLRP
 		dp = 0;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0x40: // SETP
+	OPCODE( 0x40 ) // SETP
 		dp = 0x100;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xA0: // EI
+	OPCODE( 0xA0 ) // EI
 		check( false ); // untested
 		status |= st_i;
-		goto loop;
+		NEXT_INSTR();
 	
-	case 0xC0: // DI
+	OPCODE( 0xC0 ) // DI
 		check( false ); // untested
 		status &= ~st_i;
-		goto loop;
+		NEXT_INSTR();
 	
 // 17. OTHER COMMANDS
 
-	case 0x00: // NOP
-		goto loop;
+	OPCODE( 0x00 ) // NOP
+		NEXT_INSTR();
 	
 	//case 0xEF: // SLEEP
 	//case 0xFF: // STOP
 	
+	OPCODE( 0xBE ) OPCODE( 0xDF ) OPCODE( 0xEF ) OPCODE( 0xFF )
+		goto stop;
+	
 	} // switch
 	
 	// unhandled instructions fall out of switch so emulator can catch them
@@ -27,8 +27,10 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 
 Spc_Dsp::Spc_Dsp( uint8_t* ram_ ) : ram( ram_ )
 {
+	idle_count = 0;
 	set_gain( 1.0 );
 	mute_voices( 0 );
+	set_voice_outputs( NULL );
 	disable_surround( false );
 	
 	assert( offsetof (globals_t,unused9 [2]) == register_count );
@@ -42,7 +44,19 @@ void Spc_Dsp::mute_voices( int mask )
 		voice_state [i].enabled = (mask >> i & 1) ? 31 : 7;
 }
 
+void Spc_Dsp::set_voice_outputs( short* const* out )
+{
+	for ( int i = 0; i < voice_count; i++ )
+		voice_out [i] = out ? out [i] : NULL;
+}
+
 void Spc_Dsp::reset()
+{
+	idle_count = 0;
+	soft_reset();
+}
+
+void Spc_Dsp::soft_reset()
 {
 	keys = 0;
 	echo_ptr = 0;
@@ -293,6 +307,24 @@ inline int Spc_Dsp::clock_envelope( int v )
 	return envx;
 }
 
+inline void Spc_Dsp::run_noise()
+{
+	if ( g.noise_enables )
+	{
+		noise_count -= env_rates [g.flags & 0x1F];
+		if ( noise_count <= 0 )
+		{
+			noise_count = env_rate_init;
+			
+			noise_amp = BOOST::int16_t (noise * 2);
+			
+			// TODO: switch to Galios style
+			int feedback = (noise << 13) ^ (noise << 14);
+			noise = (feedback & 0x4000) | (noise >> 1);
+		}
+	}
+}
+
 // Clamp n into range -32768 <= n <= 32767
 inline int clamp_16( int n )
 {
@@ -308,7 +340,7 @@ void Spc_Dsp::run( long count, short* out_buf )
 	// Should we just fill the buffer with silence? Flags won't be cleared
 	// during this run so it seems it should keep resetting every sample.
 	if ( g.flags & 0x80 )
-		reset();
+		soft_reset();
 	
 	struct src_dir {
 		char start [2];
@@ -324,6 +356,69 @@ void Spc_Dsp::run( long count, short* out_buf )
 	left_volume  *= emu_gain;
 	right_volume *= emu_gain;
 	
+	// With every voice keyed off and no key on pending, voices output nothing
+	// until the next key on write, so skip them
+	int starting = g.key_ons & ~g.key_offs;
+	for ( int i = 0; i < voice_count; i++ )
+		starting |= voice_state [i].on_cnt;
+	int first_voice = 0;
+	if ( !keys && !starting )
+	{
+		first_voice = voice_count;
+		idle_count += count;
+		g.wave_ended &= ~g.key_ons;
+		for ( int i = 0; i < voice_count; i++ )
+		{
+			voice [i].envx = 0;
+			voice [i].outx = 0;
+			short* vout = voice_out [i];
+			if ( vout )
+			{
+				memset( vout, 0, count * 2 * sizeof *vout );
+				voice_out [i] = vout + count * 2;
+			}
+		}
+		
+		// Echo is inaudible and writes nothing back if its volumes are zero and
+		// writes are disabled. Otherwise it's silent only while history and
+		// echo buffer are all zero.
+		bool echo_off = (g.flags & 0x20) && !g.left_echo_volume && !g.right_echo_volume;
+		bool fir_silent = true;
+		for ( int i = 0; i < 16; i++ )
+			fir_silent &= !(fir_buf [i] [0] | fir_buf [i] [1]);
+		
+		while ( count > 0 && (echo_off || fir_silent) )
+		{
+			// same echo buffer access as below, without any output
+			uint8_t* echo_buf = &ram [(g.echo_page * 0x100 + echo_ptr) & 0xFFFF];
+			int fb_left  = (BOOST::int16_t) GET_LE16( echo_buf     );
+			int fb_right = (BOOST::int16_t) GET_LE16( echo_buf + 2 );
+			if ( (fb_left | fb_right) && !echo_off )
+				break;
+			count--;
+			
+			run_noise();
+			
+			echo_ptr += 4;
+			if ( echo_ptr >= (g.echo_delay & 15) * 0x800 )
+				echo_ptr = 0;
+			
+			short (*fir_pos) [2] = &fir_buf [fir_offset];
+			fir_offset = (fir_offset + 7) & 7;
+			fir_pos [0] [0] = (short) fb_left;
+			fir_pos [0] [1] = (short) fb_right;
+			fir_pos [8] [0] = (short) fb_left;
+			fir_pos [8] [1] = (short) fb_right;
+			
+			if ( out_buf )
+			{
+				out_buf [0] = 0;
+				out_buf [1] = 0;
+				out_buf += 2;
+			}
+		}
+	}
+	
 	while ( --count >= 0 )
 	{
 		// Here we check for keys on/off.  Docs say that successive writes
@@ -335,20 +430,7 @@ void Spc_Dsp::run( long count, short* out_buf )
 		
 		g.wave_ended &= ~g.key_ons; // Keying on a voice resets that bit in ENDX.
 		
-		if ( g.noise_enables )
-		{
-			noise_count -= env_rates [g.flags & 0x1F];
-			if ( noise_count <= 0 )
-			{
-				noise_count = env_rate_init;
-				
-				noise_amp = BOOST::int16_t (noise * 2);
-				
-				// TODO: switch to Galios style
-				int feedback = (noise << 13) ^ (noise << 14);
-				noise = (feedback & 0x4000) | (noise >> 1);
-			}
-		}
+		run_noise();
 		
 		// What is the expected behavior when pitch modulation is enabled on
 		// voice 0? Jurassic Park 2 does this. Assume 0 for now.
@@ -358,7 +440,7 @@ void Spc_Dsp::run( long count, short* out_buf )
 		int echor = 0;
 		int left = 0;
 		int right = 0;
-		for ( int vidx = 0; vidx < voice_count; vidx++ )
+		for ( int vidx = first_voice; vidx < voice_count; vidx++ )
 		{
 			const int vbit = 1 << vidx;
 			raw_voice_t& raw_voice = voice [vidx];
@@ -406,6 +488,13 @@ void Spc_Dsp::run( long count, short* out_buf )
 				raw_voice.envx = 0;
 				raw_voice.outx = 0;
 				prev_outx = 0;
+				short* vout = voice_out [vidx];
+				if ( vout )
+				{
+					vout [0] = 0;
+					vout [1] = 0;
+					voice_out [vidx] = vout + 2;
+				}
 				continue;
 			}
 			
@@ -541,6 +630,21 @@ void Spc_Dsp::run( long count, short* out_buf )
 			}
 			left  += l;
 			right += r;
+			
+			short* vout = voice_out [vidx];
+			if ( vout )
+			{
+				int vl = 0;
+				int vr = 0;
+				if ( !(g.flags & 0x40) )
+				{
+					vl = clamp_16( (l * left_volume ) >> (7 + emu_gain_bits) );
+					vr = clamp_16( (r * right_volume) >> (7 + emu_gain_bits) );
+				}
+				vout [0] = (short) vl;
+				vout [1] = (short) vr;
+				voice_out [vidx] = vout + 2;
+			}
 		}
 		// end of channel loop
 		
@@ -36,6 +36,14 @@ public:
 	// Run DSP for 'count' samples. Write resulting samples to 'buf' if not NULL.
 	void run( long count, short* buf = NULL );
 	
+	// Also write voice n's stereo output, after main volume but without echo,
+	// to out [n] while running, advancing each pointer. NULL stops this.
+	void set_voice_outputs( short* const* out );
+	
+	// Number of samples since reset() that run() spent with every voice keyed
+	// off, where only noise and echo were run
+	long idle_samples() const;
+	
 	
 // End of public interface
 private:
@@ -105,8 +113,12 @@ private:
 	int noise;
 	int noise_count;
 	
+	long idle_count;
+	
 	int surround_threshold;
 	
+	short* voice_out [voice_count];
+	
 	static BOOST::int16_t const gauss [];
 	
 	enum state_t {
@@ -136,6 +148,8 @@ private:
 	
 	voice_t voice_state [voice_count];
 	
+	void soft_reset();
+	void run_noise();
 	int clock_envelope( int );
 };
 
@@ -143,6 +157,8 @@ inline void Spc_Dsp::disable_surround( bool disable ) { surround_threshold = dis
 
 inline void Spc_Dsp::set_gain( double v ) { emu_gain = (int) (v * (1 << emu_gain_bits)); }
 
+inline long Spc_Dsp::idle_samples() const { return idle_count; }
+
 inline int Spc_Dsp::read( int i )
 {
 	assert( (unsigned) i < register_count );
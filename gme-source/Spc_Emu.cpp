@@ -29,9 +29,14 @@ Spc_Emu::Spc_Emu()
 	set_voice_names( names );
 	
 	set_gain( 1.4 );
+	stem_resamplers = 0;
+	apu_time = 0;
+	hashed_echo_begin = -1;
+	hashed_echo_end = -1;
+	apu.set_tick_hook( apu_tick, this );
 }
 
-Spc_Emu::~Spc_Emu() { }
+Spc_Emu::~Spc_Emu() { delete [] stem_resamplers; }
 
 // Track info
 
@@ -254,10 +259,23 @@ blargg_err_t Spc_Emu::set_sample_rate_( long sample_rate )
 	{
 		RETURN_ERR( resampler.buffer_size( native_sample_rate / 20 * 2 ) );
 		resampler.time_ratio( (double) native_sample_rate / sample_rate, 0.9965 );
+		
+		for ( int i = 0; stem_resamplers && i < Snes_Spc::voice_count; i++ )
+		{
+			RETURN_ERR( stem_resamplers [i].buffer_size( native_sample_rate / 20 * 2 ) );
+			stem_resamplers [i].time_ratio( (double) native_sample_rate / sample_rate, 0.9965 );
+		}
 	}
 	return 0;
 }
 
+blargg_err_t Spc_Emu::enable_stems_()
+{
+	if ( !stem_resamplers )
+		CHECK_ALLOC( stem_resamplers = BLARGG_NEW stem_resampler_t [Snes_Spc::voice_count] );
+	return 0;
+}
+
 void Spc_Emu::mute_voices_( int m )
 {
 	Music_Emu::mute_voices_( m );
@@ -283,8 +301,11 @@ blargg_err_t Spc_Emu::start_track_( int track )
 {
 	RETURN_ERR( Music_Emu::start_track_( track ) );
 	resampler.clear();
+	for ( int i = 0; stem_resamplers && i < Snes_Spc::voice_count; i++ )
+		stem_resamplers [i].clear();
 	RETURN_ERR( apu.load_spc( file_data, file_size ) );
 	apu.clear_echo();
+	apu_time = 0;
 	return 0;
 }
 
@@ -293,13 +314,18 @@ blargg_err_t Spc_Emu::skip_( long count )
 	if ( sample_rate() != native_sample_rate )
 	{
 		count = long (count * resampler.ratio()) & ~1;
+		for ( int i = 0; stem_resamplers && i < Snes_Spc::voice_count; i++ )
+			stem_resamplers [i].skip_input( count );
 		count -= resampler.skip_input( count );
 	}
 	
 	// TODO: shouldn't skip be adjusted for the 64 samples read afterwards?
 	
 	if ( count > 0 )
+	{
 		RETURN_ERR( apu.skip( count ) );
+		apu_time += count / 2;
+	}
 	
 	// eliminate pop due to resampler
 	const int resampler_latency = 64;
@@ -309,8 +335,11 @@ blargg_err_t Spc_Emu::skip_( long count )
 
 blargg_err_t Spc_Emu::play_( long count, sample_t* out )
 {
+	if ( stem_resamplers )
+		return play_stems_( count, out );
+	
 	if ( sample_rate() == native_sample_rate )
-		return apu.play( count, out );
+		return play_apu( count, out );
 	
 	long remain = count;
 	while ( remain > 0 )
@@ -319,10 +348,142 @@ blargg_err_t Spc_Emu::play_( long count, sample_t* out )
 		if ( remain > 0 )
 		{
 			long n = resampler.max_write();
-			RETURN_ERR( apu.play( n, resampler.buffer() ) );
+			RETURN_ERR( play_apu( n, resampler.buffer() ) );
+			resampler.write( n );
+		}
+	}
+	check( remain == 0 );
+	return 0;
+}
+
+// Same as play_(), but also resamples each voice's output from the DSP
+blargg_err_t Spc_Emu::play_stems_( long count, sample_t* out )
+{
+	int const voice_count = Snes_Spc::voice_count;
+	sample_t* voice_out [voice_count];
+	
+	if ( sample_rate() == native_sample_rate )
+	{
+		for ( int i = 0; i < voice_count; i++ )
+			voice_out [i] = stem_out() ? stem_out() + i * stem_stride() : NULL;
+		apu.set_voice_outputs( voice_out );
+		blargg_err_t err = play_apu( count, out );
+		apu.set_voice_outputs( NULL );
+		return err;
+	}
+	
+	long remain = count;
+	while ( remain > 0 )
+	{
+		long pos = count - remain;
+		int read = resampler.read( &out [pos], remain );
+		remain -= read;
+		
+		for ( int i = 0; i < voice_count; i++ )
+		{
+			if ( stem_out() )
+			{
+				stem_resamplers [i].read( stem_out() + i * stem_stride() + pos, read );
+			}
+			else
+			{
+				// discard, keeping the resampler in step with the main one
+				sample_t scratch [256];
+				for ( int left = read; left > 0; )
+					left -= stem_resamplers [i].read( scratch, min( left, (int) (sizeof scratch / sizeof *scratch) ) );
+			}
+		}
+		
+		if ( remain > 0 )
+		{
+			long n = resampler.max_write();
+			for ( int i = 0; i < voice_count; i++ )
+				voice_out [i] = stem_resamplers [i].buffer();
+			apu.set_voice_outputs( voice_out );
+			blargg_err_t err = play_apu( n, resampler.buffer() );
+			apu.set_voice_outputs( NULL );
+			RETURN_ERR( err );
 			resampler.write( n );
+			for ( int i = 0; i < voice_count; i++ )
+				stem_resamplers [i].write( n );
 		}
 	}
 	check( remain == 0 );
 	return 0;
 }
+
+// Loop detection
+
+blargg_err_t Spc_Emu::play_apu( long count, sample_t* out )
+{
+	apu_time += count / 2;
+	return apu.play( count, out );
+}
+
+void Spc_Emu::apu_tick( void* data, long time )
+{
+	Spc_Emu& emu = *STATIC_CAST(Spc_Emu*,data);
+	if ( !emu.loop_searching() )
+		return;
+	
+	Snes_Spc& apu = emu.apu;
+	byte regs [Spc_Dsp::register_count];
+	for ( int i = 0; i < Spc_Dsp::register_count; i++ )
+		regs [i] = apu.dsp_reg( i );
+	
+	// leave out echo buffer and the DSP's envelope and output readbacks, which
+	// change with the sound rather than the song
+	long echo_begin = 0x10000;
+	long echo_end   = 0x10000;
+	if ( !(regs [0x6C] & 0x20) )
+	{
+		echo_begin = regs [0x6D] * 0x100L;
+		echo_end   = min( echo_begin + max( (regs [0x7D] & 0x0F) * 0x800L, 4L ), 0x10000L );
+	}
+	for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+	{
+		regs [i * 0x10 + 8] = 0;
+		regs [i * 0x10 + 9] = 0;
+	}
+	regs [0x7C] = 0;
+	
+	// the DSP writes the echo buffer without marking pages, so moving it means
+	// rehashing everything
+	byte* written = apu.ram_written();
+	if ( echo_begin != emu.hashed_echo_begin || echo_end != emu.hashed_echo_end )
+	{
+		emu.hashed_echo_begin = echo_begin;
+		emu.hashed_echo_end   = echo_end;
+		memset( written, 1, 0x100 );
+	}
+	
+	// rehash only pages written since the last tick, and the first two pages,
+	// whose writes aren't tracked
+	blargg_ulong hash = hash_state( regs, sizeof regs );
+	for ( long page = 0; page < 0x10000; page += 0x100 )
+	{
+		long end = page + 0x100;
+		if ( end <= echo_begin || page >= echo_end )
+		{
+			blargg_ulong& h = emu.page_hash [page >> 8];
+			if ( written [page >> 8] || page < 0x200 )
+			{
+				written [page >> 8] = 0;
+				h = hash_state( apu.ram() + page, 0x100 );
+			}
+			hash = ((hash ^ h) * 0x01000193) & 0xFFFFFFFF;
+		}
+		else
+		{
+			// partly echo buffer
+			if ( page < echo_begin )
+				hash = hash_state( apu.ram() + page, echo_begin - page, hash );
+			if ( end > echo_end )
+				hash = hash_state( apu.ram() + echo_end, end - echo_end, hash );
+		}
+	}
+	
+	int const clocks_per_sample = 32;
+	double ratio = (emu.sample_rate() == native_sample_rate ? 1.0 : emu.resampler.ratio());
+	emu.loop_checkpoint( hash, (emu.apu_time + (double) time / clocks_per_sample) / ratio / emu.sample_rate() );
+}
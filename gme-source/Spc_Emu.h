@@ -65,11 +65,25 @@ protected:
 	blargg_err_t skip_( long );
 	void mute_voices_( int );
 	void set_tempo_( double );
+	blargg_err_t enable_stems_();
 private:
 	byte const* file_data;
 	long        file_size;
 	Fir_Resampler<24> resampler;
 	Snes_Spc apu;
+	
+	// one resampler per voice, kept in step with the main one
+	typedef Fir_Resampler<24> stem_resampler_t;
+	stem_resampler_t* stem_resamplers; // NULL unless stems are enabled
+	blargg_err_t play_stems_( long, sample_t* );
+	
+	// loop detection
+	double apu_time; // samples from start of track to end of current apu.play()
+	blargg_err_t play_apu( long count, sample_t* out );
+	static void apu_tick( void*, long time );
+	blargg_ulong page_hash [0x100]; // hash of each RAM page, redone once written
+	long hashed_echo_begin;         // echo buffer page_hash was made around
+	long hashed_echo_end;
 };
 
 inline void Spc_Emu::disable_surround( bool b ) { apu.disable_surround( b ); }
@@ -231,9 +231,21 @@ void Vgm_Emu::set_tempo_( double t )
 blargg_err_t Vgm_Emu::set_sample_rate_( long sample_rate )
 {
 	RETURN_ERR( blip_buf.set_sample_rate( sample_rate, 1000 / 30 ) );
+	if ( stems_enabled() )
+	{
+		for ( int i = 0; i < 2; i++ )
+			RETURN_ERR( stem_blip_bufs [i].set_sample_rate( sample_rate, 1000 / 30 ) );
+	}
 	return Classic_Emu::set_sample_rate_( sample_rate );
 }
 
+blargg_err_t Vgm_Emu::enable_stems_()
+{
+	// PSG-only files use Classic_Emu's buffer, FM ones Dual_Resampler
+	RETURN_ERR( Classic_Emu::enable_stems_() );
+	return Dual_Resampler::enable_stems( Ym2612_Emu::channel_count, stem_blip_bufs, 2 );
+}
+
 void Vgm_Emu::update_eq( blip_eq_t const& eq )
 {
 	psg.treble_eq( eq );
@@ -249,10 +261,10 @@ void Vgm_Emu::set_voice( int i, Blip_Buffer* c, Blip_Buffer* l, Blip_Buffer* r )
 void Vgm_Emu::mute_voices_( int mask )
 {
 	Classic_Emu::mute_voices_( mask );
-	dac_synth.output( &blip_buf );
+	dac_synth.output( pcm_buf() );
 	if ( uses_fm )
 	{
-		psg.output( (mask & 0x80) ? 0 : &blip_buf );
+		psg.output( (mask & 0x80) ? 0 : psg_buf() );
 		if ( ym2612.enabled() )
 		{
 			dac_synth.volume( (mask & 0x40) ? 0.0 : 0.1115 / 256 * fm_gain * gain() );
@@ -289,6 +301,8 @@ blargg_err_t Vgm_Emu::load_mem_( byte const* new_data, long new_size )
 	if ( !psg_rate )
 		psg_rate = 3579545;
 	blip_buf.clock_rate( psg_rate );
+	stem_blip_bufs [0].clock_rate( psg_rate );
+	stem_blip_bufs [1].clock_rate( psg_rate );
 	
 	data     = new_data;
 	data_end = new_data + new_size;
@@ -302,6 +316,17 @@ blargg_err_t Vgm_Emu::load_mem_( byte const* new_data, long new_size )
 	
 	RETURN_ERR( setup_fm() );
 	
+	byte const* begin = data + header_size;
+	if ( get_le32( h.version ) >= 0x150 )
+	{
+		long data_offset = get_le32( h.data_offset );
+		check( data_offset );
+		if ( data_offset )
+			begin += data_offset + offsetof (header_t,data_offset) - 0x40;
+	}
+	RETURN_ERR( parse_events( begin ) );
+	RETURN_ERR( build_checkpoints() ); // after setup_fm() since it depends on which chips are enabled
+	
 	static const char* const fm_names [] = {
 		"FM 1", "FM 2", "FM 3", "FM 4", "FM 5", "FM 6", "PCM", "PSG"
 	};
@@ -320,6 +345,7 @@ blargg_err_t Vgm_Emu::setup_fm()
 		update_fm_rates( &ym2413_rate, &ym2612_rate );
 	
 	uses_fm = false;
+	fm_ratio = 0;
 	
 	fm_rate = blip_buf.sample_rate() * oversample_factor;
 	
@@ -328,7 +354,7 @@ blargg_err_t Vgm_Emu::setup_fm()
 		uses_fm = true;
 		if ( disable_oversampling_ )
 			fm_rate = ym2612_rate / 144.0;
-		Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
+		fm_ratio = Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
 		RETURN_ERR( ym2612.set_rate( fm_rate, ym2612_rate ) );
 		ym2612.enable( true );
 		set_voice_count( 8 );
@@ -336,10 +362,12 @@ blargg_err_t Vgm_Emu::setup_fm()
 	
 	if ( !uses_fm && ym2413_rate )
 	{
+		if ( stems_enabled() )
+			return "Per-voice output not supported for YM2413 FM";
 		uses_fm = true;
 		if ( disable_oversampling_ )
 			fm_rate = ym2413_rate / 72.0;
-		Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
+		fm_ratio = Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
 		int result = ym2413.set_rate( fm_rate, ym2413_rate );
 		if ( result == 2 )
 			return "YM2413 FM sound isn't supported";
@@ -371,18 +399,12 @@ blargg_err_t Vgm_Emu::start_track_( int track )
 	psg.reset( get_le16( header().noise_feedback ), header().noise_width );
 	
 	dac_disabled = -1;
-	pos          = data + header_size;
-	pcm_data     = pos;
-	pcm_pos      = pos;
+	pos          = events.begin();
+	pcm_data     = data + header_size;
+	pcm_pos      = pcm_data;
 	dac_amp      = -1;
-	vgm_time     = 0;
-	if ( get_le32( header().version ) >= 0x150 )
-	{
-		long data_offset = get_le32( header().data_offset );
-		check( data_offset );
-		if ( data_offset )
-			pos += data_offset + offsetof (header_t,data_offset) - 0x40;
-	}
+	time_base    = 0;
+	vgm_elapsed  = 0;
 	
 	if ( uses_fm )
 	{
@@ -394,11 +416,35 @@ blargg_err_t Vgm_Emu::start_track_( int track )
 		
 		fm_time_offset = 0;
 		blip_buf.clear();
+		stem_blip_bufs [0].clear();
+		stem_blip_bufs [1].clear();
 		Dual_Resampler::clear();
 	}
 	return 0;
 }
 
+blargg_err_t Vgm_Emu::skip_( long count )
+{
+	// Jump to the latest checkpoint that leaves time for envelopes to settle,
+	// then play the rest silently as usual. Short skips are still played out.
+	long const settle_time = 44100 / 4; // stream samples
+	double const vgm_per_sample = (double) vgm_rate / sample_rate() / stereo;
+	double time;
+	checkpoint_t const* cp = find_checkpoint( vgm_elapsed + count * vgm_per_sample - settle_time, &time );
+	if ( cp && time - vgm_elapsed > 44100 )
+	{
+		count -= (long) ((time - vgm_elapsed) / vgm_per_sample) & ~1L;
+		
+		psg.reset( get_le16( header().noise_feedback ), header().noise_width );
+		if ( ym2413.enabled() )
+			ym2413.reset();
+		if ( ym2612.enabled() )
+			ym2612.reset();
+		restore_checkpoint( *cp, time );
+	}
+	return Classic_Emu::skip_( count );
+}
+
 blargg_err_t Vgm_Emu::run_clocks( blip_time_t& time_io, int msec )
 {
 	time_io = run_commands( msec * vgm_rate / 1000 );
@@ -411,6 +457,6 @@ blargg_err_t Vgm_Emu::play_( long count, sample_t* out )
 	if ( !uses_fm )
 		return Classic_Emu::play_( count, out );
 		
-	Dual_Resampler::dual_play( count, out, blip_buf );
+	Dual_Resampler::dual_play( count, out, blip_buf, stem_out(), stem_stride() );
 	return 0;
 }
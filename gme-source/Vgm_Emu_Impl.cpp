@@ -107,131 +107,626 @@ void Vgm_Emu_Impl::write_pcm( vgm_time_t vgm_time, int amp )
 	int delta = amp - old;
 	dac_amp = amp;
 	if ( old >= 0 )
-		dac_synth.offset_inline( blip_time, delta, &blip_buf );
+		dac_synth.offset_inline( blip_time, delta, pcm_buf() );
 	else
 		dac_amp |= dac_disabled;
 }
 
+double Vgm_Emu_Impl::loop_time( vgm_time_t t ) const
+{
+	if ( !fm_ratio )
+		return track_time( to_blip_time( t ) );
+	
+	// FM output is resampled from fm_time pairs
+	return (vgm_elapsed + t) * fm_time_factor / (1L << fm_time_bits) / fm_ratio / sample_rate();
+}
+
+// Events
+
+static void set_event_index( byte* out, long index )
+{
+	out [0] = (byte) index;
+	out [1] = (byte) (index >> 8);
+	out [2] = (byte) (index >> 16);
+}
+
+static long event_index( byte const* in )
+{
+	return in [2] * 0x10000L + in [1] * 0x100L + in [0];
+}
+
+long const max_event_offsets = 0x1000000;
+
+blargg_err_t Vgm_Emu_Impl::parse_events( byte const* begin )
+{
+	loop_event     = 0;
+	loop_start     = 0;
+	loop_length    = 0;
+	stream_overrun = false;
+	
+	// first pass counts events, second stores them
+	long event_count  = 0;
+	long offset_count = 0;
+	long loop_pos     = -1;
+	for ( int pass = 0; pass < 2; pass++ )
+	{
+		if ( pass )
+		{
+			if ( offset_count > max_event_offsets )
+				return "Too many PCM data commands";
+			RETURN_ERR( events.resize( event_count ) );
+			RETURN_ERR( event_offsets.resize( offset_count ) );
+		}
+		event_t* out = (pass ? events.begin() : 0); // events may hold previous file's
+		long event_pos  = 0;
+		long offset_pos = 0;
+		loop_pos = -1;
+		blargg_long time = 0;
+		byte const* pos = begin;
+		while ( pos < data_end )
+		{
+			if ( loop_pos < 0 && pos >= loop_begin )
+			{
+				loop_pos   = event_pos;
+				loop_start = time;
+			}
+			
+			int cmd = *pos;
+			long len = 1;
+			int delay = 0;
+			bool is_event = true;
+			blargg_long offset = -1;
+			switch ( cmd )
+			{
+			case cmd_end:
+				break;
+			
+			case cmd_delay_735:
+				delay = 735;
+				is_event = false;
+				break;
+			
+			case cmd_delay_882:
+				delay = 882;
+				is_event = false;
+				break;
+			
+			case cmd_gg_stereo:
+			case cmd_psg:
+				len = 2;
+				break;
+			
+			case cmd_delay:
+				len = 3;
+				if ( data_end - pos >= len )
+					delay = pos [2] * 0x100 + pos [1];
+				is_event = false;
+				break;
+			
+			case cmd_byte_delay:
+				len = 2;
+				if ( data_end - pos >= len )
+					delay = pos [1];
+				is_event = false;
+				break;
+			
+			case cmd_ym2413:
+			case cmd_ym2612_port0:
+			case cmd_ym2612_port1:
+				len = 3;
+				break;
+			
+			case cmd_data_block:
+				len = 7;
+				if ( data_end - pos >= len )
+				{
+					check( pos [1] == cmd_end );
+					blargg_ulong size = get_le32( pos + 3 );
+					if ( size > (blargg_ulong) (data_end - pos) )
+						size = data_end - pos; // makes it overrun below
+					len += size;
+					if ( pos [2] == pcm_block_type )
+						offset = pos + 7 - data;
+				}
+				is_event = (offset >= 0);
+				break;
+			
+			case cmd_pcm_seek:
+				len = 5;
+				if ( data_end - pos >= len )
+					offset = get_le32( pos + 1 );
+				break;
+			
+			default:
+				switch ( cmd & 0xF0 )
+				{
+					case cmd_pcm_delay:
+						cmd = cmd_pcm_delay;
+						delay = pos [0] & 0x0F;
+						break;
+					
+					case cmd_short_delay:
+						delay = (pos [0] & 0x0F) + 1;
+						is_event = false;
+						break;
+					
+					case 0x50:
+						len = 3;
+						is_event = false;
+						break;
+					
+					default:
+						// kept so it can be warned about when played
+						len = command_len( cmd );
+				}
+			}
+			
+			if ( data_end - pos < len )
+			{
+				stream_overrun = true;
+				break;
+			}
+			
+			if ( is_event )
+			{
+				if ( out )
+				{
+					event_t& e = out [event_pos];
+					e.time = time;
+					e.cmd  = cmd;
+					e.data [0] = (len > 1 ? pos [1] : 0);
+					e.data [1] = (len > 2 ? pos [2] : 0);
+					e.data [2] = 0;
+					if ( offset >= 0 )
+					{
+						event_offsets [offset_pos] = offset;
+						set_event_index( e.data, offset_pos );
+					}
+				}
+				event_pos++;
+				if ( offset >= 0 )
+					offset_pos++;
+			}
+			
+			pos  += len;
+			time += delay;
+			
+			if ( cmd == cmd_end )
+			{
+				// loop only if it takes time, otherwise playback would never advance
+				if ( loop_pos >= 0 && time > loop_start )
+					loop_length = time - loop_start;
+				break;
+			}
+		}
+		event_count  = event_pos;
+		offset_count = offset_pos;
+	}
+	
+	if ( loop_length )
+		loop_event = &events [loop_pos];
+	return 0;
+}
+
+inline void Vgm_Emu_Impl::run_event( event_t const& e, vgm_time_t vgm_time )
+{
+	switch ( e.cmd )
+	{
+	case cmd_gg_stereo:
+		psg.write_ggstereo( to_blip_time( vgm_time ), e.data [0] );
+		break;
+	
+	case cmd_psg:
+		psg.write_data( to_blip_time( vgm_time ), e.data [0] );
+		break;
+	
+	case cmd_ym2413:
+		if ( ym2413.run_until( to_fm_time( vgm_time ) ) )
+			ym2413.write( e.data [0], e.data [1] );
+		break;
+	
+	case cmd_ym2612_port0:
+		if ( e.data [0] == ym2612_dac_port )
+		{
+			write_pcm( vgm_time, e.data [1] );
+		}
+		else if ( ym2612.run_until( to_fm_time( vgm_time ) ) )
+		{
+			if ( e.data [0] == 0x2B )
+			{
+				dac_disabled = (e.data [1] >> 7 & 1) - 1;
+				dac_amp |= dac_disabled;
+			}
+			ym2612.write0( e.data [0], e.data [1] );
+		}
+		break;
+	
+	case cmd_ym2612_port1:
+		if ( ym2612.run_until( to_fm_time( vgm_time ) ) )
+			ym2612.write1( e.data [0], e.data [1] );
+		break;
+	
+	case cmd_data_block:
+		pcm_data = data + event_offsets [event_index( e.data )];
+		break;
+	
+	case cmd_pcm_seek:
+		pcm_pos = pcm_data + event_offsets [event_index( e.data )];
+		break;
+	
+	case cmd_pcm_delay:
+		write_pcm( vgm_time, *pcm_pos++ );
+		break;
+	
+	default:
+		set_warning( "Unknown stream event" );
+	}
+}
+
 blip_time_t Vgm_Emu_Impl::run_commands( vgm_time_t end_time )
 {
-	vgm_time_t vgm_time = this->vgm_time; 
-	byte const* pos = this->pos;
-	if ( pos >= data_end )
+	event_t const* pos = this->pos;
+	event_t const* const end = events.end();
+	if ( pos >= end )
 	{
 		set_track_ended();
-		if ( pos > data_end )
+		if ( stream_overrun )
 			set_warning( "Stream lacked end event" );
 	}
 	
-	while ( vgm_time < end_time && pos < data_end )
+	while ( pos < end )
 	{
-		// TODO: be sure there are enough bytes left in stream for particular command
-		// so we don't read past end
-		switch ( *pos++ )
-		{
-		case cmd_end:
-			pos = loop_begin; // if not looped, loop_begin == data_end
+		vgm_time_t vgm_time = pos->time - time_base;
+		if ( vgm_time >= end_time )
 			break;
 		
-		case cmd_delay_735:
-			vgm_time += 735;
-			break;
-		
-		case cmd_delay_882:
-			vgm_time += 882;
-			break;
+		if ( pos == loop_event && loop_searching() )
+			loop_checkpoint( loop_start, loop_time( loop_start - time_base ) );
 		
-		case cmd_gg_stereo:
-			psg.write_ggstereo( to_blip_time( vgm_time ), *pos++ );
-			break;
-		
-		case cmd_psg:
-			psg.write_data( to_blip_time( vgm_time ), *pos++ );
-			break;
-		
-		case cmd_delay:
-			vgm_time += pos [1] * 0x100L + pos [0];
-			pos += 2;
+		if ( pos->cmd != cmd_end )
+		{
+			run_event( *pos++, vgm_time );
+		}
+		else if ( loop_event )
+		{
+			pos = loop_event;
+			time_base -= loop_length;
+		}
+		else
+		{
+			pos = end;
+		}
+	}
+	time_base   += end_time;
+	vgm_elapsed += end_time;
+	this->pos = pos;
+	
+	return to_blip_time( end_time );
+}
+
+// Seek checkpoints
+
+long const checkpoint_period = 44100; // stream samples
+
+// Register values as of a point in the stream, mirroring what run_event() does
+struct Vgm_Emu_Impl::chip_state_t
+{
+	enum { max_writes = 13 + 2 * 0x100 + 8 + 0x40 };
+	
+	int psg_latch;
+	int psg_tone [3];
+	int psg_volume [4];
+	int psg_noise;
+	int psg_written; // bit per register, 0x100 for latch
+	int gg_stereo;   // -1 if never written
+	
+	bool ym2612_on;
+	byte ym2612 [2] [0x100];
+	bool ym2612_written [2] [0x100];
+	int ym2612_keys [8]; // last key on/off write per channel, or -1
+	
+	byte ym2413 [0x40];
+	bool ym2413_written [0x40];
+	
+	blargg_long pcm_data;
+	blargg_long pcm_pos;
+	int dac_amp;
+	int dac_disabled;
+	
+	void init( bool ym2612_enabled );
+	void write_psg( int data );
+	void write_pcm( int amp );
+	void write( event_t const&, Vgm_Emu_Impl const& );
+	long save( event_t* out ) const;
+};
+
+void Vgm_Emu_Impl::chip_state_t::init( bool ym2612_enabled )
+{
+	memset( this, 0, sizeof *this );
+	gg_stereo = -1;
+	ym2612_on = ym2612_enabled;
+	for ( int i = 0; i < 8; i++ )
+		ym2612_keys [i] = -1;
+	pcm_data     = Vgm_Emu::header_size;
+	pcm_pos      = Vgm_Emu::header_size;
+	dac_amp      = -1;
+	dac_disabled = -1;
+}
+
+void Vgm_Emu_Impl::chip_state_t::write_psg( int data )
+{
+	// same decoding as Sms_Apu::write_data()
+	if ( data & 0x80 )
+	{
+		psg_latch = data;
+		psg_written |= 0x100;
+	}
+	int index = psg_latch >> 5 & 3;
+	if ( psg_latch & 0x10 )
+	{
+		psg_volume [index] = data & 0x0F;
+		psg_written |= 2 << (index * 2);
+	}
+	else if ( index < 3 )
+	{
+		int& tone = psg_tone [index];
+		if ( data & 0x80 )
+			tone = (tone & 0x3F0) | (data & 0x0F);
+		else
+			tone = (tone & 0x00F) | (data << 4 & 0x3F0);
+		psg_written |= 1 << (index * 2);
+	}
+	else
+	{
+		psg_noise = data & 0x07;
+		psg_written |= 1 << 6;
+	}
+}
+
+void Vgm_Emu_Impl::chip_state_t::write_pcm( int amp )
+{
+	int old = dac_amp;
+	dac_amp = amp;
+	if ( old < 0 )
+		dac_amp |= dac_disabled;
+}
+
+void Vgm_Emu_Impl::chip_state_t::write( event_t const& e, Vgm_Emu_Impl const& emu )
+{
+	int addr = e.data [0];
+	int data = e.data [1];
+	switch ( e.cmd )
+	{
+	case cmd_gg_stereo:
+		gg_stereo = addr;
+		break;
+	
+	case cmd_psg:
+		write_psg( addr );
+		break;
+	
+	case cmd_ym2413:
+		if ( addr < 0x40 )
+		{
+			ym2413 [addr] = data;
+			ym2413_written [addr] = true;
+		}
+		break;
+	
+	case cmd_ym2612_port0:
+		if ( addr == ym2612_dac_port )
+		{
+			write_pcm( data );
 			break;
-		
-		case cmd_byte_delay:
-			vgm_time += *pos++;
+		}
+		if ( !ym2612_on )
 			break;
-		
-		case cmd_ym2413:
-			if ( ym2413.run_until( to_fm_time( vgm_time ) ) )
-				ym2413.write( pos [0], pos [1] );
-			pos += 2;
+		if ( addr == 0x2B )
+		{
+			dac_disabled = (data >> 7 & 1) - 1;
+			dac_amp |= dac_disabled;
+		}
+		if ( addr == 0x28 )
+		{
+			ym2612_keys [data & 7] = data;
 			break;
-		
-		case cmd_ym2612_port0:
-			if ( pos [0] == ym2612_dac_port )
-			{
-				write_pcm( vgm_time, pos [1] );
-			}
-			else if ( ym2612.run_until( to_fm_time( vgm_time ) ) )
+		}
+		// fall through
+	case cmd_ym2612_port1: {
+		int port = (e.cmd == cmd_ym2612_port1);
+		ym2612 [port] [addr] = data;
+		ym2612_written [port] [addr] = true;
+		break;
+	}
+	
+	case cmd_data_block:
+		pcm_data = emu.event_offsets [event_index( e.data )];
+		break;
+	
+	case cmd_pcm_seek:
+		pcm_pos = pcm_data + emu.event_offsets [event_index( e.data )];
+		break;
+	
+	case cmd_pcm_delay: {
+		int amp = 0;
+		if ( pcm_pos >= 0 && pcm_pos < emu.data_end - emu.data )
+			amp = emu.data [pcm_pos];
+		pcm_pos++;
+		write_pcm( amp );
+		break;
+	}
+	}
+}
+
+long Vgm_Emu_Impl::chip_state_t::save( event_t* out ) const
+{
+	event_t* p = out;
+	#define ADD_WRITE( c, a, d ) do {\
+		p->time = 0;\
+		p->cmd  = c;\
+		p->data [0] = a;\
+		p->data [1] = d;\
+		p->data [2] = 0;\
+		p++;\
+	} while ( 0 )
+	
+	if ( psg_written )
+	{
+		for ( int i = 0; i < 4; i++ )
+		{
+			if ( i < 3 && (psg_written >> (i * 2) & 1) )
 			{
-				if ( pos [0] == 0x2B )
-				{
-					dac_disabled = (pos [1] >> 7 & 1) - 1;
-					dac_amp |= dac_disabled;
-				}
-				ym2612.write0( pos [0], pos [1] );
+				ADD_WRITE( cmd_psg, 0x80 | i << 5 | (psg_tone [i] & 0x0F), 0 );
+				ADD_WRITE( cmd_psg, psg_tone [i] >> 4, 0 );
 			}
-			pos += 2;
-			break;
+			if ( psg_written >> (i * 2 + 1) & 1 )
+				ADD_WRITE( cmd_psg, 0x90 | i << 5 | psg_volume [i], 0 );
+		}
+		if ( psg_written >> 6 & 1 )
+			ADD_WRITE( cmd_psg, 0xE0 | psg_noise, 0 );
 		
-		case cmd_ym2612_port1:
-			if ( ym2612.run_until( to_fm_time( vgm_time ) ) )
-				ym2612.write1( pos [0], pos [1] );
-			pos += 2;
-			break;
+		// latch last, rewriting the latched register's current value
+		int index = psg_latch >> 5 & 3;
+		int value = psg_noise;
+		if ( psg_latch & 0x10 )
+			value = psg_volume [index];
+		else if ( index < 3 )
+			value = psg_tone [index] & 0x0F;
+		ADD_WRITE( cmd_psg, 0x80 | (psg_latch & 0x70) | value, 0 );
+	}
+	if ( gg_stereo >= 0 )
+		ADD_WRITE( cmd_gg_stereo, gg_stereo, 0 );
+	
+	for ( int port = 0; port < 2; port++ )
+	{
+		for ( int addr = 0; addr < 0x100; addr++ )
+		{
+			if ( ym2612_written [port] [addr] )
+				ADD_WRITE( port ? cmd_ym2612_port1 : cmd_ym2612_port0, addr, ym2612 [port] [addr] );
+		}
+	}
+	for ( int i = 0; i < 8; i++ )
+	{
+		if ( ym2612_keys [i] >= 0 )
+			ADD_WRITE( cmd_ym2612_port0, 0x28, ym2612_keys [i] );
+	}
+	
+	// key on/off bits are in 0x20-0x28, so do those after instruments are set
+	for ( int addr = 0; addr < 0x40; addr++ )
+	{
+		if ( (addr & 0xF0) != 0x20 && ym2413_written [addr] )
+			ADD_WRITE( cmd_ym2413, addr, ym2413 [addr] );
+	}
+	for ( int addr = 0x20; addr < 0x30; addr++ )
+	{
+		if ( ym2413_written [addr] )
+			ADD_WRITE( cmd_ym2413, addr, ym2413 [addr] );
+	}
+	#undef ADD_WRITE
+	
+	assert( p - out <= max_writes );
+	return p - out;
+}
+
+blargg_err_t Vgm_Emu_Impl::build_checkpoints()
+{
+	checkpoints.clear();
+	checkpoint_writes.clear();
+	if ( !events.size() )
+		return 0;
+	
+	// checkpoints through the first pass of the stream and, if it loops, the
+	// second, since registers set before the loop might not be set within it
+	long const event_count = events.size();
+	blargg_long const last_time = events [event_count - 1].time + loop_length;
+	RETURN_ERR( checkpoints.resize( last_time / checkpoint_period + 1 ) );
+	
+	chip_state_t state;
+	state.init( ym2612.enabled() );
+	long count  = 0;
+	long writes = 0;
+	blargg_long offset = 0;
+	blargg_long next = checkpoint_period;
+	for ( long i = 0; i < event_count; i++ )
+	{
+		event_t const& e = events [i];
+		while ( e.time + offset >= next )
+		{
+			if ( (long) checkpoint_writes.size() - writes < chip_state_t::max_writes )
+				RETURN_ERR( checkpoint_writes.resize( (writes + chip_state_t::max_writes) * 2 ) );
 			
-		case cmd_data_block: {
-			check( *pos == cmd_end );
-			int type = pos [1];
-			long size = get_le32( pos + 2 );
-			pos += 6;
-			if ( type == pcm_block_type )
-				pcm_data = pos;
-			pos += size;
-			break;
+			checkpoint_t& cp = checkpoints [count++];
+			cp.time         = next;
+			cp.stream_time  = next - offset;
+			cp.event        = i;
+			cp.writes       = writes;
+			cp.pcm_data     = state.pcm_data;
+			cp.pcm_pos      = state.pcm_pos;
+			cp.dac_amp      = state.dac_amp;
+			cp.dac_disabled = state.dac_disabled;
+			writes += state.save( checkpoint_writes.begin() + writes );
+			next += checkpoint_period;
 		}
 		
-		case cmd_pcm_seek:
-			pcm_pos = pcm_data + pos [3] * 0x1000000L + pos [2] * 0x10000L +
-					pos [1] * 0x100L + pos [0];
-			pos += 4;
-			break;
+		state.write( e, *this );
 		
-		default:
-			int cmd = pos [-1];
-			switch ( cmd & 0xF0 )
-			{
-				case cmd_pcm_delay:
-					write_pcm( vgm_time, *pcm_pos++ );
-					vgm_time += cmd & 0x0F;
-					break;
-				
-				case cmd_short_delay:
-					vgm_time += (cmd & 0x0F) + 1;
-					break;
-				
-				case 0x50:
-					pos += 2;
-					break;
-				
-				default:
-					pos += command_len( cmd ) - 1;
-					set_warning( "Unknown stream event" );
-			}
+		if ( i == event_count - 1 && loop_event && !offset )
+		{
+			offset = loop_length;
+			i = loop_event - events.begin() - 1;
 		}
 	}
-	vgm_time -= end_time;
-	this->pos = pos;
-	this->vgm_time = vgm_time;
 	
-	return to_blip_time( end_time );
+	assert( count < (long) checkpoints.size() );
+	RETURN_ERR( checkpoints.resize( count ) );
+	return checkpoint_writes.resize( writes );
+}
+
+Vgm_Emu_Impl::checkpoint_t const* Vgm_Emu_Impl::find_checkpoint( double time, double* checkpoint_time ) const
+{
+	// stream state repeats after its second pass
+	double offset = 0;
+	if ( loop_event )
+	{
+		double end = loop_start + loop_length * 2.0;
+		if ( time >= end )
+		{
+			offset = floor( (time - end) / loop_length + 1 ) * loop_length;
+			time -= offset;
+		}
+	}
+	
+	checkpoint_t const* lo = checkpoints.begin();
+	checkpoint_t const* hi = checkpoints.end();
+	if ( lo == hi || lo->time > time )
+		return 0;
+	while ( hi - lo > 1 )
+	{
+		checkpoint_t const* mid = lo + (hi - lo) / 2;
+		if ( mid->time <= time )
+			lo = mid;
+		else
+			hi = mid;
+	}
+	*checkpoint_time = lo->time + offset;
+	return lo;
+}
+
+void Vgm_Emu_Impl::restore_checkpoint( checkpoint_t const& cp, double checkpoint_time )
+{
+	event_t const* end = checkpoint_writes.end();
+	if ( &cp + 1 < checkpoints.end() )
+		end = checkpoint_writes.begin() + (&cp) [1].writes;
+	for ( event_t const* w = checkpoint_writes.begin() + cp.writes; w < end; w++ )
+		run_event( *w, 0 );
+	
+	pcm_data     = data + cp.pcm_data;
+	pcm_pos      = data + cp.pcm_pos;
+	dac_amp      = cp.dac_amp;
+	dac_disabled = cp.dac_disabled;
+	pos          = events.begin() + cp.event;
+	time_base    = cp.stream_time;
+	vgm_elapsed  = checkpoint_time;
 }
 
 int Vgm_Emu_Impl::play_frame( blip_time_t blip_time, int sample_count, sample_t* buf )
@@ -250,6 +745,14 @@ int Vgm_Emu_Impl::play_frame( blip_time_t blip_time, int sample_count, sample_t*
 	{
 		ym2612.begin_frame( buf );
 		memset( buf, 0, pairs * stereo * sizeof *buf );
+		
+		if ( stems_enabled() )
+		{
+			sample_t* fm_out [Ym2612_Emu::channel_count];
+			for ( int i = 0; i < Ym2612_Emu::channel_count; i++ )
+				fm_out [i] = stem_pcm_out( i );
+			ym2612.set_voice_outputs( fm_out );
+		}
 	}
 	else if ( ym2413.enabled() )
 	{
@@ -260,6 +763,9 @@ int Vgm_Emu_Impl::play_frame( blip_time_t blip_time, int sample_count, sample_t*
 	ym2612.run_until( pairs );
 	ym2413.run_until( pairs );
 	
+	if ( ym2612.enabled() && stems_enabled() )
+		ym2612.set_voice_outputs( NULL );
+	
 	fm_time_offset = (vgm_time * fm_time_factor + fm_time_offset) -
 			((long) pairs << fm_time_bits);
 	
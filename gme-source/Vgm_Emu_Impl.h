@@ -47,8 +47,48 @@ protected:
 	byte const* data_end;
 	void update_fm_rates( long* ym2413_rate, long* ym2612_rate ) const;
 	
-	vgm_time_t vgm_time;
-	byte const* pos;
+	// Command stream, parsed once at load. Times are in stream samples (44100 Hz)
+	// since the beginning of the stream.
+	struct event_t
+	{
+		blargg_long time;
+		byte cmd;       // stream command; cmd_pcm_delay for any 0x8n
+		byte data [3];  // command's bytes, or index into event_offsets
+	};
+	blargg_vector<event_t> events;
+	blargg_vector<blargg_long> event_offsets; // PCM data block and seek offsets
+	event_t const* loop_event;  // where stream continues after its end, or NULL
+	blargg_long loop_start;     // time loop_event is reached
+	blargg_long loop_length;
+	bool stream_overrun;        // last command ran past end of data
+	blargg_err_t parse_events( byte const* begin );
+	void run_event( event_t const&, vgm_time_t );
+	
+	// Seek checkpoints, every second through first two passes of the stream.
+	// Each holds register writes that rebuild chip state at that point.
+	struct checkpoint_t
+	{
+		blargg_long time;        // since start of track
+		blargg_long stream_time;
+		long event;              // index of next event
+		long writes;             // index of first write in checkpoint_writes
+		blargg_long pcm_data;
+		blargg_long pcm_pos;
+		int dac_amp;
+		int dac_disabled;
+	};
+	blargg_vector<checkpoint_t> checkpoints;
+	blargg_vector<event_t> checkpoint_writes;
+	struct chip_state_t;
+	blargg_err_t build_checkpoints();
+	checkpoint_t const* find_checkpoint( double time, double* checkpoint_time ) const;
+	void restore_checkpoint( checkpoint_t const&, double checkpoint_time );
+	
+	double vgm_elapsed; // vgm time at start of current frame
+	double fm_ratio;    // resampling ratio of FM output, or 0 if not using FM
+	double loop_time( vgm_time_t ) const;
+	event_t const* pos;
+	blargg_long time_base; // stream time at start of current frame
 	blip_time_t run_commands( vgm_time_t );
 	int play_frame( blip_time_t blip_time, int sample_count, sample_t* buf );
 	
@@ -65,6 +105,11 @@ protected:
 	Sms_Apu psg;
 	Blip_Synth<blip_med_quality,1> dac_synth;
 	
+	// PCM and PSG voices get their own buffers when stems are enabled
+	Blip_Buffer stem_blip_bufs [2];
+	Blip_Buffer* pcm_buf() { return stems_enabled() ? &stem_blip_bufs [0] : &blip_buf; }
+	Blip_Buffer* psg_buf() { return stems_enabled() ? &stem_blip_bufs [1] : &blip_buf; }
+	
 	friend class Vgm_Emu;
 };
 
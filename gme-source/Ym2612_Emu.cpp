@@ -11,6 +11,10 @@
 #include <stdio.h>
 #include <math.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* Copyright (C) 2002 Stphane Dallongeville (gens AT consolemul.com) */
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -191,25 +195,39 @@ inline void set_seg( slot_t& s, int seg )
 	}
 }
 
-struct tables_t
+// Tables which don't depend on sample or clock rate. These are made once and
+// shared by all instances, since they're much larger than the rest.
+struct shared_tables_t
 {
 	short SIN_TAB [SIN_LENGHT];                 // SINUS TABLE (offset into TL TABLE)
+	unsigned int SL_TAB [16];                   // Substain level table
+	short ENV_TAB [2 * ENV_LENGHT + 8];         // ENV CURVE TABLE (attack & decay)
+	short LFO_ENV_TAB [LFO_LENGHT];             // LFO AMS TABLE (adjusted for 11.8 dB)
+	short LFO_FREQ_TAB [LFO_LENGHT];            // LFO FMS TABLE
+	int TL_TAB [TL_LENGHT * 2];                 // TOTAL LEVEL TABLE (positif and minus)
+	unsigned int DECAY_TO_ATTACK [ENV_LENGHT];  // Conversion from decay to attack phase
+	
+	shared_tables_t();
+};
+
+struct tables_t
+{
+	short const* SIN_TAB;
 	int LFOcnt;         // LFO counter = compteur-frequence pour le LFO
 	int LFOinc;         // LFO step counter = pas d'incrementation du compteur-frequence du LFO
 						// plus le pas est grand, plus la frequence est grande
 	unsigned int AR_TAB [128];                  // Attack rate table
 	unsigned int DR_TAB [96];                   // Decay rate table
 	unsigned int DT_TAB [8] [32];               // Detune table
-	unsigned int SL_TAB [16];                   // Substain level table
+	unsigned int const* SL_TAB;
 	unsigned int NULL_RATE [32];                // Table for NULL rate
 	int LFO_INC_TAB [8];                        // LFO step table
 	
-	short ENV_TAB [2 * ENV_LENGHT + 8];         // ENV CURVE TABLE (attack & decay)
-	
-	short LFO_ENV_TAB [LFO_LENGHT];             // LFO AMS TABLE (adjusted for 11.8 dB)
-	short LFO_FREQ_TAB [LFO_LENGHT];            // LFO FMS TABLE
-	int TL_TAB [TL_LENGHT * 2];                 // TOTAL LEVEL TABLE (positif and minus)
-	unsigned int DECAY_TO_ATTACK [ENV_LENGHT];  // Conversion from decay to attack phase
+	short const* ENV_TAB;
+	short const* LFO_ENV_TAB;
+	short const* LFO_FREQ_TAB;
+	int const* TL_TAB;
+	unsigned int const* DECAY_TO_ATTACK;
 	unsigned int FINC_TAB [2048];               // Frequency step table
 };
 
@@ -261,6 +279,8 @@ struct Ym2612_Impl
 	
 	state_t YM2612;
 	int mute_mask;
+	Ym2612_Emu::sample_t* voice_out [channel_count];
+	long idle_count;
 	tables_t g;
 	
 	void KEY_ON( channel_t&, int );
@@ -628,21 +648,10 @@ int Ym2612_Impl::YM_SET(int Adr, int data)
 	return 0;
 }
 
-void Ym2612_Impl::set_rate( double sample_rate, double clock_rate )
+shared_tables_t::shared_tables_t()
 {
-	assert( sample_rate );
-	assert( clock_rate > sample_rate );
-	
 	int i;
-
-	// 144 = 12 * (prescale * 2) = 12 * 6 * 2
-	// prescale set to 6 by default
 	
-	double Frequence = clock_rate / sample_rate / 144.0;
-	if ( fabs( Frequence - 1.0 ) < 0.0000001 )
-		Frequence = 1.0;
-	YM2612.TimerBase = int (Frequence * 4096.0);
-
 	// Tableau TL :
 	// [0     -  4095] = +output  [4095  - ...] = +output overflow (fill with 0)
 	// [12288 - 16383] = -output  [16384 - ...] = -output overflow (fill with 0)
@@ -651,23 +660,23 @@ void Ym2612_Impl::set_rate( double sample_rate, double clock_rate )
 	{
 		if (i >= PG_CUT_OFF)    // YM2612 cut off sound after 78 dB (14 bits output ?)
 		{
-			g.TL_TAB [TL_LENGHT + i] = g.TL_TAB [i] = 0;
+			TL_TAB [TL_LENGHT + i] = TL_TAB [i] = 0;
 		}
 		else
 		{
 			double x = MAX_OUT;                         // Max output
 			x /= pow( 10.0, (ENV_STEP * i) / 20.0 );    // Decibel -> Voltage
 
-			g.TL_TAB [i] = (int) x;
-			g.TL_TAB [TL_LENGHT + i] = -g.TL_TAB [i];
+			TL_TAB [i] = (int) x;
+			TL_TAB [TL_LENGHT + i] = -TL_TAB [i];
 		}
 	}
 	
 	// Tableau SIN :
-	// g.SIN_TAB [x] [y] = sin(x) * y; 
+	// SIN_TAB [x] [y] = sin(x) * y; 
 	// x = phase and y = volume
 
-	g.SIN_TAB [0] = g.SIN_TAB [SIN_LENGHT / 2] = PG_CUT_OFF;
+	SIN_TAB [0] = SIN_TAB [SIN_LENGHT / 2] = PG_CUT_OFF;
 
 	for(i = 1; i <= SIN_LENGHT / 4; i++)
 	{
@@ -678,8 +687,8 @@ void Ym2612_Impl::set_rate( double sample_rate, double clock_rate )
 
 		if (j > PG_CUT_OFF) j = (int) PG_CUT_OFF;
 
-		g.SIN_TAB [i] = g.SIN_TAB [(SIN_LENGHT / 2) - i] = j;
-		g.SIN_TAB [(SIN_LENGHT / 2) + i] = g.SIN_TAB [SIN_LENGHT - i] = TL_LENGHT + j;
+		SIN_TAB [i] = SIN_TAB [(SIN_LENGHT / 2) - i] = j;
+		SIN_TAB [(SIN_LENGHT / 2) + i] = SIN_TAB [SIN_LENGHT - i] = TL_LENGHT + j;
 	}
 
 	// Tableau LFO (LFO wav) :
@@ -691,18 +700,18 @@ void Ym2612_Impl::set_rate( double sample_rate, double clock_rate )
 		x /= 2.0;                   // positive only
 		x *= 11.8 / ENV_STEP;       // ajusted to MAX enveloppe modulation
 
-		g.LFO_ENV_TAB [i] = (int) x;
+		LFO_ENV_TAB [i] = (int) x;
 
 		x = sin(2.0 * PI * (double) (i) / (double) (LFO_LENGHT));   // Sinus
 		x *= (double) ((1 << (LFO_HBITS - 1)) - 1);
 
-		g.LFO_FREQ_TAB [i] = (int) x;
+		LFO_FREQ_TAB [i] = (int) x;
 
 	}
 
 	// Tableau Enveloppe :
-	// g.ENV_TAB [0] -> g.ENV_TAB [ENV_LENGHT - 1]              = attack curve
-	// g.ENV_TAB [ENV_LENGHT] -> g.ENV_TAB [2 * ENV_LENGHT - 1] = decay curve
+	// ENV_TAB [0] -> ENV_TAB [ENV_LENGHT - 1]              = attack curve
+	// ENV_TAB [ENV_LENGHT] -> ENV_TAB [2 * ENV_LENGHT - 1] = decay curve
 
 	for(i = 0; i < ENV_LENGHT; i++)
 	{
@@ -710,28 +719,28 @@ void Ym2612_Impl::set_rate( double sample_rate, double clock_rate )
 		double x = pow(((double) ((ENV_LENGHT - 1) - i) / (double) (ENV_LENGHT)), 8);
 		x *= ENV_LENGHT;
 
-		g.ENV_TAB [i] = (int) x;
+		ENV_TAB [i] = (int) x;
 
 		// Decay curve (just linear)
 		x = pow(((double) (i) / (double) (ENV_LENGHT)), 1);
 		x *= ENV_LENGHT;
 
-		g.ENV_TAB [ENV_LENGHT + i] = (int) x;
+		ENV_TAB [ENV_LENGHT + i] = (int) x;
 	}
 	for ( i = 0; i < 8; i++ )
-		g.ENV_TAB [i + ENV_LENGHT * 2] = 0;
+		ENV_TAB [i + ENV_LENGHT * 2] = 0;
 	
-	g.ENV_TAB [ENV_END >> ENV_LBITS] = ENV_LENGHT - 1;      // for the stopped state
+	ENV_TAB [ENV_END >> ENV_LBITS] = ENV_LENGHT - 1;      // for the stopped state
 	
 	// Tableau pour la conversion Attack -> Decay and Decay -> Attack
 	
 	int j = ENV_LENGHT - 1;
 	for ( i = 0; i < ENV_LENGHT; i++ )
 	{
-		while ( j && g.ENV_TAB [j] < i )
+		while ( j && ENV_TAB [j] < i )
 			j--;
 
-		g.DECAY_TO_ATTACK [i] = j << ENV_LBITS;
+		DECAY_TO_ATTACK [i] = j << ENV_LBITS;
 	}
 
 	// Tableau pour le Substain Level
@@ -741,11 +750,42 @@ void Ym2612_Impl::set_rate( double sample_rate, double clock_rate )
 		double x = i * 3;           // 3 and not 6 (Mickey Mania first music for test)
 		x /= ENV_STEP;
 
-		g.SL_TAB [i] = ((int) x << ENV_LBITS) + ENV_DECAY;
+		SL_TAB [i] = ((int) x << ENV_LBITS) + ENV_DECAY;
 	}
 
-	g.SL_TAB [15] = ((ENV_LENGHT - 1) << ENV_LBITS) + ENV_DECAY; // special case : volume off
+	SL_TAB [15] = ((ENV_LENGHT - 1) << ENV_LBITS) + ENV_DECAY; // special case : volume off
+}
+
+static shared_tables_t const& shared_tables()
+{
+	static shared_tables_t const tables;
+	return tables;
+}
+
+void Ym2612_Impl::set_rate( double sample_rate, double clock_rate )
+{
+	assert( sample_rate );
+	assert( clock_rate > sample_rate );
+	
+	int i;
+
+	// 144 = 12 * (prescale * 2) = 12 * 6 * 2
+	// prescale set to 6 by default
+	
+	double Frequence = clock_rate / sample_rate / 144.0;
+	if ( fabs( Frequence - 1.0 ) < 0.0000001 )
+		Frequence = 1.0;
+	YM2612.TimerBase = int (Frequence * 4096.0);
 
+	shared_tables_t const& shared = shared_tables();
+	g.SIN_TAB         = shared.SIN_TAB;
+	g.SL_TAB          = shared.SL_TAB;
+	g.ENV_TAB         = shared.ENV_TAB;
+	g.LFO_ENV_TAB     = shared.LFO_ENV_TAB;
+	g.LFO_FREQ_TAB    = shared.LFO_FREQ_TAB;
+	g.TL_TAB          = shared.TL_TAB;
+	g.DECAY_TO_ATTACK = shared.DECAY_TO_ATTACK;
+	
 	// Tableau Frequency Step
 
 	for(i = 0; i < 2048; i++)
@@ -832,6 +872,9 @@ const char* Ym2612_Emu::set_rate( double sample_rate, double clock_rate )
 		if ( !impl )
 			return "Out of memory";
 		impl->mute_mask = 0;
+		impl->idle_count = 0;
+		for ( int i = 0; i < Ym2612_Impl::channel_count; i++ )
+			impl->voice_out [i] = 0;
 	}
 	memset( &impl->YM2612, 0, sizeof impl->YM2612 );
 	
@@ -887,6 +930,7 @@ void Ym2612_Emu::reset()
 
 void Ym2612_Impl::reset()
 {
+	idle_count = 0;
 	g.LFOcnt = 0;
 	YM2612.TimerA = 0;
 	YM2612.TimerAL = 0;
@@ -961,6 +1005,14 @@ void Ym2612_Emu::write1( int addr, int data )
 
 void Ym2612_Emu::mute_voices( int mask ) { impl->mute_mask = mask; }
 
+long Ym2612_Emu::idle_samples() const { return impl->idle_count; }
+
+void Ym2612_Emu::set_voice_outputs( sample_t* const* out )
+{
+	for ( int i = 0; i < Ym2612_Impl::channel_count; i++ )
+		impl->voice_out [i] = out ? out [i] : 0;
+}
+
 static void update_envelope_( slot_t* sl )
 {
 	switch ( sl->Ecurp )
@@ -1024,77 +1076,231 @@ static void update_envelope_( slot_t* sl )
 	}
 }
 
-inline void update_envelope( slot_t& sl )
+// Channels are rendered a block at a time: LFO values for the block (shared by
+// all channels), then envelope and phase of each operator, then the operators
+// themselves. Each stage only depends on its own state, so output is identical
+// to stepping everything one sample at a time.
+int const block_size = 64;
+
+struct lfo_block_t
 {
-	int ecmp = sl.Ecmp;
-	if ( (sl.Ecnt += sl.Einc) >= ecmp )
-		update_envelope_( &sl );
+	int env  [block_size];
+	int freq [block_size];
+};
+
+static void calc_envelope( tables_t const& g, slot_t& sl, int const* env_LFO,
+		int* out, int count )
+{
+	int const tll = sl.TLL;
+	int const ams = sl.AMS; // 31 if AM is off, which shifts any LFO value to 0
+	int i = 0;
+	while ( i < count )
+	{
+		int ecnt = sl.Ecnt;
+		int const einc = sl.Einc;
+		
+		// samples until envelope reaches its next phase
+		int end = count;
+		bool next = false;
+		if ( ecnt + einc >= sl.Ecmp )
+		{
+			end = i + 1;
+			next = true;
+		}
+		else if ( einc > 0 )
+		{
+			int n = (sl.Ecmp - ecnt + einc - 1) / einc;
+			if ( n <= count - i )
+			{
+				end = i + n;
+				next = true;
+			}
+		}
+		
+		if ( einc > (1 << ENV_LBITS) / 4 )
+		{
+			// table entry changes every few samples
+			int const env_xor = sl.env_xor;
+			int const env_max = sl.env_max;
+			for ( ; i < end; i++ )
+			{
+				int temp = g.ENV_TAB [ecnt >> ENV_LBITS] + tll;
+				out [i] = ((temp ^ env_xor) + (env_LFO [i] >> ams)) & ((temp - env_max) >> 31);
+				ecnt += einc;
+			}
+		}
+		
+		// attenuation only changes with LFO while ecnt stays within one table entry
+		while ( i < end )
+		{
+			int run = end - i;
+			if ( einc > 0 )
+			{
+				int n = ((((ecnt >> ENV_LBITS) + 1) << ENV_LBITS) - ecnt + einc - 1) / einc;
+				if ( run > n )
+					run = n;
+			}
+			
+			int temp = g.ENV_TAB [ecnt >> ENV_LBITS] + tll;
+			int const base = temp ^ sl.env_xor;
+			int const mask = (temp - sl.env_max) >> 31;
+			ecnt += einc * run;
+			int* p = out + i;
+			int const* lfo = env_LFO + i;
+			i += run;
+			if ( ams >= 31 )
+			{
+				int const en = base & mask;
+				do { *p++ = en; } while ( --run );
+			}
+			else
+			{
+			#ifdef __SSE2__
+				__m128i const vbase  = _mm_set1_epi32( base );
+				__m128i const vmask  = _mm_set1_epi32( mask );
+				__m128i const vshift = _mm_cvtsi32_si128( ams );
+				for ( ; run >= 4; run -= 4, p += 4, lfo += 4 )
+				{
+					__m128i v = _mm_sra_epi32( _mm_loadu_si128( (__m128i const*) lfo ), vshift );
+					v = _mm_and_si128( _mm_add_epi32( v, vbase ), vmask );
+					_mm_storeu_si128( (__m128i*) p, v );
+				}
+			#endif
+				for ( ; run > 0; run-- )
+					*p++ = (base + (*lfo++ >> ams)) & mask;
+			}
+		}
+		
+		sl.Ecnt = ecnt;
+		if ( next )
+			update_envelope_( &sl );
+	}
+}
+
+// Phase of all four operators, one sample per row. freq_LFO is NULL if channel
+// has no frequency modulation.
+static void calc_phase( channel_t& ch, unsigned const* freq_LFO, int (*out) [4], int count )
+{
+#ifdef __SSE2__
+	__m128i fcnt = _mm_setr_epi32( ch.SLOT [0].Fcnt, ch.SLOT [1].Fcnt,
+			ch.SLOT [2].Fcnt, ch.SLOT [3].Fcnt );
+	__m128i const finc = _mm_setr_epi32( ch.SLOT [0].Finc, ch.SLOT [1].Finc,
+			ch.SLOT [2].Finc, ch.SLOT [3].Finc );
+	if ( !freq_LFO )
+	{
+		__m128i const step = _mm_srli_epi32( _mm_slli_epi32( finc, LFO_FMS_LBITS - 1 ),
+				LFO_FMS_LBITS - 1 );
+		for ( int n = 0; n < count; n++ )
+		{
+			_mm_storeu_si128( (__m128i*) out [n], fcnt );
+			fcnt = _mm_add_epi32( fcnt, step );
+		}
+	}
+	else
+	{
+		__m128i const finc_odd = _mm_srli_epi64( finc, 32 );
+		for ( int n = 0; n < count; n++ )
+		{
+			_mm_storeu_si128( (__m128i*) out [n], fcnt );
+			
+			// low 32 bits of finc * freq_LFO in each lane
+			__m128i f = _mm_set1_epi32( freq_LFO [n] );
+			__m128i even = _mm_mul_epu32( finc, f );
+			__m128i odd  = _mm_mul_epu32( finc_odd, f );
+			__m128i prod = _mm_unpacklo_epi32(
+					_mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 ) ),
+					_mm_shuffle_epi32( odd,  _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+			fcnt = _mm_add_epi32( fcnt, _mm_srli_epi32( prod, LFO_FMS_LBITS - 1 ) );
+		}
+	}
+	int temp [4];
+	_mm_storeu_si128( (__m128i*) temp, fcnt );
+	for ( int i = 0; i < 4; i++ )
+		ch.SLOT [i].Fcnt = temp [i];
+#else
+	for ( int i = 0; i < 4; i++ )
+	{
+		slot_t& sl = ch.SLOT [i];
+		unsigned const finc = sl.Finc;
+		unsigned fcnt = sl.Fcnt;
+		if ( !freq_LFO )
+		{
+			unsigned const step = (finc << (LFO_FMS_LBITS - 1)) >> (LFO_FMS_LBITS - 1);
+			for ( int n = 0; n < count; n++ )
+			{
+				out [n] [i] = fcnt;
+				fcnt += step;
+			}
+		}
+		else
+		{
+			for ( int n = 0; n < count; n++ )
+			{
+				out [n] [i] = fcnt;
+				fcnt += (finc * freq_LFO [n]) >> (LFO_FMS_LBITS - 1);
+			}
+		}
+		sl.Fcnt = fcnt;
+	}
+#endif
 }
 
 template<int algo>
 struct ym2612_update_chan {
-	static void func( tables_t&, channel_t&, Ym2612_Emu::sample_t*, int );
+	static void func( tables_t&, channel_t&, Ym2612_Emu::sample_t*, int, lfo_block_t const& );
 };
 
-typedef void (*ym2612_update_chan_t)( tables_t&, channel_t&, Ym2612_Emu::sample_t*, int );
+typedef void (*ym2612_update_chan_t)( tables_t&, channel_t&, Ym2612_Emu::sample_t*, int,
+		lfo_block_t const& );
 
 template<int algo>
 void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
-		Ym2612_Emu::sample_t* buf, int length )
+		Ym2612_Emu::sample_t* buf, int length, lfo_block_t const& lfo )
 {
-	int not_end = ch.SLOT [S3].Ecnt - ENV_END;
-	
 	// algo is a compile-time constant, so all conditions based on it are resolved
 	// during compilation
 	
-	// special cases
-	if ( algo == 7 )
-		not_end |= ch.SLOT [S0].Ecnt - ENV_END;
-	
-	if ( algo >= 5 )
-		not_end |= ch.SLOT [S2].Ecnt - ENV_END;
-	
-	if ( algo >= 4 )
-		not_end |= ch.SLOT [S1].Ecnt - ENV_END;
+	unsigned freq_buf [block_size];
+	unsigned const* freq_LFO = 0;
+	if ( ch.FMS )
+	{
+		for ( int n = 0; n < length; n++ )
+			freq_buf [n] = ((lfo.freq [n] * ch.FMS) >> (LFO_HBITS - 1 + 1)) +
+					(1L << (LFO_FMS_LBITS - 1));
+		freq_LFO = freq_buf;
+	}
 	
-	int CH_S0_OUT_1 = ch.S0_OUT [1];
+	int en [4] [block_size];
+	for ( int i = 0; i < 4; i++ )
+		calc_envelope( g, ch.SLOT [i], lfo.env, en [i], length );
 	
-	int in0 = ch.SLOT [S0].Fcnt;
-	int in1 = ch.SLOT [S1].Fcnt;
-	int in2 = ch.SLOT [S2].Fcnt;
-	int in3 = ch.SLOT [S3].Fcnt;
+	int in [block_size] [4];
+	calc_phase( ch, freq_LFO, in, length );
 	
-	int YM2612_LFOinc = g.LFOinc;
-	int YM2612_LFOcnt = g.LFOcnt + YM2612_LFOinc;
+	int const* const TL_TAB = g.TL_TAB;
+	short const* const SIN_TAB = g.SIN_TAB;
 	
-	if ( !not_end )
-		return;
+	#define SINT( i, o ) (TL_TAB [SIN_TAB [(i)] + (o)])
 	
-	do
+	int CH_S0_OUT_0 = ch.S0_OUT [0];
+	int CH_S0_OUT_1 = ch.S0_OUT [1];
+	int const FB    = ch.FB;
+	int const LEFT  = ch.LEFT;
+	int const RIGHT = ch.RIGHT;
+	for ( int n = 0; n < length; n++ )
 	{
-		// envelope
-		int const env_LFO = g.LFO_ENV_TAB [YM2612_LFOcnt >> LFO_LBITS & LFO_MASK];
-		
-		short const* const ENV_TAB = g.ENV_TAB;
-		
-	#define CALC_EN( x ) \
-		int temp##x = ENV_TAB [ch.SLOT [S##x].Ecnt >> ENV_LBITS] + ch.SLOT [S##x].TLL;  \
-		int en##x = ((temp##x ^ ch.SLOT [S##x].env_xor) + (env_LFO >> ch.SLOT [S##x].AMS)) &    \
-				((temp##x - ch.SLOT [S##x].env_max) >> 31);
-		
-		CALC_EN( 0 )
-		CALC_EN( 1 )
-		CALC_EN( 2 )
-		CALC_EN( 3 )
-		
-		int const* const TL_TAB = g.TL_TAB;
-		
-	#define SINT( i, o ) (TL_TAB [g.SIN_TAB [(i)] + (o)])
+		int const in0 = in [n] [S0];
+		int const in1 = in [n] [S1];
+		int const in2 = in [n] [S2];
+		int const in3 = in [n] [S3];
+		int const en0 = en [S0] [n];
+		int const en1 = en [S1] [n];
+		int const en2 = en [S2] [n];
+		int const en3 = en [S3] [n];
 		
 		// feedback
-		int CH_S0_OUT_0 = ch.S0_OUT [0];
 		{
-			int temp = in0 + ((CH_S0_OUT_0 + CH_S0_OUT_1) >> ch.FB);
+			int temp = in0 + ((CH_S0_OUT_0 + CH_S0_OUT_1) >> FB);
 			CH_S0_OUT_1 = CH_S0_OUT_0;
 			CH_S0_OUT_0 = SINT( (temp >> SIN_LBITS) & SIN_MASK, en0 );
 		}
@@ -1158,36 +1364,17 @@ void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
 		
 		CH_OUTd >>= MAX_OUT_BITS - output_bits + 2;
 		
-		// update phase
-		unsigned freq_LFO = ((g.LFO_FREQ_TAB [YM2612_LFOcnt >> LFO_LBITS & LFO_MASK] *
-				ch.FMS) >> (LFO_HBITS - 1 + 1)) + (1L << (LFO_FMS_LBITS - 1));
-		YM2612_LFOcnt += YM2612_LFOinc;
-		in0 += (ch.SLOT [S0].Finc * freq_LFO) >> (LFO_FMS_LBITS - 1);
-		in1 += (ch.SLOT [S1].Finc * freq_LFO) >> (LFO_FMS_LBITS - 1);
-		in2 += (ch.SLOT [S2].Finc * freq_LFO) >> (LFO_FMS_LBITS - 1);
-		in3 += (ch.SLOT [S3].Finc * freq_LFO) >> (LFO_FMS_LBITS - 1);
-		
-		int t0 = buf [0] + (CH_OUTd & ch.LEFT);
-		int t1 = buf [1] + (CH_OUTd & ch.RIGHT);
-		
-		update_envelope( ch.SLOT [0] );
-		update_envelope( ch.SLOT [1] );
-		update_envelope( ch.SLOT [2] );
-		update_envelope( ch.SLOT [3] );
-		
-		ch.S0_OUT [0] = CH_S0_OUT_0;
+		int t0 = buf [0] + (CH_OUTd & LEFT);
+		int t1 = buf [1] + (CH_OUTd & RIGHT);
 		buf [0] = t0;
 		buf [1] = t1;
 		buf += 2;
 	}
-	while ( --length );
 	
-	ch.S0_OUT [1] = CH_S0_OUT_1;
+	#undef SINT
 	
-	ch.SLOT [S0].Fcnt = in0;
-	ch.SLOT [S1].Fcnt = in1;
-	ch.SLOT [S2].Fcnt = in2;
-	ch.SLOT [S3].Fcnt = in3;
+	ch.S0_OUT [0] = CH_S0_OUT_0;
+	ch.S0_OUT [1] = CH_S0_OUT_1;
 }
 
 static const ym2612_update_chan_t UPDATE_CHAN [8] = {
@@ -1201,6 +1388,23 @@ static const ym2612_update_chan_t UPDATE_CHAN [8] = {
 	&ym2612_update_chan<7>::func
 };
 
+// True if an operator that reaches the output hasn't ended
+static bool channel_audible( channel_t const& ch )
+{
+	int not_end = ch.SLOT [S3].Ecnt - ENV_END;
+	
+	if ( ch.ALGO == 7 )
+		not_end |= ch.SLOT [S0].Ecnt - ENV_END;
+	
+	if ( ch.ALGO >= 5 )
+		not_end |= ch.SLOT [S2].Ecnt - ENV_END;
+	
+	if ( ch.ALGO >= 4 )
+		not_end |= ch.SLOT [S1].Ecnt - ENV_END;
+	
+	return not_end != 0;
+}
+
 void Ym2612_Impl::run_timer( int length )
 {
 	int const step = 6;
@@ -1307,10 +1511,68 @@ void Ym2612_Impl::run( int pair_count, Ym2612_Emu::sample_t* out )
 		}
 	}
 	
+	// decide which channels play once for whole call, as envelopes that end
+	// partway through still run to the end of it
+	Ym2612_Emu::sample_t* chan_out [channel_count];
+	bool idle = true;
+	for ( int i = 0; i < channel_count; i++ )
+	{
+		chan_out [i] = 0;
+		Ym2612_Emu::sample_t* vout = voice_out [i];
+		if ( vout )
+		{
+			// render channel on its own, then add it to the mix
+			voice_out [i] = vout + pair_count * 2;
+			memset( vout, 0, pair_count * 2 * sizeof *vout );
+		}
+		if ( !(mute_mask & (1 << i)) && (i != 5 || !YM2612.DAC) &&
+				channel_audible( YM2612.CHANNEL [i] ) )
+		{
+			chan_out [i] = (vout ? vout : out);
+			idle = false;
+		}
+	}
+	
+	if ( idle )
+	{
+		// nothing to synthesize until a key on; only timers and LFO advance
+		idle_count += pair_count;
+		g.LFOcnt += g.LFOinc * pair_count;
+		return;
+	}
+	
+	lfo_block_t lfo;
+	for ( int pos = 0; pos < pair_count; pos += block_size )
+	{
+		int count = pair_count - pos;
+		if ( count > block_size )
+			count = block_size;
+		
+		int lfo_cnt = g.LFOcnt + g.LFOinc * (pos + 1);
+		for ( int n = 0; n < count; n++ )
+		{
+			int index = lfo_cnt >> LFO_LBITS & LFO_MASK;
+			lfo.env  [n] = g.LFO_ENV_TAB  [index];
+			lfo.freq [n] = g.LFO_FREQ_TAB [index];
+			lfo_cnt += g.LFOinc;
+		}
+		
+		for ( int i = 0; i < channel_count; i++ )
+		{
+			if ( chan_out [i] )
+				UPDATE_CHAN [YM2612.CHANNEL [i].ALGO]( g, YM2612.CHANNEL [i],
+						chan_out [i] + pos * 2, count, lfo );
+		}
+	}
+	
 	for ( int i = 0; i < channel_count; i++ )
 	{
-		if ( !(mute_mask & (1 << i)) && (i != 5 || !YM2612.DAC) )
-			UPDATE_CHAN [YM2612.CHANNEL [i].ALGO]( g, YM2612.CHANNEL [i], out, pair_count );
+		Ym2612_Emu::sample_t const* vout = chan_out [i];
+		if ( vout && vout != out )
+		{
+			for ( int n = 0; n < pair_count * 2; n++ )
+				out [n] += vout [n];
+		}
 	}
 	
 	g.LFOcnt += g.LFOinc * pair_count;
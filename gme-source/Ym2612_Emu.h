@@ -33,6 +33,14 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+	
+	// Also write channel n's own output to out [n] during run(), advancing
+	// each pointer. NULL stops this.
+	void set_voice_outputs( sample_t* const* out );
+	
+	// Number of sample pairs run() has skipped since reset() because no channel
+	// was sounding
+	long idle_samples() const;
 };
 
 #endif
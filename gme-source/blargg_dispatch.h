@@ -0,0 +1,49 @@
+// Opcode dispatch for CPU emulator run loops
+
+// Game_Music_Emu 0.5.5
+#ifndef BLARGG_DISPATCH_H
+#define BLARGG_DISPATCH_H
+
+// BLARGG_COMPUTED_GOTO: If 1, CPU emulators jump straight to the code for each
+// opcode through a table of label addresses (a GCC extension) rather than going
+// through a switch. If undefined, it is enabled when the compiler supports it.
+#ifndef BLARGG_COMPUTED_GOTO
+	#if defined (__GNUC__)
+		#define BLARGG_COMPUTED_GOTO 1
+	#else
+		#define BLARGG_COMPUTED_GOTO 0
+	#endif
+#endif
+
+// OPCODE_SWITCH( op ) { OPCODE( 0x00 ) ... OPCODE( 0xFF ) } works like
+// switch ( op ) { case 0x00: ... case 0xFF: }. There is no default, so every
+// opcode needs an OPCODE(), written as upper-case hex with two digits. With
+// BLARGG_COMPUTED_GOTO, OPCODE_DISPATCH( op ) jumps to OPCODE( op ) from anywhere
+// after OPCODE_SWITCH in the same function, so an opcode's code can end by
+// fetching and dispatching the next one itself.
+#if BLARGG_COMPUTED_GOTO
+	#define OPCODE_SWITCH( op ) \
+		static void const* const opcode_labels_ [0x100] = {\
+			OPCODE_ROW_( 0 ) OPCODE_ROW_( 1 ) OPCODE_ROW_( 2 ) OPCODE_ROW_( 3 )\
+			OPCODE_ROW_( 4 ) OPCODE_ROW_( 5 ) OPCODE_ROW_( 6 ) OPCODE_ROW_( 7 )\
+			OPCODE_ROW_( 8 ) OPCODE_ROW_( 9 ) OPCODE_ROW_( A ) OPCODE_ROW_( B )\
+			OPCODE_ROW_( C ) OPCODE_ROW_( D ) OPCODE_ROW_( E ) OPCODE_ROW_( F )\
+		};\
+		OPCODE_DISPATCH( op );
+
+	#define OPCODE_DISPATCH( op ) goto *opcode_labels_ [op]
+
+	#define OPCODE( n ) opcode_##n:
+
+	#define OPCODE_ROW_( h )\
+		&&opcode_0x##h##0, &&opcode_0x##h##1, &&opcode_0x##h##2, &&opcode_0x##h##3,\
+		&&opcode_0x##h##4, &&opcode_0x##h##5, &&opcode_0x##h##6, &&opcode_0x##h##7,\
+		&&opcode_0x##h##8, &&opcode_0x##h##9, &&opcode_0x##h##A, &&opcode_0x##h##B,\
+		&&opcode_0x##h##C, &&opcode_0x##h##D, &&opcode_0x##h##E, &&opcode_0x##h##F,
+#else
+	#define OPCODE_SWITCH( op ) switch ( op )
+
+	#define OPCODE( n ) case n:
+#endif
+
+#endif
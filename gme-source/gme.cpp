@@ -214,6 +214,24 @@ Music_Emu* gme_new_emu( gme_type_t type, int rate )
 	return 0;
 }
 
+Music_Emu* gme_new_emu_stems( gme_type_t type, int rate )
+{
+	if ( type && rate != gme_info_only )
+	{
+		Music_Emu* me = type->new_emu();
+		if ( me )
+		{
+			if ( !me->enable_stems() && !me->set_sample_rate( rate ) )
+			{
+				check( me->type() == type );
+				return me;
+			}
+			delete me;
+		}
+	}
+	return 0;
+}
+
 gme_err_t gme_load_file( Music_Emu* me, const char* path ) { return me->load_file( path ); }
 
 gme_err_t gme_load_data( Music_Emu* me, void const* data, long size )
@@ -222,6 +240,11 @@ gme_err_t gme_load_data( Music_Emu* me, void const* data, long size )
 	return me->load( in );
 }
 
+gme_err_t gme_load_data_borrowed( Music_Emu* me, void const* data, long size )
+{
+	return me->load_mem( data, size );
+}
+
 gme_err_t gme_load_custom( Music_Emu* me, gme_reader_t func, long size, void* data )
 {
 	Callback_Reader in( func, size, data );
@@ -328,12 +351,15 @@ void      gme_set_user_cleanup(Music_Emu* me, gme_user_cleanup_t func ) { me->se
 
 gme_err_t gme_start_track    ( Music_Emu* me, int index )           { return me->start_track( index ); }
 gme_err_t gme_play           ( Music_Emu* me, int n, short* p )     { return me->play( n, p ); }
+gme_err_t gme_play_stems     ( Music_Emu* me, int n, short* p, short* s ) { return me->play_stems( n, p, s ); }
 void      gme_set_fade       ( Music_Emu* me, int start_msec )      { me->set_fade( start_msec ); }
 int       gme_track_ended    ( Music_Emu const* me )                { return me->track_ended(); }
 int       gme_tell           ( Music_Emu const* me )                { return me->tell(); }
 gme_err_t gme_seek           ( Music_Emu* me, int msec )            { return me->seek( msec ); }
 int       gme_voice_count    ( Music_Emu const* me )                { return me->voice_count(); }
 void      gme_ignore_silence ( Music_Emu* me, int disable )         { me->ignore_silence( disable != 0 ); }
+void      gme_enable_loop_replay( Music_Emu* me, int enable )       { me->enable_loop_replay( enable != 0 ); }
+void      gme_set_lookahead_limit( Music_Emu* me, int n )           { me->set_lookahead_limit( n ); }
 void      gme_set_tempo      ( Music_Emu* me, double t )            { me->set_tempo( t ); }
 void      gme_mute_voice     ( Music_Emu* me, int index, int mute ) { me->mute_voice( index, mute != 0 ); }
 void      gme_mute_voices    ( Music_Emu* me, int mask )            { me->mute_voices( mask ); }
@@ -110,6 +110,22 @@ void gme_set_stereo_depth( Music_Emu*, double depth );
 if ignore is true */
 void gme_ignore_silence( Music_Emu*, int ignore );
 
+/* Limit emulation done by gme_play() while looking ahead during silence to n times
+the number of samples requested, so each call's time stays proportional to its count.
+End of track is still detected, only later. 0 (default) doesn't limit lookahead. */
+void gme_set_lookahead_limit( Music_Emu*, int n );
+
+/* Once the track is found to loop, play back the recorded loop rather than
+emulating it again, if enable is true. Currently done for NSF, SPC and VGM. */
+void gme_enable_loop_replay( Music_Emu*, int enable );
+
+/* Generate 'count' samples into 'out' as gme_play() does and, from the same
+emulation, each voice's own output into 'stems' as gme_voice_count() blocks of
+'count' stereo samples, one after another. Voices are taken before mixing, so
+stereo depth and SPC echo aren't included. Emulator must have been created with
+gme_new_emu_stems(). */
+gme_err_t gme_play_stems( Music_Emu*, int count, short out [], short stems [] );
+
 /* Adjust song tempo, where 1.0 = normal, 0.5 = half speed, 2.0 = double speed.
 Track length as returned by track_info() assumes a tempo of 1.0. */
 void gme_set_tempo( Music_Emu*, double tempo );
@@ -201,12 +217,24 @@ gme_err_t gme_identify_file( const char path [], gme_type_t* type_out );
 track information, pass gme_info_only for sample_rate. */
 Music_Emu* gme_new_emu( gme_type_t, int sample_rate );
 
+/* Same as gme_new_emu(), but the emulator can also generate each voice's output
+separately with gme_play_stems(). Returns NULL if out of memory or if emulator
+type doesn't support this. Silence detection is disabled for such emulators. */
+Music_Emu* gme_new_emu_stems( gme_type_t, int sample_rate );
+
 /* Load music file into emulator */
 gme_err_t gme_load_file( Music_Emu*, const char path [] );
 
 /* Load music file from memory into emulator. Makes a copy of data passed. */
 gme_err_t gme_load_data( Music_Emu*, void const* data, long size );
 
+/* Same as gme_load_data(), but keeps a pointer to data instead of copying it, so
+data must not be freed until another file is loaded or the emulator is deleted.
+Formats that need their data laid out in emulated memory (NSF, GBS, etc.) still
+copy it there. Loading into an emulator that already has a file of the same type
+reuses its buffers, so a new file can be played without creating a new emulator. */
+gme_err_t gme_load_data_borrowed( Music_Emu*, void const* data, long size );
+
 /* Load music file using custom data reader function that will be called to
 read file data. Most emulators load the entire file in one read call. */
 typedef gme_err_t (*gme_reader_t)( void* your_data, void* out, int count );
@@ -0,0 +1,650 @@
+// Times parts of the library on synthetic input
+
+// usage: gme_bench [part]
+// Runs every part, or only the one named. Each prints its best time over
+// several runs, which is the least affected by other load on the machine,
+// along with a hash of the output, so that a build can be compared against
+// another one for speed and for identical output. Build the library and this
+// with optimization, e.g.
+// make -f Makefile.linux-pulse GME_CXXFLAGS=-O2 bench
+
+#include "gme.h"
+#include "Effects_Buffer.h"
+#include "Ym2612_Emu.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+int const sample_rate = 44100;
+int const runs = 5;
+
+static unsigned long rand_state;
+
+static int rand_int( int n )
+{
+	rand_state = (rand_state * 1103515245 + 12345) & 0xFFFFFFFF;
+	return (int) (rand_state >> 8) % n;
+}
+
+// Wall clock time, for timing short calls
+static double now()
+{
+	timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Processor time used, for timing whole runs
+static double cpu_time()
+{
+	timespec ts;
+	clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long hash_samples( unsigned long hash, short const* in, long count )
+{
+	for ( long i = 0; i < count; i++ )
+		hash = ((hash ^ (unsigned short) in [i]) * 16777619u) & 0xFFFFFFFF;
+	return hash;
+}
+
+// Effects_Buffer and Stereo_Buffer mixing
+
+static Blip_Synth<blip_med_quality,1> synth;
+
+// Mixes 60 seconds of five channels of random steps; stereo puts some of them
+// in the side buffers, and a depth above zero turns the effects on
+static void bench_mixing( char const* name, bool effects, bool stereo, double depth )
+{
+	int const clock_rate = 1789773;
+	int const frame_clocks = clock_rate / 60;
+
+	// best time per sample of any one read_samples() call
+	double best = 1e9;
+	unsigned long hash = 0;
+	for ( int run = 0; run < runs; run++ )
+	{
+		Stereo_Buffer stereo_buf;
+		Effects_Buffer effects_buf;
+		Multi_Buffer* buf = &stereo_buf;
+		if ( effects )
+			buf = &effects_buf;
+		if ( buf->set_sample_rate( sample_rate ) )
+			return;
+		buf->clock_rate( clock_rate );
+		buf->bass_freq( 90 );
+		if ( effects )
+			effects_buf.set_depth( depth );
+		synth.volume( 1.0 );
+
+		rand_state = 1;
+		hash = 2166136261u;
+		int amps [5] = { 0 };
+		for ( int frame = 0; frame < 60 * 60; frame++ )
+		{
+			for ( int ch = 0; ch < 5; ch++ )
+			{
+				Multi_Buffer::channel_t c = buf->channel( ch, 0 );
+				Blip_Buffer* b = c.center;
+				if ( stereo && ch >= 3 )
+					b = (ch == 3 ? c.left : c.right);
+				for ( int t = rand_int( 300 ); t < frame_clocks; t += 200 + rand_int( 400 ) )
+				{
+					int amp = rand_int( 31 ) - 15;
+					synth.offset( t, amp - amps [ch], b );
+					amps [ch] = amp;
+				}
+				b->set_modified();
+			}
+			buf->end_frame( frame_clocks );
+
+			short out [4096];
+			double start = now();
+			long n = buf->read_samples( out, 4096 );
+			double time = now() - start;
+			if ( n && best > time / n )
+				best = time / n;
+			hash = hash_samples( hash, out, n );
+		}
+	}
+	printf( "%-34s %6.2f ns/sample  %08lx\n", name, best * 1e9, hash );
+}
+
+static void bench_effects()
+{
+	bench_mixing( "Stereo_Buffer, center only", false, false, 0 );
+	bench_mixing( "Stereo_Buffer, stereo", false, true, 0 );
+	bench_mixing( "Effects_Buffer, mono effects", true, false, 0.5 );
+	bench_mixing( "Effects_Buffer, stereo effects", true, true, 0.5 );
+}
+
+// YM2612 rendering
+
+// Renders 60 seconds of six channels playing random patches, keyed on twice a
+// second with random frequencies, optionally with LFO AM and FM on every
+// operator
+static void bench_ym2612_run( char const* name, bool lfo )
+{
+	int const frames = 60 * 60;
+	int const frame_samples = 888; // 53267 Hz / 60
+	
+	double best = 1e9;
+	unsigned long hash = 0;
+	for ( int run = 0; run < runs; run++ )
+	{
+		Ym2612_Emu ym;
+		if ( ym.set_rate( 53267.0, 7670453.0 ) )
+			return;
+		
+		rand_state = 1;
+		ym.write0( 0x22, lfo ? 0x0D : 0 );
+		for ( int ch = 0; ch < 6; ch++ )
+		{
+			int const part = ch / 3;
+			int const c = ch % 3;
+			for ( int op = 0; op < 4; op++ )
+			{
+				int const regs [7] = { 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90 };
+				int const data [7] = {
+					rand_int( 16 ),                      // DT/MUL
+					rand_int( 40 ),                      // TL
+					0x10 | rand_int( 16 ),               // KS/AR
+					(lfo ? 0x80 : 0) | (8 + rand_int( 8 )), // AM/DR
+					rand_int( 8 ),                       // SR
+					0x20 | rand_int( 16 ),               // SL/RR
+					0                                    // SSG-EG
+				};
+				for ( int i = 0; i < 7; i++ )
+				{
+					if ( part )
+						ym.write1( regs [i] + op * 4 + c, data [i] );
+					else
+						ym.write0( regs [i] + op * 4 + c, data [i] );
+				}
+			}
+			int const algorithm = rand_int( 8 );
+			if ( part )
+			{
+				ym.write1( 0xB0 + c, algorithm );
+				ym.write1( 0xB4 + c, 0xC0 | (lfo ? 0x33 : 0) );
+			}
+			else
+			{
+				ym.write0( 0xB0 + c, algorithm );
+				ym.write0( 0xB4 + c, 0xC0 | (lfo ? 0x33 : 0) );
+			}
+		}
+		
+		hash = 2166136261u;
+		double start = cpu_time();
+		for ( int frame = 0; frame < frames; frame++ )
+		{
+			if ( frame % 30 == 0 )
+			{
+				for ( int ch = 0; ch < 6; ch++ )
+				{
+					int const c = ch % 3;
+					int const fnum = 300 + rand_int( 1500 );
+					int const block = rand_int( 6 );
+					if ( ch < 3 )
+					{
+						ym.write0( 0xA4 + c, (fnum >> 8) | block << 3 );
+						ym.write0( 0xA0 + c, fnum & 0xFF );
+					}
+					else
+					{
+						ym.write1( 0xA4 + c, (fnum >> 8) | block << 3 );
+						ym.write1( 0xA0 + c, fnum & 0xFF );
+					}
+					int const key = (ch < 3 ? ch : ch + 1);
+					ym.write0( 0x28, key );
+					ym.write0( 0x28, 0xF0 | key );
+				}
+			}
+			
+			short out [frame_samples * 2];
+			memset( out, 0, sizeof out );
+			ym.run( frame_samples, out );
+			hash = hash_samples( hash, out, frame_samples * 2 );
+		}
+		double time = cpu_time() - start;
+		if ( best > time )
+			best = time;
+	}
+	printf( "%-34s %6.1fx realtime  %08lx\n", name, frames / 60.0 / best, hash );
+}
+
+static void bench_ym2612()
+{
+	bench_ym2612_run( "Ym2612_Emu", false );
+	bench_ym2612_run( "Ym2612_Emu, LFO AM and FM", true );
+}
+
+// CPU emulation
+
+// Instruction kinds for random code
+enum {
+	op_implied,    // opcode only
+	op_imm,        // opcode, random byte
+	op_direct,     // opcode, address in the CPU's direct/zero page area
+	op_abs,        // opcode, address in the CPU's four RAM pages
+	op_branch,     // opcode, zero offset
+	op_push,
+	op_pop,
+	op_direct_imm, // opcode, random byte, direct address (SPC mov dp,#imm)
+	op_prefix,     // opcode, one of the CPU's prefixed opcodes
+	op_indexed     // opcode, one of the CPU's indexed opcodes, displacement
+};
+
+struct cpu_op_t
+{
+	unsigned char op;
+	unsigned char kind;
+};
+
+struct cpu_code_t
+{
+	cpu_op_t const* ops;
+	int op_count;
+	int direct_lo;     // direct addresses are direct_lo + 0 .. direct_range - 1
+	int direct_range;
+	int ram_hi;        // absolute addresses are in pages ram_hi .. ram_hi + 3
+	int pop;           // opcode that pops what op_push pushed
+	unsigned char const* prefixed; // second bytes for op_prefix and op_indexed
+	int prefixed_count;
+};
+
+#define OPS( ops ) ops, sizeof ops / sizeof ops [0]
+
+static cpu_op_t const ops_6502 [] = {
+	{0xA9,op_imm},{0xA5,op_direct},{0xB5,op_direct},{0xAD,op_abs},{0xBD,op_abs},{0xB9,op_abs},
+	{0xA2,op_imm},{0xA6,op_direct},{0xA0,op_imm},{0xA4,op_direct},{0xAE,op_abs},{0xAC,op_abs},
+	{0x85,op_direct},{0x95,op_direct},{0x8D,op_abs},{0x9D,op_abs},{0x86,op_direct},{0x84,op_direct},
+	{0x69,op_imm},{0x65,op_direct},{0x6D,op_abs},{0x7D,op_abs},{0xE9,op_imm},{0xE5,op_direct},{0xED,op_abs},
+	{0x29,op_imm},{0x25,op_direct},{0x09,op_imm},{0x05,op_direct},{0x49,op_imm},{0x45,op_direct},{0x4D,op_abs},
+	{0xC9,op_imm},{0xC5,op_direct},{0xCD,op_abs},{0xE0,op_imm},{0xC0,op_imm},{0x24,op_direct},
+	{0xE8,op_implied},{0xCA,op_implied},{0xC8,op_implied},{0x88,op_implied},{0xAA,op_implied},
+	{0x8A,op_implied},{0xA8,op_implied},{0x98,op_implied},{0x0A,op_implied},{0x4A,op_implied},
+	{0x2A,op_implied},{0x6A,op_implied},{0x06,op_direct},{0x46,op_direct},{0x26,op_direct},{0x66,op_direct},
+	{0xE6,op_direct},{0xC6,op_direct},{0xEE,op_abs},{0xCE,op_abs},{0x18,op_implied},{0x38,op_implied},
+	{0xB8,op_implied},{0xEA,op_implied},
+	{0xD0,op_branch},{0xF0,op_branch},{0x10,op_branch},{0x30,op_branch},{0x90,op_branch},{0xB0,op_branch},
+	{0x48,op_push},{0x68,op_pop}
+};
+
+static cpu_op_t const ops_spc [] = {
+	{0xE8,op_imm},{0xCD,op_imm},{0x8D,op_imm},{0xE4,op_direct},{0xC4,op_direct},{0xEB,op_direct},
+	{0xF4,op_direct},{0x88,op_imm},{0xA8,op_imm},{0x28,op_imm},{0x08,op_imm},{0x48,op_imm},{0x68,op_imm},
+	{0x84,op_direct},{0x64,op_direct},{0xBC,op_implied},{0x3D,op_implied},{0xFC,op_implied},{0xDC,op_implied},
+	{0x1D,op_implied},{0x9C,op_implied},{0x7D,op_implied},{0x5D,op_implied},{0xDD,op_implied},{0xFD,op_implied},
+	{0x1C,op_implied},{0x3C,op_implied},{0x5C,op_implied},{0x7C,op_implied},{0xF0,op_branch},{0xD0,op_branch},
+	{0xF5,op_abs},{0xC5,op_abs},{0xE5,op_abs},{0x3A,op_direct},{0x7A,op_direct},{0xBA,op_direct},
+	{0x2D,op_push},{0xAE,op_pop},{0x00,op_implied},{0x60,op_implied},{0x80,op_implied},{0x8F,op_direct_imm}
+};
+
+static cpu_op_t const ops_gb [] = {
+	{0x3E,op_imm},{0x06,op_imm},{0x0E,op_imm},{0x16,op_imm},{0x1E,op_imm},{0x78,op_implied},{0x79,op_implied},
+	{0x41,op_implied},{0x4A,op_implied},{0x80,op_implied},{0x81,op_implied},{0x90,op_implied},{0xA0,op_implied},
+	{0xB1,op_implied},{0xA8,op_implied},{0xC6,op_imm},{0xD6,op_imm},{0xE6,op_imm},{0xF6,op_imm},{0xFE,op_imm},
+	{0x04,op_implied},{0x0C,op_implied},{0x05,op_implied},{0x0D,op_implied},{0x3C,op_implied},{0x03,op_implied},
+	{0x13,op_implied},{0x0B,op_implied},{0x7E,op_implied},{0x77,op_implied},{0x2A,op_implied},{0x22,op_implied},
+	{0x46,op_implied},{0x34,op_implied},{0xFA,op_abs},{0xEA,op_abs},{0x20,op_branch},{0x28,op_branch},
+	{0x30,op_branch},{0x38,op_branch},{0xCB,op_prefix},{0x07,op_implied},{0x17,op_implied},{0x0F,op_implied},
+	{0x1F,op_implied},{0xC5,op_push},{0xC1,op_pop},{0xF0,op_direct},{0xE0,op_direct}
+};
+static unsigned char const prefixed_gb [] = { 0x7E, 0x76, 0x19, 0x7F, 0x37, 0x66, 0x11, 0xC7, 0x87 };
+
+static cpu_op_t const ops_z80 [] = {
+	{0x3E,op_imm},{0x06,op_imm},{0x0E,op_imm},{0x16,op_imm},{0x1E,op_imm},{0x78,op_implied},{0x79,op_implied},
+	{0x41,op_implied},{0x4A,op_implied},{0x53,op_implied},{0x80,op_implied},{0x81,op_implied},{0x88,op_implied},
+	{0x90,op_implied},{0x98,op_implied},{0xA0,op_implied},{0xB1,op_implied},{0xA8,op_implied},{0xB8,op_implied},
+	{0xC6,op_imm},{0xCE,op_imm},{0xD6,op_imm},{0xE6,op_imm},{0xF6,op_imm},{0xEE,op_imm},{0xFE,op_imm},
+	{0x04,op_implied},{0x0C,op_implied},{0x05,op_implied},{0x0D,op_implied},{0x3C,op_implied},{0x03,op_implied},
+	{0x13,op_implied},{0x0B,op_implied},{0x09,op_implied},{0x19,op_implied},{0x7E,op_implied},{0x77,op_implied},
+	{0x46,op_implied},{0x34,op_implied},{0x35,op_implied},{0x3A,op_abs},{0x32,op_abs},{0x2A,op_abs},
+	{0x20,op_branch},{0x28,op_branch},{0x30,op_branch},{0x38,op_branch},{0x07,op_implied},{0x17,op_implied},
+	{0x0F,op_implied},{0x1F,op_implied},{0x2F,op_implied},{0x37,op_implied},{0x3F,op_implied},{0xEB,op_implied},
+	{0x08,op_implied},{0xD9,op_implied},{0xCB,op_prefix},{0xDD,op_indexed},{0xFD,op_indexed},{0xED,op_prefix},
+	{0xC5,op_push},{0xD5,op_push},{0xC1,op_pop},{0xD1,op_pop},{0x00,op_implied}
+};
+// CB and ED second bytes, then the (IX+d)/(IY+d) ones
+static unsigned char const prefixed_z80 [] = { 0x7E, 0x46, 0x19, 0x7F, 0x27, 0x3F, 0x11, 0xC7, 0x87, 0x06 };
+static unsigned char const prefixed_z80_ed [] = { 0x44, 0x52, 0x5A, 0x4A };
+static unsigned char const indexed_z80 [] = { 0x7E, 0x77, 0x86, 0x34 };
+
+// Appends count random instructions that only touch RAM, followed by pops of
+// anything left pushed. Branches have zero offsets, so the code runs straight
+// through.
+static unsigned char* random_code( unsigned char* out, cpu_code_t const& cpu, int count )
+{
+	int pushed = 0;
+	while ( count > 0 )
+	{
+		cpu_op_t const& op = cpu.ops [rand_int( cpu.op_count )];
+		if ( op.kind == op_push && pushed > 6 )
+			continue;
+		if ( op.kind == op_pop && !pushed )
+			continue;
+		count--;
+		
+		*out++ = op.op;
+		switch ( op.kind )
+		{
+		case op_imm:
+			*out++ = rand_int( 0x100 );
+			break;
+		
+		case op_direct:
+			*out++ = cpu.direct_lo + rand_int( cpu.direct_range );
+			break;
+		
+		case op_abs:
+			*out++ = rand_int( 0x100 );
+			*out++ = cpu.ram_hi + rand_int( 4 );
+			break;
+		
+		case op_branch:
+			*out++ = 0;
+			break;
+		
+		case op_push:
+			pushed++;
+			break;
+		
+		case op_pop:
+			pushed--;
+			break;
+		
+		case op_direct_imm:
+			*out++ = rand_int( 0x100 );
+			*out++ = cpu.direct_lo + rand_int( cpu.direct_range );
+			break;
+		
+		case op_prefix:
+			if ( op.op == 0xED )
+				*out++ = prefixed_z80_ed [rand_int( sizeof prefixed_z80_ed )];
+			else
+				*out++ = cpu.prefixed [rand_int( cpu.prefixed_count )];
+			break;
+		
+		case op_indexed:
+			*out++ = indexed_z80 [rand_int( sizeof indexed_z80 )];
+			*out++ = rand_int( 0x80 );
+			break;
+		}
+	}
+	while ( pushed-- )
+		*out++ = cpu.pop;
+	return out;
+}
+
+static void set_le16( unsigned char* p, int n )
+{
+	p [0] = n & 0xFF;
+	p [1] = n >> 8 & 0xFF;
+}
+
+static void set_be16( unsigned char* p, int n )
+{
+	p [0] = n >> 8 & 0xFF;
+	p [1] = n & 0xFF;
+}
+
+static unsigned char file [0x10200];
+
+int const code_size = 400; // instructions per loop
+
+// Each of these builds a file in file [] whose CPU runs a loop of random
+// instructions for as long as the track plays, and returns its size. The NSF
+// and SAP loops write the accumulator to a DAC on each pass, so their output
+// hashes depend on the CPU's results; the others are silent.
+
+static long make_nsf()
+{
+	static cpu_code_t const cpu = { OPS( ops_6502 ), 0, 0x80, 0x02, 0x68, 0, 0 };
+	memset( file, 0, 0x80 );
+	memcpy( file, "NESM\x1A", 5 );
+	file [5] = 1;
+	file [6] = 1;
+	file [7] = 1;
+	set_le16( file + 8, 0x8000 );  // load
+	set_le16( file + 10, 0x8000 ); // init
+	set_le16( file + 0x6E, 16639 );
+	set_le16( file + 0x78, 19997 );
+	unsigned char* p = random_code( file + 0x80, cpu, code_size );
+	*p++ = 0x8D; // STA $4011
+	set_le16( p, 0x4011 );
+	p += 2;
+	*p++ = 0x4C; // JMP $8000
+	set_le16( p, 0x8000 );
+	p += 2;
+	set_le16( file + 12, 0x8000 + (int) (p - (file + 0x80)) ); // play
+	*p++ = 0x60; // RTS
+	return p - file;
+}
+
+static long make_sap()
+{
+	static cpu_code_t const cpu = { OPS( ops_6502 ), 0, 0x80, 0x02, 0x68, 0, 0 };
+	char const header [] = "SAP\r\nTYPE B\r\nINIT 1FFF\r\nPLAYER 2000\r\n";
+	long header_size = sizeof header - 1;
+	memcpy( file, header, header_size );
+	unsigned char* block = file + header_size;
+	block [0] = 0xFF;
+	block [1] = 0xFF;
+	set_le16( block + 2, 0x1FFF );
+	block [6] = 0x60; // init: RTS
+	unsigned char* p = random_code( block + 7, cpu, code_size );
+	*p++ = 0x09; // ORA #$10
+	*p++ = 0x10;
+	*p++ = 0x8D; // STA $D201 ; volume only
+	set_le16( p, 0xD201 );
+	p += 2;
+	*p++ = 0x4C; // JMP $2000
+	set_le16( p, 0x2000 );
+	p += 2;
+	set_le16( block + 4, 0x1FFF + (int) (p - (block + 6)) - 1 );
+	return p - file;
+}
+
+static long make_hes()
+{
+	static cpu_code_t const cpu = { OPS( ops_6502 ), 0, 0x80, 0x20, 0x68, 0, 0 };
+	static unsigned char const banks [8] = { 0xFF, 0xF8, 0, 1, 2, 3, 4, 5 };
+	memset( file, 0, 0x20 );
+	memcpy( file, "HESM", 4 );
+	set_le16( file + 6, 0x4000 ); // init
+	memcpy( file + 8, banks, 8 );
+	memcpy( file + 16, "DATA", 4 );
+	unsigned char* p = random_code( file + 0x20, cpu, code_size );
+	*p++ = 0x4C; // JMP $4000
+	set_le16( p, 0x4000 );
+	p += 2;
+	long size = p - (file + 0x20);
+	set_le16( file + 20, (int) size );
+	return p - file;
+}
+
+static long make_gbs()
+{
+	static cpu_code_t const cpu = { OPS( ops_gb ), 0x80, 0x70, 0xC0, 0xC1, OPS( prefixed_gb ) };
+	memset( file, 0, 0x70 );
+	memcpy( file, "GBS", 3 );
+	file [3] = 1;
+	file [4] = 1;
+	file [5] = 1;
+	set_le16( file + 6, 0x400 );  // load
+	set_le16( file + 8, 0x400 );  // init
+	set_le16( file + 12, 0xFFFE ); // stack
+	unsigned char* p = file + 0x70;
+	*p++ = 0x21; // LD HL,$C000
+	*p++ = 0x00;
+	*p++ = 0xC0;
+	p = random_code( p, cpu, code_size );
+	*p++ = 0xC3; // JP $0400
+	set_le16( p, 0x400 );
+	p += 2;
+	set_le16( file + 10, 0x400 + (int) (p - (file + 0x70)) ); // play
+	*p++ = 0xC9; // RET
+	return p - file;
+}
+
+// Z80 code at $8000 that loops forever, for KSS and AY
+static unsigned char* z80_code( unsigned char* out )
+{
+	static cpu_code_t const cpu = { OPS( ops_z80 ), 0, 0, 0xC0, 0xC1, OPS( prefixed_z80 ) };
+	static unsigned char const init [] = {
+		0x21, 0x00, 0xC0,       // LD HL,$C000
+		0xDD, 0x21, 0x10, 0xC0, // LD IX,$C010
+		0xFD, 0x21, 0x20, 0xC0  // LD IY,$C020
+	};
+	memcpy( out, init, sizeof init );
+	unsigned char* p = random_code( out + sizeof init, cpu, code_size );
+	*p++ = 0xC3; // JP $8000
+	set_le16( p, 0x8000 );
+	return p + 2;
+}
+
+static long make_kss()
+{
+	memset( file, 0, 0x10 );
+	memcpy( file, "KSCC", 4 );
+	set_le16( file + 4, 0x8000 ); // load
+	set_le16( file + 8, 0x8000 ); // init
+	set_le16( file + 10, 0x8000 ); // play
+	unsigned char* p = z80_code( file + 0x10 );
+	set_le16( file + 6, (int) (p - (file + 0x10)) );
+	return p - file;
+}
+
+static long make_ay()
+{
+	// one track and one data block; offsets are relative to where they're stored
+	memset( file, 0, 62 );
+	memcpy( file, "ZXAYEMUL", 8 );
+	set_be16( file + 18, 2 );       // first track's data
+	unsigned char* track = file + 20;
+	set_be16( track, 4 );           // name at file + 24
+	set_be16( track + 2, 4 );       // track data at file + 26
+	unsigned char* data = file + 26;
+	data [8] = 0x12;
+	data [9] = 0x34;
+	set_be16( data + 10, 4 );       // registers at file + 40
+	set_be16( data + 12, 8 );       // blocks at file + 46
+	unsigned char* regs = file + 40;
+	set_be16( regs, 0xF000 );       // stack
+	set_be16( regs + 2, 0x8000 );   // init
+	set_be16( regs + 4, 0 );        // play
+	unsigned char* blocks = file + 46;
+	set_be16( blocks, 0x8000 );
+	set_be16( blocks + 4, 12 );     // code at file + 62
+	unsigned char* p = z80_code( file + 62 );
+	set_be16( blocks + 2, (int) (p - (file + 62)) );
+	return p - file;
+}
+
+static long make_spc()
+{
+	static cpu_code_t const cpu = { OPS( ops_spc ), 0x20, 0x60, 0x02, 0xAE, 0, 0 };
+	memset( file, 0, sizeof file );
+	memcpy( file, "SNES-SPC700 Sound File Data v0.30", 33 );
+	file [0x21] = 26;
+	file [0x22] = 26;
+	file [0x23] = 27;
+	file [0x24] = 30;
+	set_le16( file + 0x25, 0x400 ); // PC
+	file [0x2A] = 0x02; // PSW
+	file [0x2B] = 0xEF; // SP
+	unsigned char* ram = file + 0x100;
+	ram [0xF0] = 0x0A;
+	unsigned char* p = random_code( ram + 0x400, cpu, code_size );
+	*p++ = 0x5F; // JMP $0400
+	set_le16( p, 0x400 );
+	file [0x10100 + 0x6C] = 0x20; // FLG: echo writes off
+	return sizeof file;
+}
+
+int const cpu_seconds = 60;
+
+static void bench_cpu_run( char const* name, long (*make)() )
+{
+	rand_state = 1;
+	long size = make();
+	
+	double best = 1e9;
+	unsigned long hash = 0;
+	for ( int run = 0; run < runs; run++ )
+	{
+		Music_Emu* emu;
+		if ( gme_open_data( file, size, &emu, sample_rate ) )
+		{
+			printf( "%s: open failed\n", name );
+			return;
+		}
+		gme_ignore_silence( emu, 1 );
+		if ( gme_start_track( emu, 0 ) )
+		{
+			printf( "%s: start failed\n", name );
+			gme_delete( emu );
+			return;
+		}
+		
+		hash = 2166136261u;
+		double start = cpu_time();
+		for ( long n = (long) sample_rate * 2 * cpu_seconds; n > 0; n -= 2048 )
+		{
+			short out [2048];
+			gme_play( emu, 2048, out );
+			hash = hash_samples( hash, out, 2048 );
+		}
+		double time = cpu_time() - start;
+		if ( best > time )
+			best = time;
+		gme_delete( emu );
+	}
+	printf( "%-34s %6.1fx realtime  %08lx\n", name, cpu_seconds / best, hash );
+}
+
+static void bench_cpu()
+{
+	bench_cpu_run( "NSF (Nes_Cpu)", make_nsf );
+	bench_cpu_run( "SAP (Sap_Cpu)", make_sap );
+	bench_cpu_run( "HES (Hes_Cpu)", make_hes );
+	bench_cpu_run( "GBS (Gb_Cpu)", make_gbs );
+	bench_cpu_run( "KSS (Kss_Cpu)", make_kss );
+	bench_cpu_run( "AY (Ay_Cpu)", make_ay );
+	bench_cpu_run( "SPC (Spc_Cpu)", make_spc );
+}
+
+struct part_t
+{
+	char const* name;
+	void (*func)();
+};
+
+static part_t const parts [] = {
+	{ "effects", bench_effects },
+	{ "ym2612",  bench_ym2612 },
+	{ "cpu",     bench_cpu }
+};
+
+int main( int argc, char** argv )
+{
+	int ran = 0;
+	for ( unsigned i = 0; i < sizeof parts / sizeof parts [0]; i++ )
+	{
+		if ( argc < 2 || !strcmp( argv [1], parts [i].name ) )
+		{
+			parts [i].func();
+			ran = 1;
+		}
+	}
+	if ( !ran )
+	{
+		printf( "unknown part: %s\n", argv [1] );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,138 @@
+// Checks SPC output while the SPC700 streams sample data into RAM
+
+// The check builds a small SPC whose driver, on every timer tick, writes a
+// counter into the BRR data voice 0 is playing, copies bytes out of the echo
+// buffer into the BRR data voice 1 is playing, and sets voice 0's pitch through
+// the DSP ports. The DSP has to see each RAM write at the right time for the
+// output to come out right, so the output hash has to match the one recorded
+// from the unmodified emulator.
+
+#include "gme.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int const sample_rate = 32000;
+int const seconds = 30;
+
+static unsigned char spc [0x10200];
+
+static void build_spc( int timer_period )
+{
+	static unsigned char const code [] = {
+		0x8F, 0x00, 0xFA, // mov $FA,#period (patched)
+		0x8F, 0x01, 0xF1, // mov $F1,#$01
+		0x8F, 0x4C, 0xF2, // mov $F2,#$4C
+		0x8F, 0x03, 0xF3, // mov $F3,#$03 ; KON voices 0 and 1
+		0xCD, 0x00,       // mov x,#0
+	// wait:
+		0xE4, 0xFD,       // mov a,$FD
+		0xF0, 0xFC,       // beq wait
+		0xAB, 0x10,       // inc $10
+		0xF5, 0x80, 0x03, // mov a,$0380+x ; offset of a BRR data byte
+		0xFD,             // mov y,a
+		0xE4, 0x10,       // mov a,$10
+		0xD6, 0x00, 0x05, // mov $0500+y,a ; into voice 0's sample
+		0xF6, 0x00, 0x20, // mov a,$2000+y ; from the echo buffer
+		0xD6, 0x00, 0x06, // mov $0600+y,a ; into voice 1's sample
+		0xE4, 0x10,       // mov a,$10
+		0x8F, 0x02, 0xF2, // mov $F2,#$02
+		0xC4, 0xF3,       // mov $F3,a ; voice 0 pitch
+		0x3D,             // inc x
+		0x7D,             // mov a,x
+		0x28, 0x1F,       // and a,#$1F
+		0x5D,             // mov x,a
+		0x2F, 0xDD        // bra wait
+	};
+
+	memset( spc, 0, sizeof spc );
+	memcpy( spc, "SNES-SPC700 Sound File Data v0.30", 33 );
+	spc [0x21] = 26;
+	spc [0x22] = 26;
+	spc [0x23] = 27;
+	spc [0x24] = 30;
+	spc [0x25] = 0x00; // PC
+	spc [0x26] = 0x02;
+	spc [0x2B] = 0xEF; // SP
+
+	unsigned char* ram = spc + 0x100;
+	memcpy( ram + 0x200, code, sizeof code );
+	ram [0x201] = timer_period;
+
+	// sample directory: voice 0 plays $500, voice 1 plays $600, both looping
+	ram [0x300] = 0x00; ram [0x301] = 0x05; ram [0x302] = 0x00; ram [0x303] = 0x05;
+	ram [0x304] = 0x00; ram [0x305] = 0x06; ram [0x306] = 0x00; ram [0x307] = 0x06;
+
+	// 16 BRR blocks per sample, last one with end and loop flags
+	for ( int b = 0; b < 16; b++ )
+	{
+		for ( int s = 0; s < 2; s++ )
+		{
+			unsigned char* blk = ram + 0x500 + s * 0x100 + b * 9;
+			blk [0] = 0xB0 | (b == 15 ? 3 : 0);
+			for ( int i = 1; i < 9; i++ )
+				blk [i] = (b * 9 + i) * (s ? 0x35 : 0x17);
+		}
+
+		// two data bytes of each block for the driver to rewrite
+		ram [0x380 + b * 2    ] = b * 9 + 1;
+		ram [0x380 + b * 2 + 1] = b * 9 + 5;
+	}
+
+	unsigned char* dsp = spc + 0x10100;
+	static unsigned char const voice [2] [8] = {
+		{ 0x50, 0x30, 0x00, 0x10, 0x00, 0x8F, 0xE0, 0x7F },
+		{ 0x30, 0x50, 0x00, 0x08, 0x01, 0x8F, 0xE0, 0x7F }
+	};
+	memcpy( dsp + 0x00, voice [0], 8 );
+	memcpy( dsp + 0x10, voice [1], 8 );
+	dsp [0x0C] = 0x7F; // MVOL
+	dsp [0x1C] = 0x7F;
+	dsp [0x2C] = 0x30; // EVOL
+	dsp [0x3C] = 0x30;
+	dsp [0x6C] = 0x00; // FLG: echo writes on
+	dsp [0x0D] = 0x40; // EFB
+	dsp [0x4D] = 0x01; // EON
+	dsp [0x5D] = 0x03; // DIR
+	dsp [0x6D] = 0x20; // ESA
+	dsp [0x7D] = 0x02; // EDL
+	dsp [0x0F] = 0x7F; // FIR
+}
+
+static int check( int timer_period, unsigned long expected )
+{
+	build_spc( timer_period );
+
+	Music_Emu* emu;
+	if ( gme_open_data( spc, sizeof spc, &emu, sample_rate ) || gme_start_track( emu, 0 ) )
+	{
+		printf( "timer period %d: open failed\n", timer_period );
+		return 1;
+	}
+
+	unsigned long hash = 2166136261u;
+	long nonzero = 0;
+	short buf [2048];
+	for ( long n = (long) sample_rate * 2 * seconds; n > 0; n -= 2048 )
+	{
+		gme_play( emu, 2048, buf );
+		for ( int i = 0; i < 2048; i++ )
+		{
+			hash = ((hash ^ (unsigned short) buf [i]) * 16777619u) & 0xFFFFFFFF;
+			nonzero += (buf [i] != 0);
+		}
+	}
+	gme_delete( emu );
+
+	bool ok = (hash == expected && nonzero);
+	printf( "timer period %d: %ld nonzero, %08lx %s\n", timer_period, nonzero, hash, ok ? "ok" : "MISMATCH" );
+	return !ok;
+}
+
+int main()
+{
+	int failed = 0;
+	failed |= check( 0x10, 0x9fb8fee4 );
+	failed |= check( 0x02, 0x69fcd59e );
+	return failed;
+}
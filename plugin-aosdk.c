@@ -9,6 +9,7 @@
 #define CONTAINER_STRING "PSF Song Archive"
 #define CONTAINER_STRING_SIZE 16
 #define INDEX_RECORD_SIZE 12
+#define MAX_AOSDK_VOICES 64
 
 typedef struct
 {
@@ -255,26 +256,74 @@ static int AosdkPreviousTrack(void *privateData)
   return cxt->currentTrack;
 }
 
-static int AosdkGetVoiceCount(void *privateData)
+static int AosdkGetVoiceCountDSF(void *privateData)
 {
-  /* just claim that there is one master voice */
-  return 1;
+  return dsf_voice_count();
+}
+
+static int AosdkGetVoiceCountPSF(void *privateData)
+{
+  return psf_voice_count();
+}
+
+static int AosdkGetVoiceCountPSF2(void *privateData)
+{
+  return psf2_voice_count();
+}
+
+static int AosdkGetVoiceCountSSF(void *privateData)
+{
+  return ssf_voice_count();
+}
+
+/* the sound chips number their channels; DSF and SSF call them slots */
+static const char* AosdkGetVoiceName(int voiceNumber, const char *prefix)
+{
+  static char voiceName[MAX_AOSDK_VOICES][12];
+
+  if (voiceNumber < 0 || voiceNumber >= MAX_AOSDK_VOICES)
+    return "";
+  snprintf(voiceName[voiceNumber], sizeof(voiceName[voiceNumber]), "%s %d",
+    prefix, voiceNumber + 1);
+  return voiceName[voiceNumber];
 }
 
-static const char* AosdkGetVoiceName(void *privateData, int voiceNumber)
+static const char* AosdkGetVoiceNameSlot(void *privateData, int voiceNumber)
 {
-  return "AOSDK Engine";
+  return AosdkGetVoiceName(voiceNumber, "Slot");
+}
+
+static const char* AosdkGetVoiceNameVoice(void *privateData, int voiceNumber)
+{
+  return AosdkGetVoiceName(voiceNumber, "Voice");
 }
 
 static int AosdkVoicesCanBeToggled(void *privateData)
 {
-  /* no, individual voices can not be toggled */
-  return 0;
+  /* yes; a muted voice still runs its envelope and position, it just
+   * isn't mixed */
+  return 1;
+}
+
+/* the player passes the voice's muted flag as the 'enabled' argument */
+static int AosdkSetVoiceStateDSF(void *privateData, int voice, int enabled)
+{
+  return dsf_mute_voice(voice, enabled) == AO_SUCCESS;
+}
+
+static int AosdkSetVoiceStatePSF(void *privateData, int voice, int enabled)
+{
+  return psf_mute_voice(voice, enabled) == AO_SUCCESS;
+}
+
+static int AosdkSetVoiceStatePSF2(void *privateData, int voice, int enabled)
+{
+  return psf2_mute_voice(voice, enabled) == AO_SUCCESS;
 }
 
-static int AosdkSetVoiceState(void *privateData, int voice, int enabled)
+static int AosdkSetVoiceStateSSF(void *privateData, int voice, int enabled)
 {
-  return 0;
+  return ssf_mute_voice(voice, enabled) == AO_SUCCESS;
 }
 
 pluginInfo pluginAosdkDSF =
@@ -286,10 +335,10 @@ pluginInfo pluginAosdkDSF =
   .getCurrentTrack =      AosdkGetCurrentTrack,
   .nextTrack =            AosdkNextTrack,
   .previousTrack =        AosdkPreviousTrack,
-  .getVoiceCount =        AosdkGetVoiceCount,
-  .getVoiceName =         AosdkGetVoiceName,
+  .getVoiceCount =        AosdkGetVoiceCountDSF,
+  .getVoiceName =         AosdkGetVoiceNameSlot,
   .voicesCanBeToggled =   AosdkVoicesCanBeToggled,
-  .setVoiceState =        AosdkSetVoiceState,
+  .setVoiceState =        AosdkSetVoiceStateDSF,
   .contextSize =          sizeof(aosdkContext)
 };
 
@@ -302,10 +351,10 @@ pluginInfo pluginAosdkPSF =
   .getCurrentTrack =      AosdkGetCurrentTrack,
   .nextTrack =            AosdkNextTrack,
   .previousTrack =        AosdkPreviousTrack,
-  .getVoiceCount =        AosdkGetVoiceCount,
-  .getVoiceName =         AosdkGetVoiceName,
+  .getVoiceCount =        AosdkGetVoiceCountPSF,
+  .getVoiceName =         AosdkGetVoiceNameVoice,
   .voicesCanBeToggled =   AosdkVoicesCanBeToggled,
-  .setVoiceState =        AosdkSetVoiceState,
+  .setVoiceState =        AosdkSetVoiceStatePSF,
   .contextSize =          sizeof(aosdkContext)
 };
 
@@ -318,10 +367,10 @@ pluginInfo pluginAosdkPSF2 =
   .getCurrentTrack =      AosdkGetCurrentTrack,
   .nextTrack =            AosdkNextTrack,
   .previousTrack =        AosdkPreviousTrack,
-  .getVoiceCount =        AosdkGetVoiceCount,
-  .getVoiceName =         AosdkGetVoiceName,
+  .getVoiceCount =        AosdkGetVoiceCountPSF2,
+  .getVoiceName =         AosdkGetVoiceNameVoice,
   .voicesCanBeToggled =   AosdkVoicesCanBeToggled,
-  .setVoiceState =        AosdkSetVoiceState,
+  .setVoiceState =        AosdkSetVoiceStatePSF2,
   .contextSize =          sizeof(aosdkContext)
 };
 
@@ -334,9 +383,9 @@ pluginInfo pluginAosdkSSF =
   .getCurrentTrack =      AosdkGetCurrentTrack,
   .nextTrack =            AosdkNextTrack,
   .previousTrack =        AosdkPreviousTrack,
-  .getVoiceCount =        AosdkGetVoiceCount,
-  .getVoiceName =         AosdkGetVoiceName,
+  .getVoiceCount =        AosdkGetVoiceCountSSF,
+  .getVoiceName =         AosdkGetVoiceNameSlot,
   .voicesCanBeToggled =   AosdkVoicesCanBeToggled,
-  .setVoiceState =        AosdkSetVoiceState,
+  .setVoiceState =        AosdkSetVoiceStateSSF,
   .contextSize =          sizeof(aosdkContext)
 };
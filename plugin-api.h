@@ -22,6 +22,27 @@ typedef int (*GetVoiceCountFunc)(void *context);
 typedef const char* (*GetVoiceNameFunc)(void *context, int voiceNumber);
 typedef int (*VoicesCanBeToggledFunc)(void *context);
 typedef int (*SetVoiceStateFunc)(void *context, int voice, int enabled);
+/* optional (NULL if unsupported): selects whether tracks are started with
+ * per-voice output; takes effect at the next startTrack() */
+typedef int (*SetVoiceOutputFunc)(void *context, int enabled);
+/* optional (NULL if unsupported): on a track started with per-voice output,
+ * renders the mix into samples and, from the same pass, each voice on its own
+ * into voiceSamples, which holds getVoiceCount() consecutive blocks of
+ * frameCount stereo frames */
+typedef int (*GenerateVoiceFramesFunc)(void *context, int16_t *samples,
+  int16_t *voiceSamples, int frameCount);
+/* optional (NULL if unsupported): boots trackNumber on a second emulator
+ * and renders its first few hundred milliseconds, so that a later
+ * startTrack() of the same track only swaps it in and plays those frames
+ * first; it may run on another thread while the current track generates
+ * frames, mixed or per-voice, but not at the same time as startTrack(),
+ * setVoiceState() or setVoiceOutput() */
+typedef int (*PrefetchTrackFunc)(void *context, int trackNumber);
+
+/* debugging */
+/* optional (NULL if unsupported): writes a line of emulation statistics for
+ * the current track into text, which holds size bytes */
+typedef int (*GetStatsFunc)(void *context, char *text, int size);
 
 typedef struct
 {
@@ -39,6 +60,11 @@ typedef struct
   GetVoiceNameFunc         getVoiceName;
   VoicesCanBeToggledFunc   voicesCanBeToggled;
   SetVoiceStateFunc        setVoiceState;
+  SetVoiceOutputFunc       setVoiceOutput;
+  GenerateVoiceFramesFunc  generateVoiceFrames;
+  PrefetchTrackFunc        prefetchTrack;
+
+  GetStatsFunc             getStats;
 
   size_t                   contextSize;
 } pluginInfo;
@@ -8,6 +8,8 @@
 #define CONTAINER_STRING_SIZE 16
 #define CONTAINER_MAX_TRACKS 256
 #define SAMPLES_PER_FRAME 2
+#define LOOKAHEAD_LIMIT 4
+#define PREFETCH_FRAMES (MASTER_FREQUENCY / 2)
 
 typedef struct
 {
@@ -20,8 +22,99 @@ typedef struct
   int trackCount;
   int voiceCount;
   int currentTrack;
+  int stems;
+  int stemsRequested;  /* applied by the next startTrack() */
+  int voiceMuteMask;
+
+  /* the upcoming track, booted by GmePrefetchTrack() with its first frames
+   * already rendered to prefetchFrames */
+  Music_Emu *prefetchEmu;
+  int prefetchEnabled;  /* cleared while stems are on */
+  int prefetchedTrack;  /* -1 if nothing is prefetched */
+  int16_t *prefetchFrames;
+
+  /* frames of the current track that were rendered ahead of time */
+  int16_t *bufferedFrames;
+  int bufferedFramePtr;
+  int bufferedFrameCount;
+
+  int16_t frameBuffers[2][PREFETCH_FRAMES * SAMPLES_PER_FRAME];
 } gmeContext;
 
+/* loads data into *emu, reusing the emulator if it is already the
+ * right type; data is not copied, so it must stay valid while it is loaded */
+static gme_err_t GmeOpenData(Music_Emu **emu, int stems, uint8_t *data,
+  long size)
+{
+  gme_type_t type = NULL;
+  gme_err_t status;
+
+  if (size >= 4)
+    type = gme_identify_extension(gme_identify_header(data));
+  if (!type)
+    return gme_wrong_file_type;
+
+  if (*emu && gme_type(*emu) != type)
+  {
+    gme_delete(*emu);
+    *emu = NULL;
+  }
+
+  if (!*emu)
+  {
+    if (!stems)
+    {
+      *emu = gme_new_emu(type, MASTER_FREQUENCY);
+      if (!*emu)
+        return "Out of memory";
+      /* no gme_enable_loop_replay(): voices can be muted at any time, and
+       * during a replay that only takes effect once the emulator has caught
+       * up, several seconds later for a long loop */
+      /* keep each frame request's emulation time bounded during silence */
+      gme_set_lookahead_limit(*emu, LOOKAHEAD_LIMIT);
+    }
+    else
+    {
+      /* per-voice output has to be requested before the sample rate is set */
+      *emu = gme_new_emu_stems(type, MASTER_FREQUENCY);
+      if (!*emu)
+        return "Per-voice output not supported";
+    }
+  }
+
+  status = gme_load_data_borrowed(*emu, data, size);
+  if (status)
+  {
+    gme_delete(*emu);
+    *emu = NULL;
+  }
+  return status;
+}
+
+/* loads track i into *emu and starts it */
+static gme_err_t GmeOpenTrack(gmeContext *gmeCxt, Music_Emu **emu, int stems,
+  int i)
+{
+  gme_err_t status;
+
+  if (gmeCxt->specialContainer)
+  {
+    status = GmeOpenData(emu, stems, &gmeCxt->dataBuffer[gmeCxt->containerTrackOffsets[i]],
+      gmeCxt->containerTrackSizes[i]);
+    if (status)
+      return status;
+    return gme_start_track(*emu, 0);
+  }
+
+  if (!*emu)
+  {
+    status = GmeOpenData(emu, stems, gmeCxt->dataBuffer, gmeCxt->dataBufferSize);
+    if (status)
+      return status;
+  }
+  return gme_start_track(*emu, i);
+}
+
 static int GmeInitPlugin(void *context, uint8_t *data, int size)
 {
   gmeContext *gmeCxt = (gmeContext*)context;
@@ -32,6 +125,15 @@ static int GmeInitPlugin(void *context, uint8_t *data, int size)
   gmeCxt->dataBufferSize = size;
   gmeCxt->trackCount = 0;
   gmeCxt->voiceCount = 0;
+  gmeCxt->stems = 0;
+  gmeCxt->stemsRequested = 0;
+  gmeCxt->voiceMuteMask = 0;
+  gmeCxt->prefetchEmu = NULL;
+  gmeCxt->prefetchEnabled = 1;
+  gmeCxt->prefetchedTrack = -1;
+  gmeCxt->prefetchFrames = gmeCxt->frameBuffers[0];
+  gmeCxt->bufferedFrames = gmeCxt->frameBuffers[1];
+  gmeCxt->bufferedFrameCount = 0;
 
   /* check for special container format */
   if (strncmp((char*)gmeCxt->dataBuffer, CONTAINER_STRING, CONTAINER_STRING_SIZE) == 0)
@@ -67,8 +169,8 @@ static int GmeInitPlugin(void *context, uint8_t *data, int size)
 
   if (!gmeCxt->specialContainer)
   {
-    status = gme_open_data(gmeCxt->dataBuffer, gmeCxt->dataBufferSize,
-      &gmeCxt->emu, MASTER_FREQUENCY);
+    status = GmeOpenData(&gmeCxt->emu, gmeCxt->stems, gmeCxt->dataBuffer,
+        gmeCxt->dataBufferSize);
     if (!status)
     {
       gmeCxt->trackCount = gme_track_count(gmeCxt->emu);
@@ -80,52 +182,121 @@ static int GmeInitPlugin(void *context, uint8_t *data, int size)
   return (status == NULL);
 }
 
+/* (re)start track i on the current emulator, leaving any prefetch alone */
+static gme_err_t GmeRestartTrack(gmeContext *gmeCxt, int i)
+{
+  gme_err_t status;
+
+  gmeCxt->bufferedFrameCount = 0;
+  status = GmeOpenTrack(gmeCxt, &gmeCxt->emu, gmeCxt->stems, i);
+  if (gmeCxt->emu)
+    gmeCxt->voiceCount = gme_voice_count(gmeCxt->emu);
+
+  return status;
+}
+
 static int GmeStartTrack(void *context, int trackNumber)
 {
   int i;
   gmeContext *gmeCxt = (gmeContext*)context;
-  gme_err_t status;
+  Music_Emu *emu;
+  int16_t *frames;
 
   if (trackNumber == -1)
     i = gmeCxt->currentTrack;
   else
     i = trackNumber;
 
-  if (gmeCxt->specialContainer)
-  {
-    if (gmeCxt->emu)
-      gme_delete(gmeCxt->emu);
+  gmeCxt->currentTrack = i;
 
-    status = gme_open_data(&gmeCxt->dataBuffer[gmeCxt->containerTrackOffsets[i]],
-      gmeCxt->containerTrackSizes[i], &gmeCxt->emu, MASTER_FREQUENCY);
-    if (status)
-      return 0;
-    status = gme_start_track(gmeCxt->emu, 0);
-    if (status)
-      return 0;
-    gmeCxt->voiceCount = gme_voice_count(gmeCxt->emu);
+  /* switching per-voice output on or off needs a new emulator; per-voice
+   * output isn't prefetched, so drop anything booted without it (the
+   * prefetch can't be running during this call) */
+  if (gmeCxt->stemsRequested != gmeCxt->stems)
+  {
+    gmeCxt->stems = gmeCxt->stemsRequested;
+    gmeCxt->prefetchEnabled = !gmeCxt->stems;
+    gme_delete(gmeCxt->prefetchEmu);
+    gmeCxt->prefetchEmu = NULL;
+    gmeCxt->prefetchedTrack = -1;
+    gme_delete(gmeCxt->emu);
+    gmeCxt->emu = NULL;
   }
-  else
+
+  /* the track was booted ahead of time: swap it in and keep the old
+   * emulator to boot the next one with */
+  if (gmeCxt->prefetchedTrack == i)
   {
-    status = gme_start_track(gmeCxt->emu, i);
+    emu = gmeCxt->emu;
+    gmeCxt->emu = gmeCxt->prefetchEmu;
+    gmeCxt->prefetchEmu = emu;
+
+    frames = gmeCxt->bufferedFrames;
+    gmeCxt->bufferedFrames = gmeCxt->prefetchFrames;
+    gmeCxt->prefetchFrames = frames;
+    gmeCxt->bufferedFramePtr = 0;
+    gmeCxt->bufferedFrameCount = PREFETCH_FRAMES;
+
+    gmeCxt->prefetchedTrack = -1;
     gmeCxt->voiceCount = gme_voice_count(gmeCxt->emu);
-    if (status)
-      return 0;
+    return 1;
   }
+  gmeCxt->prefetchedTrack = -1;
 
-  return 1;
+  return (GmeRestartTrack(gmeCxt, i) == NULL);
 }
 
 static int GmeGenerateStereoFrames(void *context, int16_t *samples, int frameCount)
 {
   gmeContext *gmeCxt = (gmeContext*)context;
   gme_err_t status;
+  int count;
+
+  /* a prefetched track starts with the frames it rendered ahead of time */
+  if (gmeCxt->bufferedFrameCount)
+  {
+    count = frameCount;
+    if (count > gmeCxt->bufferedFrameCount)
+      count = gmeCxt->bufferedFrameCount;
+    memcpy(samples, &gmeCxt->bufferedFrames[gmeCxt->bufferedFramePtr * SAMPLES_PER_FRAME],
+      count * SAMPLES_PER_FRAME * sizeof(int16_t));
+    gmeCxt->bufferedFramePtr += count;
+    gmeCxt->bufferedFrameCount -= count;
+    samples += count * SAMPLES_PER_FRAME;
+    frameCount -= count;
+    if (!frameCount)
+      return 1;
+  }
 
   status = gme_play(gmeCxt->emu, frameCount * SAMPLES_PER_FRAME, samples);
 
   return (status == NULL);
 }
 
+static int GmeSetVoiceOutput(void *context, int enabled)
+{
+  gmeContext *gmeCxt = (gmeContext*)context;
+
+  gmeCxt->stemsRequested = (enabled != 0);
+  return 1;
+}
+
+static int GmeGenerateVoiceFrames(void *context, int16_t *samples,
+  int16_t *voiceSamples, int frameCount)
+{
+  gmeContext *gmeCxt = (gmeContext*)context;
+  gme_err_t status;
+
+  /* the track wasn't started with per-voice output */
+  if (!gmeCxt->stems || !gmeCxt->emu)
+    return 0;
+
+  status = gme_play_stems(gmeCxt->emu, frameCount * SAMPLES_PER_FRAME,
+    samples, voiceSamples);
+
+  return (status == NULL);
+}
+
 static int GmeGetTrackCount(void *context)
 {
   gmeContext *gmeCxt = (gmeContext*)context;
@@ -183,8 +354,46 @@ static int GmeVoicesCanBeToggled(void *context)
 static int GmeSetVoiceState(void *context, int voice, int enabled)
 {
   gmeContext *gmeCxt = (gmeContext*)context;
+  int mask;
+
   if (voice < gmeCxt->voiceCount)
+  {
     gme_mute_voice(gmeCxt->emu, voice, enabled);
+
+    /* a prefetched track was rendered with the old mute states */
+    mask = gmeCxt->voiceMuteMask & ~(1 << voice);
+    if (enabled)
+      mask |= 1 << voice;
+    if (mask != gmeCxt->voiceMuteMask)
+    {
+      gmeCxt->voiceMuteMask = mask;
+      gmeCxt->prefetchedTrack = -1;
+    }
+  }
+  return 1;
+}
+
+static int GmePrefetchTrack(void *context, int trackNumber)
+{
+  gmeContext *gmeCxt = (gmeContext*)context;
+  gme_err_t status;
+
+  /* per-voice output isn't buffered ahead of time */
+  if (!gmeCxt->prefetchEnabled)
+    return 0;
+
+  gmeCxt->prefetchedTrack = -1;
+  status = GmeOpenTrack(gmeCxt, &gmeCxt->prefetchEmu, 0, trackNumber);
+  if (status)
+    return 0;
+
+  gme_mute_voices(gmeCxt->prefetchEmu, gmeCxt->voiceMuteMask);
+  status = gme_play(gmeCxt->prefetchEmu, PREFETCH_FRAMES * SAMPLES_PER_FRAME,
+    gmeCxt->prefetchFrames);
+  if (status)
+    return 0;
+
+  gmeCxt->prefetchedTrack = trackNumber;
   return 1;
 }
 
@@ -201,5 +410,8 @@ pluginInfo pluginGameMusicEmu =
   .getVoiceName =         GmeGetVoiceName,
   .voicesCanBeToggled =   GmeVoicesCanBeToggled,
   .setVoiceState =        GmeSetVoiceState,
+  .setVoiceOutput =       GmeSetVoiceOutput,
+  .generateVoiceFrames =  GmeGenerateVoiceFrames,
+  .prefetchTrack =        GmePrefetchTrack,
   .contextSize =          sizeof(gmeContext)
 };
@@ -215,6 +215,18 @@ static int TwosfSetVoiceState(void *privateData, int voice, int enabled)
   return 0;
 }
 
+static int TwosfGetStats(void *privateData, char *text, int size)
+{
+  unsigned long long executed[2];
+  unsigned long long skipped[2];
+
+  xsf_get_cycle_stats(executed, skipped);
+  snprintf(text, size,
+    "ARM9 cycles: %llu executed, %llu skipped; ARM7 cycles: %llu executed, %llu skipped",
+    executed[0], skipped[0], executed[1], skipped[1]);
+  return 1;
+}
+
 pluginInfo pluginVio2sf =
 {
   .initPlugin =           TwosfInitPlugin,
@@ -228,5 +240,6 @@ pluginInfo pluginVio2sf =
   .getVoiceName =         TwosfGetVoiceName,
   .voicesCanBeToggled =   TwosfVoicesCanBeToggled,
   .setVoiceState =        TwosfSetVoiceState,
+  .getStats =             TwosfGetStats,
   .contextSize =          sizeof(twosfContext)
 };
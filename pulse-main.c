@@ -13,6 +13,7 @@ extern pluginInfo pluginAosdkPSF2;
 extern pluginInfo pluginAosdkSSF;
 
 #define BUFFER_SIZE 2048
+#define STATS_BUFFERS (MASTER_FREQUENCY * 10 / BUFFER_SIZE)
 
 int main(int argc, char *argv[])
 {
@@ -27,6 +28,8 @@ int main(int argc, char *argv[])
   short audio_buffer[BUFFER_SIZE * 2];
   int track_count;
   int requested_track;
+  int buffer_count = 0;
+  char stats[256];
 
   /* process rigid command line options */
   if (argc < 4)
@@ -137,6 +140,13 @@ int main(int argc, char *argv[])
   {
     playerPlugin->generateStereoFrames(context, audio_buffer, BUFFER_SIZE);
     pa_simple_write(s, audio_buffer, BUFFER_SIZE * 2 * 2, &pa_error);
+
+    /* print the engine's statistics about every 10 seconds */
+    if (playerPlugin->getStats && ++buffer_count % STATS_BUFFERS == 0)
+    {
+      playerPlugin->getStats(context, stats, sizeof(stats));
+      printf("%d s: %s\n", buffer_count * BUFFER_SIZE / MASTER_FREQUENCY, stats);
+    }
   }
 
   pa_simple_drain(s, &pa_error);
@@ -64,7 +64,7 @@ static PPB_Var* g_var_if = NULL;
 #define CONTAINER_STRING "Game Music Files"
 #define CONTAINER_STRING_SIZE 16
 #define CONTAINER_MAX_TRACKS 256
-#define MAX_VOICES 16
+#define MAX_VOICES 64
 
 /* functions callable from JS */
 static const char* const kSetTrackId = "setTrack";
@@ -75,6 +75,8 @@ static const char* const kStopPlaybackId = "stopPlayback";
 static const char* const kDisableVizId = "disableViz";
 static const char* const kEnableVizId = "enableViz";
 static const char* const kToggleVoiceId = "toggleVoice";
+static const char* const kEnableVoiceLevelsId = "enableVoiceLevels";
+static const char* const kDisableVoiceLevelsId = "disableVoiceLevels";
 
 /* properties that can be queried from JS */
 static const char* const kTrackCountId = "trackCount";
@@ -112,6 +114,9 @@ typedef struct
   /* player plugin */
   pluginInfo *playerPlugin;
   unsigned char *pluginContext;
+  pthread_t prefetchThread;  /* boots the next track while this one plays */
+  int prefetchRunning;
+  int prefetchTrackNumber;
 
   /* network resource */
   PP_Resource songLoader;
@@ -134,6 +139,10 @@ typedef struct
   unsigned int audioStart;
   unsigned int audioEnd;
   int voiceMuted[MAX_VOICES];
+  int voiceLevelsEnabled;  /* applied when the next track starts */
+  int voiceLevels;   /* the current track renders per-voice output */
+  short *voiceBuffer;  /* per-voice output for up to FRAME_COUNT frames */
+  int voicePeaks[MAX_VOICES];  /* since the last voiceLevels message */
   int secondCounter;  /* set to framerate, dec on each frame, fire on 0 */
   int frameCountForCurrentTrack;
 
@@ -190,6 +199,10 @@ static PP_Bool InitContext(PP_Instance instance)
   cxt->instance = instance;
   cxt->audioStart = 0;
   cxt->audioEnd = 0;
+  cxt->prefetchRunning = 0;
+  cxt->voiceLevelsEnabled = 0;
+  cxt->voiceLevels = 0;
+  cxt->voiceBuffer = NULL;
 
   cxt->r = cxt->g = cxt->b = 250;
   cxt->rInc = -1;
@@ -333,20 +346,121 @@ static int GetCurrentUITrack(SaltyGmeContext *cxt)
   return cxt->playerPlugin->getCurrentTrack(cxt->pluginContext) + 1;
 }
 
+static void *PrefetchThread(void *user_data)
+{
+  SaltyGmeContext *cxt = (SaltyGmeContext*)user_data;
+
+  cxt->playerPlugin->prefetchTrack(cxt->pluginContext, cxt->prefetchTrackNumber);
+  return NULL;
+}
+
+/* the plugin can't change tracks or voice states while a prefetch runs */
+static void WaitForPrefetch(SaltyGmeContext *cxt)
+{
+  if (cxt->prefetchRunning)
+  {
+    pthread_join(cxt->prefetchThread, NULL);
+    cxt->prefetchRunning = 0;
+  }
+}
+
 static void StartTrack(SaltyGmeContext *cxt, int trackNumber)
 {
   int i;
   int voiceCount;
+  int trackCount;
+
+  WaitForPrefetch(cxt);
 
+  /* per-voice output is chosen before the track starts rather than
+   * switched on under a playing track */
+  if (cxt->playerPlugin->setVoiceOutput && cxt->playerPlugin->generateVoiceFrames)
+    cxt->playerPlugin->setVoiceOutput(cxt->pluginContext,
+      cxt->voiceLevelsEnabled);
   cxt->playerPlugin->startTrack(cxt->pluginContext, trackNumber);
   cxt->frameCountForCurrentTrack = 0;
 
-  /* mute states propagate across tracks */
   voiceCount = cxt->playerPlugin->getVoiceCount(cxt->pluginContext);
+
+  /* the audio mutex keeps the timer from generating frames while the
+   * buffer changes */
+  pthread_mutex_lock(&cxt->audioMutex);
+  free(cxt->voiceBuffer);
+  cxt->voiceBuffer = NULL;
+  cxt->voiceLevels = 0;
+  if (cxt->voiceLevelsEnabled && cxt->playerPlugin->setVoiceOutput &&
+      cxt->playerPlugin->generateVoiceFrames && voiceCount > 0)
+  {
+    cxt->voiceBuffer = (short*)malloc(voiceCount * FRAME_COUNT * BYTES_PER_FRAME);
+    cxt->voiceLevels = (cxt->voiceBuffer != NULL);
+  }
+  for (i = 0; i < MAX_VOICES; i++)
+    cxt->voicePeaks[i] = 0;
+  pthread_mutex_unlock(&cxt->audioMutex);
+
+  /* mute states propagate across tracks */
   for (i = 0; i < MAX_VOICES; i++)
     if (i < voiceCount)
       cxt->playerPlugin->setVoiceState(cxt->pluginContext, i,
         cxt->voiceMuted[i]);
+
+  /* boot the track that nextTrack would move to in the background, so that
+   * switching to it doesn't have to wait for the emulator */
+  trackCount = cxt->playerPlugin->getTrackCount(cxt->pluginContext);
+  if (cxt->playerPlugin->prefetchTrack && trackCount > 1)
+  {
+    cxt->prefetchTrackNumber =
+      (cxt->playerPlugin->getCurrentTrack(cxt->pluginContext) + 1) % trackCount;
+    if (pthread_create(&cxt->prefetchThread, NULL, PrefetchThread, cxt) == 0)
+      cxt->prefetchRunning = 1;
+  }
+}
+
+/* renders frameCount frames into samples, tracking each voice's peak level
+ * on the way if the track was started with per-voice output */
+static void GenerateFrames(SaltyGmeContext *cxt, short *samples, int frameCount)
+{
+  int voiceCount;
+  int count;
+  int voice;
+  int i;
+  int sample;
+  short *voiceSamples;
+
+  if (!cxt->voiceLevels)
+  {
+    cxt->playerPlugin->generateStereoFrames(cxt->pluginContext, samples,
+      frameCount);
+    return;
+  }
+
+  voiceCount = cxt->playerPlugin->getVoiceCount(cxt->pluginContext);
+  if (voiceCount > MAX_VOICES)
+    voiceCount = MAX_VOICES;
+  while (frameCount > 0)
+  {
+    count = frameCount;
+    if (count > FRAME_COUNT)
+      count = FRAME_COUNT;
+    cxt->playerPlugin->generateVoiceFrames(cxt->pluginContext, samples,
+      cxt->voiceBuffer, count);
+
+    for (voice = 0; voice < voiceCount; voice++)
+    {
+      voiceSamples = &cxt->voiceBuffer[voice * count * SAMPLES_PER_FRAME];
+      for (i = 0; i < count * SAMPLES_PER_FRAME; i++)
+      {
+        sample = voiceSamples[i];
+        if (sample < 0)
+          sample = -sample;
+        if (sample > cxt->voicePeaks[voice])
+          cxt->voicePeaks[voice] = sample;
+      }
+    }
+
+    samples += count * SAMPLES_PER_FRAME;
+    frameCount -= count;
+  }
 }
 
 static void DrawLoadingFrame(uint32_t *pixels, uint32_t blackPixel,
@@ -419,6 +533,8 @@ static void TimerCallback(void* user_data, int32_t result)
   unsigned char textShade;
   struct PP_Var var_result;
   char result_string[MAX_RESULT_STR_LEN];
+  char levels_string[MAX_VOICES * 4 + 16];
+  int voiceCount;
   int bufferFrames;
 
   if (!cxt->isLoaded && GetMillisecondsCount(cxt) >= (1000 / FRAME_RATE))
@@ -463,19 +579,19 @@ static void TimerCallback(void* user_data, int32_t result)
         framesPostWrap = framesToGenerate - framesPreWrap;
 
         /* before the wraparound */
-        cxt->playerPlugin->generateStereoFrames(cxt->pluginContext,
+        GenerateFrames(cxt,
           &cxt->audioBuffer[(cxt->audioEnd % BUFFER_SIZE_IN_FRAMES) * SAMPLES_PER_FRAME],
           framesPreWrap);
 
         /* after the wraparound */
-        cxt->playerPlugin->generateStereoFrames(cxt->pluginContext,
+        GenerateFrames(cxt,
           &cxt->audioBuffer[0],
           framesPostWrap);
       }
       else
       {
         /* simple, non-wraparound case */
-        cxt->playerPlugin->generateStereoFrames(cxt->pluginContext,
+        GenerateFrames(cxt,
           &cxt->audioBuffer[(cxt->audioEnd % BUFFER_SIZE_IN_FRAMES) * SAMPLES_PER_FRAME],
           framesToGenerate);
       }
@@ -568,6 +684,25 @@ static void TimerCallback(void* user_data, int32_t result)
       cxt->frameCountForCurrentTrack / MASTER_FREQUENCY);
     var_result = AllocateVarFromCStr(result_string);
     g_messaging_if->PostMessage(cxt->instance, var_result);
+
+    /* along with each voice's peak level since the last time, 0..100 */
+    if (cxt->voiceLevels)
+    {
+      voiceCount = cxt->playerPlugin->getVoiceCount(cxt->pluginContext);
+      if (voiceCount > MAX_VOICES)
+        voiceCount = MAX_VOICES;
+      pthread_mutex_lock(&cxt->audioMutex);
+      strcpy(levels_string, "voiceLevels:");
+      for (i = 0; i < voiceCount; i++)
+      {
+        sprintf(&levels_string[strlen(levels_string)], i ? ",%d" : "%d",
+          cxt->voicePeaks[i] * 100 / 32768);
+        cxt->voicePeaks[i] = 0;
+      }
+      pthread_mutex_unlock(&cxt->audioMutex);
+      var_result = AllocateVarFromCStr(levels_string);
+      g_messaging_if->PostMessage(cxt->instance, var_result);
+    }
   }
 
   g_core_if->CallOnMainThread(5, timerCallback, 0);
@@ -813,6 +948,8 @@ static void Instance_DidDestroy(PP_Instance instance) {
 
   cxt = GetContext(instance);
 
+  WaitForPrefetch(cxt);
+  free(cxt->voiceBuffer);
   pthread_mutex_destroy(&cxt->audioMutex);
 }
 
@@ -933,6 +1070,15 @@ void Messaging_HandleMessage(PP_Instance instance, struct PP_Var var_message)
   {
     cxt->vizEnabled = 1;
   }
+  else if (strncmp(message, kEnableVoiceLevelsId, strlen(kEnableVoiceLevelsId)) == 0)
+  {
+    /* per-voice levels start with the next track */
+    cxt->voiceLevelsEnabled = 1;
+  }
+  else if (strncmp(message, kDisableVoiceLevelsId, strlen(kDisableVoiceLevelsId)) == 0)
+  {
+    cxt->voiceLevelsEnabled = 0;
+  }
   else if (strncmp(message, kToggleVoiceId, strlen(kToggleVoiceId)) == 0)
   {
     /* check that string length allows for a ':track_num' after the command
@@ -946,6 +1092,7 @@ void Messaging_HandleMessage(PP_Instance instance, struct PP_Var var_message)
         voice < cxt->playerPlugin->getVoiceCount(cxt->pluginContext))
       {
         cxt->voiceMuted[voice] ^= 1;
+        WaitForPrefetch(cxt);
         cxt->playerPlugin->setVoiceState(cxt->pluginContext, voice,
           cxt->voiceMuted[voice]);
       }
@@ -211,6 +211,19 @@ u32 MMU_ARM7_MEM_MASK[256]={
 /* FX*/	DUP16(0x00000003)
 };
 
+/* Host pointers for the 4 KB pages of the first 64 MB (ITCM, ARM9 WRAM,
+   main RAM, shared and ARM7 WRAM), so plain RAM accesses skip the checks
+   in MMU_read and MMU_write. Pages left NULL (the ARM9 DTCM and regions
+   mirrored in less than a page) go through the normal path. */
+#define MMU_PAGE_SHIFT 12
+#define MMU_PAGE_COUNT (0x04000000 >> MMU_PAGE_SHIFT)
+#define MMU_PAGE_MASK ((1 << MMU_PAGE_SHIFT) - 1)
+
+static u8 * MMU_PAGE[2][MMU_PAGE_COUNT];
+
+#define MMU_PAGE_FOR(proc, adr) \
+	((adr) < 0x04000000 ? MMU_PAGE[proc][(adr) >> MMU_PAGE_SHIFT] : NULL)
+
 u32 MMU_ARM9_WAIT16[16]={
 	1, 1, 1, 1, 1, 1, 1, 1, 5, 5, 5, 1, 1, 1, 1, 1,
 };
@@ -266,6 +279,8 @@ void MMU_Init(void) {
         mc_alloc(&MMU.bupmem, 1);
         MMU.bupmem.fp = NULL;
 
+	MMU_updatePages(ARMCPU_ARM9);
+	MMU_updatePages(ARMCPU_ARM7);
 } 
 
 void MMU_DeInit(void) {
@@ -317,6 +332,7 @@ void MMU_clearMem()
 	
 	MMU.DTCMRegion = 0;
 	MMU.ITCMRegion = 0x00800000;
+	MMU_updatePages(ARMCPU_ARM9);
 	
 	memset(MMU.timer,         0, sizeof(u16) * 2 * 4);
 	memset(MMU.timerMODE,     0, sizeof(s32) * 2 * 4);
@@ -613,10 +629,32 @@ void MMU_unsetRom()
 	}
 	rom_mask = ROM_MASK;
 }
+
+void MMU_updatePages(u32 proc)
+{
+	u32 i;
+
+	for(i = 0; i < MMU_PAGE_COUNT; ++i)
+	{
+		u32 adr = i << MMU_PAGE_SHIFT;
+		u32 mask = MMU.MMU_MASK[proc][(adr>>20)&0xFF];
+
+		if(((mask & MMU_PAGE_MASK) != MMU_PAGE_MASK) ||
+		   ((proc == ARMCPU_ARM9) && ((adr & ~0x3FFF) == MMU.DTCMRegion)))
+			MMU_PAGE[proc][i] = NULL;
+		else
+			MMU_PAGE[proc][i] = MMU.MMU_MEM[proc][(adr>>20)&0xFF] + (adr & mask);
+	}
+}
 char txt[80];	
 
 u8 FASTCALL MMU_read8(u32 proc, u32 adr)
 {
+	u8 *page = MMU_PAGE_FOR(proc, adr);
+
+	if(page)
+		return T1ReadByte(page, adr & MMU_PAGE_MASK);
+
 #ifdef INTERNAL_DTCM_READ
 	if((proc==ARMCPU_ARM9)&((adr&(~0x3FFF))==MMU.DTCMRegion))
 	{
@@ -646,6 +684,11 @@ u8 FASTCALL MMU_read8(u32 proc, u32 adr)
 
 u16 FASTCALL MMU_read16(u32 proc, u32 adr)
 {    
+	u8 *page = MMU_PAGE_FOR(proc, adr);
+
+	if(page)
+		return T1ReadWord(page, adr & MMU_PAGE_MASK);
+
 #ifdef INTERNAL_DTCM_READ
 	if((proc == ARMCPU_ARM9) && ((adr & ~0x3FFF) == MMU.DTCMRegion))
 	{
@@ -719,6 +762,11 @@ u16 FASTCALL MMU_read16(u32 proc, u32 adr)
 	 
 u32 FASTCALL MMU_read32(u32 proc, u32 adr)
 {
+	u8 *page = MMU_PAGE_FOR(proc, adr);
+
+	if(page)
+		return T1ReadLong(page, adr & MMU_PAGE_MASK);
+
 #ifdef INTERNAL_DTCM_READ
 	if((proc == ARMCPU_ARM9) && ((adr & ~0x3FFF) == MMU.DTCMRegion))
 	{
@@ -822,6 +870,7 @@ u32 FASTCALL MMU_read32(u32 proc, u32 adr)
 				u32 val = FIFOValue(MMU.fifos + fifonum);
 				u32 remote = (proc+1) & 1;
 				u16 IPCFIFO_CNT_remote = T1ReadWord(MMU.MMU_MEM[remote][0x40], 0x184);
+				++MMU.sideEffects[proc];
 				IPCFIFO_CNT |= (MMU.fifos[fifonum].empty<<8) | (MMU.fifos[fifonum].full<<9) | (MMU.fifos[fifonum].error<<14);
 				IPCFIFO_CNT_remote |= (MMU.fifos[fifonum].empty) | (MMU.fifos[fifonum].full<<1);
 				T1WriteWord(MMU.MMU_MEM[proc][0x40], 0x184, IPCFIFO_CNT);
@@ -856,6 +905,7 @@ u32 FASTCALL MMU_read32(u32 proc, u32 adr)
                                 u32 val;
 
                                 if(!MMU.dscard[proc].adress) return 0;
+				++MMU.sideEffects[proc];
 				
                                 val = T1ReadLong(MMU.CART_ROM, MMU.dscard[proc].adress);
 
@@ -893,6 +943,16 @@ u32 FASTCALL MMU_read32(u32 proc, u32 adr)
 	
 void FASTCALL MMU_write8(u32 proc, u32 adr, u8 val)
 {
+	u8 *page = MMU_PAGE_FOR(proc, adr);
+
+	++MMU.sideEffects[proc];
+
+	if(page)
+	{
+		T1WriteByte(page, adr & MMU_PAGE_MASK, val);
+		return;
+	}
+
 #ifdef INTERNAL_DTCM_WRITE
 	if((proc == ARMCPU_ARM9) && ((adr & ~0x3FFF) == MMU.DTCMRegion))
 	{
@@ -1267,6 +1327,16 @@ u16 partie = 1;
 
 void FASTCALL MMU_write16(u32 proc, u32 adr, u16 val)
 {
+	u8 *page = MMU_PAGE_FOR(proc, adr);
+
+	++MMU.sideEffects[proc];
+
+	if(page)
+	{
+		T1WriteWord(page, adr & MMU_PAGE_MASK, val);
+		return;
+	}
+
 #ifdef INTERNAL_DTCM_WRITE
 	if((proc == ARMCPU_ARM9) && ((adr & ~0x3FFF) == MMU.DTCMRegion))
 	{
@@ -1890,6 +1960,16 @@ void FASTCALL MMU_write16(u32 proc, u32 adr, u16 val)
 
 void FASTCALL MMU_write32(u32 proc, u32 adr, u32 val)
 {
+	u8 *page = MMU_PAGE_FOR(proc, adr);
+
+	++MMU.sideEffects[proc];
+
+	if(page)
+	{
+		T1WriteLong(page, adr & MMU_PAGE_MASK, val);
+		return;
+	}
+
 #ifdef INTERNAL_DTCM_WRITE
 	if((proc==ARMCPU_ARM9)&((adr&(~0x3FFF))==MMU.DTCMRegion))
 	{
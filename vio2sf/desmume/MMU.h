@@ -100,6 +100,10 @@ typedef struct {
         nds_dscard	dscard[2];
 		u32			CheckTimers;
 		u32			CheckDMAs;
+
+		/* bumped by every write and by reads that change state (IPC FIFO,
+		   card data), so idle loop detection can tell a loop has no effect */
+		u32			sideEffects[2];
 		  
 } MMU_struct;
 
@@ -146,6 +150,7 @@ void MMU_clearMem( void);
 
 void MMU_setRom(u8 * rom, u32 mask);
 void MMU_unsetRom( void);
+void MMU_updatePages(u32 proc);
 
 
 /**
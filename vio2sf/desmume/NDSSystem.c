@@ -21,6 +21,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #include "NDSSystem.h"
 #include "MMU.h"
@@ -311,6 +312,8 @@ void NDS_Reset( void)
    nds.diff = 0;
    nds.lignerendu = FALSE;
    nds.touchX = nds.touchY = 0;
+   memset(nds.cyclesExecuted, 0, sizeof(u64) * 2);
+   memset(nds.cyclesSkipped, 0, sizeof(u64) * 2);
 
    MMU_write16(0, 0x04000130, 0x3FF);
    MMU_write16(1, 0x04000130, 0x3FF);
@@ -536,19 +539,102 @@ static void timer_check(void)
 	}
 }
 
+/* ARM9 idle loop detection. Sound drivers often leave the ARM9 polling
+   memory that only the ARM7 or an interrupt will change. Neither can happen
+   while the ARM9 runs its part of a half line, so once a short backward
+   loop comes round to the same registers without any write or side-effect
+   read in between, every further pass will be identical. Those passes are
+   skipped in whole, keeping the cycle count (and the remaining partial
+   pass) exactly as if they had been stepped. */
+
+#define ARM9_IDLE_LOOP_BYTES 64
+#define ARM9_IDLE_REGS (offsetof(armcpu_t, coproc) - offsetof(armcpu_t, R))
+
+static struct
+{
+	u32 adr;		/* loop head seen last, 1 when none */
+	u32 sideEffects;	/* MMU.sideEffects[0] at that point */
+	s32 cycle;		/* nds.ARM9Cycle at that point */
+	u8 regs[ARM9_IDLE_REGS];
+} arm9idle;
+
+static void NDS_checkARM9Idle(s32 nb)
+{
+	if (nb <= nds.ARM9Cycle)
+		return;
+
+	if (NDS_ARM9.instruct_adr == arm9idle.adr &&
+	    MMU.sideEffects[0] == arm9idle.sideEffects &&
+	    !memcmp(arm9idle.regs, NDS_ARM9.R, ARM9_IDLE_REGS))
+	{
+		s32 period = nds.ARM9Cycle - arm9idle.cycle;
+		s32 skip = ((nb - 1 - nds.ARM9Cycle) / period) * period;
+
+		nds.ARM9Cycle += skip;
+		nds.cyclesSkipped[0] += skip;
+		arm9idle.cycle = nds.ARM9Cycle;
+		return;
+	}
+
+	arm9idle.adr = NDS_ARM9.instruct_adr;
+	arm9idle.sideEffects = MMU.sideEffects[0];
+	arm9idle.cycle = nds.ARM9Cycle;
+	memcpy(arm9idle.regs, NDS_ARM9.R, ARM9_IDLE_REGS);
+}
+
+static void NDS_exec_arm9(s32 nb, int cpu_clockdown_level_arm9)
+{
+	s32 start = nds.ARM9Cycle;
+	u64 skipped = nds.cyclesSkipped[0];
+
+	if (nds.ARM9IdleSkip)
+	{
+		u32 last = NDS_ARM9.instruct_adr;
+
+		arm9idle.adr = 1;
+		while (nb > nds.ARM9Cycle && !NDS_ARM9.waitIRQ)
+		{
+			nds.ARM9Cycle += armcpu_exec(&NDS_ARM9) << (cpu_clockdown_level_arm9);
+			if (NDS_ARM9.instruct_adr < last && last - NDS_ARM9.instruct_adr <= ARM9_IDLE_LOOP_BYTES)
+				NDS_checkARM9Idle(nb);
+			last = NDS_ARM9.instruct_adr;
+		}
+	}
+	else
+	{
+		while (nb > nds.ARM9Cycle && !NDS_ARM9.waitIRQ)
+			nds.ARM9Cycle += armcpu_exec(&NDS_ARM9) << (cpu_clockdown_level_arm9);
+	}
+	nds.cyclesExecuted[0] += (nds.ARM9Cycle - start) - (nds.cyclesSkipped[0] - skipped);
+
+	if (NDS_ARM9.waitIRQ)
+	{
+		if (nb > nds.ARM9Cycle)
+			nds.cyclesSkipped[0] += nb - nds.ARM9Cycle;
+		nds.ARM9Cycle = nb;
+	}
+}
+
 void NDS_exec_hframe(int cpu_clockdown_level_arm9, int cpu_clockdown_level_arm7)
 {
 	int h;
 	for (h = 0; h < 2; h++)
 	{
 		s32 nb = nds.cycles + (h ? (99 * 12) : (256 * 12));
+		s32 start;
 
-		while (nb > nds.ARM9Cycle && !NDS_ARM9.waitIRQ)
-			nds.ARM9Cycle += armcpu_exec(&NDS_ARM9) << (cpu_clockdown_level_arm9);
-		if (NDS_ARM9.waitIRQ) nds.ARM9Cycle = nb;
+		NDS_exec_arm9(nb, cpu_clockdown_level_arm9);
+
+		start = nds.ARM7Cycle;
 		while (nb > nds.ARM7Cycle && !NDS_ARM7.waitIRQ)
 			nds.ARM7Cycle += armcpu_exec(&NDS_ARM7) << (1 + (cpu_clockdown_level_arm7));
-		if (NDS_ARM7.waitIRQ) nds.ARM7Cycle = nb;
+		nds.cyclesExecuted[1] += nds.ARM7Cycle - start;
+		if (NDS_ARM7.waitIRQ)
+		{
+			if (nb > nds.ARM7Cycle)
+				nds.cyclesSkipped[1] += nb - nds.ARM7Cycle;
+			nds.ARM7Cycle = nb;
+		}
 		nds.cycles = (nds.ARM9Cycle<nds.ARM7Cycle)?nds.ARM9Cycle : nds.ARM7Cycle;
 
 		/* HBLANK */
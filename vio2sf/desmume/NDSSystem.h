@@ -123,6 +123,14 @@ typedef struct
        
        u16 touchX;
        u16 touchY;
+
+       /* when set, an ARM9 spinning in a loop with no side effects is
+          advanced to the end of the half line instead of being stepped */
+       BOOL ARM9IdleSkip;
+       /* cycles per CPU (0 = ARM9, 1 = ARM7) run through armcpu_exec and
+          skipped while halted or idle, since the last reset */
+       u64 cyclesExecuted[2];
+       u64 cyclesSkipped[2];
 } NDSSystem;
 
 /** /brief A touchscreen calibration point.
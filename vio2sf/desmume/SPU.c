@@ -29,6 +29,10 @@
 
 #include "armcpu.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 enum
 {
 	FORMAT_PCM8 = 0,
@@ -69,11 +73,12 @@ typedef struct
 {
 	s32 *pmixbuf;
 	s16 *pclipingbuf;
+	s16 *pchanbuf;
 	u32 buflen;
 	SChannel ch[16];
 } SPU_struct;
 
-static SPU_struct spu = { 0, 0, 0 };
+static SPU_struct spu = { 0, 0, 0, 0 };
 
 static SoundInterface_struct *SNDCore=NULL;
 extern SoundInterface_struct *SNDCoreList[];
@@ -99,6 +104,13 @@ int SPU_ChangeSoundCore(int coreid, int buffersize)
 		return -1;
 	}
 
+	spu.pchanbuf = malloc(buffersize * sizeof(s16));
+	if (!spu.pchanbuf)
+	{
+		SPU_DeInit();
+		return -1;
+	}
+
 	// So which core do we want?
 	if (coreid == SNDCORE_DEFAULT)
 		coreid = 0; // Assume we want the first one
@@ -160,6 +172,11 @@ void SPU_DeInit(void)
 		free(spu.pclipingbuf);
 		spu.pclipingbuf = 0;
 	}
+	if (spu.pchanbuf)
+	{
+		free(spu.pchanbuf);
+		spu.pchanbuf = 0;
+	}
 	if (SNDCore)
 	{
 		SNDCore->DeInit();
@@ -507,27 +524,18 @@ static INLINE s32 clipping(s32 x, s32 min, s32 max) {
 
 //extern unsigned long dwChannelMute;
 
-static void decode_pcm8(SChannel *ch, s32 *out, int length)
+static int decode_pcm8(SChannel *ch, s16 *out, int length)
 {
 	int oi;
 	double pos, inc, len;
-	if (!ch->buf8) return;
+	if (!ch->buf8) return 0;
 
 	pos = ch->pos; inc = ch->inc; len = ch->loopend;
 
 	for(oi = 0; oi < length; oi++)
 	{
 		ch->output = ((s16)(s8)ch->buf8[(int)pos]) << 8;
-		if (0) //dwChannelMute & (1 << ch->id))
-		{
-			out++;
-			out++;
-		}
-		else
-		{
-			*(out++) += (ch->output * ch->volumel) >> VOL_SHIFT;
-			*(out++) += (ch->output * ch->volumer) >> VOL_SHIFT;
-		}
+		*(out++) = ch->output;
 		pos += inc;
 		if(pos >= len)
 		{
@@ -541,22 +549,22 @@ static void decode_pcm8(SChannel *ch, s32 *out, int length)
 				break;
 			default:
 				stop_channel(ch);
-				oi = length;
+				length = oi + 1;
 				break;
 			}
 		}
 	}
 
 	ch->pos = pos;
-	return;
+	return length;
 }
 
-static void decode_pcm16(SChannel *ch, s32 *out, int length)
+static int decode_pcm16(SChannel *ch, s16 *out, int length)
 {
 	int oi;
 	double pos, inc, len;
 
-	if (!ch->buf16) return;
+	if (!ch->buf16) return 0;
 
 	pos = ch->pos; inc = ch->inc; len = ch->loopend;
 
@@ -567,16 +575,7 @@ static void decode_pcm16(SChannel *ch, s32 *out, int length)
 #else
 		ch->output = (s16)ch->buf16[(int)pos];
 #endif
-		if (0) //dwChannelMute & (1 << ch->id))
-		{
-			out++;
-			out++;
-		}
-		else
-		{
-			*(out++) += (ch->output * ch->volumel) >> VOL_SHIFT;
-			*(out++) += (ch->output * ch->volumer) >> VOL_SHIFT;
-		}
+		*(out++) = ch->output;
 		pos += inc;
 		if(pos >= len)
 		{
@@ -590,13 +589,14 @@ static void decode_pcm16(SChannel *ch, s32 *out, int length)
 				break;
 			default:
 				stop_channel(ch);
-				oi = length;
+				length = oi + 1;
 				break;
 			}
 		}
 	}
 
 	ch->pos = pos;
+	return length;
 }
 
 static INLINE void decode_adpcmone_P4(SChannel *ch, int m)
@@ -722,11 +722,11 @@ static INLINE void decode_adpcmone_XX(SChannel *ch, int m)
 
 #define decode_adpcmone decode_adpcmone_P4
 
-static void decode_adpcm(SChannel *ch, s32 *out, int length)
+static int decode_adpcm(SChannel *ch, s16 *out, int length)
 {
 	int oi;
 	double pos, inc, len;
-	if (!ch->buf8) return;
+	if (!ch->buf8) return 0;
 
 	pos = ch->pos; inc = ch->inc; len = ch->loopend;
 
@@ -737,16 +737,7 @@ static void decode_adpcm(SChannel *ch, s32 *out, int length)
 		if(i < m)
 			decode_adpcmone(ch, m);
 
-		if (0) //dwChannelMute & (1 << ch->id))
-		{
-			out++;
-			out++;
-		}
-		else
-		{
-			*(out++) += (ch->output * ch->volumel) >> VOL_SHIFT;
-			*(out++) += (ch->output * ch->volumer) >> VOL_SHIFT;
-		}
+		*(out++) = ch->output;
 		pos += inc;
 		if(pos >= len)
 		{
@@ -775,15 +766,16 @@ static void decode_adpcm(SChannel *ch, s32 *out, int length)
 #endif
 			default:
 				stop_channel(ch);
-				oi = length;
+				length = oi + 1;
 				break;
 			}
 		}
 	}
 	ch->pos = pos;
+	return length;
 }
 
-static void decode_psg(SChannel *ch, s32 *out, int length)
+static int decode_psg(SChannel *ch, s16 *out, int length)
 {
 	int oi;
 
@@ -795,19 +787,11 @@ static void decode_psg(SChannel *ch, s32 *out, int length)
 		for(oi = 0; oi < length; oi++)
 		{
 			ch->output = (s16)g_psg_duty[ch->psg_duty][(int)pos & 0x00000007];
-			if (0) //dwChannelMute & (1 << ch->id))
-			{
-				out++;
-				out++;
-			}
-			else
-			{
-				*(out++) += (ch->output * ch->volumel) >> VOL_SHIFT;
-				*(out++) += (ch->output * ch->volumer) >> VOL_SHIFT;
-			}
+			*(out++) = ch->output;
 			pos += inc;
 		}
 		ch->pos = pos;
+		return length;
 	}
 	else
 	{
@@ -828,23 +812,62 @@ static void decode_psg(SChannel *ch, s32 *out, int length)
 				ch->output = +0x7FFF;
 			}
 		}
-		if (0) //dwChannelMute & (1 << ch->id))
-		{
-			out++;
-			out++;
-		}
-		else
-		{
-			*(out++) += (ch->output * ch->volumel) >> VOL_SHIFT;
-			*(out++) += (ch->output * ch->volumer) >> VOL_SHIFT;
-		}
+		/* only the last value is mixed, into the first sample */
+		*(out++) = ch->output;
 		ch->pos = X;
+		return 1;
+	}
+}
+
+/* Adds a decoded channel block to the stereo mix. The volumes are at most
+   127*127*127 >> 11, so they fit in 16 bits and each product in 32. */
+static void mix_channel(s32 *out, const s16 *in, int length, s32 volumel, s32 volumer)
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i vol = _mm_set1_epi32((volumer << 16) | (volumel & 0xFFFF));
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i lo = _mm_unpacklo_epi16(x, x);
+		__m128i hi = _mm_unpackhi_epi16(x, x);
+		__m128i plo = _mm_unpacklo_epi16(_mm_mullo_epi16(lo, vol), _mm_mulhi_epi16(lo, vol));
+		__m128i phi = _mm_unpackhi_epi16(_mm_mullo_epi16(lo, vol), _mm_mulhi_epi16(lo, vol));
+		__m128i qlo = _mm_unpacklo_epi16(_mm_mullo_epi16(hi, vol), _mm_mulhi_epi16(hi, vol));
+		__m128i qhi = _mm_unpackhi_epi16(_mm_mullo_epi16(hi, vol), _mm_mulhi_epi16(hi, vol));
+		__m128i *o = (__m128i *)(out + i * 2);
+		_mm_storeu_si128(o + 0, _mm_add_epi32(_mm_loadu_si128(o + 0), _mm_srai_epi32(plo, VOL_SHIFT)));
+		_mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1), _mm_srai_epi32(phi, VOL_SHIFT)));
+		_mm_storeu_si128(o + 2, _mm_add_epi32(_mm_loadu_si128(o + 2), _mm_srai_epi32(qlo, VOL_SHIFT)));
+		_mm_storeu_si128(o + 3, _mm_add_epi32(_mm_loadu_si128(o + 3), _mm_srai_epi32(qhi, VOL_SHIFT)));
+	}
+#endif
+	for (; i < length; i++)
+	{
+		out[i * 2 + 0] += (in[i] * volumel) >> VOL_SHIFT;
+		out[i * 2 + 1] += (in[i] * volumer) >> VOL_SHIFT;
 	}
 }
 
+static void clip_mix(s16 *out, const s32 *in, int length)
+{
+	int i = 0;
+#ifdef __SSE2__
+	/* packs saturates to the same -0x8000..0x7fff range as clipping() */
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+	}
+#endif
+	for (; i < length; i++)
+		out[i] = (s16)clipping(in[i], -0x8000, 0x7fff);
+}
 
 
-void SPU_EmulateSamples(u32 numsamples)
+
+u32 SPU_MixSamples(s16 *buffer, u32 numsamples)
 {
 	u32 sizesmp = numsamples;
 	u32 sizebyte = sizesmp << 2;
@@ -855,33 +878,41 @@ void SPU_EmulateSamples(u32 numsamples)
 	{
 		unsigned i;
 		SChannel *ch = spu.ch;
-		memset(spu.pmixbuf, 0, spu.buflen * sizeof(s32));
+		memset(spu.pmixbuf, 0, sizesmp * 2 * sizeof(s32));
 		for (i = 0; i < 16; i++)
 		{
 			if (ch->status && ch->enabled)
 			{
+				int n = 0;
 				switch (ch->format)
 				{
 				case 0:
-					decode_pcm8(ch, spu.pmixbuf, sizesmp);
+					n = decode_pcm8(ch, spu.pchanbuf, sizesmp);
 					break;
 				case 1:
-					decode_pcm16(ch, spu.pmixbuf, sizesmp);
+					n = decode_pcm16(ch, spu.pchanbuf, sizesmp);
 					break;
 				case 2:
-					decode_adpcm(ch, spu.pmixbuf, sizesmp);
+					n = decode_adpcm(ch, spu.pchanbuf, sizesmp);
 					break;
 				case 3:
-					decode_psg(ch, spu.pmixbuf, sizesmp);
+					n = decode_psg(ch, spu.pchanbuf, sizesmp);
 					break;
 				}
+				mix_channel(spu.pmixbuf, spu.pchanbuf, n, ch->volumel, ch->volumer);
 			}
 			ch++;
 		}
-		for (i = 0; i < sizesmp * 2; i++)
-			spu.pclipingbuf[i] = (s16)clipping(spu.pmixbuf[i], -0x8000, 0x7fff);
-		SNDCore->UpdateAudio(spu.pclipingbuf, sizesmp);
+		clip_mix(buffer, spu.pmixbuf, sizesmp * 2);
 	}
+	return sizesmp;
+}
+
+void SPU_EmulateSamples(u32 numsamples)
+{
+	u32 sizesmp = SPU_MixSamples(spu.pclipingbuf, numsamples);
+	if (sizesmp > 0)
+		SNDCore->UpdateAudio(spu.pclipingbuf, sizesmp);
 }
 
 void SPU_Emulate(void)
@@ -23,6 +23,7 @@
 #include "thumb_instructions.h"
 #include "cp15.h"
 #include "bios.h"
+#include "mem.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -80,6 +81,92 @@ const unsigned char arm_cond_table[16*16] = {
 armcpu_t NDS_ARM7;
 armcpu_t NDS_ARM9;
 
+#ifndef GDB_STUB
+
+/* Decoded instruction cache. Every fetch from plain memory (ITCM, main RAM,
+   shared/ARM7 WRAM and the BIOS) keeps the instruction, its handler and a
+   host pointer to the word it was read from. A hit only has to check that
+   the word still holds the same instruction, so code written by either CPU
+   or by DMA is picked up without hooks in the MMU write paths.
+   IO, cartridge space and the ARM9 DTCM always go through the MMU. */
+
+#define ARMCPU_DECODED_SIZE 8192
+
+typedef struct
+{
+	u32 adr;		/* fetch address, bit 0 set for THUMB */
+	u32 instruction;
+	u8 *src;
+	u32 (FASTCALL *handler)(armcpu_t * cpu);
+} armcpu_decoded_t;
+
+static armcpu_decoded_t armcpu_decoded[2][ARMCPU_DECODED_SIZE];
+
+/* never equal to the instruction cached in an empty entry */
+static u32 armcpu_decoded_empty = 0;
+
+void armcpu_flushDecoded(armcpu_t *armcpu)
+{
+	armcpu_decoded_t *d = armcpu_decoded[armcpu->proc_ID];
+	u32 i;
+
+	for(i = 0; i < ARMCPU_DECODED_SIZE; ++i)
+	{
+		d[i].adr = 0;
+		d[i].instruction = 1;
+		d[i].src = (u8 *)&armcpu_decoded_empty;
+		d[i].handler = NULL;
+	}
+}
+
+static void armcpu_decode(armcpu_t *armcpu, armcpu_decoded_t *d, u32 adr, u32 thumb)
+{
+	u32 proc = armcpu->proc_ID;
+	u32 region;
+	u32 i;
+
+	if(thumb)
+	{
+		i = MMU_read16_acl(proc, adr, CP15_ACCESS_EXECUTE);
+		armcpu->instruction_handler = thumb_instructions_set[i>>6];
+	}
+	else
+	{
+		i = MMU_read32_acl(proc, adr, CP15_ACCESS_EXECUTE);
+		armcpu->instruction_handler = arm_instructions_set[INSTRUCTION_INDEX(i)];
+	}
+	armcpu->instruction = i;
+
+	region = (adr >> 24) & 0xF;
+	if((region > 3 && region != 0xF) || (proc == 0 && (adr & ~0x3FFF) == MMU.DTCMRegion))
+		return;
+
+	d->adr = adr | thumb;
+	d->instruction = i;
+	d->src = MMU.MMU_MEM[proc][(adr>>20)&0xFF] + (adr & MMU.MMU_MASK[proc][(adr>>20)&0xFF] & (thumb ? ~1 : ~3));
+	d->handler = armcpu->instruction_handler;
+}
+
+static INLINE void armcpu_fetch(armcpu_t *armcpu, u32 adr, u32 thumb)
+{
+	armcpu_decoded_t *d = &armcpu_decoded[armcpu->proc_ID][(adr >> (2 - thumb)) & (ARMCPU_DECODED_SIZE - 1)];
+	u32 i;
+
+	if(d->adr == (adr | thumb))
+	{
+		i = thumb ? T1ReadWord(d->src, 0) : T1ReadLong(d->src, 0);
+		if(i == d->instruction)
+		{
+			armcpu->instruction = i;
+			armcpu->instruction_handler = d->handler;
+			return;
+		}
+	}
+	armcpu_decode(armcpu, d, adr, thumb);
+}
+
+#endif
+
 #define SWAP(a, b, c) do      \
 	              {       \
                          c=a; \
@@ -240,6 +327,7 @@ void armcpu_init(armcpu_t *armcpu, u32 adr)
 	armcpu->coproc[15] = (armcp_t*)armcp15_new(armcpu);
 
 #ifndef GDB_STUB
+	armcpu_flushDecoded(armcpu);
 	armcpu_prefetch(armcpu);
 #endif
 }
@@ -351,7 +439,7 @@ u32 armcpu_switchMode(armcpu_t *armcpu, u8 mode)
 	return oldmode;
 }
 
-static u32
+u32
 armcpu_prefetch(armcpu_t *armcpu)
 {
 	u32 temp_instruction;
@@ -365,12 +453,13 @@ armcpu_prefetch(armcpu_t *armcpu)
 
 		if ( !armcpu->stalled) {
 			armcpu->instruction = temp_instruction;
+			armcpu->instruction_handler = arm_instructions_set[INSTRUCTION_INDEX(temp_instruction)];
 			armcpu->instruct_adr = armcpu->next_instruction;
 			armcpu->next_instruction += 4;
 			armcpu->R[15] = armcpu->next_instruction + 4;
 		}
 #else
-		armcpu->instruction = MMU_read32_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
+		armcpu_fetch(armcpu, armcpu->next_instruction, 0);
 
 		armcpu->instruct_adr = armcpu->next_instruction;
 		armcpu->next_instruction += 4;
@@ -387,12 +476,13 @@ armcpu_prefetch(armcpu_t *armcpu)
 
 	if ( !armcpu->stalled) {
 		armcpu->instruction = temp_instruction;
+		armcpu->instruction_handler = thumb_instructions_set[temp_instruction>>6];
 		armcpu->instruct_adr = armcpu->next_instruction;
 		armcpu->next_instruction = armcpu->next_instruction + 2;
 		armcpu->R[15] = armcpu->next_instruction + 2;
 	}
 #else
-	armcpu->instruction = MMU_read16_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
+	armcpu_fetch(armcpu, armcpu->next_instruction, 1);
 
 	armcpu->instruct_adr = armcpu->next_instruction;
 	armcpu->next_instruction += 2;
@@ -550,7 +640,7 @@ u32 armcpu_exec(armcpu_t *armcpu)
 /*        if((TEST_COND(CONDITION(armcpu->instruction), armcpu->CPSR)) || ((CONDITION(armcpu->instruction)==0xF)&&(CODE(armcpu->instruction)==0x5)))*/
         if((TEST_COND(CONDITION(armcpu->instruction), CODE(armcpu->instruction), armcpu->CPSR)))
 		{
-			c += arm_instructions_set[INSTRUCTION_INDEX(armcpu->instruction)](armcpu);
+			c += armcpu->instruction_handler(armcpu);
 		}
 #ifdef GDB_STUB
         if ( armcpu->post_ex_fn != NULL) {
@@ -564,7 +654,7 @@ u32 armcpu_exec(armcpu_t *armcpu)
 		return c;
 	}
 
-	c += thumb_instructions_set[armcpu->instruction>>6](armcpu);
+	c += armcpu->instruction_handler(armcpu);
 
 #ifdef GDB_STUB
     if ( armcpu->post_ex_fn != NULL) {
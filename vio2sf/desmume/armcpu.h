@@ -201,6 +201,9 @@ typedef struct armcpu_t
 
         u32 (* *swi_tab)(struct armcpu_t * cpu);
 
+        /* handler for the prefetched instruction */
+        u32 (FASTCALL *instruction_handler)(struct armcpu_t * cpu);
+
 #ifdef GDB_STUB
   /** there is a pending irq for the cpu */
   int irq_flag;
@@ -231,7 +234,8 @@ int armcpu_new( armcpu_t *armcpu, u32 id);
 #endif
 void armcpu_init(armcpu_t *armcpu, u32 adr);
 u32 armcpu_switchMode(armcpu_t *armcpu, u8 mode);
-static u32 armcpu_prefetch(armcpu_t *armcpu);
+u32 armcpu_prefetch(armcpu_t *armcpu);
+void armcpu_flushDecoded(armcpu_t *armcpu);
 u32 armcpu_exec(armcpu_t *armcpu);
 BOOL armcpu_irqExeption(armcpu_t *armcpu);
 //BOOL armcpu_prefetchExeption(armcpu_t *armcpu);
@@ -567,6 +567,10 @@ BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1,
 				case 0 :
 					armcp15->DTCMRegion = val;
 					MMU.DTCMRegion = val & 0x0FFFFFFC0;
+					MMU_updatePages(ARMCPU_ARM9);
+#ifndef GDB_STUB
+					armcpu_flushDecoded(armcp15->cpu);
+#endif
 					/*sprintf(logbuf, "%08X", val);
 					log::ajouter(logbuf);*/
 					return TRUE;
@@ -431,20 +431,7 @@ void gdb_stub_fix(armcpu_t *armcpu)
 {
   /* armcpu->R[15] = armcpu->instruct_adr; */
   armcpu->next_instruction = armcpu->instruct_adr;
-  if(armcpu->CPSR.bits.T == 0)
-    {
-      armcpu->instruction = MMU_read32_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
-      armcpu->instruct_adr = armcpu->next_instruction;
-      armcpu->next_instruction += 4;
-      armcpu->R[15] = armcpu->next_instruction + 4;
-    }
-  else
-    {
-      armcpu->instruction = MMU_read16_acl(armcpu->proc_ID, armcpu->next_instruction,CP15_ACCESS_EXECUTE);
-      armcpu->instruct_adr = armcpu->next_instruction;
-      armcpu->next_instruction += 2;
-      armcpu->R[15] = armcpu->next_instruction + 2;
-    }
+  armcpu_prefetch(armcpu);
 }
 
 static void load_setstate(void)
@@ -583,8 +570,9 @@ static struct
   int xfs_load;
   int sync_type;
   int arm7_clockdown_level;
+  int arm9_idle_skip;
   int arm9_clockdown_level;
-} sndifwork = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+} sndifwork = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
 static void SNDIFDeInit(void)
 {
@@ -661,6 +649,7 @@ int xsf_start(void *pfile, unsigned bytes)
   sndifwork.sync_type = xsf_tagget_int("_vio2sf_sync_type", pfile, bytes, 0);
   sndifwork.arm9_clockdown_level = xsf_tagget_int("_vio2sf_arm9_clockdown_level", pfile, bytes, clockdown);
   sndifwork.arm7_clockdown_level = xsf_tagget_int("_vio2sf_arm7_clockdown_level", pfile, bytes, clockdown);
+  sndifwork.arm9_idle_skip = xsf_tagget_int("_vio2sf_arm9_idle_skip", pfile, bytes, 1);
 
   sndifwork.xfs_load = 0;
   if (!load_psf(pfile, bytes))
@@ -684,6 +673,7 @@ int xsf_start(void *pfile, unsigned bytes)
     }
 
   NDS_Reset();
+  nds.ARM9IdleSkip = sndifwork.arm9_idle_skip;
 
   execute = TRUE;
 
@@ -851,7 +841,19 @@ int xsf_gen(void *pbuffer, unsigned samples)
 		}
 	      NDS_exec_hframe(sndifwork.arm9_clockdown_level, sndifwork.arm7_clockdown_level);
 	    }
-	  SPU_EmulateSamples(numsamples);
+	  if ((unsigned)numsamples << 2 <= bytes)
+	    {
+	      /* the whole frame fits: mix straight into the caller's buffer */
+	      unsigned mixbytes = SPU_MixSamples((s16 *)ptr, numsamples) << 2;
+	      ptr += mixbytes;
+	      bytes -= mixbytes;
+	    }
+	  else
+	    {
+	      /* keep the rest of the frame for the next call */
+	      sndifwork.filled = SPU_MixSamples((s16 *)sndifwork.pcmbuftop, numsamples) << 2;
+	      sndifwork.used = 0;
+	    }
 	}
     }
   return ptr - (unsigned char *)pbuffer;
@@ -862,6 +864,17 @@ void xsf_enable_channel(int channel, int enabled)
   SPU_EnableChannel(channel, enabled);
 }
 
+/* executed/skipped cycles per CPU (0 = ARM9, 1 = ARM7) since xsf_start */
+void xsf_get_cycle_stats(unsigned long long executed[2], unsigned long long skipped[2])
+{
+  int i;
+  for (i = 0; i < 2; i++)
+    {
+      executed[i] = nds.cyclesExecuted[i];
+      skipped[i] = nds.cyclesSkipped[i];
+    }
+}
+
 void xsf_term(void)
 {
   MMU_unsetRom();
@@ -5,4 +5,5 @@ int xsf_start(void *pfile, unsigned bytes);
 int xsf_gen(void *pbuffer, unsigned samples);
 int xsf_get_lib(char *pfilename, void **ppbuffer, unsigned int *plength);
 void xsf_enable_channel(int channel, int enabled);
+void xsf_get_cycle_stats(unsigned long long executed[2], unsigned long long skipped[2]);
 void xsf_term(void);